@@ -1,91 +1,366 @@
 #include "alu.hpp"
 
+#include <limits>
+#include <cmath>
+#include <cfenv>
+#include <bit>
+#include <concepts>
+#include <algorithm>
+
+#include <magic_enum.hpp>
+
+using namespace magic_enum::bitwise_operators;
+
+namespace arch::rv64 {
+    /* Upper half of the 128-bit product, a single host multiply where 128-bit integers exist */
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef __int128 int128;
+    __extension__ typedef unsigned __int128 uint128;
+
+    [[nodiscard]] uint64_t mul_high_unsigned(uint64_t a, uint64_t b) {
+        return uint64_t((uint128(a) * uint128(b)) >> 64);
+    }
+
+    [[nodiscard]] uint64_t mul_high_signed(uint64_t a, uint64_t b) {
+        return uint64_t((int128(int64_t(a)) * int128(int64_t(b))) >> 64);
+    }
+
+    [[nodiscard]] uint64_t mul_high_signed_unsigned(uint64_t a, uint64_t b) {
+        return uint64_t((int128(int64_t(a)) * int128(b)) >> 64);
+    }
+#else
+    [[nodiscard]] uint64_t mul_high_unsigned(uint64_t a, uint64_t b) {
+        uint64_t a_lo = a & 0xffffffff, a_hi = a >> 32;
+        uint64_t b_lo = b & 0xffffffff, b_hi = b >> 32;
+
+        uint64_t lo_lo = a_lo * b_lo;
+        uint64_t hi_lo = a_hi * b_lo;
+        uint64_t lo_hi = a_lo * b_hi;
+        uint64_t hi_hi = a_hi * b_hi;
+
+        uint64_t mid = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+        return hi_hi + (hi_lo >> 32) + (mid >> 32);
+    }
+
+    /* Two's complement correction of the unsigned product */
+    [[nodiscard]] uint64_t mul_high_signed(uint64_t a, uint64_t b) {
+        return mul_high_unsigned(a, b) - ((int64_t(a) < 0) ? b : 0) - ((int64_t(b) < 0) ? a : 0);
+    }
+
+    [[nodiscard]] uint64_t mul_high_signed_unsigned(uint64_t a, uint64_t b) {
+        return mul_high_unsigned(a, b) - ((int64_t(a) < 0) ? b : 0);
+    }
+#endif
+}
+
+namespace {
+    using arch::rv64::alu_op;
+    using arch::rv64::rounding_mode;
+
+    /* Single-precision values live in the lower half of a float register with all upper bits set */
+    constexpr uint64_t nan_box = 0xffffffff00000000;
+
+    template <std::floating_point T>
+    using float_bits = std::conditional_t<std::is_same_v<T, float>, uint32_t, uint64_t>;
+
+    /* Improperly boxed singles read as the canonical NaN */
+    template <std::floating_point T>
+    [[nodiscard]] T unbox(uint64_t val) {
+        if constexpr (std::is_same_v<T, float>) {
+            if ((val & nan_box) != nan_box) {
+                return std::numeric_limits<float>::quiet_NaN();
+            }
+
+            return std::bit_cast<float>(uint32_t(val));
+        } else {
+            return std::bit_cast<double>(val);
+        }
+    }
+
+    template <std::floating_point T>
+    [[nodiscard]] uint64_t box(T val) {
+        if constexpr (std::is_same_v<T, float>) {
+            return nan_box | std::bit_cast<uint32_t>(val);
+        } else {
+            return std::bit_cast<uint64_t>(val);
+        }
+    }
+
+    /* Arithmetic never propagates NaN payloads, unlike the host */
+    template <std::floating_point T>
+    [[nodiscard]] uint64_t box_canonical(T val) {
+        return box(std::isnan(val) ? std::numeric_limits<T>::quiet_NaN() : val);
+    }
+
+    template <std::floating_point T>
+    [[nodiscard]] bool signaling(T val) {
+        constexpr float_bits<T> quiet = float_bits<T> { 1 } << (std::numeric_limits<T>::digits - 2);
+        return std::isnan(val) && !(std::bit_cast<float_bits<T>>(val) & quiet);
+    }
+
+    template <std::floating_point T>
+    [[nodiscard]] uint64_t sign_inject(alu_op op, T a, T b) {
+        constexpr float_bits<T> sign = float_bits<T> { 1 } << (sizeof(T) * 8 - 1);
+
+        auto x = std::bit_cast<float_bits<T>>(a);
+        auto y = std::bit_cast<float_bits<T>>(b);
+
+        switch (op) {
+            case alu_op::fsgnj:  y = y & sign; break;
+            case alu_op::fsgnjn: y = ~y & sign; break;
+            default:             y = (x ^ y) & sign; break;
+        }
+
+        return box(std::bit_cast<T>(static_cast<float_bits<T>>((x & ~sign) | y)));
+    }
+
+    /* fmin/fmax return the non-NaN operand and order -0 below +0 */
+    template <std::floating_point T>
+    [[nodiscard]] uint64_t min_max(bool max, T a, T b) {
+        if (signaling(a) || signaling(b)) {
+            std::feraiseexcept(FE_INVALID);
+        }
+
+        if (std::isnan(a) && std::isnan(b)) {
+            return box(std::numeric_limits<T>::quiet_NaN());
+        } else if (std::isnan(a)) {
+            return box(b);
+        } else if (std::isnan(b)) {
+            return box(a);
+        } else if (a == b) {
+            return box((std::signbit(a) != max) ? a : b);
+        }
+
+        return box(max ? std::max(a, b) : std::min(a, b));
+    }
+
+    /* Comparisons are quiet for feq, signaling for flt and fle */
+    template <std::floating_point T>
+    [[nodiscard]] uint64_t compare(alu_op op, T a, T b) {
+        bool invalid = (op == alu_op::feq) ? (signaling(a) || signaling(b)) : (std::isnan(a) || std::isnan(b));
+        if (invalid) {
+            std::feraiseexcept(FE_INVALID);
+        }
+
+        switch (op) {
+            case alu_op::feq: return std::isnan(a) || std::isnan(b) ? 0 : (a == b);
+            case alu_op::flt: return std::isless(a, b);
+            default:          return std::islessequal(a, b);
+        }
+    }
+
+    template <std::floating_point T>
+    [[nodiscard]] uint64_t classify(T val) {
+        bool negative = std::signbit(val);
+
+        switch (std::fpclassify(val)) {
+            case FP_INFINITE:  return negative ? (1 << 0) : (1 << 7);
+            case FP_NORMAL:    return negative ? (1 << 1) : (1 << 6);
+            case FP_SUBNORMAL: return negative ? (1 << 2) : (1 << 5);
+            case FP_ZERO:      return negative ? (1 << 3) : (1 << 4);
+            default:           return signaling(val) ? (1 << 8) : (1 << 9);
+        }
+    }
+
+    /* Out of range values and NaN saturate and raise invalid instead of being UB like a plain cast.
+     * 32-bit results are sign-extended, even unsigned ones.
+     */
+    template <std::integral I, std::floating_point T>
+    [[nodiscard]] uint64_t float_to_int(T val, rounding_mode rm) {
+        constexpr T upper = T { 2 } * T(std::numeric_limits<I>::max() / 2 + 1);
+        constexpr T lower = T(std::numeric_limits<I>::min());
+
+        /* The host has no ties-to-max-magnitude mode, but it has a function for it */
+        T rounded = (rm == rounding_mode::rmm) ? std::round(val) : std::rint(val);
+
+        I res;
+        if (std::isnan(rounded) || rounded >= upper) {
+            std::feraiseexcept(FE_INVALID);
+            res = std::numeric_limits<I>::max();
+        } else if (rounded < lower) {
+            std::feraiseexcept(FE_INVALID);
+            res = std::numeric_limits<I>::min();
+        } else {
+            res = static_cast<I>(rounded);
+        }
+
+        return uint64_t(int64_t(std::conditional_t<sizeof(I) == 4, int32_t, int64_t>(res)));
+    }
+
+    template <std::floating_point T>
+    [[nodiscard]] uint64_t float_arith(alu_op op, uint64_t a, uint64_t b, uint64_t c) {
+        T x = unbox<T>(a);
+        T y = unbox<T>(b);
+        T z = unbox<T>(c);
+
+        switch (op) {
+            case alu_op::fadd:  return box_canonical<T>(x + y);
+            case alu_op::fsub:  return box_canonical<T>(x - y);
+            case alu_op::fmul:  return box_canonical<T>(x * y);
+            case alu_op::fdiv:  return box_canonical<T>(x / y);
+            case alu_op::fsqrt: return box_canonical<T>(std::sqrt(x));
+
+            /* Single rounding, a host FMA instruction where available */
+            case alu_op::madd:  return box_canonical<T>(std::fma(x, y, z));
+            case alu_op::msub:  return box_canonical<T>(std::fma(x, y, -z));
+            case alu_op::nmsub: return box_canonical<T>(std::fma(-x, y, z));
+            case alu_op::nmadd: return box_canonical<T>(std::fma(-x, y, -z));
+
+            case alu_op::fsgnj:
+            case alu_op::fsgnjn:
+            case alu_op::fsgnjx:
+                return sign_inject<T>(op, x, y);
+
+            case alu_op::fmin: return min_max<T>(false, x, y);
+            case alu_op::fmax: return min_max<T>(true, x, y);
+
+            /* Raw bits from an integer register */
+            case alu_op::fmv: return box(std::bit_cast<T>(static_cast<float_bits<T>>(a)));
+
+            /* Integer to float, rounded in the host's current mode */
+            case alu_op::fcvtw:  return box(static_cast<T>(int32_t(a)));
+            case alu_op::fcvtwu: return box(static_cast<T>(uint32_t(a)));
+            case alu_op::fcvtl:  return box(static_cast<T>(int64_t(a)));
+            case alu_op::fcvtlu: return box(static_cast<T>(a));
+
+            default:
+                throw arch::rv64::invalid_alu_op(a, b, op);
+        }
+    }
+}
+
 namespace arch::rv64 {
     void alu::pulse() {
         switch (_op) {
-            case alu_op::invalid:
-                throw invalid_alu_op(_a, _b, _op);
+            case alu_op::add:
+                _res = _a + _b;
+                break;
 
-            case alu_op::nop:
+            case alu_op::sub:
+                _res = _a - _b;
                 break;
 
-            case alu_op::forward_a:
-                _res = _a;
+            case alu_op::mul:
+                _res = _a * _b;
                 break;
 
-            case alu_op::forward_b:
-                _res = _b;
+            case alu_op::mulh:
+                _res = mul_high_signed(_a, _b);
                 break;
-            
-            case alu_op::add:
-                _res = _a + _b;
+
+            case alu_op::mulhsu:
+                _res = mul_high_signed_unsigned(_a, _b);
                 break;
 
-            case alu_op::sub:
-                _res = int64_t(_a) - int64_t(_b);
+            case alu_op::mulhu:
+                _res = mul_high_unsigned(_a, _b);
                 break;
 
+            /* Division never traps: dividing by zero gives all ones for the quotient and the
+             * dividend for the remainder, signed overflow gives the dividend and a zero remainder
+             */
             case alu_op::div:
-                _res = int64_t(_a) / int64_t(_b);
+                if (_b == 0) {
+                    _res = ~uint64_t { 0 };
+                } else if (int64_t(_a) == std::numeric_limits<int64_t>::min() && int64_t(_b) == -1) {
+                    _res = _a;
+                } else {
+                    _res = uint64_t(int64_t(_a) / int64_t(_b));
+                }
                 break;
 
             case alu_op::divu:
-                _res = _a / _b;
-                break;
-
-            case alu_op::mul:
-                _res = int64_t(_a) * int64_t(_b);
+                _res = (_b == 0) ? ~uint64_t { 0 } : (_a / _b);
                 break;
 
             case alu_op::rem:
-                _res = int64_t(_a) % int64_t(_b);
+                if (_b == 0) {
+                    _res = _a;
+                } else if (int64_t(_a) == std::numeric_limits<int64_t>::min() && int64_t(_b) == -1) {
+                    _res = 0;
+                } else {
+                    _res = uint64_t(int64_t(_a) % int64_t(_b));
+                }
                 break;
 
             case alu_op::remu:
-                _res = _a % _b;
+                _res = (_b == 0) ? _a : (_a % _b);
                 break;
 
-            case alu_op::addw:
-                _res = sign_extend<32>((_a + _b) & 0xffffffff);
+            /* Word variants operate on the lower 32 bits and sign-extend the result */
+            case alu_op::mulw:
+                _res = sign_extend<32>((_a * _b) & 0xffffffff);
                 break;
 
-            case alu_op::subw:
-                _res = sign_extend<32>(uint64_t(int64_t(_a) - int64_t(_b)) & 0xffffffff);
+            case alu_op::divw: {
+                int32_t a = int32_t(_a);
+                int32_t b = int32_t(_b);
+
+                if (b == 0) {
+                    _res = ~uint64_t { 0 };
+                } else if (a == std::numeric_limits<int32_t>::min() && b == -1) {
+                    _res = uint64_t(int64_t(a));
+                } else {
+                    _res = uint64_t(int64_t(a / b));
+                }
                 break;
+            }
+
+            case alu_op::divuw: {
+                uint32_t a = uint32_t(_a);
+                uint32_t b = uint32_t(_b);
 
-            case alu_op::eq:
-                _res = (_a == _b) ? 1 : 0;
+                _res = (b == 0) ? ~uint64_t { 0 } : sign_extend<32>(a / b);
                 break;
+            }
 
-            case alu_op::ne:
-                _res = (_a != _b) ? 1 : 0;
+            case alu_op::remw: {
+                int32_t a = int32_t(_a);
+                int32_t b = int32_t(_b);
+
+                if (b == 0) {
+                    _res = uint64_t(int64_t(a));
+                } else if (a == std::numeric_limits<int32_t>::min() && b == -1) {
+                    _res = 0;
+                } else {
+                    _res = uint64_t(int64_t(a % b));
+                }
                 break;
+            }
 
-            case alu_op::lt:
-                _res = (int64_t(_a) < int64_t(_b)) ? 1 : 0;
+            case alu_op::remuw: {
+                uint32_t a = uint32_t(_a);
+                uint32_t b = uint32_t(_b);
+
+                _res = sign_extend<32>((b == 0) ? a : (a % b));
                 break;
+            }
 
-            case alu_op::ge:
-                _res = (int64_t(_a) >= int64_t(_b)) ? 1 : 0;
+            case alu_op::addw:
+                _res = sign_extend<32>((_a + _b) & 0xffffffff);
                 break;
 
-            case alu_op::ltu:
-                _res = (_a < _b) ? 1 : 0;
+            case alu_op::subw:
+                _res = sign_extend<32>((_a - _b) & 0xffffffff);
                 break;
 
-            case alu_op::geu:
-                _res = (_a >= _b) ? 1 : 0;
+            case alu_op::slt:
+                _res = (int64_t(_a) < int64_t(_b)) ? 1 : 0;
+                break;
+
+            case alu_op::sltu:
+                _res = (_a < _b) ? 1 : 0;
                 break;
 
-            case alu_op::bitwise_xor:
+            case alu_op::bxor:
                 _res = _a ^ _b;
                 break;
 
-            case alu_op::bitwise_or:
+            case alu_op::bor:
                 _res = _a | _b;
                 break;
 
-            case alu_op::bitwise_and:
+            case alu_op::band:
                 _res = _a & _b;
                 break;
 
@@ -101,17 +376,168 @@ namespace arch::rv64 {
                 _res = int64_t(_a) >> (_b & 0b111111);
                 break;
 
+            /* Word shifts only look at the lower 32 bits of the input */
             case alu_op::sllw:
                 _res = sign_extend<32>((_a << (_b & 0b11111)) & 0xffffffff);
                 break;
 
             case alu_op::srlw:
-                _res = sign_extend<32>((_a >> (_b & 0b111111)) & 0xffffffff);
+                _res = sign_extend<32>(uint32_t(_a) >> (_b & 0b11111));
                 break;
 
             case alu_op::sraw:
-                _res = sign_extend<32>(static_cast<uint64_t>(int64_t(_a) >> (_b & 0b111111)) & 0xffffffff);
+                _res = uint64_t(int64_t(int32_t(_a) >> (_b & 0b11111)));
+                break;
+
+            /* Zba, a shifted index added to a base */
+            case alu_op::sh1add: _res = (_a << 1) + _b; break;
+            case alu_op::sh2add: _res = (_a << 2) + _b; break;
+            case alu_op::sh3add: _res = (_a << 3) + _b; break;
+
+            case alu_op::adduw:    _res = uint64_t(uint32_t(_a)) + _b;        break;
+            case alu_op::sh1adduw: _res = (uint64_t(uint32_t(_a)) << 1) + _b; break;
+            case alu_op::sh2adduw: _res = (uint64_t(uint32_t(_a)) << 2) + _b; break;
+            case alu_op::sh3adduw: _res = (uint64_t(uint32_t(_a)) << 3) + _b; break;
+
+            case alu_op::slliuw:
+                _res = uint64_t(uint32_t(_a)) << (_b & 0b111111);
+                break;
+
+            /* Zbb */
+            case alu_op::andn: _res = _a & ~_b;   break;
+            case alu_op::orn:  _res = _a | ~_b;   break;
+            case alu_op::xnor: _res = ~(_a ^ _b); break;
+
+            /* Counts of 0 yield the operand width, just like the host's lzcnt and tzcnt */
+            case alu_op::clz:   _res = std::countl_zero(_a);           break;
+            case alu_op::ctz:   _res = std::countr_zero(_a);           break;
+            case alu_op::cpop:  _res = std::popcount(_a);              break;
+            case alu_op::clzw:  _res = std::countl_zero(uint32_t(_a)); break;
+            case alu_op::ctzw:  _res = std::countr_zero(uint32_t(_a)); break;
+            case alu_op::cpopw: _res = std::popcount(uint32_t(_a));    break;
+
+            case alu_op::max:  _res = uint64_t(std::max(int64_t(_a), int64_t(_b))); break;
+            case alu_op::maxu: _res = std::max(_a, _b);                             break;
+            case alu_op::min:  _res = uint64_t(std::min(int64_t(_a), int64_t(_b))); break;
+            case alu_op::minu: _res = std::min(_a, _b);                             break;
+
+            case alu_op::sextb: _res = uint64_t(int64_t(int8_t(_a)));  break;
+            case alu_op::sexth: _res = uint64_t(int64_t(int16_t(_a))); break;
+            case alu_op::zexth: _res = uint16_t(_a);                   break;
+
+            case alu_op::rol:  _res = std::rotl(_a, int(_b & 0b111111)); break;
+            case alu_op::ror:  _res = std::rotr(_a, int(_b & 0b111111)); break;
+            case alu_op::rolw: _res = sign_extend<32>(std::rotl(uint32_t(_a), int(_b & 0b11111))); break;
+            case alu_op::rorw: _res = sign_extend<32>(std::rotr(uint32_t(_a), int(_b & 0b11111))); break;
+
+            case alu_op::orcb: {
+                _res = 0;
+                for (unsigned i = 0; i < 64; i += 8) {
+                    if ((_a >> i) & 0xff) {
+                        _res |= uint64_t { 0xff } << i;
+                    }
+                }
+                break;
+            }
+
+            case alu_op::rev8:
+                _res = std::byteswap(_a);
+                break;
+
+            default:
+                _pulse_float();
+                break;
+        }
+    }
+
+    void alu::set_host_rounding(rounding_mode rm) {
+        if (rm == _host_rm) {
+            return;
+        }
+
+        switch (rm) {
+            case rounding_mode::rtz: std::fesetround(FE_TOWARDZERO); break;
+            case rounding_mode::rdn: std::fesetround(FE_DOWNWARD); break;
+            case rounding_mode::rup: std::fesetround(FE_UPWARD); break;
+
+            /* Ties-to-max-magnitude only differs from this on exact ties, conversions handle it separately */
+            default: std::fesetround(FE_TONEAREST); break;
+        }
+
+        _host_rm = rm;
+    }
+
+    fflags alu::take_flags() {
+        int raised = std::fetestexcept(FE_ALL_EXCEPT);
+
+        if (!raised) {
+            return fflags::none;
+        }
+
+        std::feclearexcept(FE_ALL_EXCEPT);
+
+        fflags flags = fflags::none;
+        if (raised & FE_INEXACT)   { flags |= fflags::nx; }
+        if (raised & FE_UNDERFLOW) { flags |= fflags::uf; }
+        if (raised & FE_OVERFLOW)  { flags |= fflags::of; }
+        if (raised & FE_DIVBYZERO) { flags |= fflags::dz; }
+        if (raised & FE_INVALID)   { flags |= fflags::nv; }
+
+        return flags;
+    }
+
+    void alu::reset_host() {
+        std::fesetround(FE_TONEAREST);
+        std::feclearexcept(FE_ALL_EXCEPT);
+
+        _host_rm = rounding_mode::rne;
+    }
+
+    void alu::_pulse_float() {
+        if ((_rm & rounding_mode::invalid_mask) != rounding_mode::invalid_mask) {
+            set_host_rounding(_rm);
+        }
+
+        switch (_op) {
+            /* Float to integer, word variants produce a 32-bit integer */
+            case alu_op::fcvts:   _res = float_to_int<int64_t>(unbox<float>(_a), _rm);   break;
+            case alu_op::fcvtsu:  _res = float_to_int<uint64_t>(unbox<float>(_a), _rm);  break;
+            case alu_op::fcvtsw:  _res = float_to_int<int32_t>(unbox<float>(_a), _rm);   break;
+            case alu_op::fcvtsuw: _res = float_to_int<uint32_t>(unbox<float>(_a), _rm);  break;
+            case alu_op::fcvtd:   _res = float_to_int<int64_t>(unbox<double>(_a), _rm);  break;
+            case alu_op::fcvtdu:  _res = float_to_int<uint64_t>(unbox<double>(_a), _rm); break;
+            case alu_op::fcvtdw:  _res = float_to_int<int32_t>(unbox<double>(_a), _rm);  break;
+            case alu_op::fcvtduw: _res = float_to_int<uint32_t>(unbox<double>(_a), _rm); break;
+
+            case alu_op::fle:  _res = compare<double>(alu_op::fle, unbox<double>(_a), unbox<double>(_b)); break;
+            case alu_op::flt:  _res = compare<double>(alu_op::flt, unbox<double>(_a), unbox<double>(_b)); break;
+            case alu_op::feq:  _res = compare<double>(alu_op::feq, unbox<double>(_a), unbox<double>(_b)); break;
+            case alu_op::fles: _res = compare<float>(alu_op::fle, unbox<float>(_a), unbox<float>(_b));    break;
+            case alu_op::flts: _res = compare<float>(alu_op::flt, unbox<float>(_a), unbox<float>(_b));    break;
+            case alu_op::feqs: _res = compare<float>(alu_op::feq, unbox<float>(_a), unbox<float>(_b));    break;
+
+            case alu_op::fclass:  _res = classify(unbox<double>(_a)); break;
+            case alu_op::fclasss: _res = classify(unbox<float>(_a));  break;
+
+            /* f32 -> f64 is exact, f64 -> f32 rounds */
+            case alu_op::fconv:  _res = box_canonical<double>(unbox<float>(_a)); break;
+            case alu_op::fconvs: _res = box_canonical<float>(static_cast<float>(unbox<double>(_a))); break;
+
+            default: {
+                if ((_op & alu_op::float_op) != alu_op::float_op) {
+                    throw invalid_alu_op(_a, _b, _op);
+                }
+
+                /* Remaining float operations use word_op to select single precision */
+                alu_op base = _op & ~alu_op::word_op;
+
+                if ((_op & alu_op::word_op) == alu_op::word_op) {
+                    _res = float_arith<float>(base, _a, _b, _c);
+                } else {
+                    _res = float_arith<double>(base, _a, _b, _c);
+                }
                 break;
+            }
         }
     }
 }
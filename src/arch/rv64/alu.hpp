@@ -9,19 +9,51 @@ namespace arch::rv64 {
             : illegal_operation("illegal alu operation {} with: a = {}, b = {}", op, a, b) { }
     };
 
+    /* Upper 64 bits of the 128-bit product */
+    [[nodiscard]] uint64_t mul_high_unsigned(uint64_t a, uint64_t b);
+    [[nodiscard]] uint64_t mul_high_signed(uint64_t a, uint64_t b);
+    [[nodiscard]] uint64_t mul_high_signed_unsigned(uint64_t a, uint64_t b);
+
     class alu {
         uint64_t _a;
         uint64_t _b;
+        uint64_t _c;
         alu_op _op;
         uint64_t _res;
 
+        /* Rounding mode for float operations, invalid_mask if the operation doesn't round */
+        rounding_mode _rm = rounding_mode::invalid_mask;
+
+        /* Rounding mode the host thread is in, only switched when an operation needs another one */
+        rounding_mode _host_rm = rounding_mode::rne;
+
+        void _pulse_float();
+
         public:
         void set_a(uint64_t a) { _a = a; }
         void set_b(uint64_t b) { _b = b; }
         void set_op(alu_op op) { _op = op; }
 
+        /* Third operand of fused multiply-adds */
+        void set_c(uint64_t c) { _c = c; }
+
+        /* Must be a static rounding mode, dyn is resolved by the caller */
+        void set_rm(rounding_mode rm) { _rm = rm; }
+
         void pulse();
 
+        /* Exceptions the host raised since the last call, cleared afterwards.
+         * Float operations leave their flags in the host's sticky state, which
+         * belongs to the calling thread, so this runs on the hart's own thread.
+         */
+        [[nodiscard]] fflags take_flags();
+
+        /* Switch the host rounding mode, for float work done outside of the alu */
+        void set_host_rounding(rounding_mode rm);
+
+        /* Put the calling thread's rounding mode and flags in the state the alu expects */
+        void reset_host();
+
         [[nodiscard]] uint64_t a() const { return _a; }
         [[nodiscard]] uint64_t b() const { return _b; }
         [[nodiscard]] alu_op op() const { return _op; }
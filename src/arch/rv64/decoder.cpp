@@ -121,6 +121,113 @@ namespace arch::rv64 {
             default:
                 throw illegal_compressed_instruction(_pc, _instr, "decode compressed");
         }
+
+        _canonicalize_compressed();
+    }
+
+    void decoder::_canonicalize_compressed() {
+        /* The c.* decoders already produce the operands of the expanded instruction, this fills
+         * in the type, function code and opcode it would have had as a 32-bit instruction.
+         * Past this point only the formatter looks at the compressed encoding.
+         */
+        switch (_opcode) {
+            case opc::addi: {
+                _type = instr_type::I;
+
+                switch (_alu_op) {
+                    case alu_op::add:  _funct = 0b000; break;
+                    case alu_op::sll:  _funct = 0b001; break;
+                    case alu_op::srl:  _funct = 0b101; break;
+                    case alu_op::band: _funct = 0b111; break;
+
+                    case alu_op::sra:
+                        /* srai keeps its funct7 in the upper immediate bits */
+                        _funct = 0b101;
+                        _imm |= 0b010000000000;
+                        break;
+
+                    /* c.addiw */
+                    case alu_op::addw:
+                        _opcode = opc::addiw;
+                        _funct = 0b000;
+                        break;
+
+                    default: throw illegal_compressed_instruction(_pc, _instr, "canonical addi");
+                }
+
+                if (_opcode_compressed == opc::clui && _rd != reg::sp) {
+                    /* c.lui is decoded as an addi to zero */
+                    _type = instr_type::U;
+                    _opcode = opc::lui;
+                    _funct = 0;
+                }
+                break;
+            }
+
+            case opc::add: {
+                _type = instr_type::R;
+
+                switch (_alu_op) {
+                    case alu_op::add:  _funct = 0b0000000000; break;
+                    case alu_op::sub:  _funct = 0b0100000000; break;
+                    case alu_op::bxor: _funct = 0b0000000100; break;
+                    case alu_op::bor:  _funct = 0b0000000110; break;
+                    case alu_op::band: _funct = 0b0000000111; break;
+
+                    /* c.addw and c.subw */
+                    case alu_op::addw: _opcode = opc::addw; _funct = 0b0000000000; break;
+                    case alu_op::subw: _opcode = opc::addw; _funct = 0b0100000000; break;
+
+                    default: throw illegal_compressed_instruction(_pc, _instr, "canonical add");
+                }
+                break;
+            }
+
+            case opc::load:
+                _type = instr_type::I;
+                _alu_op = alu_op::add;
+
+                if ((_mem & mem_size::float_mask) == mem_size::float_mask) {
+                    _opcode = opc::fload;
+                }
+
+                _funct = static_cast<uint32_t>(_mem) & 0b111;
+                break;
+
+            case opc::store:
+                _type = instr_type::S;
+
+                /* c.sdsp is the only one that picks an unsigned size */
+                if (_mem == mem_size::u64) {
+                    _mem = mem_size::s64;
+                }
+
+                if ((_mem & mem_size::float_mask) == mem_size::float_mask) {
+                    _opcode = opc::fstore;
+                }
+
+                _funct = static_cast<uint32_t>(_mem) & 0b111;
+                break;
+
+            case opc::branch:
+                _type = instr_type::B;
+                _funct = static_cast<uint32_t>(_bcomp);
+                break;
+
+            case opc::jal:
+                _type = instr_type::J;
+                break;
+
+            case opc::jalr:
+            case opc::ecall:
+                /* c.jr, c.jalr and c.ebreak */
+                _type = instr_type::I;
+                _funct = 0;
+                break;
+
+            default:
+                throw illegal_compressed_instruction(_pc, _instr, "canonical opcode");
+        }
     }
 
     void decoder::_decode_regular() {
@@ -143,19 +250,42 @@ namespace arch::rv64 {
             case opc::load:
             case opc::jalr:
             case opc::addiw:
-            case opc::fload:
             case opc::ecall:
+            case opc::fence:
                 _decode_i();
                 break;
 
+            /* Vector loads and stores use the widths scalar float accesses don't */
+            case opc::fload:
+            case opc::fstore:
+                switch ((_instr >> 12) & 0b111) {
+                    case 0b010:
+                    case 0b011:
+                        if (_opcode == opc::fload) {
+                            _decode_i();
+                        } else {
+                            _decode_s();
+                        }
+                        break;
+
+                    default:
+                        _decode_v_mem();
+                        break;
+                }
+                break;
+
+            case opc::vector:
+                _decode_v();
+                break;
+
             case opc::add:
             case opc::addw:
             case opc::fadd:
+            case opc::amo:
                 _decode_r();
                 break;
 
             case opc::store:
-            case opc::fstore:
                 _decode_s();
                 break;
 
@@ -215,14 +345,44 @@ namespace arch::rv64 {
                     case 0b110: _alu_op = alu_op::bor;  break; /* ori   */
                     case 0b111: _alu_op = alu_op::band; break; /* andi  */
 
-                    case 0b001: /* slli */
-                        _imm &= 0b111111; /* Limit to 6 bits = 64 bits shift max */
-                        _alu_op = alu_op::sll;
+                    case 0b001: {
+                        /* Upper 6 bits select the operation, Zbb puts its single-operand ones here */
+                        switch (_imm & 0xfff) {
+                            case 0x600: _alu_op = alu_op::clz;   break; /* clz    */
+                            case 0x601: _alu_op = alu_op::ctz;   break; /* ctz    */
+                            case 0x602: _alu_op = alu_op::cpop;  break; /* cpop   */
+                            case 0x604: _alu_op = alu_op::sextb; break; /* sext.b */
+                            case 0x605: _alu_op = alu_op::sexth; break; /* sext.h */
+
+                            default: {
+                                if (_imm & ~0b111111) {
+                                    throw illegal_instruction(_pc, _instr, "slli shamt");
+                                }
+
+                                _alu_op = alu_op::sll; /* slli */
+                                break;
+                            }
+                        }
                         break;
+                    }
 
-                    case 0b101: /* srli, srai */
-                        _alu_op = (_imm & ~0b111111) ? alu_op::sra : alu_op::srl;
+                    case 0b101: {
+                        switch (_imm & 0xfff) {
+                            case 0x287: _alu_op = alu_op::orcb; break; /* orc.b */
+                            case 0x6b8: _alu_op = alu_op::rev8; break; /* rev8  */
+
+                            default: {
+                                switch ((_imm >> 6) & 0b111111) {
+                                    case 0b000000: _alu_op = alu_op::srl; break; /* srli */
+                                    case 0b010000: _alu_op = alu_op::sra; break; /* srai */
+                                    case 0b011000: _alu_op = alu_op::ror; break; /* rori */
+                                    default: throw illegal_instruction(_pc, _instr, "shift right funct");
+                                }
+                                break;
+                            }
+                        }
                         break;
+                    }
 
                     default: throw illegal_instruction(_pc, _instr, "addi funct");
                 }
@@ -233,23 +393,78 @@ namespace arch::rv64 {
                 switch (_funct) {
                     case 0b000: _alu_op = alu_op::addw; break; /* addiw */
 
-                    case 0b001: /* slliw */
-                        _imm &= 0b11111; /* Limit to 5 bits = 32-bit shift */
-                        _alu_op = alu_op::sllw;
+                    case 0b001: {
+                        switch (_imm & 0xfff) {
+                            case 0x600: _alu_op = alu_op::clzw;  break; /* clzw  */
+                            case 0x601: _alu_op = alu_op::ctzw;  break; /* ctzw  */
+                            case 0x602: _alu_op = alu_op::cpopw; break; /* cpopw */
+
+                            default: {
+                                /* slli.uw has a 6-bit shift amount like slli */
+                                if (((_imm >> 6) & 0b111111) == 0b000010) {
+                                    _alu_op = alu_op::slliuw;
+                                } else if (_imm & ~0b11111) {
+                                    throw illegal_instruction(_pc, _instr, "slliw shamt");
+                                } else {
+                                    _alu_op = alu_op::sllw; /* slliw */
+                                }
+                                break;
+                            }
+                        }
                         break;
+                    }
 
-                    case 0b101: /* srliw, sraiw */
-                        _alu_op = (_imm & ~0b11111) ? alu_op::sraw : alu_op::srlw;
+                    case 0b101: {
+                        switch ((_imm >> 5) & 0b1111111) {
+                            case 0b0000000: _alu_op = alu_op::srlw; break; /* srliw */
+                            case 0b0100000: _alu_op = alu_op::sraw; break; /* sraiw */
+                            case 0b0110000: _alu_op = alu_op::rorw; break; /* roriw */
+                            default: throw illegal_instruction(_pc, _instr, "shift right word funct");
+                        }
                         break;
+                    }
                     
                     default: throw illegal_instruction(_pc, _instr, "addiw funct");
                 }
                 break;
             }
 
-            case opc::ecall:
-                /* Do nothing */
+            case opc::ecall: {
+                switch (_funct) {
+                    case 0b000: /* ecall, ebreak */
+                        break;
+
+                    case 0b001: /* csrrw */
+                    case 0b010: /* csrrs */
+                    case 0b011: /* csrrc */
+                        _csr = static_cast<csr>(_imm & 0xfff);
+                        break;
+
+                    case 0b101: /* csrrwi */
+                    case 0b110: /* csrrsi */
+                    case 0b111: /* csrrci */
+                        /* The immediate takes the place of rs1 */
+                        _csr = static_cast<csr>(_imm & 0xfff);
+                        _imm = (_instr >> 15) & 0b11111;
+                        _rs1 = reg::zero;
+                        _alu_a = alu_input::imm;
+                        break;
+
+                    default: throw illegal_instruction(_pc, _instr, "system funct");
+                }
+                break;
+            }
+
+            case opc::fence: {
+                /* fence keeps fm, pred and succ in the immediate, fence.i ignores all fields */
+                switch (_funct) {
+                    case 0b000: break; /* fence   */
+                    case 0b001: break; /* fence.i */
+                    default: throw illegal_instruction(_pc, _instr, "fence funct");
+                }
+                _imm &= 0xfff;
                 break;
+            }
 
             default:
                 throw illegal_instruction(_pc, _instr, "decode I");
@@ -293,6 +508,22 @@ namespace arch::rv64 {
                     case 0b0000001110: _alu_op = alu_op::rem;    break; /* rem    */
                     case 0b0000001111: _alu_op = alu_op::remu;   break; /* remu   */
 
+                    /* Zba */
+                    case 0b0010000010: _alu_op = alu_op::sh1add; break; /* sh1add */
+                    case 0b0010000100: _alu_op = alu_op::sh2add; break; /* sh2add */
+                    case 0b0010000110: _alu_op = alu_op::sh3add; break; /* sh3add */
+
+                    /* Zbb */
+                    case 0b0100000111: _alu_op = alu_op::andn; break; /* andn */
+                    case 0b0100000110: _alu_op = alu_op::orn;  break; /* orn  */
+                    case 0b0100000100: _alu_op = alu_op::xnor; break; /* xnor */
+                    case 0b0000101100: _alu_op = alu_op::min;  break; /* min  */
+                    case 0b0000101101: _alu_op = alu_op::minu; break; /* minu */
+                    case 0b0000101110: _alu_op = alu_op::max;  break; /* max  */
+                    case 0b0000101111: _alu_op = alu_op::maxu; break; /* maxu */
+                    case 0b0110000001: _alu_op = alu_op::rol;  break; /* rol  */
+                    case 0b0110000101: _alu_op = alu_op::ror;  break; /* ror  */
+
                     default: throw illegal_instruction(_pc, _instr, "add funct");
                 }
                 break;
@@ -313,12 +544,59 @@ namespace arch::rv64 {
                     case 0b0000001101: _alu_op = alu_op::divuw; break; /* divuw */
                     case 0b0000001110: _alu_op = alu_op::remw;  break; /* remw  */
                     case 0b0000001111: _alu_op = alu_op::remuw; break; /* remuw */
+
+                    /* Zba */
+                    case 0b0000100000: _alu_op = alu_op::adduw;    break; /* add.uw    */
+                    case 0b0010000010: _alu_op = alu_op::sh1adduw; break; /* sh1add.uw */
+                    case 0b0010000100: _alu_op = alu_op::sh2adduw; break; /* sh2add.uw */
+                    case 0b0010000110: _alu_op = alu_op::sh3adduw; break; /* sh3add.uw */
+
+                    /* Zbb */
+                    case 0b0110000001: _alu_op = alu_op::rolw; break; /* rolw */
+                    case 0b0110000101: _alu_op = alu_op::rorw; break; /* rorw */
+
+                    case 0b0000100100: /* zext.h */
+                        if (_rs2 != reg::zero) {
+                            throw illegal_instruction(_pc, _instr, "zext.h rs2");
+                        }
+                        _alu_op = alu_op::zexth;
+                        break;
                     
                     default: throw illegal_instruction(_pc, _instr, "addw funct");
                 }
                 break;
             }
 
+            case opc::amo: {
+                /* Only word and doubleword widths exist, aq and rl sit below funct5 */
+                switch (_funct & 0b111) {
+                    case 0b010: _mem = mem_size::s32; break;
+                    case 0b011: _mem = mem_size::s64; break;
+                    default: throw illegal_instruction(_pc, _instr, "amo width");
+                }
+
+                switch (_funct >> 5) {
+                    case 0b00010: _amo = amo_op::lr;   break; /* lr      */
+                    case 0b00011: _amo = amo_op::sc;   break; /* sc      */
+                    case 0b00001: _amo = amo_op::swap; break; /* amoswap */
+                    case 0b00000: _amo = amo_op::add;  break; /* amoadd  */
+                    case 0b00100: _amo = amo_op::bxor; break; /* amoxor  */
+                    case 0b01100: _amo = amo_op::band; break; /* amoand  */
+                    case 0b01000: _amo = amo_op::bor;  break; /* amoor   */
+                    case 0b10000: _amo = amo_op::min;  break; /* amomin  */
+                    case 0b10100: _amo = amo_op::max;  break; /* amomax  */
+                    case 0b11000: _amo = amo_op::minu; break; /* amominu */
+                    case 0b11100: _amo = amo_op::maxu; break; /* amomaxu */
+
+                    default: throw illegal_instruction(_pc, _instr, "amo funct");
+                }
+
+                if (_amo == amo_op::lr && _rs2 != reg::zero) {
+                    throw illegal_instruction(_pc, _instr, "lr rs2");
+                }
+                break;
+            }
+
             case opc::fadd: {
                 /* Upper 4 bits dictate some properties, MSB first:
                 * [] Integer input if integer flag is set, else integer output
@@ -562,7 +840,7 @@ namespace arch::rv64 {
         /* imm[20] */
         imm |= (_instr >> 11) & (0b1 << 20);
 
-        _imm = sign_extend<20>(imm);
+        _imm = sign_extend<21>(imm);
     }
 
     void decoder::_decode_s() {
@@ -629,6 +907,341 @@ namespace arch::rv64 {
         }
     }
 
+    void decoder::_decode_v() {
+        _type = instr_type::R;
+        _funct = (_instr >> 12) & 0b111;
+
+        if (_funct == 0b111) {
+            _decode_v_config();
+            return;
+        }
+
+        uint32_t funct6 = _instr >> 26;
+        auto scalar = static_cast<reg>((_instr >> 15) & REG_MASK);
+
+        /* Only instructions producing a scalar write rd */
+        _rd = reg::zero;
+        _rs1 = reg::zero;
+
+        switch (_funct) {
+            case 0b000: _vsrc = vector_operand::vector; break; /* OPIVV */
+            case 0b001: _vsrc = vector_operand::vector; break; /* OPFVV */
+            case 0b010: _vsrc = vector_operand::vector; break; /* OPMVV */
+
+            case 0b011: /* OPIVI */
+                _vsrc = vector_operand::imm;
+                _imm = sign_extend<5>((_instr >> 15) & REG_MASK);
+                break;
+
+            case 0b100: /* OPIVX */
+            case 0b110: /* OPMVX */
+                _vsrc = vector_operand::scalar;
+                _rs1 = scalar;
+                break;
+
+            case 0b101: /* OPFVF */
+                _vsrc = vector_operand::scalar;
+                _rs1 = scalar | reg::float_mask;
+                break;
+        }
+
+        /* Vector float operations have no static rounding mode */
+        if (_funct == 0b001 || _funct == 0b101) {
+            _fround = rounding_mode::dyn;
+        }
+
+        bool vv = _vsrc == vector_operand::vector;
+        bool vi = _vsrc == vector_operand::imm;
+
+        switch (_funct) {
+            /* OPIVV, OPIVX, OPIVI */
+            case 0b000:
+            case 0b011:
+            case 0b100: {
+                switch (funct6) {
+                    case 0b000000: _vop = vector_op::add;  break;
+                    case 0b000010: _vop = vector_op::sub;  break;
+                    case 0b000011: _vop = vector_op::rsub; break;
+                    case 0b000100: _vop = vector_op::minu; break;
+                    case 0b000101: _vop = vector_op::min;  break;
+                    case 0b000110: _vop = vector_op::maxu; break;
+                    case 0b000111: _vop = vector_op::max;  break;
+                    case 0b001001: _vop = vector_op::band; break;
+                    case 0b001010: _vop = vector_op::bor;  break;
+                    case 0b001011: _vop = vector_op::bxor; break;
+                    case 0b001110: _vop = vector_op::slideup;   break;
+                    case 0b001111: _vop = vector_op::slidedown; break;
+                    case 0b010111: _vop = vector_op::merge; break;
+                    case 0b011000: _vop = vector_op::mseq;  break;
+                    case 0b011001: _vop = vector_op::msne;  break;
+                    case 0b011010: _vop = vector_op::msltu; break;
+                    case 0b011011: _vop = vector_op::mslt;  break;
+                    case 0b011100: _vop = vector_op::msleu; break;
+                    case 0b011101: _vop = vector_op::msle;  break;
+                    case 0b011110: _vop = vector_op::msgtu; break;
+                    case 0b011111: _vop = vector_op::msgt;  break;
+                    case 0b100101: _vop = vector_op::sll; break;
+                    case 0b101000: _vop = vector_op::srl; break;
+                    case 0b101001: _vop = vector_op::sra; break;
+                    default: throw illegal_instruction(_pc, _instr, "opi funct6");
+                }
+
+                /* Forms that are reserved for some operand categories */
+                switch (_vop) {
+                    case vector_op::sub:
+                    case vector_op::minu:
+                    case vector_op::min:
+                    case vector_op::maxu:
+                    case vector_op::max:
+                    case vector_op::msltu:
+                    case vector_op::mslt:
+                        if (vi) { throw illegal_instruction(_pc, _instr, "opi immediate"); }
+                        break;
+
+                    case vector_op::rsub:
+                    case vector_op::slideup:
+                    case vector_op::slidedown:
+                    case vector_op::msgtu:
+                    case vector_op::msgt:
+                        if (vv) { throw illegal_instruction(_pc, _instr, "opi vector"); }
+                        break;
+
+                    default:
+                        break;
+                }
+                break;
+            }
+
+            /* OPMVV, OPMVX */
+            case 0b010:
+            case 0b110: {
+                switch (funct6) {
+                    case 0b100000: _vop = vector_op::divu;   break;
+                    case 0b100001: _vop = vector_op::div;    break;
+                    case 0b100010: _vop = vector_op::remu;   break;
+                    case 0b100011: _vop = vector_op::rem;    break;
+                    case 0b100100: _vop = vector_op::mulhu;  break;
+                    case 0b100101: _vop = vector_op::mul;    break;
+                    case 0b100110: _vop = vector_op::mulhsu; break;
+                    case 0b100111: _vop = vector_op::mulh;   break;
+                    case 0b101001: _vop = vector_op::madd;   break;
+                    case 0b101011: _vop = vector_op::nmsub;  break;
+                    case 0b101101: _vop = vector_op::macc;   break;
+                    case 0b101111: _vop = vector_op::nmsac;  break;
+
+                    case 0b001110: _vop = vv ? vector_op::invalid : vector_op::slide1up;   break;
+                    case 0b001111: _vop = vv ? vector_op::invalid : vector_op::slide1down; break;
+
+                    case 0b000000: _vop = vv ? vector_op::redsum  : vector_op::invalid; break;
+                    case 0b000001: _vop = vv ? vector_op::redand  : vector_op::invalid; break;
+                    case 0b000010: _vop = vv ? vector_op::redor   : vector_op::invalid; break;
+                    case 0b000011: _vop = vv ? vector_op::redxor  : vector_op::invalid; break;
+                    case 0b000100: _vop = vv ? vector_op::redminu : vector_op::invalid; break;
+                    case 0b000101: _vop = vv ? vector_op::redmin  : vector_op::invalid; break;
+                    case 0b000110: _vop = vv ? vector_op::redmaxu : vector_op::invalid; break;
+                    case 0b000111: _vop = vv ? vector_op::redmax  : vector_op::invalid; break;
+
+                    case 0b011000: _vop = vv ? vector_op::mandn : vector_op::invalid; break;
+                    case 0b011001: _vop = vv ? vector_op::mand  : vector_op::invalid; break;
+                    case 0b011010: _vop = vv ? vector_op::mor   : vector_op::invalid; break;
+                    case 0b011011: _vop = vv ? vector_op::mxor  : vector_op::invalid; break;
+                    case 0b011100: _vop = vv ? vector_op::morn  : vector_op::invalid; break;
+                    case 0b011101: _vop = vv ? vector_op::mnand : vector_op::invalid; break;
+                    case 0b011110: _vop = vv ? vector_op::mnor  : vector_op::invalid; break;
+                    case 0b011111: _vop = vv ? vector_op::mxnor : vector_op::invalid; break;
+
+                    /* VWXUNARY0 and VRXUNARY0, vs1 or vs2 select the operation */
+                    case 0b010000: {
+                        if (!vv) {
+                            _vop = (vs2() == 0) ? vector_op::mv_s_x : vector_op::invalid;
+                            break;
+                        }
+
+                        switch (vs1()) {
+                            case 0b00000: _vop = vector_op::mv_x_s; break;
+                            case 0b10000: _vop = vector_op::cpop;   break;
+                            case 0b10001: _vop = vector_op::first;  break;
+                            default:      _vop = vector_op::invalid; break;
+                        }
+
+                        _rd = static_cast<reg>(vd());
+                        break;
+                    }
+
+                    /* VMUNARY0 */
+                    case 0b010100:
+                        _vop = (vv && vs1() == 0b10001 && vs2() == 0) ? vector_op::id : vector_op::invalid;
+                        break;
+
+                    default: throw illegal_instruction(_pc, _instr, "opm funct6");
+                }
+                break;
+            }
+
+            /* OPFVV, OPFVF */
+            case 0b001:
+            case 0b101: {
+                switch (funct6) {
+                    case 0b000000: _vop = vector_op::fadd;   break;
+                    case 0b000010: _vop = vector_op::fsub;   break;
+                    case 0b000100: _vop = vector_op::fmin;   break;
+                    case 0b000110: _vop = vector_op::fmax;   break;
+                    case 0b001000: _vop = vector_op::fsgnj;  break;
+                    case 0b001001: _vop = vector_op::fsgnjn; break;
+                    case 0b001010: _vop = vector_op::fsgnjx; break;
+                    case 0b011000: _vop = vector_op::mfeq;   break;
+                    case 0b011001: _vop = vector_op::mfle;   break;
+                    case 0b011011: _vop = vector_op::mflt;   break;
+                    case 0b011100: _vop = vector_op::mfne;   break;
+                    case 0b100000: _vop = vector_op::fdiv;   break;
+                    case 0b100100: _vop = vector_op::fmul;   break;
+                    case 0b101000: _vop = vector_op::fmadd;  break;
+                    case 0b101001: _vop = vector_op::fnmadd; break;
+                    case 0b101010: _vop = vector_op::fmsub;  break;
+                    case 0b101011: _vop = vector_op::fnmsub; break;
+                    case 0b101100: _vop = vector_op::fmacc;  break;
+                    case 0b101101: _vop = vector_op::fnmacc; break;
+                    case 0b101110: _vop = vector_op::fmsac;  break;
+                    case 0b101111: _vop = vector_op::fnmsac; break;
+
+                    case 0b000001: _vop = vv ? vector_op::fredusum : vector_op::invalid; break;
+                    case 0b000011: _vop = vv ? vector_op::fredosum : vector_op::invalid; break;
+                    case 0b000101: _vop = vv ? vector_op::fredmin  : vector_op::invalid; break;
+                    case 0b000111: _vop = vv ? vector_op::fredmax  : vector_op::invalid; break;
+
+                    case 0b001110: _vop = vv ? vector_op::invalid : vector_op::fslide1up;   break;
+                    case 0b001111: _vop = vv ? vector_op::invalid : vector_op::fslide1down; break;
+                    case 0b010111: _vop = vv ? vector_op::invalid : vector_op::fmerge; break;
+                    case 0b011101: _vop = vv ? vector_op::invalid : vector_op::mfgt;   break;
+                    case 0b011111: _vop = vv ? vector_op::invalid : vector_op::mfge;   break;
+                    case 0b100001: _vop = vv ? vector_op::invalid : vector_op::frdiv;  break;
+                    case 0b100111: _vop = vv ? vector_op::invalid : vector_op::frsub;  break;
+
+                    /* VWFUNARY0 and VRFUNARY0 */
+                    case 0b010000:
+                        if (vv) {
+                            _vop = (vs1() == 0) ? vector_op::fmv_f_s : vector_op::invalid;
+                            _rd = static_cast<reg>(vd()) | reg::float_mask;
+                        } else {
+                            _vop = (vs2() == 0) ? vector_op::fmv_s_f : vector_op::invalid;
+                        }
+                        break;
+
+                    default: throw illegal_instruction(_pc, _instr, "opf funct6");
+                }
+                break;
+            }
+
+            default: throw illegal_instruction(_pc, _instr, "vector funct");
+        }
+
+        if (_vop == vector_op::invalid) {
+            throw illegal_instruction(_pc, _instr, "vector operand category");
+        }
+
+        /* vmv.v and vfmv.v are the unmasked merges, they only take the scalar or vs1 operand */
+        if ((_vop == vector_op::merge || _vop == vector_op::fmerge) && !masked() && vs2() != 0) {
+            throw illegal_instruction(_pc, _instr, "vmv vs2");
+        }
+    }
+
+    void decoder::_decode_v_config() {
+        _rd = static_cast<reg>((_instr >> 7) & REG_MASK);
+        _rs1 = static_cast<reg>((_instr >> 15) & REG_MASK);
+
+        if (!(_instr >> 31)) {
+            _vop = vector_op::vsetvli;
+            _vtype = (_instr >> 20) & 0x7ff;
+        } else if ((_instr >> 30) == 0b11) {
+            /* The AVL is an immediate in place of rs1 */
+            _vop = vector_op::vsetivli;
+            _vtype = (_instr >> 20) & 0x3ff;
+            _imm = (_instr >> 15) & REG_MASK;
+            _rs1 = reg::zero;
+        } else if ((_instr >> 25) == 0b1000000) {
+            _vop = vector_op::vsetvl;
+            _rs2 = static_cast<reg>((_instr >> 20) & REG_MASK);
+        } else {
+            throw illegal_instruction(_pc, _instr, "vsetvl");
+        }
+    }
+
+    void decoder::_decode_v_mem() {
+        _type = (_opcode == opc::fload) ? instr_type::I : instr_type::S;
+        _vop = (_opcode == opc::fload) ? vector_op::load : vector_op::store;
+        _opcode = opc::vector;
+
+        _funct = (_instr >> 12) & 0b111;
+        _rs1 = static_cast<reg>((_instr >> 15) & REG_MASK);
+        _imm = 0;
+
+        switch (_funct) {
+            case 0b000: _mem = mem_size::s8;  break;
+            case 0b101: _mem = mem_size::s16; break;
+            case 0b110: _mem = mem_size::s32; break;
+            case 0b111: _mem = mem_size::s64; break;
+            default: throw illegal_instruction(_pc, _instr, "vector width");
+        }
+
+        if ((_instr >> 28) & 1) {
+            throw illegal_instruction(_pc, _instr, "vector mew");
+        }
+
+        bool segment = (_instr >> 29) != 0;
+        bool load = _vop == vector_op::load;
+
+        switch ((_instr >> 26) & 0b11) {
+            case 0b00: {
+                switch ((_instr >> 20) & REG_MASK) {
+                    /* Fault-only-first loads never fault past the first element here, so they're plain loads */
+                    case 0b10000:
+                        if (!load) {
+                            throw illegal_instruction(_pc, _instr, "vector store mode");
+                        }
+                        [[fallthrough]];
+
+                    case 0b00000:
+                        _vaddr = vector_addressing::unit;
+                        break;
+
+                    case 0b01000: {
+                        _vaddr = vector_addressing::whole;
+
+                        size_t count = vregs();
+                        if (masked() || (count & (count - 1)) || (!load && _funct != 0b000)) {
+                            throw illegal_instruction(_pc, _instr, "whole register access");
+                        }
+
+                        segment = false;
+                        break;
+                    }
+
+                    case 0b01011:
+                        _vaddr = vector_addressing::mask;
+
+                        if (masked() || _funct != 0b000) {
+                            throw illegal_instruction(_pc, _instr, "mask access");
+                        }
+                        break;
+
+                    default: throw illegal_instruction(_pc, _instr, "vector unit-stride mode");
+                }
+                break;
+            }
+
+            case 0b10:
+                _vaddr = vector_addressing::strided;
+                _rs2 = static_cast<reg>((_instr >> 20) & REG_MASK);
+                break;
+
+            default: throw illegal_instruction(_pc, _instr, "indexed vector access");
+        }
+
+        if (segment) {
+            throw illegal_instruction(_pc, _instr, "segment vector access");
+        }
+    }
+
     void decoder::_decode_ci() {
         _ctype = compressed_type::CI;
 
@@ -33,11 +33,20 @@ namespace arch::rv64 {
 
         branch_comp _bcomp = branch_comp::none;
         mem_size _mem{};
+
+        amo_op _amo{};
+        csr _csr{};
+
+        vector_op _vop{};
+        vector_operand _vsrc{};
+        vector_addressing _vaddr{};
+        uint64_t _vtype{};
         
         float_fmt _ffmt{};
         rounding_mode _fround = rounding_mode::invalid_mask;
 
         void _decode_compressed();
+        void _canonicalize_compressed();
         void _decode_regular();
 
         void _decode_i();
@@ -47,6 +56,9 @@ namespace arch::rv64 {
         void _decode_s();
         void _decode_b();
         void _decode_r4();
+        void _decode_v();
+        void _decode_v_config();
+        void _decode_v_mem();
 
         void _decode_ci();
         void _decode_cr();
@@ -75,7 +87,11 @@ namespace arch::rv64 {
         [[nodiscard]] uintptr_t pc() const { return _pc; }
         [[nodiscard]] uint32_t instr() const { return _instr; }
 
+        /* Compressed instructions decode to their 32-bit equivalent, this and the size are
+         * all that's left of the encoding outside of ctype() and opcode_compressed()
+         */
         [[nodiscard]] bool compressed() const { return _compressed; }
+        [[nodiscard]] uintptr_t size() const { return _compressed ? 2 : 4; }
         [[nodiscard]] static bool compressed(uint16_t half) { return !((half & 0b11) == OPC_FULL_SIZE); }
 
         [[nodiscard]] instr_type type() const { return _type; }
@@ -102,6 +118,32 @@ namespace arch::rv64 {
         [[nodiscard]] branch_comp comparison() const { return _bcomp; }
         [[nodiscard]] mem_size memory() const { return _mem; }
 
+        /* Atomic memory operation and its ordering bits */
+        [[nodiscard]] amo_op amo() const { return _amo; }
+        [[nodiscard]] bool acquire() const { return (_funct >> 4) & 1; }
+        [[nodiscard]] bool release() const { return (_funct >> 3) & 1; }
+
+        /* CSR instructions, the source is rs1 or a 5-bit immediate depending on a() */
+        [[nodiscard]] csr_op csr_operation() const { return static_cast<csr_op>(_funct & 0b11); }
+        [[nodiscard]] csr csr_addr() const { return _csr; }
+
+        /* V extension. vd, vs1 and vs2 are vector register numbers, rd and rs1 are the scalar
+         * registers involved, if any, and the width of loads and stores is in memory()
+         */
+        [[nodiscard]] vector_op vop() const { return _vop; }
+        [[nodiscard]] vector_operand voperand() const { return _vsrc; }
+        [[nodiscard]] vector_addressing vaddressing() const { return _vaddr; }
+        [[nodiscard]] uint8_t vd() const { return (_instr >> 7) & REG_MASK; }
+        [[nodiscard]] uint8_t vs1() const { return (_instr >> 15) & REG_MASK; }
+        [[nodiscard]] uint8_t vs2() const { return (_instr >> 20) & REG_MASK; }
+        [[nodiscard]] bool masked() const { return !((_instr >> 25) & 1); }
+
+        /* Number of registers moved by whole register loads and stores */
+        [[nodiscard]] size_t vregs() const { return ((_instr >> 29) & 0b111) + 1; }
+
+        /* vtype immediate of vsetvli and vsetivli */
+        [[nodiscard]] uint64_t vtype() const { return _vtype; }
+
         [[nodiscard]] float_fmt float_type() const { return _ffmt; }
         [[nodiscard]] rounding_mode rm() const { return _fround; }
     };
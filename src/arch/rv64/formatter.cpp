@@ -2,6 +2,8 @@
 
 #include "decoder.hpp"
 
+#include <string>
+
 #include <fmt/ostream.h>
 
 #include <magic_enum.hpp>
@@ -11,6 +13,64 @@ using namespace magic_enum::bitwise_operators;
 namespace {
     using namespace arch::rv64;
 
+    /* Set bits of a fence predecessor or successor set, as "iorw" */
+    [[nodiscard]] std::string fence_set(uint64_t bits) {
+        std::string res;
+
+        if (bits & 0b1000) { res += 'i'; }
+        if (bits & 0b0100) { res += 'o'; }
+        if (bits & 0b0010) { res += 'r'; }
+        if (bits & 0b0001) { res += 'w'; }
+
+        return res.empty() ? "0" : res;
+    }
+
+    [[nodiscard]] std::string_view amo_ordering(const decoder& dec) {
+        if (dec.acquire() && dec.release()) {
+            return ".aqrl";
+        } else if (dec.acquire()) {
+            return ".aq";
+        } else if (dec.release()) {
+            return ".rl";
+        }
+
+        return "";
+    }
+
+    /* Zbb operations that only print rd and rs1 */
+    [[nodiscard]] bool single_operand(alu_op op) {
+        switch (op) {
+            case alu_op::clz:
+            case alu_op::ctz:
+            case alu_op::cpop:
+            case alu_op::clzw:
+            case alu_op::ctzw:
+            case alu_op::cpopw:
+            case alu_op::sextb:
+            case alu_op::sexth:
+            case alu_op::zexth:
+            case alu_op::orcb:
+            case alu_op::rev8:
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    /* Unknown CSRs are printed by number, like objdump does */
+    [[nodiscard]] std::string csr_name(csr addr) {
+        switch (addr) {
+            case csr::fflags:  return "fflags";
+            case csr::frm:     return "frm";
+            case csr::fcsr:    return "fcsr";
+            case csr::cycle:   return "cycle";
+            case csr::time:    return "time";
+            case csr::instret: return "instret";
+            default:           return fmt::format("{:#x}", static_cast<uint16_t>(addr));
+        }
+    }
+
     [[nodiscard]] std::string_view instr_name_regular(const decoder& dec) {
         switch (dec.opcode()) {
             case opc::lui:   return "lui";
@@ -64,13 +124,28 @@ namespace {
                     case 0b100: return "xori";
                     case 0b110: return "ori";
                     case 0b111: return "andi";
-                    case 0b001: return "slli";
-                    case 0b101:
-                        if (dec.imm() & ~0b111111) {
-                            return "srai";
-                        } else {
-                            return "srli";
+                    case 0b001: {
+                        switch (dec.imm() & 0xfff) {
+                            case 0x600: return "clz";
+                            case 0x601: return "ctz";
+                            case 0x602: return "cpop";
+                            case 0x604: return "sext.b";
+                            case 0x605: return "sext.h";
+                            default:    return "slli";
+                        }
+                    }
+                    case 0b101: {
+                        switch (dec.imm() & 0xfff) {
+                            case 0x287: return "orc.b";
+                            case 0x6b8: return "rev8";
                         }
+
+                        switch ((dec.imm() >> 6) & 0b111111) {
+                            case 0b010000: return "srai";
+                            case 0b011000: return "rori";
+                            default:       return "srli";
+                        }
+                    }
                     default: throw illegal_instruction(dec.pc(), dec.instr(), "unknown funct code (addi)");
                 }
                 break;
@@ -79,13 +154,22 @@ namespace {
             case opc::addiw: {
                 switch (dec.funct()) {
                     case 0b000: return "addiw";
-                    case 0b001: return "slliw";
-                    case 0b101:
-                        if (dec.imm() & ~0b11111) {
-                            return "sraiw";
-                        } else {
-                            return "srliw";
+                    case 0b001: {
+                        switch (dec.imm() & 0xfff) {
+                            case 0x600: return "clzw";
+                            case 0x601: return "ctzw";
+                            case 0x602: return "cpopw";
+                        }
+
+                        return (((dec.imm() >> 6) & 0b111111) == 0b000010) ? "slli.uw" : "slliw";
+                    }
+                    case 0b101: {
+                        switch ((dec.imm() >> 5) & 0b1111111) {
+                            case 0b0100000: return "sraiw";
+                            case 0b0110000: return "roriw";
+                            default:        return "srliw";
                         }
+                    }
                     default: throw illegal_instruction(dec.pc(), dec.instr(), "unknown funct code (addiw)");
                 }
                 break;
@@ -115,6 +199,22 @@ namespace {
                     case 0b0000001110: return "rem";
                     case 0b0000001111: return "remu";
 
+                    /* Zba */
+                    case 0b0010000010: return "sh1add";
+                    case 0b0010000100: return "sh2add";
+                    case 0b0010000110: return "sh3add";
+
+                    /* Zbb */
+                    case 0b0100000111: return "andn";
+                    case 0b0100000110: return "orn";
+                    case 0b0100000100: return "xnor";
+                    case 0b0000101100: return "min";
+                    case 0b0000101101: return "minu";
+                    case 0b0000101110: return "max";
+                    case 0b0000101111: return "maxu";
+                    case 0b0110000001: return "rol";
+                    case 0b0110000101: return "ror";
+
                     default: throw illegal_instruction(dec.pc(), dec.instr(), "unknown funct code (add)");
                 }
                 break;
@@ -136,12 +236,33 @@ namespace {
                     case 0b0000001110: return "remw";
                     case 0b0000001111: return "remuw";
 
+                    /* Zba */
+                    case 0b0000100000: return "add.uw";
+                    case 0b0010000010: return "sh1add.uw";
+                    case 0b0010000100: return "sh2add.uw";
+                    case 0b0010000110: return "sh3add.uw";
+
+                    /* Zbb */
+                    case 0b0000100100: return "zext.h";
+                    case 0b0110000001: return "rolw";
+                    case 0b0110000101: return "rorw";
+
                     default: throw illegal_instruction(dec.pc(), dec.instr(), "unknown funct code (addw)");
                 }
                 break;
             }
 
             case opc::ecall: {
+                switch (dec.funct()) {
+                    case 0b001: return "csrrw";
+                    case 0b010: return "csrrs";
+                    case 0b011: return "csrrc";
+                    case 0b101: return "csrrwi";
+                    case 0b110: return "csrrsi";
+                    case 0b111: return "csrrci";
+                    default: break;
+                }
+
                 switch (dec.imm()) {
                     case 0: return "ecall";
                     case 1: return "ebreak";
@@ -150,6 +271,35 @@ namespace {
                 break;
             }
 
+            case opc::fence: {
+                switch (dec.funct()) {
+                    case 0b000: return (dec.imm() == 0b100000110011) ? "fence.tso" : "fence";
+                    case 0b001: return "fence.i";
+                    default: throw illegal_instruction(dec.pc(), dec.instr(), "unknown funct code (fence)");
+                }
+                break;
+            }
+
+            case opc::amo: {
+                bool word = (dec.memory() == mem_size::s32);
+
+                switch (dec.amo()) {
+                    case amo_op::lr:   return word ? "lr.w"      : "lr.d";
+                    case amo_op::sc:   return word ? "sc.w"      : "sc.d";
+                    case amo_op::swap: return word ? "amoswap.w" : "amoswap.d";
+                    case amo_op::add:  return word ? "amoadd.w"  : "amoadd.d";
+                    case amo_op::bxor: return word ? "amoxor.w"  : "amoxor.d";
+                    case amo_op::band: return word ? "amoand.w"  : "amoand.d";
+                    case amo_op::bor:  return word ? "amoor.w"   : "amoor.d";
+                    case amo_op::min:  return word ? "amomin.w"  : "amomin.d";
+                    case amo_op::max:  return word ? "amomax.w"  : "amomax.d";
+                    case amo_op::minu: return word ? "amominu.w" : "amominu.d";
+                    case amo_op::maxu: return word ? "amomaxu.w" : "amomaxu.d";
+                    default: throw illegal_instruction(dec.pc(), dec.instr(), "unknown funct code (amo)");
+                }
+                break;
+            }
+
             case opc::fload: {
                 switch (dec.memory()) {
                     case mem_size::f32: return "flw";
@@ -444,7 +594,7 @@ namespace {
             case opc::cldsp:  return "c.ldsp";
 
             case opc::cjr: {
-                if (dec.funct()) {
+                if ((dec.instr() >> 12) & 1) {
                     /* c.ebreak, c.jalr, c.add */
                     if (dec.rs2() == reg::zero) {
                         if (dec.rs1() == reg::zero) {
@@ -537,6 +687,10 @@ namespace {
                 switch ((dec.instr() >> 10) & 0b11) {
                     case 0b00:
                     case 0b01:
+                        /* The expanded srai has its funct7 in the immediate */
+                        fmt::print(os, "{}, {}", dec.rd(), dec.imm() & 0b111111);
+                        break;
+
                     case 0b10:
                         fmt::print(os, "{}, {}", dec.rd(), dec.simm());
                         break;
@@ -565,6 +719,209 @@ namespace {
         return os;
     }
 
+    [[nodiscard]] std::string_view vector_name(const decoder& dec) {
+        switch (dec.vop()) {
+            case vector_op::add:    return "vadd";
+            case vector_op::sub:    return "vsub";
+            case vector_op::rsub:   return "vrsub";
+            case vector_op::minu:   return "vminu";
+            case vector_op::min:    return "vmin";
+            case vector_op::maxu:   return "vmaxu";
+            case vector_op::max:    return "vmax";
+            case vector_op::band:   return "vand";
+            case vector_op::bor:    return "vor";
+            case vector_op::bxor:   return "vxor";
+            case vector_op::sll:    return "vsll";
+            case vector_op::srl:    return "vsrl";
+            case vector_op::sra:    return "vsra";
+            case vector_op::merge:  return dec.masked() ? "vmerge" : "vmv.v";
+            case vector_op::mseq:   return "vmseq";
+            case vector_op::msne:   return "vmsne";
+            case vector_op::msltu:  return "vmsltu";
+            case vector_op::mslt:   return "vmslt";
+            case vector_op::msleu:  return "vmsleu";
+            case vector_op::msle:   return "vmsle";
+            case vector_op::msgtu:  return "vmsgtu";
+            case vector_op::msgt:   return "vmsgt";
+            case vector_op::slideup:    return "vslideup";
+            case vector_op::slidedown:  return "vslidedown";
+            case vector_op::slide1up:   return "vslide1up";
+            case vector_op::slide1down: return "vslide1down";
+
+            case vector_op::mul:    return "vmul";
+            case vector_op::mulh:   return "vmulh";
+            case vector_op::mulhu:  return "vmulhu";
+            case vector_op::mulhsu: return "vmulhsu";
+            case vector_op::divu:   return "vdivu";
+            case vector_op::div:    return "vdiv";
+            case vector_op::remu:   return "vremu";
+            case vector_op::rem:    return "vrem";
+            case vector_op::macc:   return "vmacc";
+            case vector_op::nmsac:  return "vnmsac";
+            case vector_op::madd:   return "vmadd";
+            case vector_op::nmsub:  return "vnmsub";
+
+            case vector_op::redsum:  return "vredsum";
+            case vector_op::redand:  return "vredand";
+            case vector_op::redor:   return "vredor";
+            case vector_op::redxor:  return "vredxor";
+            case vector_op::redminu: return "vredminu";
+            case vector_op::redmin:  return "vredmin";
+            case vector_op::redmaxu: return "vredmaxu";
+            case vector_op::redmax:  return "vredmax";
+
+            case vector_op::mand:  return "vmand";
+            case vector_op::mnand: return "vmnand";
+            case vector_op::mandn: return "vmandn";
+            case vector_op::mxor:  return "vmxor";
+            case vector_op::mor:   return "vmor";
+            case vector_op::mnor:  return "vmnor";
+            case vector_op::morn:  return "vmorn";
+            case vector_op::mxnor: return "vmxnor";
+
+            case vector_op::fadd:   return "vfadd";
+            case vector_op::fsub:   return "vfsub";
+            case vector_op::frsub:  return "vfrsub";
+            case vector_op::fmul:   return "vfmul";
+            case vector_op::fdiv:   return "vfdiv";
+            case vector_op::frdiv:  return "vfrdiv";
+            case vector_op::fmin:   return "vfmin";
+            case vector_op::fmax:   return "vfmax";
+            case vector_op::fsgnj:  return "vfsgnj";
+            case vector_op::fsgnjn: return "vfsgnjn";
+            case vector_op::fsgnjx: return "vfsgnjx";
+            case vector_op::fmerge: return dec.masked() ? "vfmerge" : "vfmv.v";
+            case vector_op::mfeq:   return "vmfeq";
+            case vector_op::mfne:   return "vmfne";
+            case vector_op::mflt:   return "vmflt";
+            case vector_op::mfle:   return "vmfle";
+            case vector_op::mfgt:   return "vmfgt";
+            case vector_op::mfge:   return "vmfge";
+            case vector_op::fslide1up:   return "vfslide1up";
+            case vector_op::fslide1down: return "vfslide1down";
+            case vector_op::fmacc:  return "vfmacc";
+            case vector_op::fnmacc: return "vfnmacc";
+            case vector_op::fmsac:  return "vfmsac";
+            case vector_op::fnmsac: return "vfnmsac";
+            case vector_op::fmadd:  return "vfmadd";
+            case vector_op::fnmadd: return "vfnmadd";
+            case vector_op::fmsub:  return "vfmsub";
+            case vector_op::fnmsub: return "vfnmsub";
+
+            case vector_op::fredusum: return "vfredusum";
+            case vector_op::fredosum: return "vfredosum";
+            case vector_op::fredmin:  return "vfredmin";
+            case vector_op::fredmax:  return "vfredmax";
+
+            default: throw illegal_instruction(dec.pc(), dec.instr(), "unknown vector op");
+        }
+    }
+
+    /* As "e32, m1, ta, ma" */
+    [[nodiscard]] std::string vector_type(uint64_t vtype) {
+        int lmul = static_cast<int>(vtype & 0b111);
+        std::string group = (lmul & 0b100) ? fmt::format("mf{}", 1 << (8 - lmul)) : fmt::format("m{}", 1 << lmul);
+
+        return fmt::format("e{}, {}, {}, {}", 8 << ((vtype >> 3) & 0b111), group,
+            ((vtype >> 6) & 1) ? "ta" : "tu", ((vtype >> 7) & 1) ? "ma" : "mu");
+    }
+
+    std::ostream& format_vector(std::ostream& os, const decoder& dec) {
+        std::string_view mask = dec.masked() ? ", v0.t" : "";
+        size_t bits = mem_size_bytes(dec.memory()) * 8;
+        bool load = dec.vop() == vector_op::load;
+
+        switch (dec.vop()) {
+            case vector_op::vsetvli:
+                fmt::print(os, "vsetvli {}, {}, {}", dec.rd(), dec.rs1(), vector_type(dec.vtype()));
+                return os;
+
+            case vector_op::vsetivli:
+                fmt::print(os, "vsetivli {}, {}, {}", dec.rd(), dec.imm(), vector_type(dec.vtype()));
+                return os;
+
+            case vector_op::vsetvl:
+                fmt::print(os, "vsetvl {}, {}, {}", dec.rd(), dec.rs1(), dec.rs2());
+                return os;
+
+            case vector_op::load:
+            case vector_op::store: {
+                switch (dec.vaddressing()) {
+                    case vector_addressing::unit:
+                        fmt::print(os, "{}{}.v v{}, ({}){}", load ? "vle" : "vse", bits, dec.vd(), dec.rs1(), mask);
+                        break;
+
+                    case vector_addressing::strided:
+                        fmt::print(os, "{}{}.v v{}, ({}), {}{}", load ? "vlse" : "vsse", bits, dec.vd(), dec.rs1(), dec.rs2(), mask);
+                        break;
+
+                    case vector_addressing::whole:
+                        if (load) {
+                            fmt::print(os, "vl{}re{}.v v{}, ({})", dec.vregs(), bits, dec.vd(), dec.rs1());
+                        } else {
+                            fmt::print(os, "vs{}r.v v{}, ({})", dec.vregs(), dec.vd(), dec.rs1());
+                        }
+                        break;
+
+                    case vector_addressing::mask:
+                        fmt::print(os, "{}.v v{}, ({})", load ? "vlm" : "vsm", dec.vd(), dec.rs1());
+                        break;
+                }
+                return os;
+            }
+
+            case vector_op::mv_x_s:  fmt::print(os, "vmv.x.s {}, v{}", dec.rd(), dec.vs2());   return os;
+            case vector_op::mv_s_x:  fmt::print(os, "vmv.s.x v{}, {}", dec.vd(), dec.rs1());   return os;
+            case vector_op::fmv_f_s: fmt::print(os, "vfmv.f.s {}, v{}", dec.rd(), dec.vs2());  return os;
+            case vector_op::fmv_s_f: fmt::print(os, "vfmv.s.f v{}, {}", dec.vd(), dec.rs1());  return os;
+            case vector_op::cpop:    fmt::print(os, "vcpop.m {}, v{}{}", dec.rd(), dec.vs2(), mask);  return os;
+            case vector_op::first:   fmt::print(os, "vfirst.m {}, v{}{}", dec.rd(), dec.vs2(), mask); return os;
+            case vector_op::id:      fmt::print(os, "vid.v v{}{}", dec.vd(), mask); return os;
+            default: break;
+        }
+
+        vector_op op = dec.vop();
+        bool reduction = (op >= vector_op::redsum && op <= vector_op::redmax) || (op >= vector_op::fredusum && op <= vector_op::fredmax);
+        bool mask_logic = op >= vector_op::mand && op <= vector_op::mxnor;
+        bool merge = op == vector_op::merge || op == vector_op::fmerge;
+
+        /* The multiply-adds list the multiplier first */
+        bool fused = (op >= vector_op::macc && op <= vector_op::nmsub) || (op >= vector_op::fmacc && op <= vector_op::fnmsub);
+
+        std::string operand;
+        std::string_view suffix;
+
+        switch (dec.voperand()) {
+            case vector_operand::vector:
+                operand = fmt::format("v{}", dec.vs1());
+                suffix = reduction ? ".vs" : (mask_logic ? ".mm" : ".vv");
+                break;
+
+            case vector_operand::scalar:
+                operand = fmt::format("{}", dec.rs1());
+                suffix = (dec.rs1() >= reg::float_mask) ? ".vf" : ".vx";
+                break;
+
+            case vector_operand::imm:
+                operand = fmt::format("{}", dec.simm());
+                suffix = ".vi";
+                break;
+        }
+
+        if (merge && !dec.masked()) {
+            /* vmv.v.v and friends, v.v is written without the first v */
+            fmt::print(os, "{}.{} v{}, {}", vector_name(dec), suffix.substr(2), dec.vd(), operand);
+        } else if (merge) {
+            fmt::print(os, "{}{}m v{}, v{}, {}, v0", vector_name(dec), suffix, dec.vd(), dec.vs2(), operand);
+        } else if (fused) {
+            fmt::print(os, "{}{} v{}, {}, v{}{}", vector_name(dec), suffix, dec.vd(), operand, dec.vs2(), mask);
+        } else {
+            fmt::print(os, "{}{} v{}, v{}, {}{}", vector_name(dec), suffix, dec.vd(), dec.vs2(), operand, mask);
+        }
+
+        return os;
+    }
+
     std::ostream& format_full(std::ostream& os, const decoder& dec) {
          fmt::print(os, "{:x}:  {:08x}   ", dec.pc(), dec.instr());
 
@@ -572,12 +929,32 @@ namespace {
         //     return os;
         // }
 
-        fmt::print(os, "{} ", instr_name_regular(dec));
+        if (dec.opcode() == opc::vector) {
+            return format_vector(os, dec);
+        }
+
+        fmt::print(os, "{}{} ", instr_name_regular(dec), (dec.opcode() == opc::amo) ? amo_ordering(dec) : "");
 
         switch (dec.type()) {
             case instr_type::I:
                 switch (dec.opcode()) {
                     case opc::ecall:
+                        if (dec.funct() == 0) {
+                            break;
+                        }
+
+                        if (dec.a() == alu_input::imm) {
+                            fmt::print(os, "{}, {}, {}", dec.rd(), csr_name(dec.csr_addr()), dec.imm());
+                        } else {
+                            fmt::print(os, "{}, {}, {}", dec.rd(), csr_name(dec.csr_addr()), dec.rs1());
+                        }
+                        break;
+
+                    case opc::fence:
+                        /* Plain fence iorw, iorw and fence.tso print without operands */
+                        if (dec.funct() == 0 && dec.imm() != 0b000011111111 && dec.imm() != 0b100000110011) {
+                            fmt::print(os, "{}, {}", fence_set((dec.imm() >> 4) & 0b1111), fence_set(dec.imm() & 0b1111));
+                        }
                         break;
                         
                     case opc::jalr:
@@ -588,6 +965,11 @@ namespace {
 
                     case opc::addi:
                     case opc::addiw:
+                        if (single_operand(dec.op())) {
+                            fmt::print(os, "{}, {}", dec.rd(), dec.rs1());
+                            break;
+                        }
+
                         if (dec.imm() & ~0b111111) {
                             /* Shifts */
                             fmt::print(os, "{}, {}, {}", dec.rd(), dec.rs1(), dec.imm() & 0b111111);
@@ -602,6 +984,23 @@ namespace {
 
             case instr_type::R:
                 switch (dec.opcode()) {
+                    case opc::amo:
+                        if (dec.amo() == amo_op::lr) {
+                            fmt::print(os, "{}, ({})", dec.rd(), dec.rs1());
+                        } else {
+                            fmt::print(os, "{}, {}, ({})", dec.rd(), dec.rs2(), dec.rs1());
+                        }
+                        break;
+
+                    case opc::addw:
+                        if (single_operand(dec.op())) {
+                            fmt::print(os, "{}, {}", dec.rd(), dec.rs1());
+                            break;
+                        }
+
+                        fmt::print(os, "{}, {}, {}", dec.rd(), dec.rs1(), dec.rs2());
+                        break;
+
                     case opc::fadd:
                         /* If this bit is set, only  rs1 is used */
                         if ((dec.funct() >> 8) & 1) {
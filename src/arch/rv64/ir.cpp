@@ -1,5 +1,34 @@
 #include "ir.hpp"
 
+namespace {
+    using arch::rv64::alu_op;
+
+    /* Zba and Zbb operations, in both their register and immediate forms */
+    [[nodiscard]] bool bit_manipulation(alu_op op) {
+        switch (op) {
+            case alu_op::sh1add:   case alu_op::sh2add:   case alu_op::sh3add:
+            case alu_op::adduw:    case alu_op::sh1adduw: case alu_op::sh2adduw: case alu_op::sh3adduw:
+            case alu_op::slliuw:
+            case alu_op::andn:     case alu_op::orn:      case alu_op::xnor:
+            case alu_op::clz:      case alu_op::ctz:      case alu_op::cpop:
+            case alu_op::clzw:     case alu_op::ctzw:     case alu_op::cpopw:
+            case alu_op::max:      case alu_op::maxu:     case alu_op::min:      case alu_op::minu:
+            case alu_op::sextb:    case alu_op::sexth:    case alu_op::zexth:
+            case alu_op::rol:      case alu_op::ror:      case alu_op::rolw:     case alu_op::rorw:
+            case alu_op::orcb:     case alu_op::rev8:
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    /* Registers the calling convention links through, which is what return address prediction keys on */
+    [[nodiscard]] bool link_register(arch::rv64::reg r) {
+        return r == arch::rv64::reg::ra || r == arch::rv64::reg::t0;
+    }
+}
+
 namespace arch::rv64 {
     abstract_reg instruction_parser::assign_to(rv64::reg rd) {
         _reg_state[rd] = _cur_reg;
@@ -12,6 +41,29 @@ namespace arch::rv64 {
     }
 
     instruction_parser::parse_result instruction_parser::parse(const decoder& dec) {
+        if (bit_manipulation(dec.op())) {
+            std::vector<abstract_reg> sources { read_from(dec.rs1()) };
+            std::optional<uint64_t> imm;
+
+            if (dec.type() == instr_type::I) {
+                /* The immediate is a shift amount or, for the single-operand ones, part of the opcode */
+                switch (dec.op()) {
+                    case alu_op::ror:
+                    case alu_op::rorw:
+                    case alu_op::slliuw:
+                        imm = dec.imm() & 0b111111;
+                        break;
+
+                    default:
+                        break;
+                }
+            } else if (dec.op() != alu_op::zexth) {
+                sources.push_back(read_from(dec.rs2()));
+            }
+
+            return make_result<ir::bitmanip>(dec.op(), assign_to(dec.rd()), std::move(sources), imm);
+        }
+
         switch (dec.opcode()) {
             case opc::addi: {
                 if (dec.rs1() == reg::zero) {
@@ -27,8 +79,128 @@ namespace arch::rv64 {
                 break;
             }
 
+            case opc::add:
+            case opc::addw: {
+                abstract_reg rs1 = read_from(dec.rs1());
+                abstract_reg rs2 = read_from(dec.rs2());
+
+                switch (dec.op()) {
+                    case alu_op::mul:    return make_result<ir::mul>(assign_to(dec.rd()), rs1, rs2);
+                    case alu_op::mulh:   return make_result<ir::mulh>(assign_to(dec.rd()), rs1, rs2);
+                    case alu_op::mulhsu: return make_result<ir::mulhsu>(assign_to(dec.rd()), rs1, rs2);
+                    case alu_op::mulhu:  return make_result<ir::mulhu>(assign_to(dec.rd()), rs1, rs2);
+                    case alu_op::div:    return make_result<ir::div>(assign_to(dec.rd()), rs1, rs2);
+                    case alu_op::divu:   return make_result<ir::divu>(assign_to(dec.rd()), rs1, rs2);
+                    case alu_op::rem:    return make_result<ir::rem>(assign_to(dec.rd()), rs1, rs2);
+                    case alu_op::remu:   return make_result<ir::remu>(assign_to(dec.rd()), rs1, rs2);
+                    case alu_op::mulw:   return make_result<ir::mulw>(assign_to(dec.rd()), rs1, rs2);
+                    case alu_op::divw:   return make_result<ir::divw>(assign_to(dec.rd()), rs1, rs2);
+                    case alu_op::divuw:  return make_result<ir::divuw>(assign_to(dec.rd()), rs1, rs2);
+                    case alu_op::remw:   return make_result<ir::remw>(assign_to(dec.rd()), rs1, rs2);
+                    case alu_op::remuw:  return make_result<ir::remuw>(assign_to(dec.rd()), rs1, rs2);
+                    default: return nullptr;
+                }
+            }
+
+            case opc::jal: {
+                if (!link_register(dec.rd())) {
+                    return nullptr;
+                }
+
+                return make_result<ir::call>(assign_to(dec.rd()), dec.pc() + dec.imm(), dec.pc() + dec.size());
+            }
+
+            case opc::jalr: {
+                abstract_reg rs = read_from(dec.rs1());
+
+                if (link_register(dec.rd())) {
+                    return make_result<ir::call_indirect>(assign_to(dec.rd()), rs, dec.simm(), dec.pc() + dec.size());
+                } else if (dec.rd() == reg::zero && link_register(dec.rs1())) {
+                    return make_result<ir::ret>(rs, dec.simm());
+                }
+
+                return nullptr;
+            }
+
+            case opc::fadd:
+            case opc::fmadd:
+            case opc::fmsub:
+            case opc::fnmsub:
+            case opc::fnmadd: {
+                std::vector<abstract_reg> sources { read_from(dec.rs1()) };
+
+                /* Conversions, moves, fsqrt and fclass use rs2 as part of the opcode */
+                if (dec.type() == instr_type::R4 || !(dec.funct() & 0b0100000000)) {
+                    sources.push_back(read_from(dec.rs2()));
+                }
+
+                if (dec.type() == instr_type::R4) {
+                    sources.push_back(read_from(dec.rs3()));
+                }
+
+                return make_result<ir::float_op>(dec.op(), dec.rm(), assign_to(dec.rd()), std::move(sources));
+            }
+
+            case opc::vector: {
+                std::vector<abstract_reg> sources;
+
+                if (dec.rs1() != reg::zero) {
+                    sources.push_back(read_from(dec.rs1()));
+                }
+
+                bool memory = dec.vop() == vector_op::load || dec.vop() == vector_op::store;
+
+                /* Stride of strided accesses, the new vtype of vsetvl */
+                if (dec.vop() == vector_op::vsetvl || (memory && dec.vaddressing() == vector_addressing::strided)) {
+                    sources.push_back(read_from(dec.rs2()));
+                }
+
+                std::optional<abstract_reg> rd;
+                if (dec.rd() != reg::zero) {
+                    rd = assign_to(dec.rd());
+                }
+
+                return make_result<ir::vector_instruction>(dec, rd, std::move(sources));
+            }
+
+            case opc::fence: {
+                if (dec.funct() == 0b001) {
+                    return make_result<ir::fence_i>();
+                } else {
+                    return make_result<ir::fence>();
+                }
+            }
+
+            case opc::amo: {
+                /* rd may be the address or source register, read those first */
+                abstract_reg addr = read_from(dec.rs1());
+
+                switch (dec.amo()) {
+                    case amo_op::lr:
+                        return make_result<ir::lr>(assign_to(dec.rd()), addr, dec.memory(), dec.acquire(), dec.release());
+
+                    case amo_op::sc: {
+                        abstract_reg src = read_from(dec.rs2());
+                        return make_result<ir::sc>(assign_to(dec.rd()), addr, src, dec.memory(), dec.acquire(), dec.release());
+                    }
+
+                    default: {
+                        abstract_reg src = read_from(dec.rs2());
+                        return make_result<ir::amo>(dec.amo(), assign_to(dec.rd()), addr, src,
+                            dec.memory(), dec.acquire(), dec.release());
+                    }
+                }
+            }
+
             case opc::ecall: {
-                if (dec.imm()) {
+                if (dec.funct() != 0) {
+                    if (dec.a() == alu_input::imm) {
+                        return make_result<ir::csr_access>(dec.csr_operation(), dec.csr_addr(), assign_to(dec.rd()), std::nullopt, dec.imm());
+                    }
+
+                    abstract_reg rs = read_from(dec.rs1());
+                    return make_result<ir::csr_access>(dec.csr_operation(), dec.csr_addr(), assign_to(dec.rd()), rs, 0);
+                } else if (dec.imm()) {
 
                 } else {
                     return make_result<ir::ecall>();
@@ -42,4 +214,113 @@ namespace arch::rv64 {
 
         throw std::runtime_error("unknown opc");
     }
+
+    instruction_parser::parse_result instruction_parser::parse_fused(const decoder& first, const decoder& second) {
+        /* Both have to execute back to back, data in between the two breaks the pair */
+        if (second.pc() != first.pc() + first.size() || first.rd() == reg::zero) {
+            return nullptr;
+        }
+
+        switch (first.opcode()) {
+            case opc::lui:
+            case opc::auipc: {
+                uint64_t base = first.imm() + ((first.opcode() == opc::auipc) ? first.pc() : 0);
+
+                if (second.rs1() != first.rd()) {
+                    return nullptr;
+                }
+
+                /* 32-bit constants and pc-relative addresses, the intermediate value is overwritten */
+                if (second.rd() == first.rd()) {
+                    switch (second.opcode()) {
+                        case opc::addi:
+                            if (second.op() == alu_op::add) {
+                                return make_result<ir::li>(assign_to(second.rd()), int64_t(base + second.imm()));
+                            }
+                            break;
+
+                        case opc::addiw:
+                            if (second.op() == alu_op::addw && first.opcode() == opc::lui) {
+                                return make_result<ir::li>(assign_to(second.rd()),
+                                    int64_t(sign_extend<32>((base + second.imm()) & 0xffffffff)));
+                            }
+                            break;
+
+                        case opc::load:
+                            if (first.opcode() == opc::auipc) {
+                                return make_result<ir::load_absolute>(assign_to(second.rd()), base + second.imm(), second.memory());
+                            }
+                            break;
+
+                        default:
+                            break;
+                    }
+                }
+
+                if (first.opcode() == opc::auipc && second.opcode() == opc::jalr) {
+                    uint64_t target = (base + second.imm()) & ~uint64_t { 1 };
+                    uint64_t return_addr = second.pc() + second.size();
+
+                    std::optional<abstract_reg> scratch;
+                    if (second.rd() != first.rd()) {
+                        scratch = assign_to(first.rd());
+                    }
+
+                    std::optional<abstract_reg> link;
+                    if (second.rd() != reg::zero) {
+                        link = assign_to(second.rd());
+                    }
+
+                    return make_result<ir::jump_absolute>(target, link, return_addr, scratch, base);
+                }
+
+                return nullptr;
+            }
+
+            case opc::addi: {
+                /* Zero extension by shifting the upper bits out and back in */
+                bool shifts = first.op() == alu_op::sll && second.opcode() == opc::addi && second.op() == alu_op::srl;
+
+                if (!shifts || second.rd() != first.rd() || second.rs1() != first.rd()
+                    || first.imm() != second.imm() || first.imm() == 0) {
+                    return nullptr;
+                }
+
+                abstract_reg rs = read_from(first.rs1());
+                return make_result<ir::zero_extend>(assign_to(second.rd()), rs, unsigned(64 - first.imm()));
+            }
+
+            case opc::add: {
+                switch (first.op()) {
+                    case alu_op::mulh:
+                    case alu_op::mulhu:
+                    case alu_op::mulhsu:
+                        break;
+
+                    default:
+                        return nullptr;
+                }
+
+                /* The high half must not overwrite a source the multiply still needs */
+                bool same_operands = second.opcode() == opc::add && second.op() == alu_op::mul
+                    && second.rs1() == first.rs1() && second.rs2() == first.rs2();
+
+                if (!same_operands || first.rd() == first.rs1() || first.rd() == first.rs2()
+                    || second.rd() == first.rd() || second.rd() == reg::zero) {
+                    return nullptr;
+                }
+
+                abstract_reg rs1 = read_from(first.rs1());
+                abstract_reg rs2 = read_from(first.rs2());
+
+                abstract_reg high = assign_to(first.rd());
+                abstract_reg low = assign_to(second.rd());
+
+                return make_result<ir::mul_wide>(first.op(), high, low, rs1, rs2);
+            }
+
+            default:
+                return nullptr;
+        }
+    }
 }
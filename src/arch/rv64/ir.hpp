@@ -4,6 +4,8 @@
 #include <map>
 #include <concepts>
 #include <string_view>
+#include <vector>
+#include <optional>
 
 #include <util/formatting.hpp>
 #include <arch/rv64/decoder.hpp>
@@ -37,6 +39,13 @@ namespace arch::rv64 {
         public:
         /* Parse a single instruction based on the current state */
         [[nodiscard]] parse_result parse(const decoder& dec);
+
+        /* Parse two adjacent instructions as a single fused operation if they form one of the
+         * common idioms: lui or auipc with addi, auipc with a load or jalr, slli with srli and
+         * a high multiply followed by mul. Returns nullptr if they don't, in which case the
+         * first one has to be parsed on its own.
+         */
+        [[nodiscard]] parse_result parse_fused(const decoder& first, const decoder& second);
     };
 
     template <typename T>
@@ -59,6 +68,20 @@ namespace arch::rv64 {
         }
     };
 
+    template <typename Derived>
+    class r_type : public instruction {
+        abstract_reg rd;
+        abstract_reg rs1;
+        abstract_reg rs2;
+
+        public:
+        explicit r_type(abstract_reg rd, abstract_reg rs1, abstract_reg rs2) : rd { rd }, rs1 { rs1 }, rs2 { rs2 } { }
+
+        std::ostream& dump(std::ostream& os) const requires NamedInstruction<Derived> override {
+            return fmt::print_to(os, "{} r{}, r{}, r{}", Derived::name, rd, rs1, rs2);
+        }
+    };
+
     namespace ir {
         class nop : public instruction {
             public:
@@ -69,6 +92,31 @@ namespace arch::rv64 {
             std::ostream& dump(std::ostream& os) const override { return fmt::print_to(os, "ecall"); }
         };
 
+        /* Translated code adds up instret once per block, so reading a counter
+         * in the middle of a block also adds the instructions before it
+         */
+        class csr_access : public instruction {
+            csr_op op;
+            csr addr;
+            abstract_reg rd;
+
+            /* Register source, or the 5-bit immediate if there is none */
+            std::optional<abstract_reg> rs;
+            uint64_t imm;
+
+            public:
+            csr_access(csr_op op, csr addr, abstract_reg rd, std::optional<abstract_reg> rs, uint64_t imm)
+                : op { op }, addr { addr }, rd { rd }, rs { rs }, imm { imm } { }
+
+            std::ostream& dump(std::ostream& os) const override {
+                if (rs) {
+                    return fmt::print_to(os, "csr{} r{}, {:#x}, r{}", op, rd, static_cast<uint16_t>(addr), *rs);
+                }
+
+                return fmt::print_to(os, "csr{}i r{}, {:#x}, {}", op, rd, static_cast<uint16_t>(addr), imm);
+            }
+        };
+
         class li : public instruction {
             abstract_reg rd;
             int64_t imm;
@@ -84,5 +132,393 @@ namespace arch::rv64 {
             using i_type::i_type;
             static constexpr std::string_view name = "addi";
         };
+
+        /* M extension. The high multiplies map to the upper half of a single widening host
+         * multiply, divisions are lowered inline with the divisor checked for zero and the
+         * signed ones for overflow first, as the host divide traps on both.
+         */
+        class mul : public r_type<mul> {
+            public:
+            using r_type::r_type;
+            static constexpr std::string_view name = "mul";
+        };
+
+        class mulh : public r_type<mulh> {
+            public:
+            using r_type::r_type;
+            static constexpr std::string_view name = "mulh";
+        };
+
+        class mulhsu : public r_type<mulhsu> {
+            public:
+            using r_type::r_type;
+            static constexpr std::string_view name = "mulhsu";
+        };
+
+        class mulhu : public r_type<mulhu> {
+            public:
+            using r_type::r_type;
+            static constexpr std::string_view name = "mulhu";
+        };
+
+        class div : public r_type<div> {
+            public:
+            using r_type::r_type;
+            static constexpr std::string_view name = "div";
+        };
+
+        class divu : public r_type<divu> {
+            public:
+            using r_type::r_type;
+            static constexpr std::string_view name = "divu";
+        };
+
+        class rem : public r_type<rem> {
+            public:
+            using r_type::r_type;
+            static constexpr std::string_view name = "rem";
+        };
+
+        class remu : public r_type<remu> {
+            public:
+            using r_type::r_type;
+            static constexpr std::string_view name = "remu";
+        };
+
+        class mulw : public r_type<mulw> {
+            public:
+            using r_type::r_type;
+            static constexpr std::string_view name = "mulw";
+        };
+
+        class divw : public r_type<divw> {
+            public:
+            using r_type::r_type;
+            static constexpr std::string_view name = "divw";
+        };
+
+        class divuw : public r_type<divuw> {
+            public:
+            using r_type::r_type;
+            static constexpr std::string_view name = "divuw";
+        };
+
+        class remw : public r_type<remw> {
+            public:
+            using r_type::r_type;
+            static constexpr std::string_view name = "remw";
+        };
+
+        class remuw : public r_type<remuw> {
+            public:
+            using r_type::r_type;
+            static constexpr std::string_view name = "remuw";
+        };
+
+        /* Calls and returns, as told apart by the link registers ra and t0. Calls push the
+         * return address on the thread's return stack and returns pop it, so they can continue
+         * in the returned-to block without looking it up. A jump_absolute with a link
+         * register is a call as well.
+         */
+        class call : public instruction {
+            abstract_reg link;
+            uint64_t target;
+            uint64_t return_addr;
+
+            public:
+            call(abstract_reg link, uint64_t target, uint64_t return_addr)
+                : link { link }, target { target }, return_addr { return_addr } { }
+
+            std::ostream& dump(std::ostream& os) const override {
+                return fmt::print_to(os, "call {:#x}, r{} = {:#x}", target, link, return_addr);
+            }
+        };
+
+        class call_indirect : public instruction {
+            abstract_reg link;
+            abstract_reg rs;
+            int64_t offset;
+            uint64_t return_addr;
+
+            public:
+            call_indirect(abstract_reg link, abstract_reg rs, int64_t offset, uint64_t return_addr)
+                : link { link }, rs { rs }, offset { offset }, return_addr { return_addr } { }
+
+            std::ostream& dump(std::ostream& os) const override {
+                return fmt::print_to(os, "call {}(r{}), r{} = {:#x}", offset, rs, link, return_addr);
+            }
+        };
+
+        class ret : public instruction {
+            abstract_reg rs;
+            int64_t offset;
+
+            public:
+            ret(abstract_reg rs, int64_t offset) : rs { rs }, offset { offset } { }
+
+            std::ostream& dump(std::ostream& os) const override {
+                return fmt::print_to(os, "ret {}(r{})", offset, rs);
+            }
+        };
+
+        /* Fused instruction pairs. Addresses built from the pc are resolved while parsing, so
+         * these only carry the constants the backend puts in the host instruction.
+         */
+
+        /* auipc followed by a load from the same register, a GOT or global variable load */
+        class load_absolute : public instruction {
+            abstract_reg rd;
+            uint64_t addr;
+            mem_size size;
+
+            public:
+            load_absolute(abstract_reg rd, uint64_t addr, mem_size size) : rd { rd }, addr { addr }, size { size } { }
+
+            std::ostream& dump(std::ostream& os) const override {
+                return fmt::print_to(os, "load.{} r{}, [{:#x}]", size, rd, addr);
+            }
+        };
+
+        /* auipc followed by jalr through the same register, a far call or tail call. When the
+         * auipc register isn't the link register, it still gets its pc-relative value.
+         */
+        class jump_absolute : public instruction {
+            uint64_t target;
+
+            std::optional<abstract_reg> link;
+            uint64_t return_addr;
+
+            std::optional<abstract_reg> scratch;
+            uint64_t scratch_value;
+
+            public:
+            jump_absolute(uint64_t target, std::optional<abstract_reg> link, uint64_t return_addr,
+                    std::optional<abstract_reg> scratch, uint64_t scratch_value)
+                : target { target }, link { link }, return_addr { return_addr }
+                , scratch { scratch }, scratch_value { scratch_value } { }
+
+            std::ostream& dump(std::ostream& os) const override {
+                fmt::print_to(os, "jump {:#x}", target);
+
+                if (link) {
+                    fmt::print_to(os, ", r{} = {:#x}", *link, return_addr);
+                }
+
+                if (scratch) {
+                    fmt::print_to(os, ", r{} = {:#x}", *scratch, scratch_value);
+                }
+
+                return os;
+            }
+        };
+
+        /* slli followed by srli by the same amount, keeps the lower bits of rs. A 32-bit mov,
+         * movzx or a BMI2 bzhi on the host.
+         */
+        class zero_extend : public instruction {
+            abstract_reg rd;
+            abstract_reg rs;
+            unsigned bits;
+
+            public:
+            zero_extend(abstract_reg rd, abstract_reg rs, unsigned bits) : rd { rd }, rs { rs }, bits { bits } { }
+
+            std::ostream& dump(std::ostream& os) const override {
+                return fmt::print_to(os, "zext{} r{}, r{}", bits, rd, rs);
+            }
+        };
+
+        /* mulh, mulhu or mulhsu followed by mul of the same operands, both halves come out
+         * of one widening host multiply
+         */
+        class mul_wide : public instruction {
+            alu_op op;
+            abstract_reg rd_high;
+            abstract_reg rd_low;
+            abstract_reg rs1;
+            abstract_reg rs2;
+
+            public:
+            mul_wide(alu_op op, abstract_reg rd_high, abstract_reg rd_low, abstract_reg rs1, abstract_reg rs2)
+                : op { op }, rd_high { rd_high }, rd_low { rd_low }, rs1 { rs1 }, rs2 { rs2 } { }
+
+            std::ostream& dump(std::ostream& os) const override {
+                return fmt::print_to(os, "{}.wide r{}:r{}, r{}, r{}", op, rd_high, rd_low, rs1, rs2);
+            }
+        };
+
+        /* Zba and Zbb, which map to single host instructions: the shifted adds to lea, clz, ctz
+         * and cpop to lzcnt, tzcnt and popcnt, rev8 to bswap, andn to the BMI1 andn, rotates to
+         * rol and ror and the sign and zero extensions to movsx and movzx. The uw variants
+         * take a 32-bit mov first to zero-extend, min and max a cmp and cmov, orc.b is the
+         * only one that needs a short SSE2 sequence.
+         */
+        class bitmanip : public instruction {
+            alu_op op;
+            abstract_reg rd;
+            std::vector<abstract_reg> sources;
+
+            /* Shift amount of rori, roriw and slli.uw */
+            std::optional<uint64_t> imm;
+
+            public:
+            bitmanip(alu_op op, abstract_reg rd, std::vector<abstract_reg> sources, std::optional<uint64_t> imm)
+                : op { op }, rd { rd }, sources { std::move(sources) }, imm { imm } { }
+
+            std::ostream& dump(std::ostream& os) const override {
+                fmt::print_to(os, "{} r{}", op, rd);
+
+                for (abstract_reg rs : sources) {
+                    fmt::print_to(os, ", r{}", rs);
+                }
+
+                if (imm) {
+                    fmt::print_to(os, ", {}", *imm);
+                }
+
+                return os;
+            }
+        };
+
+        /* F and D operations, each maps to a scalar SSE2 or FMA instruction on the host.
+         * Results are NaN-boxed and canonicalized, the exception flags are left to accumulate
+         * in the host. rm stays dyn when the instruction uses frm, so the backend only has to
+         * change the host rounding mode where it differs from what the block already uses.
+         */
+        class float_op : public instruction {
+            alu_op op;
+            rounding_mode rm;
+            abstract_reg rd;
+            std::vector<abstract_reg> sources;
+
+            public:
+            float_op(alu_op op, rounding_mode rm, abstract_reg rd, std::vector<abstract_reg> sources)
+                : op { op }, rm { rm }, rd { rd }, sources { std::move(sources) } { }
+
+            std::ostream& dump(std::ostream& os) const override {
+                fmt::print_to(os, "{}.{} r{}", op, rm, rd);
+
+                for (abstract_reg rs : sources) {
+                    fmt::print_to(os, ", r{}", rs);
+                }
+
+                return os;
+            }
+        };
+
+        /* V extension instructions are kept whole, the backend lowers each one to a host SIMD
+         * loop over vl. Scalar registers read or written go through the usual abstract registers.
+         */
+        class vector_instruction : public instruction {
+            vector_op op;
+            uint8_t vd;
+            uint8_t vs1;
+            uint8_t vs2;
+            bool masked;
+
+            std::optional<abstract_reg> rd;
+            std::vector<abstract_reg> sources;
+
+            public:
+            vector_instruction(const decoder& dec, std::optional<abstract_reg> rd, std::vector<abstract_reg> sources)
+                : op { dec.vop() }, vd { dec.vd() }, vs1 { dec.vs1() }, vs2 { dec.vs2() }, masked { dec.masked() }
+                , rd { rd }, sources { std::move(sources) } { }
+
+            std::ostream& dump(std::ostream& os) const override {
+                fmt::print_to(os, "v{}", op);
+
+                if (rd) {
+                    fmt::print_to(os, " r{},", *rd);
+                }
+
+                fmt::print_to(os, " v{}, v{}, v{}", vd, vs2, vs1);
+
+                for (abstract_reg rs : sources) {
+                    fmt::print_to(os, ", r{}", rs);
+                }
+
+                return fmt::print_to(os, "{}", masked ? ", v0.t" : "");
+            }
+        };
+
+        /* Memory ordering only, instruction fetch ordering is fence_i */
+        class fence : public instruction {
+            public:
+            std::ostream& dump(std::ostream& os) const override { return fmt::print_to(os, "fence"); }
+        };
+
+        class fence_i : public instruction {
+            public:
+            std::ostream& dump(std::ostream& os) const override { return fmt::print_to(os, "fence.i"); }
+        };
+
+        /* Atomics, lowered to host atomic read-modify-write instructions */
+        class atomic_instruction : public instruction {
+            protected:
+            mem_size size;
+            bool aq;
+            bool rl;
+
+            [[nodiscard]] std::string_view ordering() const {
+                return (aq && rl) ? ".aqrl" : aq ? ".aq" : rl ? ".rl" : "";
+            }
+
+            [[nodiscard]] char width() const { return (size == mem_size::s32) ? 'w' : 'd'; }
+
+            public:
+            atomic_instruction(mem_size size, bool aq, bool rl) : size { size }, aq { aq }, rl { rl } { }
+        };
+
+        class lr : public atomic_instruction {
+            abstract_reg rd;
+            abstract_reg addr;
+
+            public:
+            lr(abstract_reg rd, abstract_reg addr, mem_size size, bool aq, bool rl)
+                : atomic_instruction(size, aq, rl), rd { rd }, addr { addr } { }
+
+            std::ostream& dump(std::ostream& os) const override {
+                return fmt::print_to(os, "lr.{}{} r{}, (r{})", width(), ordering(), rd, addr);
+            }
+        };
+
+        class sc : public atomic_instruction {
+            abstract_reg rd;
+            abstract_reg addr;
+            abstract_reg src;
+
+            public:
+            sc(abstract_reg rd, abstract_reg addr, abstract_reg src, mem_size size, bool aq, bool rl)
+                : atomic_instruction(size, aq, rl), rd { rd }, addr { addr }, src { src } { }
+
+            std::ostream& dump(std::ostream& os) const override {
+                return fmt::print_to(os, "sc.{}{} r{}, r{}, (r{})", width(), ordering(), rd, src, addr);
+            }
+        };
+
+        class amo : public atomic_instruction {
+            amo_op op;
+            abstract_reg rd;
+            abstract_reg addr;
+            abstract_reg src;
+
+            [[nodiscard]] std::string_view name() const {
+                switch (op) {
+                    case amo_op::swap: return "swap";
+                    case amo_op::bxor: return "xor";
+                    case amo_op::bor:  return "or";
+                    case amo_op::band: return "and";
+                    default: return magic_enum::enum_name(op);
+                }
+            }
+
+            public:
+            amo(amo_op op, abstract_reg rd, abstract_reg addr, abstract_reg src, mem_size size, bool aq, bool rl)
+                : atomic_instruction(size, aq, rl), op { op }, rd { rd }, addr { addr }, src { src } { }
+
+            std::ostream& dump(std::ostream& os) const override {
+                return fmt::print_to(os, "amo{}.{}{} r{}, r{}, (r{})", name(), width(), ordering(), rd, src, addr);
+            }
+        };
     }
 }
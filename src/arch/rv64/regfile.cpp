@@ -1,5 +1,7 @@
 #include "regfile.hpp"
 
+#include <fmt/ostream.h>
+
 namespace arch::rv64 {
     uint64_t regfile::read(reg idx) const {
         return file[static_cast<uint8_t>(idx)];
@@ -10,4 +12,13 @@ namespace arch::rv64 {
             file[static_cast<uint8_t>(idx)] = val;
         }
     }
+
+    std::ostream& regfile::print(std::ostream& os) const {
+        /* Integer registers only, 4 per line */
+        for (uint8_t i = 0; i < static_cast<uint8_t>(reg::float_mask); ++i) {
+            fmt::print(os, "{:>4}: {:#018x}{}", static_cast<reg>(i), file[i], ((i % 4) == 3) ? "\n" : "  ");
+        }
+
+        return os;
+    }
 }
@@ -85,6 +85,17 @@ namespace arch::rv64 {
         invalid_mask = 0b1000,
     };
 
+    /* Accrued exception flags, the fflags field of fcsr */
+    enum class fflags : uint8_t {
+        none = 0,
+
+        nx = 0b00001,
+        uf = 0b00010,
+        of = 0b00100,
+        dz = 0b01000,
+        nv = 0b10000,
+    };
+
     /* Represents the 3-bit funct field on branching instructions */
     enum class branch_comp : uint8_t {
         eq  = 0b000,
@@ -97,6 +108,105 @@ namespace arch::rv64 {
         none = 0b11111111,
     };
 
+    /* Represents the funct5 field of atomic memory operations */
+    enum class amo_op : uint8_t {
+        add  = 0b00000,
+        swap = 0b00001,
+        lr   = 0b00010,
+        sc   = 0b00011,
+        bxor = 0b00100,
+        bor  = 0b01000,
+        band = 0b01100,
+        min  = 0b10000,
+        max  = 0b10100,
+        minu = 0b11000,
+        maxu = 0b11100,
+    };
+
+    /* Represents the funct3 field of CSR instructions, the immediate forms have bit 2 set */
+    enum class csr_op : uint8_t {
+        rw = 0b01,
+        rs = 0b10,
+        rc = 0b11,
+    };
+
+    /* Control and status registers available to user mode */
+    enum class csr : uint16_t {
+        fflags  = 0x001,
+        frm     = 0x002,
+        fcsr    = 0x003,
+
+        vstart  = 0x008,
+
+        cycle   = 0xc00,
+        time    = 0xc01,
+        instret = 0xc02,
+
+        vl      = 0xc20,
+        vtype   = 0xc21,
+        vlenb   = 0xc22,
+    };
+
+    /* V extension operations, the same funct6 means different things depending on the operand category */
+    enum class vector_op : uint8_t {
+        invalid,
+
+        vsetvli, vsetivli, vsetvl,
+
+        load, store,
+
+        /* Integer */
+        add, sub, rsub,
+        minu, min, maxu, max,
+        band, bor, bxor,
+        sll, srl, sra,
+        merge,
+        mseq, msne, msltu, mslt, msleu, msle, msgtu, msgt,
+        slideup, slidedown, slide1up, slide1down,
+
+        mul, mulh, mulhu, mulhsu,
+        divu, div, remu, rem,
+        macc, nmsac, madd, nmsub,
+
+        redsum, redand, redor, redxor, redminu, redmin, redmaxu, redmax,
+
+        /* Masks */
+        mand, mnand, mandn, mxor, mor, mnor, morn, mxnor,
+        cpop, first, id,
+
+        /* Element 0 to or from a scalar register */
+        mv_x_s, mv_s_x, fmv_f_s, fmv_s_f,
+
+        /* Float */
+        fadd, fsub, frsub, fmul, fdiv, frdiv,
+        fmin, fmax,
+        fsgnj, fsgnjn, fsgnjx,
+        fmerge,
+        mfeq, mfne, mflt, mfle, mfgt, mfge,
+        fslide1up, fslide1down,
+
+        fmacc, fnmacc, fmsac, fnmsac,
+        fmadd, fnmadd, fmsub, fnmsub,
+
+        fredusum, fredosum, fredmin, fredmax,
+    };
+
+    /* Where the second operand of a vector operation comes from */
+    enum class vector_operand : uint8_t {
+        vector, scalar, imm,
+    };
+
+    /* Address generation of vector loads and stores */
+    enum class vector_addressing : uint8_t {
+        unit, strided,
+
+        /* Whole registers, ignoring vl and vtype */
+        whole,
+
+        /* A mask, ceil(vl / 8) bytes */
+        mask,
+    };
+
     enum class opc : uint8_t {
         lui    = 0b0110111, /* U */
         auipc  = 0b0010111, /* U */
@@ -110,6 +220,8 @@ namespace arch::rv64 {
         add    = 0b0110011, /* R */
         addw   = 0b0111011, /* R */
         ecall  = 0b1110011, /* I */
+        fence  = 0b0001111, /* I */
+        amo    = 0b0101111, /* R */
 
         fload  = 0b0000111, /* I  */
         fstore = 0b0100111, /* S  */
@@ -119,6 +231,9 @@ namespace arch::rv64 {
         fnmadd = 0b1001111, /* R4 */
         fadd   = 0b1010011, /* R  */
 
+        /* OP-V, vector loads and stores are decoded to this as well */
+        vector = 0b1010111,
+
         /* First 2 bits of a compressed instruction never match those of a
          * regular instruction, meaning they can share an enum
          */
@@ -155,11 +270,41 @@ namespace arch::rv64 {
 
     /* https://github.com/bminor/glibc/blob/master/sysdeps/unix/sysv/linux/riscv/rv64/arch-syscall.h */
     enum class syscall : uint64_t {
+        ioctl = 29,
+        openat = 56,
+        close = 57,
+        lseek = 62,
+        read = 63,
+        write = 64,
+        readv = 65,
+        writev = 66,
+        pread64 = 67,
+        pwrite64 = 68,
+        fstat = 80,
+        fsync = 82,
+        fdatasync = 83,
         exit = 93,
+        exit_group = 94,
         set_tid_address = 96,
+        futex = 98,
         set_robust_list = 99,
+        getitimer = 102,
+        setitimer = 103,
+        sched_yield = 124,
+        kill = 129,
+        tkill = 130,
+        tgkill = 131,
+        rt_sigaction = 134,
+        rt_sigprocmask = 135,
+        rt_sigreturn = 139,
+        getpid = 172,
+        gettid = 178,
         brk = 214,
+        munmap = 215,
+        mremap = 216,
+        clone = 220,
         mmap = 222,
+        mprotect = 226,
     };
 
     /* Input data source for the ALU */
@@ -185,6 +330,18 @@ namespace arch::rv64 {
 
         slt, sltu,
 
+        /* Zba, the uw variants zero-extend the lower 32 bits of a first */
+        sh1add, sh2add, sh3add,
+        adduw, sh1adduw, sh2adduw, sh3adduw, slliuw,
+
+        /* Zbb, b is unused by the single-operand ones */
+        andn, orn, xnor,
+        clz, ctz, cpop,
+        max, maxu, min, minu,
+        sextb, sexth, zexth,
+        rol, ror,
+        orcb, rev8,
+
         /* Convert float or double to XLEN int */
         fcvts, fcvtsu, fcvtd, fcvtdu,
 
@@ -229,6 +386,11 @@ namespace arch::rv64 {
         sllw  = sll  | word_op,
         srlw  = srl  | word_op,
         sraw  = sra  | word_op,
+        clzw  = clz  | word_op,
+        ctzw  = ctz  | word_op,
+        cpopw = cpop | word_op,
+        rolw  = rol  | word_op,
+        rorw  = ror  | word_op,
 
         fcvtsw  = fcvts  | word_op,
         fcvtsuw = fcvtsu | word_op,
@@ -339,6 +501,10 @@ template <> struct fmt::formatter<arch::rv64::syscall>         : fmt_enum<arch::
 template <> struct fmt::formatter<arch::rv64::alu_op>          : fmt_enum<arch::rv64::alu_op>          { };
 template <> struct fmt::formatter<arch::rv64::alu_input>       : fmt_enum<arch::rv64::alu_input>       { };
 template <> struct fmt::formatter<arch::rv64::branch_comp>     : fmt_enum<arch::rv64::branch_comp>     { };
+template <> struct fmt::formatter<arch::rv64::amo_op>          : fmt_enum<arch::rv64::amo_op>          { };
+template <> struct fmt::formatter<arch::rv64::csr_op>          : fmt_enum<arch::rv64::csr_op>          { };
+template <> struct fmt::formatter<arch::rv64::vector_op>       : fmt_enum<arch::rv64::vector_op>       { };
 template <> struct fmt::formatter<arch::rv64::mem_size>        : fmt_enum<arch::rv64::mem_size>        { };
 template <> struct fmt::formatter<arch::rv64::float_fmt>       : fmt_enum<arch::rv64::float_fmt>       { };
 template <> struct fmt::formatter<arch::rv64::rounding_mode>   : fmt_enum<arch::rv64::rounding_mode>   { };
+template <> struct fmt::formatter<arch::rv64::fflags>          : fmt_enum<arch::rv64::fflags>          { };
@@ -0,0 +1,620 @@
+#include "vector.hpp"
+
+#include "alu.hpp"
+
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+namespace {
+    using arch::rv64::vector_op;
+    using arch::rv64::vector_operand;
+
+    /* Same integer width as a float type, for sign injection */
+    template <std::floating_point T>
+    using float_bits = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+
+    template <std::floating_point T>
+    [[nodiscard]] T canonical(T val) {
+        return std::isnan(val) ? std::numeric_limits<T>::quiet_NaN() : val;
+    }
+
+    /* Scalar float operand, singles that aren't NaN-boxed read as the canonical NaN */
+    template <std::floating_point T>
+    [[nodiscard]] T unbox(uint64_t val) {
+        if constexpr (sizeof(T) == 4) {
+            if ((val >> 32) != 0xffffffff) {
+                return std::numeric_limits<T>::quiet_NaN();
+            }
+        }
+
+        return std::bit_cast<T>(float_bits<T>(val));
+    }
+
+    template <std::floating_point T>
+    [[nodiscard]] uint64_t box(T val) {
+        uint64_t bits = std::bit_cast<float_bits<T>>(val);
+        return (sizeof(T) == 4) ? (bits | 0xffffffff00000000) : bits;
+    }
+
+    /* IEEE 754-2019 minimumNumber and maximumNumber, -0 is below +0 */
+    template <std::floating_point T>
+    [[nodiscard]] T min_max(T a, T b, bool max) {
+        if (std::isnan(a) && std::isnan(b)) {
+            return std::numeric_limits<T>::quiet_NaN();
+        } else if (std::isnan(a)) {
+            return b;
+        } else if (std::isnan(b)) {
+            return a;
+        } else if (a == b) {
+            return (std::signbit(a) == max) ? b : a;
+        }
+
+        return ((a < b) != max) ? a : b;
+    }
+
+    template <std::floating_point T>
+    [[nodiscard]] T sign_inject(T a, T b, vector_op op) {
+        constexpr float_bits<T> sign = float_bits<T> { 1 } << (sizeof(T) * 8 - 1);
+
+        auto x = std::bit_cast<float_bits<T>>(a);
+        auto y = std::bit_cast<float_bits<T>>(b);
+
+        switch (op) {
+            case vector_op::fsgnjn: y = ~y; break;
+            case vector_op::fsgnjx: y ^= x; break;
+            default: break;
+        }
+
+        return std::bit_cast<T>(float_bits<T>((x & ~sign) | (y & sign)));
+    }
+
+    /* Upper half of the product, SEW is at most 64 so only that needs more than a host multiply */
+    template <std::unsigned_integral T>
+    [[nodiscard]] T mul_high(T a, T b, bool a_signed, bool b_signed) {
+        using S = std::make_signed_t<T>;
+        constexpr unsigned bits = sizeof(T) * 8;
+
+        if constexpr (sizeof(T) == 8) {
+            if (a_signed && b_signed) {
+                return arch::rv64::mul_high_signed(a, b);
+            } else if (a_signed) {
+                return arch::rv64::mul_high_signed_unsigned(a, b);
+            }
+
+            return arch::rv64::mul_high_unsigned(a, b);
+        } else {
+            int64_t x = a_signed ? int64_t(S(a)) : int64_t(a);
+            int64_t y = b_signed ? int64_t(S(b)) : int64_t(b);
+
+            /* Unsigned, so 32-bit unsigned operands can't overflow. The low 64 bits are exact either way */
+            return T((uint64_t(x) * uint64_t(y)) >> bits);
+        }
+    }
+
+    /* Division by zero and overflow give the same results as the scalar M instructions */
+    template <std::unsigned_integral T>
+    [[nodiscard]] T divide(T a, T b, vector_op op) {
+        using S = std::make_signed_t<T>;
+
+        bool overflow = S(a) == std::numeric_limits<S>::min() && S(b) == -1;
+
+        switch (op) {
+            case vector_op::divu: return b ? T(a / b) : std::numeric_limits<T>::max();
+            case vector_op::remu: return b ? T(a % b) : a;
+            case vector_op::div:  return !b ? std::numeric_limits<T>::max() : (overflow ? a : T(S(a) / S(b)));
+            case vector_op::rem:  return !b ? a : (overflow ? T(0) : T(S(a) % S(b)));
+            default: return 0;
+        }
+    }
+}
+
+namespace arch::rv64 {
+    int vector_unit::_lmul_shift() const {
+        /* 0b100 is reserved and never makes it past configure */
+        int lmul = static_cast<int>(_vtype & 0b111);
+        return (lmul & 0b100) ? lmul - 8 : lmul;
+    }
+
+    size_t vector_unit::_vlmax() const {
+        int shift = static_cast<int>(std::countr_zero(vlen)) - 3 - static_cast<int>(_sew_shift()) + _lmul_shift();
+        return size_t { 1 } << shift;
+    }
+
+    size_t vector_unit::_group() const {
+        return size_t { 1 } << std::max(_lmul_shift(), 0);
+    }
+
+    void vector_unit::_check_group(const decoder& dec, uint8_t v, size_t regs) const {
+        if (v % regs) {
+            throw illegal_instruction(dec.pc(), dec.instr(), "misaligned vector register group v{}", v);
+        }
+    }
+
+    template <typename T>
+    T vector_unit::_get(uint8_t v, size_t i) const {
+        T val;
+        std::memcpy(&val, _regs.data() + v * vlenb + i * sizeof(T), sizeof(T));
+        return val;
+    }
+
+    template <typename T>
+    void vector_unit::_set(uint8_t v, size_t i, T val) {
+        std::memcpy(_regs.data() + v * vlenb + i * sizeof(T), &val, sizeof(T));
+    }
+
+    void vector_unit::_set_bit(uint8_t v, size_t i, bool val) {
+        uint8_t& byte = _regs[v * vlenb + i / 8];
+        byte = static_cast<uint8_t>((byte & ~(1 << (i % 8))) | (val << (i % 8)));
+    }
+
+    template <typename T, typename F>
+    void vector_unit::_map(const decoder& dec, T x, F f) {
+        uint8_t vd = dec.vd(), vs1 = dec.vs1(), vs2 = dec.vs2();
+
+        /* Locals, so the compiler doesn't have to assume writes to the registers change them */
+        size_t first = _vstart, vl = _vl;
+
+        /* Split up so the unmasked loops vectorize */
+        if (dec.masked()) {
+            for (size_t i = first; i < vl; i++) {
+                if (mask(i)) {
+                    T b = (dec.voperand() == vector_operand::vector) ? _get<T>(vs1, i) : x;
+                    _set<T>(vd, i, f(_get<T>(vs2, i), b));
+                }
+            }
+        } else if (dec.voperand() == vector_operand::vector) {
+            for (size_t i = first; i < vl; i++) {
+                _set<T>(vd, i, f(_get<T>(vs2, i), _get<T>(vs1, i)));
+            }
+        } else {
+            for (size_t i = first; i < vl; i++) {
+                _set<T>(vd, i, f(_get<T>(vs2, i), x));
+            }
+        }
+    }
+
+    template <typename T, typename F>
+    void vector_unit::_fused(const decoder& dec, T x, F f) {
+        uint8_t vd = dec.vd(), vs1 = dec.vs1(), vs2 = dec.vs2();
+
+        for (size_t i = _vstart; i < _vl; i++) {
+            if (_active(dec, i)) {
+                T b = (dec.voperand() == vector_operand::vector) ? _get<T>(vs1, i) : x;
+                _set<T>(vd, i, f(_get<T>(vs2, i), b, _get<T>(vd, i)));
+            }
+        }
+    }
+
+    template <typename T, typename F>
+    void vector_unit::_compare(const decoder& dec, T x, F f) {
+        uint8_t vd = dec.vd(), vs1 = dec.vs1(), vs2 = dec.vs2();
+
+        for (size_t i = _vstart; i < _vl; i++) {
+            if (_active(dec, i)) {
+                T b = (dec.voperand() == vector_operand::vector) ? _get<T>(vs1, i) : x;
+                _set_bit(vd, i, f(_get<T>(vs2, i), b));
+            }
+        }
+    }
+
+    template <typename T, typename F>
+    void vector_unit::_reduce(const decoder& dec, F f) {
+        /* No elements means vd isn't written at all */
+        if (_vl == 0) {
+            return;
+        }
+
+        T acc = _get<T>(dec.vs1(), 0);
+
+        for (size_t i = 0; i < _vl; i++) {
+            if (_active(dec, i)) {
+                acc = f(acc, _get<T>(dec.vs2(), i));
+            }
+        }
+
+        _set<T>(dec.vd(), 0, acc);
+    }
+
+    template <typename T>
+    void vector_unit::_merge(const decoder& dec, T x) {
+        uint8_t vd = dec.vd(), vs1 = dec.vs1(), vs2 = dec.vs2();
+
+        /* Every element is written, the mask selects between vs2 and the operand */
+        for (size_t i = _vstart; i < _vl; i++) {
+            T b = (dec.voperand() == vector_operand::vector) ? _get<T>(vs1, i) : x;
+            _set<T>(vd, i, (dec.masked() && !mask(i)) ? _get<T>(vs2, i) : b);
+        }
+    }
+
+    template <typename T>
+    void vector_unit::_slide(const decoder& dec, T x, uint64_t offset) {
+        uint8_t vd = dec.vd(), vs2 = dec.vs2();
+        size_t vlmax = _vlmax();
+
+        switch (dec.vop()) {
+            case vector_op::slideup:
+                for (size_t i = std::max<uint64_t>(_vstart, offset); i < _vl; i++) {
+                    if (_active(dec, i)) {
+                        _set<T>(vd, i, _get<T>(vs2, i - offset));
+                    }
+                }
+                break;
+
+            case vector_op::slidedown:
+                for (size_t i = _vstart; i < _vl; i++) {
+                    if (_active(dec, i)) {
+                        _set<T>(vd, i, (offset < vlmax - i) ? _get<T>(vs2, i + offset) : T {});
+                    }
+                }
+                break;
+
+            case vector_op::slide1up:
+            case vector_op::fslide1up:
+                for (size_t i = _vstart; i < _vl; i++) {
+                    if (_active(dec, i)) {
+                        _set<T>(vd, i, i ? _get<T>(vs2, i - 1) : x);
+                    }
+                }
+                break;
+
+            case vector_op::slide1down:
+            case vector_op::fslide1down:
+                for (size_t i = _vstart; i < _vl; i++) {
+                    if (_active(dec, i)) {
+                        _set<T>(vd, i, (i + 1 < _vl) ? _get<T>(vs2, i + 1) : x);
+                    }
+                }
+                break;
+
+            default:
+                throw illegal_instruction(dec.pc(), dec.instr(), "vector slide");
+        }
+    }
+
+    template <std::unsigned_integral T>
+    uint64_t vector_unit::_integer(const decoder& dec, uint64_t scalar) {
+        using S = std::make_signed_t<T>;
+        constexpr T shift_mask = sizeof(T) * 8 - 1;
+
+        /* Shifts and slides take the immediate as unsigned */
+        uint64_t uimm = (dec.voperand() == vector_operand::imm) ? (scalar & 0b11111) : scalar;
+        T x = T(scalar);
+
+        switch (dec.vop()) {
+            case vector_op::add:  _map<T>(dec, x, [](T a, T b) { return T(a + b); }); break;
+            case vector_op::sub:  _map<T>(dec, x, [](T a, T b) { return T(a - b); }); break;
+            case vector_op::rsub: _map<T>(dec, x, [](T a, T b) { return T(b - a); }); break;
+
+            case vector_op::minu: _map<T>(dec, x, [](T a, T b) { return std::min(a, b); }); break;
+            case vector_op::maxu: _map<T>(dec, x, [](T a, T b) { return std::max(a, b); }); break;
+            case vector_op::min:  _map<T>(dec, x, [](T a, T b) { return T(std::min(S(a), S(b))); }); break;
+            case vector_op::max:  _map<T>(dec, x, [](T a, T b) { return T(std::max(S(a), S(b))); }); break;
+
+            case vector_op::band: _map<T>(dec, x, [](T a, T b) { return T(a & b); }); break;
+            case vector_op::bor:  _map<T>(dec, x, [](T a, T b) { return T(a | b); }); break;
+            case vector_op::bxor: _map<T>(dec, x, [](T a, T b) { return T(a ^ b); }); break;
+
+            case vector_op::sll: _map<T>(dec, T(uimm), [](T a, T b) { return T(a << (b & shift_mask)); }); break;
+            case vector_op::srl: _map<T>(dec, T(uimm), [](T a, T b) { return T(a >> (b & shift_mask)); }); break;
+            case vector_op::sra: _map<T>(dec, T(uimm), [](T a, T b) { return T(S(a) >> (b & shift_mask)); }); break;
+
+            case vector_op::mul:    _map<T>(dec, x, [](T a, T b) { return T(a * b); }); break;
+            case vector_op::mulh:   _map<T>(dec, x, [](T a, T b) { return mul_high(a, b, true, true); }); break;
+            case vector_op::mulhu:  _map<T>(dec, x, [](T a, T b) { return mul_high(a, b, false, false); }); break;
+            case vector_op::mulhsu: _map<T>(dec, x, [](T a, T b) { return mul_high(a, b, true, false); }); break;
+
+            case vector_op::divu:
+            case vector_op::div:
+            case vector_op::remu:
+            case vector_op::rem:
+                _map<T>(dec, x, [op = dec.vop()](T a, T b) { return divide(a, b, op); });
+                break;
+
+            case vector_op::macc:  _fused<T>(dec, x, [](T a, T b, T d) { return T(d + b * a); }); break;
+            case vector_op::nmsac: _fused<T>(dec, x, [](T a, T b, T d) { return T(d - b * a); }); break;
+            case vector_op::madd:  _fused<T>(dec, x, [](T a, T b, T d) { return T(b * d + a); }); break;
+            case vector_op::nmsub: _fused<T>(dec, x, [](T a, T b, T d) { return T(a - b * d); }); break;
+
+            case vector_op::mseq:  _compare<T>(dec, x, [](T a, T b) { return a == b; }); break;
+            case vector_op::msne:  _compare<T>(dec, x, [](T a, T b) { return a != b; }); break;
+            case vector_op::msltu: _compare<T>(dec, x, [](T a, T b) { return a < b; }); break;
+            case vector_op::msleu: _compare<T>(dec, x, [](T a, T b) { return a <= b; }); break;
+            case vector_op::msgtu: _compare<T>(dec, x, [](T a, T b) { return a > b; }); break;
+            case vector_op::mslt:  _compare<T>(dec, x, [](T a, T b) { return S(a) < S(b); }); break;
+            case vector_op::msle:  _compare<T>(dec, x, [](T a, T b) { return S(a) <= S(b); }); break;
+            case vector_op::msgt:  _compare<T>(dec, x, [](T a, T b) { return S(a) > S(b); }); break;
+
+            case vector_op::redsum:  _reduce<T>(dec, [](T a, T b) { return T(a + b); }); break;
+            case vector_op::redand:  _reduce<T>(dec, [](T a, T b) { return T(a & b); }); break;
+            case vector_op::redor:   _reduce<T>(dec, [](T a, T b) { return T(a | b); }); break;
+            case vector_op::redxor:  _reduce<T>(dec, [](T a, T b) { return T(a ^ b); }); break;
+            case vector_op::redminu: _reduce<T>(dec, [](T a, T b) { return std::min(a, b); }); break;
+            case vector_op::redmaxu: _reduce<T>(dec, [](T a, T b) { return std::max(a, b); }); break;
+            case vector_op::redmin:  _reduce<T>(dec, [](T a, T b) { return T(std::min(S(a), S(b))); }); break;
+            case vector_op::redmax:  _reduce<T>(dec, [](T a, T b) { return T(std::max(S(a), S(b))); }); break;
+
+            case vector_op::merge:
+                _merge<T>(dec, x);
+                break;
+
+            case vector_op::slideup:
+            case vector_op::slidedown:
+                _slide<T>(dec, x, uimm);
+                break;
+
+            case vector_op::slide1up:
+            case vector_op::slide1down:
+                _slide<T>(dec, x, 1);
+                break;
+
+            case vector_op::id:
+                for (size_t i = _vstart; i < _vl; i++) {
+                    if (_active(dec, i)) {
+                        _set<T>(dec.vd(), i, T(i));
+                    }
+                }
+                break;
+
+            /* Element 0 regardless of vl, sign-extended to XLEN */
+            case vector_op::mv_x_s:
+                return uint64_t(int64_t(S(_get<T>(dec.vs2(), 0))));
+
+            case vector_op::mv_s_x:
+                if (_vstart < _vl) {
+                    _set<T>(dec.vd(), 0, x);
+                }
+                break;
+
+            default:
+                throw illegal_instruction(dec.pc(), dec.instr(), "vector integer op");
+        }
+
+        return 0;
+    }
+
+    template <std::floating_point T>
+    uint64_t vector_unit::_float(const decoder& dec, uint64_t scalar) {
+        T x = unbox<T>(scalar);
+
+        switch (dec.vop()) {
+            case vector_op::fadd:  _map<T>(dec, x, [](T a, T b) { return canonical<T>(a + b); }); break;
+            case vector_op::fsub:  _map<T>(dec, x, [](T a, T b) { return canonical<T>(a - b); }); break;
+            case vector_op::frsub: _map<T>(dec, x, [](T a, T b) { return canonical<T>(b - a); }); break;
+            case vector_op::fmul:  _map<T>(dec, x, [](T a, T b) { return canonical<T>(a * b); }); break;
+            case vector_op::fdiv:  _map<T>(dec, x, [](T a, T b) { return canonical<T>(a / b); }); break;
+            case vector_op::frdiv: _map<T>(dec, x, [](T a, T b) { return canonical<T>(b / a); }); break;
+
+            case vector_op::fmin: _map<T>(dec, x, [](T a, T b) { return min_max<T>(a, b, false); }); break;
+            case vector_op::fmax: _map<T>(dec, x, [](T a, T b) { return min_max<T>(a, b, true); }); break;
+
+            case vector_op::fsgnj:
+            case vector_op::fsgnjn:
+            case vector_op::fsgnjx:
+                _map<T>(dec, x, [op = dec.vop()](T a, T b) { return sign_inject<T>(a, b, op); });
+                break;
+
+            /* vs1 or the scalar multiplies vs2, or vd for the *add and *sub forms */
+            case vector_op::fmacc:  _fused<T>(dec, x, [](T a, T b, T d) { return canonical<T>(std::fma(b, a, d)); });   break;
+            case vector_op::fnmacc: _fused<T>(dec, x, [](T a, T b, T d) { return canonical<T>(std::fma(-b, a, -d)); }); break;
+            case vector_op::fmsac:  _fused<T>(dec, x, [](T a, T b, T d) { return canonical<T>(std::fma(b, a, -d)); });  break;
+            case vector_op::fnmsac: _fused<T>(dec, x, [](T a, T b, T d) { return canonical<T>(std::fma(-b, a, d)); });  break;
+            case vector_op::fmadd:  _fused<T>(dec, x, [](T a, T b, T d) { return canonical<T>(std::fma(b, d, a)); });   break;
+            case vector_op::fnmadd: _fused<T>(dec, x, [](T a, T b, T d) { return canonical<T>(std::fma(-b, d, -a)); }); break;
+            case vector_op::fmsub:  _fused<T>(dec, x, [](T a, T b, T d) { return canonical<T>(std::fma(b, d, -a)); });  break;
+            case vector_op::fnmsub: _fused<T>(dec, x, [](T a, T b, T d) { return canonical<T>(std::fma(-b, d, a)); });  break;
+
+            /* Equality is quiet, ordering comparisons signal on any NaN */
+            case vector_op::mfeq: _compare<T>(dec, x, [](T a, T b) { return a == b; }); break;
+            case vector_op::mfne: _compare<T>(dec, x, [](T a, T b) { return a != b; }); break;
+            case vector_op::mflt: _compare<T>(dec, x, [](T a, T b) { return a < b; }); break;
+            case vector_op::mfle: _compare<T>(dec, x, [](T a, T b) { return a <= b; }); break;
+            case vector_op::mfgt: _compare<T>(dec, x, [](T a, T b) { return a > b; }); break;
+            case vector_op::mfge: _compare<T>(dec, x, [](T a, T b) { return a >= b; }); break;
+
+            /* The unordered sum may be computed in any order, in order is one of them */
+            case vector_op::fredusum:
+            case vector_op::fredosum:
+                _reduce<T>(dec, [](T a, T b) { return canonical<T>(a + b); });
+                break;
+
+            case vector_op::fredmin: _reduce<T>(dec, [](T a, T b) { return min_max<T>(a, b, false); }); break;
+            case vector_op::fredmax: _reduce<T>(dec, [](T a, T b) { return min_max<T>(a, b, true); }); break;
+
+            case vector_op::fmerge:
+                _merge<T>(dec, x);
+                break;
+
+            case vector_op::fslide1up:
+            case vector_op::fslide1down:
+                _slide<T>(dec, x, 1);
+                break;
+
+            case vector_op::fmv_f_s:
+                return box<T>(_get<T>(dec.vs2(), 0));
+
+            case vector_op::fmv_s_f:
+                if (_vstart < _vl) {
+                    _set<T>(dec.vd(), 0, x);
+                }
+                break;
+
+            default:
+                throw illegal_instruction(dec.pc(), dec.instr(), "vector float op");
+        }
+
+        return 0;
+    }
+
+    uint64_t vector_unit::_mask(const decoder& dec) {
+        uint8_t vd = dec.vd(), vs1 = dec.vs1(), vs2 = dec.vs2();
+
+        switch (dec.vop()) {
+            case vector_op::cpop: {
+                uint64_t count = 0;
+
+                for (size_t i = 0; i < _vl; i++) {
+                    count += _active(dec, i) && _bit(vs2, i);
+                }
+
+                return count;
+            }
+
+            case vector_op::first: {
+                for (size_t i = 0; i < _vl; i++) {
+                    if (_active(dec, i) && _bit(vs2, i)) {
+                        return i;
+                    }
+                }
+
+                return ~uint64_t { 0 };
+            }
+
+            default:
+                break;
+        }
+
+        for (size_t i = _vstart; i < _vl; i++) {
+            bool a = _bit(vs2, i);
+            bool b = _bit(vs1, i);
+            bool res;
+
+            switch (dec.vop()) {
+                case vector_op::mand:  res = a && b;    break;
+                case vector_op::mnand: res = !(a && b); break;
+                case vector_op::mandn: res = a && !b;   break;
+                case vector_op::mxor:  res = a != b;    break;
+                case vector_op::mor:   res = a || b;    break;
+                case vector_op::mnor:  res = !(a || b); break;
+                case vector_op::morn:  res = a || !b;   break;
+                case vector_op::mxnor: res = a == b;    break;
+                default: throw illegal_instruction(dec.pc(), dec.instr(), "vector mask op");
+            }
+
+            _set_bit(vd, i, res);
+        }
+
+        return 0;
+    }
+
+    uint64_t vector_unit::configure(uint64_t avl, uint64_t vtype) {
+        unsigned sew_shift = (vtype >> 3) & 0b111;
+        int lmul = static_cast<int>(vtype & 0b111);
+        int lmul_shift = (lmul & 0b100) ? lmul - 8 : lmul;
+
+        /* Fractional groups need SEW <= LMUL * ELEN, with ELEN = 64 */
+        bool valid = (vtype >> 8) == 0 && lmul != 0b100 && sew_shift <= 3
+            && (lmul_shift >= 0 || static_cast<int>(sew_shift) <= 3 + lmul_shift);
+
+        _vstart = 0;
+
+        if (!valid) {
+            _vtype = vill;
+            _vl = 0;
+            return 0;
+        }
+
+        _vtype = vtype;
+        _vl = std::min<uint64_t>(avl, _vlmax());
+
+        return _vl;
+    }
+
+    uint64_t vector_unit::execute(const decoder& dec, uint64_t scalar) {
+        if (_vtype & vill) {
+            throw illegal_instruction(dec.pc(), dec.instr(), "vill");
+        }
+
+        vector_op op = dec.vop();
+        size_t group = _group();
+
+        bool mask_logic = op >= vector_op::mand && op <= vector_op::first;
+        bool reduction = (op >= vector_op::redsum && op <= vector_op::redmax)
+            || (op >= vector_op::fredusum && op <= vector_op::fredmax);
+        bool compare = (op >= vector_op::mseq && op <= vector_op::msgt) || (op >= vector_op::mfeq && op <= vector_op::mfge);
+        bool scalar_move = op >= vector_op::mv_x_s && op <= vector_op::fmv_s_f;
+
+        /* Single registers are always aligned, vd only holds a mask or element 0 for these */
+        if (!mask_logic && !scalar_move) {
+            _check_group(dec, dec.vs2(), group);
+
+            if (!reduction && !compare) {
+                _check_group(dec, dec.vd(), group);
+            }
+
+            if (dec.voperand() == vector_operand::vector && !reduction) {
+                _check_group(dec, dec.vs1(), group);
+            }
+        }
+
+        /* A masked instruction can't overwrite its own mask, unless the result is a mask */
+        if (dec.masked() && dec.vd() == 0 && !compare && !mask_logic && op != vector_op::merge && op != vector_op::fmerge) {
+            throw illegal_instruction(dec.pc(), dec.instr(), "masked write to v0");
+        }
+
+        uint64_t res;
+
+        if (mask_logic) {
+            res = _mask(dec);
+        } else if (op >= vector_op::fmv_f_s) {
+            switch (_sew_shift()) {
+                case 2: res = _float<float>(dec, scalar);  break;
+                case 3: res = _float<double>(dec, scalar); break;
+                default: throw illegal_instruction(dec.pc(), dec.instr(), "vector float width");
+            }
+        } else {
+            switch (_sew_shift()) {
+                case 0: res = _integer<uint8_t>(dec, scalar);  break;
+                case 1: res = _integer<uint16_t>(dec, scalar); break;
+                case 2: res = _integer<uint32_t>(dec, scalar); break;
+                default: res = _integer<uint64_t>(dec, scalar); break;
+            }
+        }
+
+        _vstart = 0;
+        return res;
+    }
+
+    std::span<uint8_t> vector_unit::memory_operand(const decoder& dec) {
+        uint8_t v = dec.vd();
+        size_t width = mem_size_bytes(dec.memory());
+
+        switch (dec.vaddressing()) {
+            case vector_addressing::whole: {
+                _check_group(dec, v, dec.vregs());
+                return { _regs.data() + v * vlenb, dec.vregs() * vlenb };
+            }
+
+            case vector_addressing::mask:
+                if (_vtype & vill) {
+                    throw illegal_instruction(dec.pc(), dec.instr(), "vill");
+                }
+
+                return { _regs.data() + v * vlenb, (_vl + 7) / 8 };
+
+            default:
+                break;
+        }
+
+        if (_vtype & vill) {
+            throw illegal_instruction(dec.pc(), dec.instr(), "vill");
+        }
+
+        /* The group holds as many elements of the access width as of SEW */
+        int emul_shift = _lmul_shift() + std::countr_zero(width) - static_cast<int>(_sew_shift());
+        if (emul_shift < -3 || emul_shift > 3) {
+            throw illegal_instruction(dec.pc(), dec.instr(), "vector emul");
+        }
+
+        _check_group(dec, v, size_t { 1 } << std::max(emul_shift, 0));
+
+        if (dec.masked() && v == 0 && dec.vop() == vector_op::load) {
+            throw illegal_instruction(dec.pc(), dec.instr(), "masked write to v0");
+        }
+
+        return { _regs.data() + v * vlenb, _vlmax() * width };
+    }
+}
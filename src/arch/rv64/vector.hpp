@@ -0,0 +1,117 @@
+#pragma once
+
+#include "rv64.hpp"
+#include "decoder.hpp"
+
+#include <array>
+#include <span>
+#include <concepts>
+
+namespace arch::rv64 {
+    /* V extension registers, configuration and arithmetic.
+     *
+     * All 32 registers are one contiguous byte array, so a register group is
+     * a plain array of elements. Every operation is a loop over such arrays
+     * with no dependency between elements, which the host compiler turns into
+     * SSE, AVX2 or AVX-512 code for whatever it targets. The common unmasked
+     * case gets its own loop, so the vectorized code has no per-element branch.
+     *
+     * Tails and inactive elements are always left undisturbed, which is valid
+     * for both the agnostic and the undisturbed policies.
+     */
+    class vector_unit {
+        public:
+        /* Bits per register, the smallest VLEN allowed by the application profiles */
+        static constexpr size_t vlen = 128;
+        static constexpr size_t vlenb = vlen / 8;
+
+        /* vtype with vill set, every other field is zero */
+        static constexpr uint64_t vill = uint64_t { 1 } << 63;
+
+        private:
+        alignas(64) std::array<uint8_t, 32 * vlenb> _regs {};
+
+        uint64_t _vl = 0;
+        uint64_t _vtype = vill;
+        uint64_t _vstart = 0;
+
+        /* log2 of SEW in bytes and of LMUL, which is negative for fractional groups */
+        [[nodiscard]] unsigned _sew_shift() const { return (_vtype >> 3) & 0b111; }
+        [[nodiscard]] int _lmul_shift() const;
+
+        [[nodiscard]] size_t _vlmax() const;
+
+        /* Registers in a group, at least 1 */
+        [[nodiscard]] size_t _group() const;
+
+        /* Register groups have to start at a multiple of their size */
+        void _check_group(const decoder& dec, uint8_t v, size_t regs) const;
+
+        template <typename T>
+        [[nodiscard]] T _get(uint8_t v, size_t i) const;
+
+        template <typename T>
+        void _set(uint8_t v, size_t i, T val);
+
+        [[nodiscard]] bool _bit(uint8_t v, size_t i) const { return (_regs[v * vlenb + i / 8] >> (i % 8)) & 1; }
+        void _set_bit(uint8_t v, size_t i, bool val);
+
+        [[nodiscard]] bool _active(const decoder& dec, size_t i) const { return !dec.masked() || mask(i); }
+
+        /* vd[i] = f(vs2[i], vs1[i] or the scalar) */
+        template <typename T, typename F>
+        void _map(const decoder& dec, T x, F f);
+
+        /* vd[i] = f(vs2[i], vs1[i] or the scalar, vd[i]) */
+        template <typename T, typename F>
+        void _fused(const decoder& dec, T x, F f);
+
+        /* Mask bit vd[i] = f(vs2[i], vs1[i] or the scalar) */
+        template <typename T, typename F>
+        void _compare(const decoder& dec, T x, F f);
+
+        /* vd[0] = f(... f(vs1[0], vs2[0]) ..., vs2[vl - 1]) over active elements */
+        template <typename T, typename F>
+        void _reduce(const decoder& dec, F f);
+
+        template <typename T>
+        void _merge(const decoder& dec, T x);
+
+        template <typename T>
+        void _slide(const decoder& dec, T x, uint64_t offset);
+
+        template <std::unsigned_integral T>
+        [[nodiscard]] uint64_t _integer(const decoder& dec, uint64_t scalar);
+
+        template <std::floating_point T>
+        [[nodiscard]] uint64_t _float(const decoder& dec, uint64_t scalar);
+
+        /* Mask logical operations, vcpop and vfirst */
+        [[nodiscard]] uint64_t _mask(const decoder& dec);
+
+        public:
+        /* vsetvl, vsetvli and vsetivli, returns the new vl */
+        uint64_t configure(uint64_t avl, uint64_t vtype);
+
+        /* Arithmetic instructions, scalar is rs1 or the immediate. Returns the value for rd,
+         * which is only set by instructions with a scalar result. Float operations run in
+         * whatever rounding mode the host is in.
+         */
+        uint64_t execute(const decoder& dec, uint64_t scalar);
+
+        /* The register group a load or store transfers, as bytes. Elements of unit-stride and
+         * strided accesses are at multiples of the access width in it.
+         */
+        [[nodiscard]] std::span<uint8_t> memory_operand(const decoder& dec);
+
+        /* Whether element i is active under the v0 mask */
+        [[nodiscard]] bool mask(size_t i) const { return _bit(0, i); }
+
+        [[nodiscard]] uint64_t vl() const { return _vl; }
+        [[nodiscard]] uint64_t vtype() const { return _vtype; }
+        [[nodiscard]] uint64_t vstart() const { return _vstart; }
+
+        /* Instructions start at vstart, and reset it once they're done */
+        void set_vstart(uint64_t vstart) { _vstart = vstart; }
+    };
+}
@@ -0,0 +1,310 @@
+#include "batch_runner.hpp"
+
+#include <array>
+#include <deque>
+#include <sstream>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <arch/arch.hpp>
+#include <memory/memory.hpp>
+#include <util/elf_file.hpp>
+
+namespace fs = std::filesystem;
+
+batch_runner::batch_runner(size_t threads)
+    : _threads { threads ? threads : std::max<size_t>(std::thread::hardware_concurrency(), 1) } {
+
+}
+
+batch_runner::~batch_runner() = default;
+
+elf_file& batch_runner::_file(const fs::path& path) {
+    auto canonical = fs::canonical(path);
+
+    std::scoped_lock lock { _files_lock };
+
+    auto it = _files.find(canonical);
+    if (it == _files.end()) {
+        it = _files.emplace(canonical, std::make_unique<elf_file>(canonical)).first;
+    }
+
+    return *it->second;
+}
+
+batch_runner::result batch_runner::_run(const job& j) {
+    result res;
+
+    std::array<int, 3> stdio { -1, -1, -1 };
+    std::array<const fs::path*, 3> paths { &j.stdin_path, &j.stdout_path, &j.stderr_path };
+
+    auto close_stdio = [&] {
+        for (int& fd : stdio) {
+            if (fd >= 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+    };
+
+    try {
+        if (j.executable.empty()) {
+            throw std::runtime_error("no executable");
+        }
+
+        for (size_t i = 0; i < stdio.size(); i++) {
+            if (paths[i]->empty()) {
+                continue;
+            }
+
+            int flags = (i == STDIN_FILENO) ? O_RDONLY : (O_WRONLY | O_CREAT | O_TRUNC);
+
+            stdio[i] = open(paths[i]->c_str(), flags | O_CLOEXEC, 0644);
+            if (stdio[i] < 0) {
+                throw std::system_error(errno, std::generic_category(), paths[i]->string());
+            }
+        }
+
+        elf_file& elf = _file(j.executable);
+
+        virtual_memory mem = elf.load();
+        auto executor = elf.make_executor(mem, elf.entry(), j.config);
+
+        std::ostringstream report;
+        executor->report_to(report);
+
+        /* The executor owns them from here on */
+        executor->attach_stdio(stdio);
+        stdio.fill(-1);
+
+        std::vector<std::string> argv = j.argv;
+        std::vector<std::string> env = j.env;
+
+        if (argv.empty()) {
+            argv.push_back(j.executable.string());
+        }
+
+        executor->setup_stack(argv, env);
+
+        res.exit_code = executor->run();
+        res.instructions = executor->current_instructions();
+        res.runtime = executor->last_runtime();
+        res.report = report.str();
+    } catch (invalid_file& e) {
+        res.error = fmt::format("invalid executable file: {}", e.what());
+    } catch (illegal_access& e) {
+        res.error = fmt::format("illegal_access: {}", e.what());
+    } catch (arch::illegal_instruction& e) {
+        res.error = fmt::format("illegal_instruction: {}", e.what());
+    } catch (arch::invalid_syscall& e) {
+        res.error = fmt::format("invalid syscall: {}", e.what());
+    } catch (arch::illegal_operation& e) {
+        res.error = fmt::format("illegal operation: {}", e.what());
+    } catch (std::exception& e) {
+        res.error = e.what();
+    }
+
+    close_stdio();
+
+    return res;
+}
+
+std::vector<batch_runner::result> batch_runner::run(std::span<const job> jobs) {
+    std::vector<result> results(jobs.size());
+
+    /* Dependencies each job still waits for, and the jobs waiting for each */
+    std::vector<size_t> waiting(jobs.size());
+    std::vector<std::vector<size_t>> dependents(jobs.size());
+    std::deque<size_t> ready;
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        for (size_t dep : jobs[i].depends) {
+            if (dep >= jobs.size()) {
+                throw std::out_of_range(fmt::format("job {} depends on job {}, there are only {}", i, dep, jobs.size()));
+            }
+
+            dependents[dep].push_back(i);
+        }
+
+        waiting[i] = jobs[i].depends.size();
+        if (!waiting[i]) {
+            ready.push_back(i);
+        }
+    }
+
+    std::mutex lock;
+    std::condition_variable cond;
+    size_t running = 0;
+    size_t done = 0;
+
+    /* With the lock held, release the dependents of a job that is done */
+    auto finish = [&](size_t first) {
+        std::vector<size_t> finished { first };
+
+        while (!finished.empty()) {
+            size_t n = finished.back();
+            finished.pop_back();
+            done += 1;
+
+            bool passed = !results[n].skipped && results[n].error.empty() && results[n].exit_code == 0;
+
+            for (size_t dependent : dependents[n]) {
+                auto& res = results[dependent];
+
+                if (!passed && !res.skipped) {
+                    res.skipped = true;
+                    res.error = fmt::format("skipped, job {} failed", n);
+                }
+
+                /* Skipped jobs are done as soon as nothing keeps them waiting */
+                if (--waiting[dependent] == 0) {
+                    if (res.skipped) {
+                        finished.push_back(dependent);
+                    } else {
+                        ready.push_back(dependent);
+                    }
+                }
+            }
+        }
+    };
+
+    auto work = [&] {
+        std::unique_lock guard { lock };
+
+        while (done < jobs.size()) {
+            if (ready.empty()) {
+                /* Nothing running could make anything ready, whatever is left waits on itself */
+                if (!running) {
+                    for (size_t i = 0; i < jobs.size(); i++) {
+                        if (waiting[i]) {
+                            waiting[i] = 0;
+                            results[i].skipped = true;
+                            results[i].error = "skipped, its dependencies form a cycle";
+                            done += 1;
+                        }
+                    }
+
+                    break;
+                }
+
+                cond.wait(guard);
+                continue;
+            }
+
+            size_t n = ready.front();
+            ready.pop_front();
+            running += 1;
+
+            guard.unlock();
+            result res = _run(jobs[n]);
+            guard.lock();
+
+            results[n] = std::move(res);
+            running -= 1;
+            finish(n);
+
+            cond.notify_all();
+        }
+
+        cond.notify_all();
+    };
+
+    {
+        std::vector<std::jthread> workers;
+
+        for (size_t i = 0; i < std::min(_threads, jobs.size()); i++) {
+            workers.emplace_back(work);
+        }
+    }
+
+    return results;
+}
+
+batch_runner::job batch_runner::from_config(const fs::path& path) {
+    job j;
+    j.config = cpptoml::parse_file(path.string());
+
+    /* Relative to the config file, and as given for argv[0], like specter_emu -c */
+    if (auto exec = j.config->get_qualified_as<std::string>("execution.executable")) {
+        fs::path executable { *exec };
+
+        j.executable = executable.is_absolute() ? executable : path.parent_path() / executable;
+        j.argv.push_back(*exec);
+    }
+
+    return j;
+}
+
+std::vector<batch_runner::job> batch_runner::load(const fs::path& path) {
+    auto file = cpptoml::parse_file(path.string());
+    fs::path dir = path.parent_path();
+
+    auto relative_to = [](const fs::path& base, const std::string& p) {
+        fs::path res { p };
+        return res.is_absolute() ? res : base / res;
+    };
+
+    std::vector<job> jobs;
+
+    auto entries = file->get_table_array("job");
+    if (!entries) {
+        return jobs;
+    }
+
+    for (const auto& entry : *entries) {
+        job j;
+
+        if (auto config = entry->get_as<std::string>("config")) {
+            j = from_config(relative_to(dir, *config));
+        }
+
+        if (auto exec = entry->get_as<std::string>("executable")) {
+            j.executable = relative_to(dir, *exec);
+            j.argv.clear();
+        }
+
+        if (j.executable.empty()) {
+            throw std::runtime_error(fmt::format("{}: job {} has no executable", path.string(), jobs.size()));
+        }
+
+        if (auto argv = entry->get_array_of<std::string>("argv")) {
+            j.argv = *argv;
+        }
+
+        if (auto env = entry->get_array_of<std::string>("env")) {
+            j.env = *env;
+        }
+
+        if (auto depends = entry->get_array_of<int64_t>("depends")) {
+            for (int64_t dep : *depends) {
+                if (dep < 0) {
+                    throw std::runtime_error(fmt::format("{}: job {} depends on job {}", path.string(), jobs.size(), dep));
+                }
+
+                j.depends.push_back(static_cast<size_t>(dep));
+            }
+        }
+
+        if (auto in = entry->get_as<std::string>("stdin")) {
+            j.stdin_path = relative_to(dir, *in);
+        }
+
+        if (auto out = entry->get_as<std::string>("stdout")) {
+            j.stdout_path = relative_to(dir, *out);
+        }
+
+        if (auto err = entry->get_as<std::string>("stderr")) {
+            j.stderr_path = relative_to(dir, *err);
+        }
+
+        jobs.push_back(std::move(j));
+    }
+
+    return jobs;
+}
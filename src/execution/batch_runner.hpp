@@ -0,0 +1,92 @@
+#pragma once
+
+#include <map>
+#include <span>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+#include <cstdlib>
+
+#include <cpptoml.h>
+
+class elf_file;
+
+/* Runs many guests at once in this process, on a pool of host threads.
+ *
+ * Jobs of the same executable share its parsed and mapped ELF file, and with
+ * it the read-only segments, which are mapped from the file rather than
+ * copied. Every job still gets its own address space, executor, registers
+ * and interval timers. Signals from outside the process are the exception,
+ * each goes to just one of the guests that handle or ignore it.
+ */
+class batch_runner {
+    public:
+    struct job {
+        std::filesystem::path executable;
+
+        /* argv[0] is the executable if there are none */
+        std::vector<std::string> argv;
+        std::vector<std::string> env;
+
+        /* The emulator's own if empty */
+        std::filesystem::path stdin_path;
+        std::filesystem::path stdout_path;
+        std::filesystem::path stderr_path;
+
+        /* Executor config, like specter_emu -c */
+        std::shared_ptr<cpptoml::table> config;
+
+        /* Jobs, by index, that have to exit with 0 before this one starts */
+        std::vector<size_t> depends;
+    };
+
+    struct result {
+        int exit_code = EXIT_FAILURE;
+
+        /* Why the guest didn't run to its end, empty if it did */
+        std::string error;
+
+        /* Not run at all because a dependency failed */
+        bool skipped = false;
+
+        /* Test mode's mismatches */
+        std::string report;
+
+        size_t instructions = 0;
+        std::chrono::nanoseconds runtime {};
+    };
+
+    private:
+    size_t _threads;
+
+    std::mutex _files_lock;
+    std::map<std::filesystem::path, std::unique_ptr<elf_file>> _files;
+
+    [[nodiscard]] elf_file& _file(const std::filesystem::path& path);
+
+    /* Never throws, errors end up in the result */
+    [[nodiscard]] result _run(const job& j);
+
+    public:
+    /* As many threads as the host has cores for 0 */
+    explicit batch_runner(size_t threads = 0);
+    ~batch_runner();
+
+    batch_runner(const batch_runner&) = delete;
+    batch_runner& operator=(const batch_runner&) = delete;
+
+    /* Returns once all jobs are done or skipped, results are in the order of the jobs */
+    [[nodiscard]] std::vector<result> run(std::span<const job> jobs);
+
+    /* A job running what an executor config names in execution.executable */
+    [[nodiscard]] static job from_config(const std::filesystem::path& path);
+
+    /* Read a job list, a [[job]] table array with the fields of job. Paths are relative to the file,
+     * a job with a config but no executable runs the config's execution.executable, depends are
+     * indices into the list.
+     */
+    [[nodiscard]] static std::vector<job> load(const std::filesystem::path& path);
+};
@@ -2,24 +2,40 @@
 
 #include <ranges>
 #include <random>
+#include <algorithm>
+#include <array>
+#include <iostream>
 
-#include "elf_file.hpp"
+#include <util/elf_file.hpp>
 
 #include <fmt/ostream.h>
 
 executor::executor(elf_file& elf, virtual_memory& mem, uintptr_t entry, uintptr_t sp)
     : elf { elf }, mem { mem }, entry { entry }, pc { entry }, sp { sp }
     , cycles { 0 }, instructions { 0 }
-    , start_time { }, end_time { } {
+    , start_time { }, end_time { }, report { &std::cerr } {
 
 }
 
+void executor::restore([[maybe_unused]] const snapshot& snap) {
+    throw std::runtime_error("this executor can't restore snapshots");
+}
+
+void executor::attach_stdio([[maybe_unused]] std::span<const int, 3> host) {
+    throw std::runtime_error("this executor can't redirect stdio");
+}
+
 void executor::setup_stack(std::span<std::string> argv, std::span<std::string> env) {
     if (argv.empty()) {
         throw std::runtime_error("argv cannot be empty");
     }
 
-    /* Push argc and argv onto the stack */
+    /* Push a null-terminated string, std::string always has the terminator in memory */
+    auto push_string = [this](const std::string& str) {
+        sp -= str.size() + 1;
+        mem.write_block(sp, std::span(reinterpret_cast<const uint8_t*>(str.c_str()), str.size() + 1));
+        return sp;
+    };
 
     /* sp currently points at the stack base */
 
@@ -28,73 +44,32 @@ void executor::setup_stack(std::span<std::string> argv, std::span<std::string> e
     mem.write_dword(sp, 0);
 
     /* First the program name (for whatever reason) */
-    {
-        size_t bytes = argv.front().size() + 1;
-        sp -= bytes;
-        for (size_t i = 0; i < bytes; ++i) {
-            mem.write_byte(sp + i, argv[0][i]);
-        }
-    }
-    uintptr_t at_execfn = sp;
-
-    /* Push environment */
-    /* Contains pointers to env values in reverse order, including null terminator */
-    std::vector<uintptr_t> mapped_env(env.size() + 1, uintptr_t{0});
-    {
-        auto env_it = mapped_env.begin();
-
-        /* Not std::string_view because we want a null terminator */
-        for (const std::string& v : std::views::reverse(env)) {
-            size_t bytes = v.size() + 1;
+    uintptr_t at_execfn = push_string(argv.front());
 
-            sp -= bytes;
-            *env_it++ = sp;
-
-            for (size_t i = 0; i < bytes; ++i) {
-                mem.write_byte(sp + i, v[i]);
-            }
-        }
+    /* Push environment and argv strings, keeping track of where they end up */
+    std::vector<uintptr_t> mapped_env(env.size());
+    for (size_t i = env.size(); i > 0; --i) {
+        mapped_env[i - 1] = push_string(env[i - 1]);
     }
 
-    /* Push argv */
-    std::vector<uintptr_t> mapped_argv(argv.size() + 1, uintptr_t{0});
-    {
-        auto argv_it = mapped_argv.begin();
-        for (const std::string& v : std::views::reverse(argv)) {
-            size_t bytes = v.size() + 1;
-
-            sp -= bytes;
-            *argv_it++ = sp;
-
-            for (size_t i = 0; i < bytes; ++i) {
-                mem.write_byte(sp + i, v[i]);
-            }
-        }
+    std::vector<uintptr_t> mapped_argv(argv.size());
+    for (size_t i = argv.size(); i > 0; --i) {
+        mapped_argv[i - 1] = push_string(argv[i - 1]);
     }
 
     /* Pad to a 16-byte boundary */
     sp &= uintptr_t(-16);
     
-    {
-        /* AT_PLATFORM value */
-        std::string platform = "Specter";
-        size_t bytes = platform.size() + 1;
-
-        sp -= bytes;
-
-        for (size_t i = 0; i < bytes; ++i) {
-            mem.write_byte(sp + i, platform[i]);
-        }
-    }
-    uintptr_t at_platform = sp;
+    /* AT_PLATFORM value */
+    uintptr_t at_platform = push_string("Specter");
 
     {
         /* 16 random bytes */
         std::random_device rand;
-        for (size_t i = 0; i < 4; ++i) {
-            sp -= 4;
-            mem.write_word(sp, rand());
-        }
+        std::array<uint32_t, 4> random_bytes { rand(), rand(), rand(), rand() };
+
+        sp -= sizeof(random_bytes);
+        mem.write_block(sp, std::span(reinterpret_cast<const uint8_t*>(random_bytes.data()), sizeof(random_bytes)));
     }
 
     uintptr_t at_random = sp;
@@ -102,41 +77,46 @@ void executor::setup_stack(std::span<std::string> argv, std::span<std::string> e
     /* Pad to 16 bytes again */
     sp &= uintptr_t(-16);
 
-    {
-        /* auxvec in dword,dword pairs */
-        std::array auxvec {
-            Elf64_auxv_t{ AT_NULL, 0 },
-            Elf64_auxv_t{ AT_PLATFORM, at_platform },
-            Elf64_auxv_t{ AT_EXECFN, at_execfn },
-            Elf64_auxv_t{ AT_RANDOM, at_random },
-            Elf64_auxv_t{ AT_SECURE, 0 }
-        };
-
-        for (auto& v : auxvec) {
-            sp -= 8;
-            mem.write_dword(sp, v.a_un.a_val);
-
-            sp -= 8;
-            mem.write_dword(sp, v.a_type);
-        }
-    }
+    /* Everything below is written as one block, in increasing address order:
+     * argc, argv, NULL, envp, NULL, auxv (AT_NULL terminated)
+     */
+    std::vector<uint64_t> table;
+    table.reserve(1 + (argv.size() + 1) + (env.size() + 1) + 2 * 5);
 
-    /* Already 16-aligned, push environ and argv */
-    for (uintptr_t environ : mapped_env) {
-        sp -= 8;
-        mem.write_dword(sp, environ);
+    /* argc takes 8 bytes on the stack
+     * https://elixir.bootlin.com/linux/v6.1-rc7/source/fs/binfmt_elf.c#L326
+     */
+    table.push_back(argv.size());
+
+    std::ranges::copy(mapped_argv, std::back_inserter(table));
+    table.push_back(0);
+
+    std::ranges::copy(mapped_env, std::back_inserter(table));
+    table.push_back(0);
+
+    /* auxvec in dword,dword pairs */
+    std::array auxvec {
+        Elf64_auxv_t{ AT_PLATFORM, { at_platform } },
+        Elf64_auxv_t{ AT_EXECFN, { at_execfn } },
+        Elf64_auxv_t{ AT_RANDOM, { at_random } },
+        Elf64_auxv_t{ AT_SECURE, { 0 } },
+        Elf64_auxv_t{ AT_NULL, { 0 } },
+    };
+
+    for (const auto& v : auxvec) {
+        table.push_back(v.a_type);
+        table.push_back(v.a_un.a_val);
     }
 
-    for (uintptr_t arg : mapped_argv) {
-        sp -= 8;
-        mem.write_dword(sp, arg);
+    if (mem.byte_order() != std::endian::native) {
+        std::ranges::transform(table, table.begin(), [](uint64_t v) { return std::byteswap(v); });
     }
 
-    /* ALlocate 8 bytes but only use 4 bytes for argc
-     * https://elixir.bootlin.com/linux/v6.1-rc7/source/fs/binfmt_elf.c#L326
-     */
-    sp -= 8;
-    mem.write_word(sp, static_cast<int>(argv.size()));
+    /* Keep the final sp 16-byte aligned */
+    sp -= table.size() * sizeof(uint64_t);
+    sp &= uintptr_t(-16);
+
+    mem.write_block(sp, std::span(reinterpret_cast<const uint8_t*>(table.data()), table.size() * sizeof(uint64_t)));
 }
 
 std::ostream& executor::print_state(std::ostream& os) const {
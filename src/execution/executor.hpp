@@ -1,11 +1,13 @@
 #pragma once
 
 #include <chrono>
+#include <ostream>
 
 #include <arch/arch.hpp>
 #include <memory/virtual_memory.hpp>
 
 class elf_file;
+class snapshot;
 class executor {
     protected:
     elf_file& elf;
@@ -18,6 +20,9 @@ class executor {
 
     std::chrono::steady_clock::time_point start_time;
     std::chrono::steady_clock::time_point end_time;
+
+    /* Where test mode reports mismatches */
+    std::ostream* report;
     
     public:
     executor(elf_file& elf, virtual_memory& mem, uintptr_t entry, uintptr_t sp);
@@ -37,6 +42,17 @@ class executor {
 
     virtual void setup_stack(std::span<std::string> argv, std::span<std::string> env);
 
+    /* Continue a saved guest instead of starting at the entry point, in place of setup_stack */
+    virtual void restore(const snapshot& snap);
+
+    /* Give the guest these host fds as stdin, stdout and stderr instead of the emulator's, -1 keeps one.
+     * The executor closes them when it's done.
+     */
+    virtual void attach_stdio(std::span<const int, 3> host);
+
+    /* Send test mode reports somewhere other than stderr */
+    void report_to(std::ostream& os) { report = &os; }
+
     virtual std::ostream& print_state(std::ostream& os) const;
 };
 
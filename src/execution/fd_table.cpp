@@ -0,0 +1,93 @@
+#include "fd_table.hpp"
+
+#include <cerrno>
+#include <utility>
+
+#include <unistd.h>
+
+fd_table::fd_table() {
+    for (int fd : { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO }) {
+        _entries.push_back({ .host = fd, .owned = false });
+    }
+}
+
+fd_table::~fd_table() {
+    for (const auto& [host, owned] : _entries) {
+        if (host >= 0 && owned) {
+            ::close(host);
+        }
+    }
+}
+
+int fd_table::insert(int host, bool owned) {
+    std::scoped_lock lock { _lock };
+
+    for (size_t i = 0; i < _entries.size(); ++i) {
+        if (_entries[i].host < 0) {
+            _entries[i] = { .host = host, .owned = owned };
+            return static_cast<int>(i);
+        }
+    }
+
+    _entries.push_back({ .host = host, .owned = owned });
+    return static_cast<int>(_entries.size() - 1);
+}
+
+void fd_table::install(int guest, int host, bool owned) {
+    std::unique_lock lock { _lock };
+
+    if (static_cast<size_t>(guest) >= _entries.size()) {
+        _entries.resize(static_cast<size_t>(guest) + 1);
+    }
+
+    entry old = std::exchange(_entries[guest], { .host = host, .owned = owned });
+    lock.unlock();
+
+    if (old.host >= 0 && old.owned) {
+        ::close(old.host);
+    }
+}
+
+int fd_table::host(int guest) const {
+    std::scoped_lock lock { _lock };
+
+    if (guest < 0 || static_cast<size_t>(guest) >= _entries.size()) {
+        return -1;
+    }
+
+    return _entries[guest].host;
+}
+
+int fd_table::close(int guest) {
+    std::unique_lock lock { _lock };
+
+    if (guest < 0 || static_cast<size_t>(guest) >= _entries.size() || _entries[guest].host < 0) {
+        return EBADF;
+    }
+
+    auto [host, owned] = _entries[guest];
+    _entries[guest] = {};
+
+    /* Closing can block, the entry is already gone */
+    lock.unlock();
+
+    if (owned && ::close(host) != 0) {
+        return errno;
+    }
+
+    return 0;
+}
+
+std::vector<std::pair<int, int>> fd_table::open_fds() const {
+    std::scoped_lock lock { _lock };
+
+    std::vector<std::pair<int, int>> res;
+
+    for (size_t i = 0; i < _entries.size(); ++i) {
+        if (_entries[i].host >= 0) {
+            res.emplace_back(static_cast<int>(i), _entries[i].host);
+        }
+    }
+
+    return res;
+}
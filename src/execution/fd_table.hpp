@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <mutex>
+
+/* Maps guest file descriptors to host file descriptors, shared by all guest threads */
+class fd_table {
+    struct entry {
+        int host = -1;
+
+        /* Whether the host fd is closed along with the guest fd */
+        bool owned = false;
+    };
+
+    std::vector<entry> _entries;
+    mutable std::mutex _lock;
+
+    public:
+    /* Guest stdin, stdout and stderr are the host's */
+    fd_table();
+    ~fd_table();
+
+    fd_table(const fd_table&) = delete;
+    fd_table& operator=(const fd_table&) = delete;
+
+    fd_table(fd_table&&) = delete;
+    fd_table& operator=(fd_table&&) = delete;
+
+    /* Install a host fd at the lowest free guest fd, returns the guest fd */
+    int insert(int host, bool owned = true);
+
+    /* Install a host fd at a specific guest fd, closing whatever was there */
+    void install(int guest, int host, bool owned = true);
+
+    /* Host fd for a guest fd, or -1 if it's not open */
+    [[nodiscard]] int host(int guest) const;
+
+    /* Remove a guest fd, returns the errno-style result of closing the host fd */
+    [[nodiscard]] int close(int guest);
+
+    /* All open (guest, host) pairs */
+    [[nodiscard]] std::vector<std::pair<int, int>> open_fds() const;
+};
@@ -0,0 +1,285 @@
+#include "fork_server.hpp"
+
+#include <array>
+#include <string_view>
+#include <algorithm>
+#include <system_error>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <util/formatting.hpp>
+
+namespace {
+    [[nodiscard]] bool write_all(int fd, std::string_view text) {
+        while (!text.empty()) {
+            ssize_t res = write(fd, text.data(), text.size());
+
+            if (res < 0 && errno == EINTR) {
+                continue;
+            } else if (res <= 0) {
+                return false;
+            }
+
+            text.remove_prefix(static_cast<size_t>(res));
+        }
+
+        return true;
+    }
+}
+
+fork_server::fork_server(std::filesystem::path path, bool fixed_arguments)
+    : _path { std::move(path) }, _fixed_arguments { fixed_arguments } {
+
+    if (_path == "-") {
+        return;
+    }
+
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+
+    auto name = _path.string();
+    if (name.size() >= sizeof(addr.sun_path)) {
+        throw std::system_error(ENAMETOOLONG, std::generic_category(), name);
+    }
+
+    std::ranges::copy(name, addr.sun_path);
+
+    _listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (_listener < 0) {
+        throw std::system_error(errno, std::generic_category(), "socket");
+    }
+
+    /* Left behind by a server that was killed */
+    std::error_code ec;
+    if (std::filesystem::is_socket(_path, ec)) {
+        std::filesystem::remove(_path, ec);
+    }
+
+    if (bind(_listener, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || listen(_listener, SOMAXCONN) != 0) {
+        int err = errno;
+        close(_listener);
+        throw std::system_error(err, std::generic_category(), fmt::format("listen on {}", name));
+    }
+}
+
+fork_server::~fork_server() {
+    if (_listener >= 0) {
+        close(_listener);
+        unlink(_path.c_str());
+    }
+}
+
+std::string fork_server::_launch(const request& req, const runner& run, int in, int out) const {
+    bool on_stdio = _listener < 0;
+
+    /* Running anyway would silently use other inputs than the client asked for */
+    if (_fixed_arguments && (!req.argv.empty() || !req.env.empty())) {
+        return "error the guest's arguments and environment are fixed, arg and env can't be used";
+    }
+
+    std::array<std::filesystem::path, 3> paths { req.stdin_path, req.stdout_path, req.stderr_path };
+    std::array<int, 3> fds { -1, -1, -1 };
+
+    /* The control connection is on stdin in "-" mode */
+    if (on_stdio && paths[0].empty()) {
+        paths[0] = "/dev/null";
+    }
+
+    auto close_all = [&] {
+        for (int fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    };
+
+    /* Opened before forking, so failures make it into the reply */
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (paths[i].empty()) {
+            continue;
+        }
+
+        int flags = (i == STDIN_FILENO) ? O_RDONLY : (O_WRONLY | O_CREAT | O_TRUNC);
+
+        fds[i] = open(paths[i].c_str(), flags | O_CLOEXEC, 0644);
+        if (fds[i] < 0) {
+            int err = errno;
+            close_all();
+
+            return fmt::format("error {}: {}", paths[i].string(), std::generic_category().message(err));
+        }
+    }
+
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (fds[i] >= 0) {
+                dup2(fds[i], static_cast<int>(i));
+            }
+        }
+
+        if (on_stdio && fds[STDOUT_FILENO] < 0) {
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+        }
+
+        for (int fd : { in, out }) {
+            if (fd > STDERR_FILENO) {
+                close(fd);
+            }
+        }
+
+        /* The guest may rely on the dispositions the server replaced */
+        sigaction(SIGPIPE, &_previous_pipe, nullptr);
+        sigaction(SIGCHLD, &_previous_child, nullptr);
+
+        int code = EXIT_FAILURE;
+        try {
+            code = run(req);
+        } catch (const std::exception& e) {
+            fmt::print(stderr, "run failed: {}\n", e.what());
+        }
+
+        /* Not exit(), the server's atexit handlers and static objects aren't ours */
+        std::fflush(nullptr);
+        _exit(code);
+    }
+
+    int err = errno;
+    close_all();
+
+    if (pid < 0) {
+        return fmt::format("error fork: {}", std::generic_category().message(err));
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return fmt::format("error waitpid: {}", std::generic_category().message(errno));
+        }
+    }
+
+    if (WIFSIGNALED(status)) {
+        return fmt::format("signal {}", WTERMSIG(status));
+    }
+
+    return fmt::format("exit {}", WEXITSTATUS(status));
+}
+
+void fork_server::_session(int in, int out, const runner& run) const {
+    FILE* input = fdopen(in, "r");
+    if (!input) {
+        throw std::system_error(errno, std::generic_category(), "fdopen");
+    }
+
+    request req;
+
+    char* line = nullptr;
+    size_t capacity = 0;
+    ssize_t len;
+
+    while ((len = getline(&line, &capacity, input)) >= 0) {
+        std::string_view text { line, static_cast<size_t>(len) };
+        if (text.ends_with('\n')) {
+            text.remove_suffix(1);
+        }
+
+        auto space = text.find(' ');
+        auto key = text.substr(0, space);
+        auto value = (space == std::string_view::npos) ? std::string_view {} : text.substr(space + 1);
+
+        std::string reply;
+
+        if (key == "arg") {
+            req.argv.emplace_back(value);
+        } else if (key == "env") {
+            req.env.emplace_back(value);
+        } else if (key == "stdin") {
+            req.stdin_path = value;
+        } else if (key == "stdout") {
+            req.stdout_path = value;
+        } else if (key == "stderr") {
+            req.stderr_path = value;
+        } else if (key == "run") {
+            reply = _launch(req, run, in, out);
+            req = {};
+        } else if (!key.empty()) {
+            reply = fmt::format("error unknown request {}", key);
+        }
+
+        if (!reply.empty() && !write_all(out, reply + "\n")) {
+            break;
+        }
+    }
+
+    free(line);
+    fclose(input);
+}
+
+void fork_server::serve(const runner& run) {
+    /* A client hanging up shouldn't take the server with it */
+    struct sigaction ignore {};
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+
+    sigaction(SIGPIPE, &ignore, &_previous_pipe);
+
+    if (_listener < 0) {
+        sigaction(SIGCHLD, nullptr, &_previous_child);
+        _session(STDIN_FILENO, STDOUT_FILENO, run);
+        return;
+    }
+
+    /* Sessions are never waited for */
+    struct sigaction reap = ignore;
+    reap.sa_flags = SA_NOCLDWAIT;
+
+    sigaction(SIGCHLD, &reap, &_previous_child);
+
+    while (true) {
+        int conn = accept4(_listener, nullptr, nullptr, SOCK_CLOEXEC);
+
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+
+            throw std::system_error(errno, std::generic_category(), "accept");
+        }
+
+        pid_t pid = fork();
+
+        if (pid == 0) {
+            close(_listener);
+
+            /* Runs are waited for */
+            struct sigaction waited {};
+            waited.sa_handler = SIG_DFL;
+            sigemptyset(&waited.sa_mask);
+            sigaction(SIGCHLD, &waited, nullptr);
+
+            int res = EXIT_SUCCESS;
+            try {
+                _session(conn, conn, run);
+            } catch (const std::exception& e) {
+                fmt::print(stderr, "fork server session failed: {}\n", e.what());
+                res = EXIT_FAILURE;
+            }
+
+            _exit(res);
+        }
+
+        if (pid < 0) {
+            fmt::print(stderr, "fork server: fork failed: {}\n", std::generic_category().message(errno));
+        }
+
+        close(conn);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <functional>
+
+#include <csignal>
+
+/* Runs a guest that is loaded once many times over, each run in a forked child.
+ *
+ * Everything set up before serve() is shared copy-on-write with the runs, so
+ * a run costs a fork instead of parsing and loading the executable again.
+ * Clients connect to a unix socket and send requests as lines:
+ *
+ *     arg <argument>       appended to argv, the server's argv if there are none
+ *     env <NAME=value>     appended to the environment, likewise
+ *     stdin <path>         guest stdin, stdout and stderr, the server's by default
+ *     stdout <path>
+ *     stderr <path>
+ *     run                  start the run and wait for it
+ *
+ * and get back one line per run: "exit <code>", "signal <number>" if the
+ * emulator itself was killed, or "error <message>" if the run couldn't start.
+ * Each connection is served by its own process, so runs on different
+ * connections are concurrent. Arguments can't contain newlines.
+ *
+ * With "-" as the path, a single connection is served on stdin and stdout
+ * instead, and the guest's stdin and stdout default to /dev/null and stderr.
+ * A server for a guest whose arguments are already fixed, like a restored
+ * snapshot, replies with an error to runs that have arg or env lines.
+ */
+class fork_server {
+    public:
+    struct request {
+        std::vector<std::string> argv;
+        std::vector<std::string> env;
+
+        std::filesystem::path stdin_path;
+        std::filesystem::path stdout_path;
+        std::filesystem::path stderr_path;
+    };
+
+    /* Called in the child to run the guest, returns its exit code */
+    using runner = std::function<int(const request&)>;
+
+    private:
+    std::filesystem::path _path;
+    int _listener = -1;
+
+    bool _fixed_arguments;
+
+    /* Dispositions from before serve(), for the runs */
+    struct sigaction _previous_pipe {};
+    struct sigaction _previous_child {};
+
+    /* Serve requests until the client hangs up */
+    void _session(int in, int out, const runner& run) const;
+
+    /* Fork and wait for a run, returns the reply */
+    [[nodiscard]] std::string _launch(const request& req, const runner& run, int in, int out) const;
+
+    public:
+    explicit fork_server(std::filesystem::path path, bool fixed_arguments = false);
+    ~fork_server();
+
+    fork_server(const fork_server&) = delete;
+    fork_server& operator=(const fork_server&) = delete;
+
+    /* Only returns once the client hung up in "-" mode, a socket is served until the process is killed */
+    void serve(const runner& run);
+};
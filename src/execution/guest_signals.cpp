@@ -0,0 +1,345 @@
+#include "guest_signals.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <thread>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+namespace {
+    /* Raised on the host, by the terminal, a timer or another process */
+    std::atomic<uint64_t> host_pending { 0 };
+
+    std::atomic<uint64_t> signal_sequence { 0 };
+
+    /* Guests that handle or ignore each host signal, the host handler is installed while there are any */
+    std::mutex host_lock;
+    std::array<int, guest_signals::count> host_users {};
+
+    /* Guests to wake after a host signal, and the pipe the handler pokes the waker through */
+    std::vector<std::function<void()>*> host_listeners;
+    std::array<int, 2> waker_pipe { -1, -1 };
+    pid_t waker_pid = 0;
+
+    /* Asynchronous signals that are worth passing on. Faults are the guest's own and
+     * reported as errors, job control signals stay with the emulator.
+     */
+    [[nodiscard]] bool forwarded(int sig) {
+        switch (sig) {
+            case SIGHUP:
+            case SIGINT:
+            case SIGQUIT:
+            case SIGUSR1:
+            case SIGUSR2:
+            case SIGPIPE:
+            case SIGALRM:
+            case SIGTERM:
+            case SIGVTALRM:
+            case SIGPROF:
+            case SIGWINCH:
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    void forward(int sig) {
+        host_pending.fetch_or(guest_signals::bit(sig), std::memory_order_relaxed);
+        signal_sequence.fetch_add(1, std::memory_order_release);
+
+        /* A full pipe already has the waker going */
+        int saved = errno;
+        [[maybe_unused]] ssize_t res = write(waker_pipe[1], "", 1);
+        errno = saved;
+    }
+
+    /* The thread a host signal lands on may be blocked itself, and SA_RESTART restarts its
+     * call, so the harts are woken from here. Must be called with host_lock held.
+     */
+    void start_waker() {
+        /* Threads don't survive fork, a forked child needs its own */
+        if (waker_pid == getpid()) {
+            return;
+        }
+
+        if (waker_pipe[0] >= 0) {
+            close(waker_pipe[0]);
+            close(waker_pipe[1]);
+        }
+
+        if (pipe2(waker_pipe.data(), O_CLOEXEC) != 0) {
+            throw std::system_error(errno, std::generic_category(), "pipe2");
+        }
+
+        fcntl(waker_pipe[1], F_SETFL, O_NONBLOCK);
+        waker_pid = getpid();
+
+        std::thread([fd = waker_pipe[0]] {
+            std::array<char, 64> buf;
+
+            while (true) {
+                ssize_t res = read(fd, buf.data(), buf.size());
+
+                if (res < 0 && errno == EINTR) {
+                    continue;
+                } else if (res <= 0) {
+                    return;
+                }
+
+                std::scoped_lock lock { host_lock };
+                for (auto* wake : host_listeners) {
+                    (*wake)();
+                }
+            }
+        }).detach();
+    }
+
+    [[nodiscard]] timespec to_timespec(const timeval& tv) {
+        return { tv.tv_sec, tv.tv_usec * 1000 };
+    }
+
+    [[nodiscard]] timeval to_timeval(const timespec& ts) {
+        /* Rounded up, a timer that is still running never reads as 0 */
+        timeval res { ts.tv_sec, (ts.tv_nsec + 999) / 1000 };
+
+        if (res.tv_usec == 1000000) {
+            res.tv_sec += 1;
+            res.tv_usec = 0;
+        }
+
+        return res;
+    }
+
+    [[nodiscard]] itimerval to_itimerval(const itimerspec& spec) {
+        return { to_timeval(spec.it_interval), to_timeval(spec.it_value) };
+    }
+
+    /* Whether an action makes the host signal worth catching */
+    [[nodiscard]] bool catches(const guest_signals::action& act) {
+        return act.handler != guest_signals::handler_default;
+    }
+
+    void update_host(int sig, bool before, bool after) {
+        if (before == after || !forwarded(sig)) {
+            return;
+        }
+
+        std::scoped_lock lock { host_lock };
+        int& users = host_users[static_cast<size_t>(sig - 1)];
+
+        users += after ? 1 : -1;
+
+        if (after && users == 1) {
+            start_waker();
+
+            struct sigaction action {};
+
+            /* Guests see the interruption through the waker, nothing else has to deal with EINTR */
+            action.sa_handler = &forward;
+            action.sa_flags = SA_RESTART;
+            sigemptyset(&action.sa_mask);
+
+            sigaction(sig, &action, nullptr);
+        } else if (!after && users == 0) {
+            signal(sig, SIG_DFL);
+        }
+    }
+}
+
+guest_signals::~guest_signals() {
+    on_host_signal({});
+
+    /* Also drops an expiry that is still pending */
+    for (auto& t : _timers) {
+        if (t.created) {
+            timer_delete(t.id);
+        }
+    }
+
+    for (int sig = 1; sig <= count; sig++) {
+        update_host(sig, catches(_actions[static_cast<size_t>(sig - 1)]), false);
+    }
+}
+
+bool guest_signals::ignored_by_default(int sig) {
+    switch (sig) {
+        case SIGCHLD:
+        case SIGCONT:
+        case SIGURG:
+        case SIGWINCH:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+uint64_t guest_signals::sequence() {
+    return signal_sequence.load(std::memory_order_relaxed);
+}
+
+guest_signals::action guest_signals::get(int sig) const {
+    std::scoped_lock lock { _lock };
+    return _actions[static_cast<size_t>(sig - 1)];
+}
+
+guest_signals::action guest_signals::set(int sig, const action& act) {
+    std::scoped_lock lock { _lock };
+
+    action old = std::exchange(_actions[static_cast<size_t>(sig - 1)], act);
+    update_host(sig, catches(old), catches(act));
+
+    if (catches(act)) {
+        _caught.fetch_or(bit(sig), std::memory_order_relaxed);
+    } else {
+        _caught.fetch_and(~bit(sig), std::memory_order_relaxed);
+    }
+
+    /* Signals that were pending under the old action may be deliverable now */
+    signal_sequence.fetch_add(1, std::memory_order_release);
+
+    return old;
+}
+
+void guest_signals::reset(int sig) {
+    set(sig, action {});
+}
+
+void guest_signals::raise(int sig) {
+    _pending.fetch_or(bit(sig), std::memory_order_relaxed);
+    signal_sequence.fetch_add(1, std::memory_order_release);
+}
+
+void guest_signals::raise(std::atomic<uint64_t>& thread, int sig) {
+    thread.fetch_or(bit(sig), std::memory_order_relaxed);
+    signal_sequence.fetch_add(1, std::memory_order_release);
+}
+
+std::optional<int> guest_signals::take(std::atomic<uint64_t>& thread, uint64_t blocked) {
+    /* Whoever clears the bit gets the signal, other harts may be taking from the same sets */
+    auto claim = [&](std::atomic<uint64_t>& set) -> std::optional<int> {
+        uint64_t cur = set.load(std::memory_order_relaxed);
+
+        while (cur & ~blocked) {
+            uint64_t lowest = cur & ~blocked & -(cur & ~blocked);
+
+            if (set.compare_exchange_weak(cur, cur & ~lowest, std::memory_order_acquire)) {
+                return std::countr_zero(lowest) + 1;
+            }
+        }
+
+        return std::nullopt;
+    };
+
+    if (auto sig = claim(thread)) {
+        return sig;
+    } else if (auto sig = claim(_pending)) {
+        return sig;
+    }
+
+    /* Not a host signal that only other guests in this process care about */
+    blocked |= ~_caught.load(std::memory_order_relaxed);
+
+    return claim(host_pending);
+}
+
+int guest_signals::set_timer(int which, const itimerval& next, itimerval& old, int notify) {
+    if (which < 0 || which >= timers) {
+        return EINVAL;
+    }
+
+    std::scoped_lock lock { _lock };
+    timer& t = _timers[static_cast<size_t>(which)];
+
+    /* Made again for another thread, the expiry goes to whichever set it last */
+    itimerspec moved {};
+    bool remade = t.created && t.thread != gettid();
+
+    if (remade) {
+        timer_gettime(t.id, &moved);
+        timer_delete(t.id);
+        t.created = false;
+    }
+
+    if (!t.created) {
+        clockid_t clock = CLOCK_MONOTONIC;
+
+        if (which != ITIMER_REAL) {
+            if (int err = pthread_getcpuclockid(pthread_self(), &clock); err != 0) {
+                return err;
+            }
+        }
+
+        sigevent ev {};
+        ev.sigev_notify = SIGEV_THREAD_ID;
+        ev.sigev_signo = notify;
+        ev.sigev_value.sival_ptr = &t;
+        ev._sigev_un._tid = gettid(); /* sigev_notify_thread_id, which older glibc lacks */
+
+        if (timer_create(clock, &ev, &t.id) != 0) {
+            return errno;
+        }
+
+        static constexpr std::array<int, timers> signals { SIGALRM, SIGVTALRM, SIGPROF };
+
+        t.owner = this;
+        t.sig = signals[static_cast<size_t>(which)];
+        t.thread = gettid();
+        t.created = true;
+    }
+
+    itimerspec spec { to_timespec(next.it_interval), to_timespec(next.it_value) };
+    itimerspec prev {};
+
+    if (timer_settime(t.id, 0, &spec, &prev) != 0) {
+        return errno;
+    }
+
+    old = to_itimerval(remade ? moved : prev);
+    return 0;
+}
+
+int guest_signals::get_timer(int which, itimerval& cur) const {
+    if (which < 0 || which >= timers) {
+        return EINVAL;
+    }
+
+    std::scoped_lock lock { _lock };
+    const timer& t = _timers[static_cast<size_t>(which)];
+
+    itimerspec spec {};
+    if (t.created && timer_gettime(t.id, &spec) != 0) {
+        return errno;
+    }
+
+    cur = to_itimerval(spec);
+    return 0;
+}
+
+void guest_signals::expired(const siginfo_t* info) {
+    if (info->si_code != SI_TIMER) {
+        return;
+    }
+
+    /* Lock-free atomics only, this runs in a signal handler */
+    const auto* t = static_cast<const timer*>(info->si_value.sival_ptr);
+    t->owner->raise(t->sig);
+}
+
+void guest_signals::on_host_signal(std::function<void()> wake) {
+    std::scoped_lock lock { host_lock };
+
+    std::erase(host_listeners, &_wake);
+    _wake = std::move(wake);
+
+    if (_wake) {
+        host_listeners.push_back(&_wake);
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <cstdint>
+#include <csignal>
+#include <ctime>
+
+#include <sys/time.h>
+
+/* Signal dispositions and process-directed pending signals of a guest.
+ *
+ * Signals use the generic Linux numbering, which the host shares, and a
+ * signal's bit in a set is 1 << (sig - 1) like in the kernel. Thread-directed
+ * signals are pending on the hart they were sent to, the set lives there.
+ *
+ * Harts only look for signals when sequence() changed since they last did,
+ * so the check between instructions is a single relaxed load. Host signals
+ * are shared by every guest in the process, each goes to the first guest that
+ * handles or ignores it and has it unblocked. Interval timers are the
+ * guest's own and only ever signal it.
+ *
+ * The host handlers only record a signal and restart whatever call they
+ * interrupted, emulator threads never see EINTR from them. Harts blocked
+ * in the host for the guest are woken from a helper thread instead, through
+ * the callback passed to on_host_signal(), and pick the signal up at their
+ * next safe point like any other.
+ */
+class guest_signals {
+    public:
+    static constexpr int count = 64;
+
+    static constexpr uint64_t handler_default = 0;
+    static constexpr uint64_t handler_ignore = 1;
+
+    /* ITIMER_REAL, ITIMER_VIRTUAL and ITIMER_PROF */
+    static constexpr int timers = 3;
+
+    /* The kernel's struct sigaction on riscv64, which has no restorer */
+    struct action {
+        uint64_t handler = handler_default;
+        uint64_t flags = 0;
+        uint64_t mask = 0;
+    };
+
+    private:
+    /* A host POSIX timer standing in for one of the guest's interval timers */
+    struct timer {
+        guest_signals* owner = nullptr;
+        int sig = 0;
+
+        timer_t id {};
+        pid_t thread = 0;
+        bool created = false;
+    };
+
+    /* Guards the actions and timers, taking a signal doesn't need it */
+    mutable std::mutex _lock;
+    std::array<action, count> _actions {};
+    std::array<timer, timers> _timers {};
+
+    /* Sent to the process instead of a specific thread */
+    std::atomic<uint64_t> _pending { 0 };
+
+    /* Host signals this guest handles or ignores, the only ones it takes */
+    std::atomic<uint64_t> _caught { 0 };
+
+    /* Wakes the guest's harts after a host signal, guarded by the host handler lock */
+    std::function<void()> _wake;
+
+    public:
+    guest_signals() = default;
+    ~guest_signals();
+
+    guest_signals(const guest_signals&) = delete;
+    guest_signals& operator=(const guest_signals&) = delete;
+
+    [[nodiscard]] static constexpr uint64_t bit(int sig) { return uint64_t { 1 } << (sig - 1); }
+    [[nodiscard]] static constexpr bool valid(int sig) { return sig >= 1 && sig <= count; }
+
+    /* SIGKILL and SIGSTOP, which can't be caught, ignored or blocked */
+    static constexpr uint64_t unblockable = (uint64_t { 1 } << (SIGKILL - 1)) | (uint64_t { 1 } << (SIGSTOP - 1));
+
+    /* Whether the default action is to do nothing */
+    [[nodiscard]] static bool ignored_by_default(int sig);
+
+    /* Changes whenever a signal was raised or a guest action changed */
+    [[nodiscard]] static uint64_t sequence();
+
+    [[nodiscard]] action get(int sig) const;
+
+    /* Returns the previous action */
+    action set(int sig, const action& act);
+
+    /* Reset a SA_RESETHAND action once it was delivered */
+    void reset(int sig);
+
+    /* Raise a process-directed signal */
+    void raise(int sig);
+
+    /* Raise a signal on a hart's own set */
+    static void raise(std::atomic<uint64_t>& thread, int sig);
+
+    /* Take the lowest-numbered signal not in blocked, thread-directed ones first */
+    [[nodiscard]] std::optional<int> take(std::atomic<uint64_t>& thread, uint64_t blocked);
+
+    /* setitimer and getitimer, returning 0 or an errno. An expiring timer sends notify to the
+     * calling thread, whose handler passes it on to expired(). ITIMER_VIRTUAL and ITIMER_PROF
+     * count the CPU time of that thread only.
+     */
+    [[nodiscard]] int set_timer(int which, const itimerval& next, itimerval& old, int notify);
+    [[nodiscard]] int get_timer(int which, itimerval& cur) const;
+
+    /* Raise the signal of the timer that sent info, if it was one. Async-signal-safe */
+    static void expired(const siginfo_t* info);
+
+    /* Called on a helper thread whenever a host signal was recorded, to break the guest's harts
+     * out of blocking host calls. Empty to stop, which waits for a call in progress.
+     */
+    void on_host_signal(std::function<void()> wake);
+};
@@ -0,0 +1,283 @@
+#include "io_ring.hpp"
+
+#include <atomic>
+#include <system_error>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <linux/io_uring.h>
+
+namespace {
+    [[nodiscard]] int io_uring_setup(uint32_t entries, io_uring_params* params) {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    [[nodiscard]] int io_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+
+    template <typename T>
+    [[nodiscard]] T* ring_ptr(void* base, uint32_t offset) {
+        return reinterpret_cast<T*>(static_cast<uint8_t*>(base) + offset);
+    }
+
+    /* The kernel updates the other end of the rings concurrently */
+    [[nodiscard]] uint32_t load_acquire(uint32_t* ptr) {
+        return std::atomic_ref(*ptr).load(std::memory_order_acquire);
+    }
+
+    void store_release(uint32_t* ptr, uint32_t val) {
+        std::atomic_ref(*ptr).store(val, std::memory_order_release);
+    }
+}
+
+io_ring::io_ring(uint32_t entries) : _entries { entries } {
+    io_uring_params params {};
+
+    _fd = io_uring_setup(entries, &params);
+    if (_fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+    }
+
+    _entries = params.sq_entries;
+
+    _sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    _cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    /* Newer kernels map both rings at once */
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        _sq_size = _cq_size = std::max(_sq_size, _cq_size);
+    }
+
+    auto map_ring = [this](size_t size, off_t offset) {
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, offset);
+        if (ptr == MAP_FAILED) {
+            int err = errno;
+
+            /* The destructor doesn't run, undo whatever was mapped before */
+            if (_cq_ptr && _cq_ptr != _sq_ptr) {
+                munmap(_cq_ptr, _cq_size);
+            }
+
+            if (_sq_ptr) {
+                munmap(_sq_ptr, _sq_size);
+            }
+
+            ::close(_fd);
+            throw std::system_error(err, std::generic_category(), "mmap");
+        }
+
+        return ptr;
+    };
+
+    _sq_ptr = map_ring(_sq_size, IORING_OFF_SQ_RING);
+    _cq_ptr = single_mmap ? _sq_ptr : map_ring(_cq_size, IORING_OFF_CQ_RING);
+
+    _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    _sqes_ptr = map_ring(_sqes_size, IORING_OFF_SQES);
+
+    _sq_head  = ring_ptr<uint32_t>(_sq_ptr, params.sq_off.head);
+    _sq_tail  = ring_ptr<uint32_t>(_sq_ptr, params.sq_off.tail);
+    _sq_mask  = ring_ptr<uint32_t>(_sq_ptr, params.sq_off.ring_mask);
+    _sq_array = ring_ptr<uint32_t>(_sq_ptr, params.sq_off.array);
+
+    _cq_head = ring_ptr<uint32_t>(_cq_ptr, params.cq_off.head);
+    _cq_tail = ring_ptr<uint32_t>(_cq_ptr, params.cq_off.tail);
+    _cq_mask = ring_ptr<uint32_t>(_cq_ptr, params.cq_off.ring_mask);
+    _cqes    = ring_ptr<io_uring_cqe>(_cq_ptr, params.cq_off.cqes);
+}
+
+io_ring::~io_ring() {
+    /* The kernel may still write to guest memory, so let everything finish first */
+    while (_in_flight > 0 || _unsubmitted > 0) {
+        try {
+            _enter(1);
+            _reap();
+        } catch (const std::system_error&) {
+            break;
+        }
+    }
+
+    munmap(_sqes_ptr, _sqes_size);
+    if (_cq_ptr != _sq_ptr) {
+        munmap(_cq_ptr, _cq_size);
+    }
+    munmap(_sq_ptr, _sq_size);
+
+    ::close(_fd);
+}
+
+bool io_ring::supported() {
+    io_uring_params params {};
+    int fd = io_uring_setup(1, &params);
+    if (fd < 0) {
+        return false;
+    }
+
+    ::close(fd);
+    return true;
+}
+
+io_ring::ticket io_ring::_alloc(std::span<const iovec> iov) {
+    ticket t;
+    if (!_free.empty()) {
+        t = _free.back();
+        _free.pop_back();
+    } else {
+        t = static_cast<ticket>(_requests.size());
+        _requests.emplace_back();
+    }
+
+    auto& req = _requests[t];
+    req.iov.assign(iov.begin(), iov.end());
+    req.result.reset();
+    req.in_use = true;
+
+    return t;
+}
+
+void io_ring::_queue(uint8_t opcode, int fd, ticket t, uint64_t offset, uint32_t rw_flags) {
+    /* Make room if the submission ring is full */
+    if ((_unsubmitted + _in_flight) >= _entries) {
+        _enter(1);
+        _reap();
+    }
+
+    uint32_t tail = *_sq_tail;
+    uint32_t index = tail & *_sq_mask;
+
+    auto& sqe = static_cast<io_uring_sqe*>(_sqes_ptr)[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+
+    const auto& iov = _requests[t].iov;
+
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.off = offset;
+    sqe.addr = reinterpret_cast<uintptr_t>(iov.data());
+    sqe.len = static_cast<uint32_t>(iov.size());
+    sqe.rw_flags = static_cast<int>(rw_flags);
+    sqe.user_data = t;
+
+    _sq_array[index] = index;
+    store_release(_sq_tail, tail + 1);
+
+    _unsubmitted += 1;
+}
+
+void io_ring::_enter(uint32_t min_complete) {
+    uint32_t flags = (min_complete > 0) ? IORING_ENTER_GETEVENTS : 0;
+
+    int res;
+    do {
+        res = io_uring_enter(_fd, _unsubmitted, min_complete, flags);
+    } while (res < 0 && errno == EINTR);
+
+    if (res < 0) {
+        throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+    }
+
+    _unsubmitted -= static_cast<uint32_t>(res);
+    _in_flight += static_cast<uint32_t>(res);
+}
+
+size_t io_ring::_reap() {
+    uint32_t head = *_cq_head;
+    uint32_t tail = load_acquire(_cq_tail);
+
+    size_t count = 0;
+    for (; head != tail; ++head, ++count) {
+        const auto& cqe = static_cast<io_uring_cqe*>(_cqes)[head & *_cq_mask];
+
+        auto& req = _requests[static_cast<ticket>(cqe.user_data)];
+        req.result = cqe.res;
+        req.iov.clear();
+
+        _in_flight -= 1;
+    }
+
+    store_release(_cq_head, head);
+
+    return count;
+}
+
+io_ring::ticket io_ring::submit_readv(int fd, std::span<const iovec> iov, off_t offset) {
+    ticket t = _alloc(iov);
+    _queue(IORING_OP_READV, fd, t, static_cast<uint64_t>(offset), 0);
+    return t;
+}
+
+io_ring::ticket io_ring::submit_writev(int fd, std::span<const iovec> iov, off_t offset) {
+    ticket t = _alloc(iov);
+    _queue(IORING_OP_WRITEV, fd, t, static_cast<uint64_t>(offset), 0);
+    return t;
+}
+
+io_ring::ticket io_ring::submit_fsync(int fd, bool datasync) {
+    ticket t = _alloc({});
+    _queue(IORING_OP_FSYNC, fd, t, 0, datasync ? IORING_FSYNC_DATASYNC : 0);
+    return t;
+}
+
+void io_ring::flush() {
+    if (_unsubmitted > 0) {
+        _enter(0);
+    }
+}
+
+size_t io_ring::drain() {
+    flush();
+    return _reap();
+}
+
+std::optional<int64_t> io_ring::poll(ticket t) {
+    auto& req = _requests.at(t);
+    if (!req.in_use || !req.result) {
+        return std::nullopt;
+    }
+
+    req.in_use = false;
+    _free.push_back(t);
+
+    return req.result;
+}
+
+int64_t io_ring::wait(ticket t) {
+    for (;;) {
+        if (auto res = poll(t)) {
+            return *res;
+        }
+
+        if (!_requests.at(t).in_use) {
+            throw std::logic_error("waiting on an unused io_ring ticket");
+        }
+
+        _enter(1);
+        _reap();
+    }
+}
+
+size_t io_ring::collect() {
+    return _reap();
+}
+
+bool io_ring::await_completion() const {
+    if (io_uring_enter(_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0) {
+        if (errno == EINTR) {
+            return false;
+        }
+
+        throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+    }
+
+    return true;
+}
+
+size_t io_ring::pending() const {
+    return _requests.size() - _free.size();
+}
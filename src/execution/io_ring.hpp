@@ -0,0 +1,107 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <optional>
+#include <cstdint>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/* Minimal io_uring wrapper for asynchronous guest I/O.
+ *
+ * Operations are queued with the submit_* functions, which return a ticket.
+ * Nothing is handed to the kernel until flush(), drain() or wait() is called,
+ * so requests issued between two safe points are submitted in one batch.
+ * Results are raw kernel results, negative errno on failure.
+ *
+ * Not thread-safe, every user needs its own ring.
+ */
+class io_ring {
+    public:
+    using ticket = uint32_t;
+
+    private:
+    struct request {
+        /* Keeps the iovecs alive until the kernel is done with them */
+        std::vector<iovec> iov;
+        std::optional<int64_t> result;
+        bool in_use = false;
+    };
+
+    int _fd = -1;
+
+    /* Mapped rings */
+    void* _sq_ptr = nullptr;
+    size_t _sq_size = 0;
+    void* _cq_ptr = nullptr;
+    size_t _cq_size = 0;
+    void* _sqes_ptr = nullptr;
+    size_t _sqes_size = 0;
+
+    /* Pointers into the submission ring */
+    uint32_t* _sq_head;
+    uint32_t* _sq_tail;
+    uint32_t* _sq_mask;
+    uint32_t* _sq_array;
+
+    /* Pointers into the completion ring */
+    uint32_t* _cq_head;
+    uint32_t* _cq_tail;
+    uint32_t* _cq_mask;
+    void* _cqes;
+
+    /* Submitted but not yet entered into the kernel */
+    uint32_t _unsubmitted = 0;
+
+    /* In flight in the kernel */
+    uint32_t _in_flight = 0;
+
+    uint32_t _entries;
+
+    std::vector<request> _requests;
+    std::vector<ticket> _free;
+
+    [[nodiscard]] ticket _alloc(std::span<const iovec> iov);
+    void _queue(uint8_t opcode, int fd, ticket t, uint64_t offset, uint32_t rw_flags);
+    void _enter(uint32_t min_complete);
+    size_t _reap();
+
+    public:
+    explicit io_ring(uint32_t entries = 64);
+    ~io_ring();
+
+    io_ring(const io_ring&) = delete;
+    io_ring& operator=(const io_ring&) = delete;
+
+    /* Whether the host kernel supports io_uring at all */
+    [[nodiscard]] static bool supported();
+
+    /* An offset of -1 uses and updates the file position */
+    [[nodiscard]] ticket submit_readv(int fd, std::span<const iovec> iov, off_t offset = -1);
+    [[nodiscard]] ticket submit_writev(int fd, std::span<const iovec> iov, off_t offset = -1);
+    [[nodiscard]] ticket submit_fsync(int fd, bool datasync);
+
+    /* Pass any queued requests to the kernel */
+    void flush();
+
+    /* Submit queued requests and collect completions without blocking, returns the number collected */
+    size_t drain();
+
+    /* Result of a request if it's done, which releases the ticket */
+    [[nodiscard]] std::optional<int64_t> poll(ticket t);
+
+    /* Block until a request completes, which releases the ticket */
+    [[nodiscard]] int64_t wait(ticket t);
+
+    /* Collect finished requests without submitting anything, returns the number collected */
+    size_t collect();
+
+    /* Block until the kernel has a completion to collect, false if a signal interrupted the wait.
+     * The one call that may run while another thread uses the ring, it touches none of its state.
+     */
+    [[nodiscard]] bool await_completion() const;
+
+    /* Number of requests that haven't been collected yet */
+    [[nodiscard]] size_t pending() const;
+};
@@ -0,0 +1,475 @@
+#include "io_syscalls.hpp"
+
+#include <array>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <exception>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+using namespace arch;
+
+namespace {
+    [[nodiscard]] constexpr uint64_t syscall_error(int err) {
+        return static_cast<uint64_t>(-err);
+    }
+
+    /* Host result, or the negated errno */
+    [[nodiscard]] uint64_t syscall_result(ssize_t res) {
+        return (res < 0) ? syscall_error(errno) : static_cast<uint64_t>(res);
+    }
+
+    /* struct stat for 64-bit targets using the generic Linux ABI */
+    struct guest_stat {
+        uint64_t st_dev;
+        uint64_t st_ino;
+        uint32_t st_mode;
+        uint32_t st_nlink;
+        uint32_t st_uid;
+        uint32_t st_gid;
+        uint64_t st_rdev;
+        uint64_t pad1;
+        int64_t  st_size;
+        int32_t  st_blksize;
+        int32_t  pad2;
+        int64_t  st_blocks;
+        int64_t  st_atime_sec;
+        uint64_t st_atime_nsec;
+        int64_t  st_mtime_sec;
+        uint64_t st_mtime_nsec;
+        int64_t  st_ctime_sec;
+        uint64_t st_ctime_nsec;
+        uint32_t unused4;
+        uint32_t unused5;
+    };
+
+    static_assert(sizeof(guest_stat) == 128);
+
+    /* The kernel's struct termios, which is what TCGETS actually returns */
+    struct kernel_termios {
+        uint32_t c_iflag;
+        uint32_t c_oflag;
+        uint32_t c_cflag;
+        uint32_t c_lflag;
+        uint8_t  c_line;
+        uint8_t  c_cc[19];
+    };
+
+    static_assert(sizeof(kernel_termios) == 36);
+
+    /* Guest ioctl request numbers */
+    static constexpr unsigned long guest_tcgets = 0x5401;
+
+    template <typename T>
+    [[nodiscard]] std::span<const uint8_t> as_span(const T& val) {
+        return { reinterpret_cast<const uint8_t*>(&val), sizeof(T) };
+    }
+}
+
+io_syscalls::io_syscalls(virtual_memory& mem, safepoint* sync) : _mem { mem }, _sync { sync } {
+
+}
+
+std::string io_syscalls::_read_string(uintptr_t addr, size_t max_size) {
+    std::string res;
+
+    while (res.size() < max_size) {
+        /* Translate up to the end of the current page, so a string at the end of a region is fine */
+        size_t chunk = std::min<size_t>(4096 - (addr % 4096), max_size - res.size());
+        auto host = _mem.translate(addr, chunk, memory::access::read);
+
+        if (host.empty()) {
+            /* Not host-backed, fall back to regular reads */
+            char c = static_cast<char>(_mem.read_byte(addr++));
+            if (c == '\0') {
+                return res;
+            }
+
+            res.push_back(c);
+            continue;
+        }
+
+        if (auto end = std::ranges::find(host, uint8_t{0}); end != host.end()) {
+            res.append(reinterpret_cast<const char*>(host.data()), end - host.begin());
+            return res;
+        }
+
+        res.append(reinterpret_cast<const char*>(host.data()), host.size());
+        addr += host.size();
+    }
+
+    throw illegal_access("string at {:#x} exceeds {} bytes", addr, max_size);
+}
+
+std::optional<uint64_t> io_syscalls::dispatch(rv64::syscall id, std::span<const uint64_t, 6> args) {
+    auto fd = [&](size_t i) { return static_cast<int>(args[i]); };
+
+    try {
+        switch (id) {
+            case rv64::syscall::openat:   return openat(fd(0), args[1], static_cast<int>(args[2]), static_cast<mode_t>(args[3]));
+            case rv64::syscall::close:    return close(fd(0));
+            case rv64::syscall::read:     return read(fd(0), args[1], args[2]);
+            case rv64::syscall::write:    return write(fd(0), args[1], args[2]);
+            case rv64::syscall::readv:    return readv(fd(0), args[1], args[2]);
+            case rv64::syscall::writev:   return writev(fd(0), args[1], args[2]);
+            case rv64::syscall::pread64:  return pread64(fd(0), args[1], args[2], static_cast<off_t>(args[3]));
+            case rv64::syscall::pwrite64: return pwrite64(fd(0), args[1], args[2], static_cast<off_t>(args[3]));
+            case rv64::syscall::lseek:    return lseek(fd(0), static_cast<off_t>(args[1]), static_cast<int>(args[2]));
+            case rv64::syscall::fstat:    return fstat(fd(0), args[1]);
+            case rv64::syscall::fsync:     return fsync(fd(0), false);
+            case rv64::syscall::fdatasync: return fsync(fd(0), true);
+            case rv64::syscall::ioctl:    return ioctl(fd(0), args[1], args[2]);
+            default: return std::nullopt;
+        }
+    } catch (const illegal_access&) {
+        /* Any guest buffer that isn't accessible */
+        return syscall_error(EFAULT);
+    }
+}
+
+uint64_t io_syscalls::openat(int dirfd, uintptr_t path, int flags, mode_t mode) {
+    int host_dirfd = (dirfd == AT_FDCWD) ? AT_FDCWD : _fds.host(dirfd);
+    if (host_dirfd == -1) {
+        return syscall_error(EBADF);
+    }
+
+    std::string host_path = _read_string(path, PATH_MAX);
+
+    /* Flags are the generic O_* values, which are x86-64's as well. Opening a FIFO blocks until the other end shows up */
+    int host = _blocking([&] { return ::openat(host_dirfd, host_path.c_str(), flags, mode); });
+    if (host < 0) {
+        return syscall_error(errno);
+    }
+
+    return _fds.insert(host);
+}
+
+uint64_t io_syscalls::close(int fd) {
+    if (int err = _fds.close(fd); err != 0) {
+        return syscall_error(err);
+    }
+
+    return 0;
+}
+
+uint64_t io_syscalls::read(int fd, uintptr_t buf, size_t count) {
+    int host = _fds.host(fd);
+    if (host < 0) {
+        return syscall_error(EBADF);
+    }
+
+    /* Reading into guest memory is a guest write */
+    std::vector<iovec> iov;
+    _mem.translate_range(buf, count, memory::access::write, iov);
+
+    return syscall_result(_blocking(iov, [&] { return ::readv(host, iov.data(), static_cast<int>(iov.size())); }));
+}
+
+uint64_t io_syscalls::write(int fd, uintptr_t buf, size_t count) {
+    int host = _fds.host(fd);
+    if (host < 0) {
+        return syscall_error(EBADF);
+    }
+
+    std::vector<iovec> iov;
+    _mem.translate_range(buf, count, memory::access::read, iov);
+
+    return syscall_result(_blocking(iov, [&] { return ::writev(host, iov.data(), static_cast<int>(iov.size())); }));
+}
+
+uint64_t io_syscalls::readv(int fd, uintptr_t iov_addr, size_t iovcnt) {
+    int host = _fds.host(fd);
+    if (host < 0) {
+        return syscall_error(EBADF);
+    }
+
+    std::vector<iovec> iov;
+    _mem.translate_iovec(iov_addr, iovcnt, memory::access::write, iov);
+
+    return syscall_result(_blocking(iov, [&] { return ::readv(host, iov.data(), static_cast<int>(iov.size())); }));
+}
+
+uint64_t io_syscalls::writev(int fd, uintptr_t iov_addr, size_t iovcnt) {
+    int host = _fds.host(fd);
+    if (host < 0) {
+        return syscall_error(EBADF);
+    }
+
+    std::vector<iovec> iov;
+    _mem.translate_iovec(iov_addr, iovcnt, memory::access::read, iov);
+
+    return syscall_result(_blocking(iov, [&] { return ::writev(host, iov.data(), static_cast<int>(iov.size())); }));
+}
+
+uint64_t io_syscalls::pread64(int fd, uintptr_t buf, size_t count, off_t offset) {
+    int host = _fds.host(fd);
+    if (host < 0) {
+        return syscall_error(EBADF);
+    }
+
+    std::vector<iovec> iov;
+    _mem.translate_range(buf, count, memory::access::write, iov);
+
+    return syscall_result(_blocking(iov, [&] { return ::preadv(host, iov.data(), static_cast<int>(iov.size()), offset); }));
+}
+
+uint64_t io_syscalls::pwrite64(int fd, uintptr_t buf, size_t count, off_t offset) {
+    int host = _fds.host(fd);
+    if (host < 0) {
+        return syscall_error(EBADF);
+    }
+
+    std::vector<iovec> iov;
+    _mem.translate_range(buf, count, memory::access::read, iov);
+
+    return syscall_result(_blocking(iov, [&] { return ::pwritev(host, iov.data(), static_cast<int>(iov.size()), offset); }));
+}
+
+uint64_t io_syscalls::lseek(int fd, off_t offset, int whence) {
+    int host = _fds.host(fd);
+    if (host < 0) {
+        return syscall_error(EBADF);
+    }
+
+    return syscall_result(::lseek(host, offset, whence));
+}
+
+uint64_t io_syscalls::fstat(int fd, uintptr_t statbuf) {
+    int host = _fds.host(fd);
+    if (host < 0) {
+        return syscall_error(EBADF);
+    }
+
+    struct stat st;
+    if (::fstat(host, &st) != 0) {
+        return syscall_error(errno);
+    }
+
+    guest_stat res {
+        .st_dev = st.st_dev,
+        .st_ino = st.st_ino,
+        .st_mode = st.st_mode,
+        .st_nlink = static_cast<uint32_t>(st.st_nlink),
+        .st_uid = st.st_uid,
+        .st_gid = st.st_gid,
+        .st_rdev = st.st_rdev,
+        .pad1 = 0,
+        .st_size = st.st_size,
+        .st_blksize = static_cast<int32_t>(st.st_blksize),
+        .pad2 = 0,
+        .st_blocks = st.st_blocks,
+        .st_atime_sec = st.st_atim.tv_sec,
+        .st_atime_nsec = static_cast<uint64_t>(st.st_atim.tv_nsec),
+        .st_mtime_sec = st.st_mtim.tv_sec,
+        .st_mtime_nsec = static_cast<uint64_t>(st.st_mtim.tv_nsec),
+        .st_ctime_sec = st.st_ctim.tv_sec,
+        .st_ctime_nsec = static_cast<uint64_t>(st.st_ctim.tv_nsec),
+        .unused4 = 0,
+        .unused5 = 0,
+    };
+
+    _mem.write_block(statbuf, as_span(res));
+
+    return 0;
+}
+
+uint64_t io_syscalls::fsync(int fd, bool datasync) {
+    int host = _fds.host(fd);
+    if (host < 0) {
+        return syscall_error(EBADF);
+    }
+
+    return syscall_result(_blocking([&] { return datasync ? ::fdatasync(host) : ::fsync(host); }));
+}
+
+uint64_t io_syscalls::ioctl(int fd, unsigned long request, uintptr_t arg) {
+    int host = _fds.host(fd);
+    if (host < 0) {
+        return syscall_error(EBADF);
+    }
+
+    switch (request) {
+        case guest_tcgets: {
+            /* Layout is identical between the generic ABI and x86-64 */
+            kernel_termios term;
+            if (::ioctl(host, TCGETS, &term) != 0) {
+                return syscall_error(errno);
+            }
+
+            _mem.write_block(arg, as_span(term));
+            return 0;
+        }
+
+        default:
+            return syscall_error(ENOTTY);
+    }
+}
+
+#ifdef SPECTER_ENABLE_IO_URING
+bool io_syscalls::enable_async(uint32_t entries) {
+    if (!io_ring::supported()) {
+        return false;
+    }
+
+    _ring = std::make_unique<io_ring>(entries);
+    return true;
+}
+
+std::optional<io_ring::ticket> io_syscalls::submit(rv64::syscall id, std::span<const uint64_t, 6> args) {
+    if (!_ring) {
+        return std::nullopt;
+    }
+
+    switch (id) {
+        case rv64::syscall::read:
+        case rv64::syscall::write:
+        case rv64::syscall::pread64:
+        case rv64::syscall::pwrite64:
+        case rv64::syscall::fsync:
+        case rv64::syscall::fdatasync:
+            break;
+
+        default:
+            return std::nullopt;
+    }
+
+    int host = _fds.host(static_cast<int>(args[0]));
+    if (host < 0) {
+        return std::nullopt;
+    }
+
+    /* Standard streams are usually expected to be in order with the host */
+    if (host <= STDERR_FILENO) {
+        return std::nullopt;
+    }
+
+    /* Pipes, sockets and terminals may wait for another guest thread, or forever */
+    struct stat st;
+    if (::fstat(host, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return std::nullopt;
+    }
+
+    std::scoped_lock lock { _ring_lock };
+    std::vector<iovec> iov;
+
+    std::optional<io_ring::ticket> t;
+
+    try {
+        switch (id) {
+            case rv64::syscall::read:
+                _mem.translate_range(args[1], args[2], memory::access::write, iov);
+                t = _ring->submit_readv(host, iov);
+                break;
+
+            case rv64::syscall::write:
+                _mem.translate_range(args[1], args[2], memory::access::read, iov);
+                t = _ring->submit_writev(host, iov);
+                break;
+
+            case rv64::syscall::pread64:
+                _mem.translate_range(args[1], args[2], memory::access::write, iov);
+                t = _ring->submit_readv(host, iov, static_cast<off_t>(args[3]));
+                break;
+
+            case rv64::syscall::pwrite64:
+                _mem.translate_range(args[1], args[2], memory::access::read, iov);
+                t = _ring->submit_writev(host, iov, static_cast<off_t>(args[3]));
+                break;
+
+            case rv64::syscall::fsync:
+                t = _ring->submit_fsync(host, false);
+                break;
+
+            case rv64::syscall::fdatasync:
+                t = _ring->submit_fsync(host, true);
+                break;
+
+            default:
+                return std::nullopt;
+        }
+    } catch (const illegal_access&) {
+        /* Let the synchronous path report the fault */
+        return std::nullopt;
+    }
+
+    /* The kernel may access the buffers until the result is collected */
+    if (t && !iov.empty()) {
+        _ring_pins.try_emplace(*t, iov);
+    }
+
+    return t;
+}
+
+size_t io_syscalls::drain() {
+    if (!_ring) {
+        return 0;
+    }
+
+    std::scoped_lock lock { _ring_lock };
+    _ring->flush();
+
+    /* A thread waiting in the kernel relies on finding the completions still there */
+    return _ring_waiting ? 0 : _ring->collect();
+}
+
+std::optional<uint64_t> io_syscalls::poll(io_ring::ticket t) {
+    std::scoped_lock lock { _ring_lock };
+
+    if (auto res = _ring->poll(t)) {
+        _ring_pins.erase(t);
+        return static_cast<uint64_t>(*res);
+    }
+
+    return std::nullopt;
+}
+
+std::optional<uint64_t> io_syscalls::wait(io_ring::ticket t, const std::atomic<bool>& stop) {
+    /* One thread waits in the kernel without the lock, the others for it to collect something */
+    return _blocking([&]() -> std::optional<uint64_t> {
+        std::unique_lock lock { _ring_lock };
+
+        while (!stop.load()) {
+            if (auto res = _ring->poll(t)) {
+                _ring_pins.erase(t);
+                return static_cast<uint64_t>(*res);
+            }
+
+            if (_ring_waiting) {
+                _ring_cond.wait(lock);
+                continue;
+            }
+
+            _ring_waiting = true;
+            _ring->flush();
+            lock.unlock();
+
+            bool completed = false;
+            std::exception_ptr error;
+
+            try {
+                completed = _ring->await_completion();
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            lock.lock();
+            _ring_waiting = false;
+            _ring->collect();
+            _ring_cond.notify_all();
+
+            if (error) {
+                std::rethrow_exception(error);
+            } else if (!completed) {
+                break;
+            }
+        }
+
+        return std::nullopt;
+    });
+}
+#endif
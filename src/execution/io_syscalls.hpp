@@ -0,0 +1,116 @@
+#pragma once
+
+#include "fd_table.hpp"
+#include "safepoint.hpp"
+
+#ifdef SPECTER_ENABLE_IO_URING
+#include "io_ring.hpp"
+#endif
+
+#include <span>
+#include <string>
+#include <optional>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <unordered_map>
+#include <cstdint>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <arch/rv64/rv64.hpp>
+#include <memory/virtual_memory.hpp>
+#include <memory/host_pin.hpp>
+
+/* Guest file I/O on top of host file descriptors.
+ *
+ * Arguments and results follow the raw Linux syscall ABI, errors are returned
+ * as negative errno values. Guest buffers are passed to the host directly
+ * wherever they're backed by host memory. Both the interpreter and recompiled
+ * code call into this through dispatch(), from any number of guest threads.
+ */
+class io_syscalls {
+    virtual_memory& _mem;
+    fd_table _fds;
+
+    /* Left around blocking host calls if set */
+    safepoint* _sync;
+
+#ifdef SPECTER_ENABLE_IO_URING
+    /* Guest buffers of queued calls, declared first so they outlive the ring's own wait for them */
+    std::unordered_map<io_ring::ticket, host_pin> _ring_pins;
+
+    std::unique_ptr<io_ring> _ring;
+    std::mutex _ring_lock;
+
+    /* Set while a thread waits for completions in the kernel, nobody else collects them meanwhile */
+    bool _ring_waiting = false;
+    std::condition_variable _ring_cond;
+#endif
+
+    template <typename Func>
+    [[nodiscard]] auto _blocking(Func&& func) {
+        safepoint::blocking_section section { _sync };
+        return func();
+    }
+
+    /* Same for calls that access guest memory through iov, which stays valid even if it's unmapped meanwhile */
+    template <typename Func>
+    [[nodiscard]] auto _blocking(std::span<const iovec> iov, Func&& func) {
+        host_pin pin { iov };
+        return _blocking(std::forward<Func>(func));
+    }
+
+    /* Read a null-terminated string from guest memory */
+    [[nodiscard]] std::string _read_string(uintptr_t addr, size_t max_size);
+
+    public:
+    explicit io_syscalls(virtual_memory& mem, safepoint* sync = nullptr);
+
+    [[nodiscard]] fd_table& fds() { return _fds; }
+    [[nodiscard]] const fd_table& fds() const { return _fds; }
+
+    /* Handle syscall id if it's an I/O syscall */
+    [[nodiscard]] std::optional<uint64_t> dispatch(arch::rv64::syscall id, std::span<const uint64_t, 6> args);
+
+#ifdef SPECTER_ENABLE_IO_URING
+    /* Issue blocking calls through io_uring, returns false if the host doesn't support it */
+    bool enable_async(uint32_t entries = 64);
+    [[nodiscard]] bool async() const { return !!_ring; }
+
+    /* Queue syscall id if it can be done asynchronously.
+     *
+     * The caller must not resume the issuing guest thread until the result is
+     * collected with poll() or wait(). Only regular files go through the ring,
+     * anything else, including calls that would fail immediately, returns
+     * std::nullopt and should go through dispatch() instead.
+     */
+    [[nodiscard]] std::optional<io_ring::ticket> submit(arch::rv64::syscall id, std::span<const uint64_t, 6> args);
+
+    /* Submit queued calls and collect finished ones, meant to be called at safe points */
+    size_t drain();
+
+    /* Syscall result for a ticket, if it's done */
+    [[nodiscard]] std::optional<uint64_t> poll(io_ring::ticket t);
+
+    /* Block until the call completes. Returns nothing if a signal interrupted the wait or stop is set,
+     * the call is still pending then.
+     */
+    [[nodiscard]] std::optional<uint64_t> wait(io_ring::ticket t, const std::atomic<bool>& stop);
+#endif
+
+    uint64_t openat(int dirfd, uintptr_t path, int flags, mode_t mode);
+    uint64_t close(int fd);
+    uint64_t read(int fd, uintptr_t buf, size_t count);
+    uint64_t write(int fd, uintptr_t buf, size_t count);
+    uint64_t readv(int fd, uintptr_t iov, size_t iovcnt);
+    uint64_t writev(int fd, uintptr_t iov, size_t iovcnt);
+    uint64_t pread64(int fd, uintptr_t buf, size_t count, off_t offset);
+    uint64_t pwrite64(int fd, uintptr_t buf, size_t count, off_t offset);
+    uint64_t lseek(int fd, off_t offset, int whence);
+    uint64_t fstat(int fd, uintptr_t statbuf);
+    uint64_t fsync(int fd, bool datasync);
+    uint64_t ioctl(int fd, unsigned long request, uintptr_t arg);
+};
@@ -2,323 +2,1752 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <csignal>
+#include <cstring>
 
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <time.h>
+#include <linux/futex.h>
+#include <linux/sched.h>
+
+#include <util/elf_file.hpp>
 
 #include <fmt/ostream.h>
 
-using namespace magic_enum::ostream_operators;
+using namespace magic_enum::ostream_operators;
+using namespace magic_enum::bitwise_operators;
+
+using namespace arch;
+
+namespace {
+    /* Guest PROT_* flags to memory permissions, the generic Linux values match the host's */
+    [[nodiscard]] mapped_memory::permissions guest_permissions(uint64_t prot) {
+        using enum mapped_memory::permissions;
+
+        auto perms = static_cast<mapped_memory::permissions>(0);
+        if (prot & PROT_READ)  { perms = perms | R; }
+        if (prot & PROT_WRITE) { perms = perms | W; }
+        if (prot & PROT_EXEC)  { perms = perms | X; }
+
+        return perms;
+    }
+
+    /* Frequency of the time CSR, the timebase of QEMU's virt machine */
+    constexpr uint64_t time_frequency = 10'000'000;
+
+    /* CLOCK_MONOTONIC is served from the vDSO, so rdtime never enters the kernel */
+    [[nodiscard]] uint64_t host_time() {
+        timespec ts {};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return static_cast<uint64_t>(ts.tv_sec) * time_frequency
+            + static_cast<uint64_t>(ts.tv_nsec) / (1'000'000'000 / time_frequency);
+    }
+
+    [[nodiscard]] constexpr uint64_t syscall_error(int err) {
+        return static_cast<uint64_t>(-err);
+    }
+
+    long host_futex(void* uaddr, int op, uint32_t val, const void* timeout, void* uaddr2, uint32_t val3) {
+        return ::syscall(SYS_futex, uaddr, op, val, timeout, uaddr2, val3);
+    }
+
+    [[nodiscard]] std::memory_order amo_order(const rv64::decoder& dec) {
+        if (dec.acquire() && dec.release()) {
+            return std::memory_order_seq_cst;
+        } else if (dec.acquire()) {
+            return std::memory_order_acquire;
+        } else if (dec.release()) {
+            return std::memory_order_release;
+        }
+
+        return std::memory_order_relaxed;
+    }
+
+    /* A load can't be release, lr.rl is ordered like lr.aqrl */
+    [[nodiscard]] std::memory_order load_order(std::memory_order order) {
+        if (order == std::memory_order_release || order == std::memory_order_acq_rel) {
+            return std::memory_order_seq_cst;
+        }
+
+        return order;
+    }
+
+    /* Host atomic read-modify-write for an AMO, returns the old value */
+    template <std::unsigned_integral T>
+    T amo_host(rv64::amo_op op, T& target, T val, std::memory_order order) {
+        using S = std::make_signed_t<T>;
+        std::atomic_ref<T> ref { target };
+
+        switch (op) {
+            case rv64::amo_op::swap: return ref.exchange(val, order);
+            case rv64::amo_op::add:  return ref.fetch_add(val, order);
+            case rv64::amo_op::bxor: return ref.fetch_xor(val, order);
+            case rv64::amo_op::bor:  return ref.fetch_or(val, order);
+            case rv64::amo_op::band: return ref.fetch_and(val, order);
+            default: break;
+        }
+
+        /* No host instruction for min/max, so loop on compare-exchange */
+        T old = ref.load(std::memory_order_relaxed);
+        T res;
+
+        do {
+            switch (op) {
+                case rv64::amo_op::min:  res = (S(old) < S(val)) ? old : val; break;
+                case rv64::amo_op::max:  res = (S(old) > S(val)) ? old : val; break;
+                case rv64::amo_op::minu: res = std::min(old, val); break;
+                default:                 res = std::max(old, val); break;
+            }
+        } while (!ref.compare_exchange_weak(old, res, order, std::memory_order_relaxed));
+
+        return old;
+    }
+
+    template <std::unsigned_integral T>
+    uint64_t atomic_access(rv64::amo_op op, std::span<uint8_t> host, uint64_t val, std::memory_order order,
+        std::optional<uintptr_t>& reservation, uint64_t& reservation_value, uintptr_t addr) {
+
+        T& target = *reinterpret_cast<T*>(host.data());
+
+        switch (op) {
+            case rv64::amo_op::lr:
+                reservation = addr;
+                reservation_value = std::atomic_ref<T> { target }.load(load_order(order));
+                return reservation_value;
+
+            case rv64::amo_op::sc: {
+                /* Only reached with a reservation on addr */
+                reservation.reset();
+
+                /* The value might have been changed and changed back in between, which is allowed to pass */
+                T expected = static_cast<T>(reservation_value);
+                bool stored = std::atomic_ref<T> { target }.compare_exchange_strong(expected, static_cast<T>(val),
+                    order, std::memory_order_relaxed);
+
+                return stored ? 0 : 1;
+            }
+
+            default:
+                return amo_host<T>(op, target, static_cast<T>(val), order);
+        }
+    }
+
+    /* The kernel's rt_sigframe on riscv64, a siginfo followed by a ucontext */
+    namespace signal_frame {
+        constexpr size_t siginfo = 0;
+        constexpr size_t info_signo = siginfo;
+        constexpr size_t info_code = siginfo + 8;
+        constexpr size_t info_pid = siginfo + 16;
+
+        constexpr size_t ucontext = 128;
+        constexpr size_t uc_stack = ucontext + 16;
+        constexpr size_t uc_sigmask = ucontext + 40;
+
+        /* After the space reserved for a larger sigset_t, aligned to 16 bytes */
+        constexpr size_t sc_regs = ucontext + 176;
+        constexpr size_t sc_fpregs = sc_regs + 32 * 8;
+        constexpr size_t sc_fcsr = sc_fpregs + 32 * 8;
+
+        /* The float state is a union sized for the Q extension */
+        constexpr size_t trampoline = sc_fpregs + 528;
+        constexpr size_t size = (trampoline + 8 + 15) & ~size_t { 15 };
+
+        /* li a7, 139 (rt_sigreturn) and ecall */
+        constexpr uint32_t li_a7_rt_sigreturn = 0x08b00893;
+        constexpr uint32_t ecall = 0x00000073;
+
+        template <typename T>
+        void put(std::span<uint8_t> frame, size_t offset, T val) {
+            std::memcpy(frame.data() + offset, &val, sizeof(T));
+        }
+
+        template <typename T>
+        [[nodiscard]] T get(std::span<const uint8_t> frame, size_t offset) {
+            T val;
+            std::memcpy(&val, frame.data() + offset, sizeof(T));
+            return val;
+        }
+    }
+
+    /* Sent to harts to break them out of blocking host calls */
+    [[nodiscard]] int interrupt_signal() {
+        return SIGRTMIN;
+    }
+
+    void install_interrupt_handler() {
+        static std::once_flag installed;
+        std::call_once(installed, [] {
+            struct sigaction action {};
+
+            /* No SA_RESTART, so blocking calls return EINTR. Guest interval timers expire with it as well */
+            action.sa_sigaction = [](int, siginfo_t* info, void*) { guest_signals::expired(info); };
+            action.sa_flags = SA_SIGINFO;
+            sigemptyset(&action.sa_mask);
+
+            sigaction(interrupt_signal(), &action, nullptr);
+        });
+    }
+}
+
+rv64_executor::hart& rv64_executor::_main_hart() const {
+    return *_harts.at(guest_pid);
+}
+
+uint64_t rv64_executor::_operand(const hart& h, const rv64::decoder& dec, rv64::alu_input input, rv64::reg reg) const {
+    switch (input) {
+        case rv64::alu_input::reg: return h.reg.read(reg);
+        case rv64::alu_input::imm: return dec.imm();
+        case rv64::alu_input::pc:  return h.pc;
+        default: throw rv64::illegal_instruction(h.pc, dec.instr(), "alu input");
+    }
+}
+
+void rv64_executor::_run_hart(hart& h) {
+    {
+        std::scoped_lock lock { _harts_lock };
+        h.host_thread = pthread_self();
+        h.running = true;
+    }
+
+    /* Host threads start with a copy of their creator's float state */
+    h.alu.reset_host();
+
+    _sync.enter();
+
+    try {
+        while (!_exiting.load(std::memory_order_relaxed)) {
+            /* Safe point, between two instructions */
+            if (_sync.requested()) {
+                _sync.yield();
+            }
+
+#ifdef SPECTER_ENABLE_IO_URING
+            if (h.pending_io) {
+                /* The hart is parked until its I/O completes */
+                _io.drain();
+
+                auto res = _io.poll(*h.pending_io);
+                if (!res) {
+                    res = _io.wait(*h.pending_io, _exiting);
+                }
+
+                /* Interrupted, look for exit_group and wait again */
+                if (!res) {
+                    continue;
+                }
+
+                h.reg.write(rv64::reg::a0, *res);
+                h.pending_io.reset();
+            }
+#endif
+
+            /* Signals are delivered here as well, looking for them costs a load unless one was sent */
+            if (guest_signals::sequence() != h.signals_seen && !_deliver_signals(h)) {
+                break;
+            }
+
+            if (h.pc == _snapshot_at) [[unlikely]] {
+                _save_snapshot(h);
+            }
+
+            bool cont = _step(h);
+
+            h.pc = h.next_pc;
+            h.instructions += 1;
+
+            if (!cont) {
+                break;
+            }
+        }
+    } catch (...) {
+        _finish_hart(h);
+        _sync.leave();
+        throw;
+    }
+
+    _finish_hart(h);
+    _sync.leave();
+}
+
+bool rv64_executor::_step(hart& h) {
+    uint16_t lo = mem.read_half(h.pc);
+
+    auto dec = [&] {
+        if (rv64::decoder::compressed(lo)) {
+            return rv64::decoder { h.pc, lo };
+        }
+
+        /* Read in halves, 32-bit instructions only need 16-bit alignment */
+        return rv64::decoder { h.pc, (static_cast<uint32_t>(mem.read_half(h.pc + 2)) << 16) | lo };
+    }();
+
+    h.next_pc = h.pc + dec.size();
+
+    if (_verbose) {
+        try {
+            fmt::print(std::cerr, "{}\n", dec);
+        } catch (const arch::illegal_instruction&) {
+            fmt::print(std::cerr, "{:x}: {:08x}\n", h.pc, dec.instr());
+        }
+    }
+
+    return _exec(h, dec);
+}
+
+bool rv64_executor::_exec(hart& h, const rv64::decoder& dec) {
+    switch (dec.opcode()) {
+        case rv64::opc::lui:
+        case rv64::opc::auipc:
+        case rv64::opc::addi:
+        case rv64::opc::addiw:
+        case rv64::opc::add:
+        case rv64::opc::addw: {
+            h.alu.set_a(_operand(h, dec, dec.a(), dec.rs1()));
+            h.alu.set_b(_operand(h, dec, dec.b(), dec.rs2()));
+            h.alu.set_op(dec.op());
+            h.alu.pulse();
+
+            h.reg.write(dec.rd(), h.alu.result());
+            break;
+        }
+
+        case rv64::opc::jal: {
+            h.reg.write(dec.rd(), h.next_pc);
+            h.next_pc = h.pc + dec.imm();
+            break;
+        }
+
+        case rv64::opc::jalr: {
+            /* rd may be rs1 */
+            uintptr_t target = (h.reg.read(dec.rs1()) + dec.imm()) & ~uintptr_t { 1 };
+
+            h.reg.write(dec.rd(), h.next_pc);
+            h.next_pc = target;
+            break;
+        }
+
+        case rv64::opc::branch: {
+            uint64_t a = h.reg.read(dec.rs1());
+            uint64_t b = h.reg.read(dec.rs2());
+
+            bool taken;
+            switch (dec.comparison()) {
+                case rv64::branch_comp::eq:  taken = (a == b); break;
+                case rv64::branch_comp::ne:  taken = (a != b); break;
+                case rv64::branch_comp::lt:  taken = (int64_t(a) < int64_t(b)); break;
+                case rv64::branch_comp::ge:  taken = (int64_t(a) >= int64_t(b)); break;
+                case rv64::branch_comp::ltu: taken = (a < b); break;
+                case rv64::branch_comp::geu: taken = (a >= b); break;
+                default: throw rv64::illegal_instruction(h.pc, dec.instr(), "branch comparison");
+            }
+
+            if (taken) {
+                h.next_pc = h.pc + dec.imm();
+            }
+            break;
+        }
+
+        case rv64::opc::load:
+        case rv64::opc::fload: {
+            uintptr_t addr = h.reg.read(dec.rs1()) + dec.imm();
+            size_t bytes = rv64::mem_size_bytes(dec.memory());
+
+            uint64_t val;
+            switch (bytes) {
+                case 1: val = mem.read_byte(addr); break;
+                case 2: val = mem.read_half(addr); break;
+                case 4: val = mem.read_word(addr); break;
+                default: val = mem.read_dword(addr); break;
+            }
+
+            if (rv64::mem_size_float(dec.memory())) {
+                /* Singles are NaN-boxed */
+                if (bytes == 4) {
+                    val |= 0xffffffff00000000;
+                }
+            } else if (rv64::mem_size_signed(dec.memory())) {
+                val = sign_extend(val, static_cast<uint8_t>(bytes * 8));
+            }
+
+            h.reg.write(dec.rd(), val);
+            break;
+        }
+
+        case rv64::opc::store:
+        case rv64::opc::fstore: {
+            uintptr_t addr = h.reg.read(dec.rs1()) + dec.imm();
+            uint64_t val = h.reg.read(dec.rs2());
+
+            switch (rv64::mem_size_bytes(dec.memory())) {
+                case 1: mem.write_byte(addr, static_cast<uint8_t>(val)); break;
+                case 2: mem.write_half(addr, static_cast<uint16_t>(val)); break;
+                case 4: mem.write_word(addr, static_cast<uint32_t>(val)); break;
+                default: mem.write_dword(addr, val); break;
+            }
+            break;
+        }
+
+        /* Float registers and integer registers share the regfile, fmv.x is an integer add */
+        case rv64::opc::fadd:
+        case rv64::opc::fmadd:
+        case rv64::opc::fmsub:
+        case rv64::opc::fnmsub:
+        case rv64::opc::fnmadd: {
+            h.alu.set_a(h.reg.read(dec.rs1()));
+            h.alu.set_b(h.reg.read(dec.rs2()));
+            h.alu.set_c(h.reg.read(dec.rs3()));
+            h.alu.set_rm(_rounding(h, dec));
+            h.alu.set_op(dec.op());
+            h.alu.pulse();
+
+            h.reg.write(dec.rd(), h.alu.result());
+            break;
+        }
+
+        case rv64::opc::amo:
+            _atomic(h, dec);
+            break;
+
+        case rv64::opc::fence: {
+            /* Instructions are fetched from guest memory every time, so fence.i has nothing to do */
+            if (dec.funct() == 0) {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+            break;
+        }
+
+        case rv64::opc::vector:
+            _vector(h, dec);
+            break;
+
+        case rv64::opc::ecall: {
+            /* The same major opcode holds the CSR instructions */
+            if (dec.funct() != 0) {
+                _csr(h, dec);
+                break;
+            }
+
+            switch (dec.imm()) {
+                case 0: {
+                    /* The emulator's own float code must not leak into the guest's flags */
+                    h.accrued = _fflags(h);
+
+                    bool cont = _syscall(h);
+                    _set_fflags(h, h.accrued);
+
+                    return cont;
+                }
+
+                case 1: throw rv64::illegal_instruction(h.pc, dec.instr(), "ebreak");
+                default: throw rv64::illegal_instruction(h.pc, dec.instr(), "system");
+            }
+        }
+
+        default:
+            throw rv64::illegal_instruction(h.pc, dec.instr(), "not implemented");
+    }
+
+    return true;
+}
+
+rv64::rounding_mode rv64_executor::_rounding(const hart& h, const rv64::decoder& dec) const {
+    rv64::rounding_mode rm = (dec.rm() == rv64::rounding_mode::dyn) ? h.frm : dec.rm();
+
+    switch (rm) {
+        case rv64::rounding_mode::rne:
+        case rv64::rounding_mode::rtz:
+        case rv64::rounding_mode::rdn:
+        case rv64::rounding_mode::rup:
+        case rv64::rounding_mode::rmm:
+        case rv64::rounding_mode::invalid_mask:
+            return rm;
+
+        /* Reserved encodings, or dyn with a reserved frm */
+        default:
+            throw rv64::illegal_instruction(h.pc, dec.instr(), "rounding mode");
+    }
+}
+
+void rv64_executor::_vector(hart& h, const rv64::decoder& dec) {
+    switch (dec.vop()) {
+        case rv64::vector_op::vsetvli:
+        case rv64::vector_op::vsetivli:
+        case rv64::vector_op::vsetvl: {
+            uint64_t vtype = (dec.vop() == rv64::vector_op::vsetvl) ? h.reg.read(dec.rs2()) : dec.vtype();
+            uint64_t avl;
+
+            if (dec.vop() == rv64::vector_op::vsetivli) {
+                avl = dec.imm();
+            } else if (dec.rs1() != rv64::reg::zero) {
+                avl = h.reg.read(dec.rs1());
+            } else if (dec.rd() != rv64::reg::zero) {
+                /* As many elements as fit */
+                avl = ~uint64_t { 0 };
+            } else {
+                /* Only vtype changes */
+                avl = h.vec.vl();
+            }
+
+            h.reg.write(dec.rd(), h.vec.configure(avl, vtype));
+            return;
+        }
+
+        case rv64::vector_op::load:
+        case rv64::vector_op::store:
+            _vector_memory(h, dec);
+            return;
+
+        default:
+            break;
+    }
+
+    uint64_t scalar = 0;
+
+    switch (dec.voperand()) {
+        case rv64::vector_operand::scalar: scalar = h.reg.read(dec.rs1()); break;
+        case rv64::vector_operand::imm:    scalar = dec.imm(); break;
+        default: break;
+    }
+
+    if (dec.rm() == rv64::rounding_mode::dyn) {
+        h.alu.set_host_rounding(_rounding(h, dec));
+    }
+
+    h.reg.write(dec.rd(), h.vec.execute(dec, scalar));
+}
+
+void rv64_executor::_vector_memory(hart& h, const rv64::decoder& dec) {
+    std::span<uint8_t> data = h.vec.memory_operand(dec);
+    uintptr_t addr = h.reg.read(dec.rs1());
+    bool load = dec.vop() == rv64::vector_op::load;
+
+    auto transfer = [&](uintptr_t at, std::span<uint8_t> bytes) {
+        if (load) {
+            mem.read_block(at, bytes);
+        } else {
+            mem.write_block(at, bytes);
+        }
+    };
+
+    switch (dec.vaddressing()) {
+        /* Plain byte copies, independent of vtype */
+        case rv64::vector_addressing::whole:
+        case rv64::vector_addressing::mask:
+            if (!data.empty()) {
+                transfer(addr, data);
+            }
+            break;
+
+        default: {
+            size_t width = rv64::mem_size_bytes(dec.memory());
+            uint64_t stride = (dec.vaddressing() == rv64::vector_addressing::strided) ? h.reg.read(dec.rs2()) : width;
+            uint64_t vl = h.vec.vl();
+
+            if (!dec.masked() && stride == width && h.vec.vstart() < vl) {
+                /* Contiguous elements, the whole group in one copy */
+                uint64_t first = h.vec.vstart();
+                transfer(addr + first * width, data.subspan(first * width, (vl - first) * width));
+                break;
+            }
+
+            for (uint64_t i = h.vec.vstart(); i < vl; i++) {
+                if (!dec.masked() || h.vec.mask(i)) {
+                    transfer(addr + i * stride, data.subspan(i * width, width));
+                }
+            }
+            break;
+        }
+    }
+
+    h.vec.set_vstart(0);
+}
+
+void rv64_executor::_atomic(hart& h, const rv64::decoder& dec) {
+    uintptr_t addr = h.reg.read(dec.rs1());
+    size_t bytes = rv64::mem_size_bytes(dec.memory());
+
+    if (addr % bytes) {
+        throw illegal_access("misaligned atomic access at {:#x}", addr);
+    }
+
+    /* A failing SC doesn't touch memory */
+    if (dec.amo() == rv64::amo_op::sc && h.reservation != addr) {
+        h.reservation.reset();
+        h.reg.write(dec.rd(), 1);
+        return;
+    }
+
+    auto op = (dec.amo() == rv64::amo_op::lr) ? memory::access::read : memory::access::write;
+    std::span<uint8_t> host = mem.translate(addr, bytes, op);
+
+    if (host.size() != bytes) {
+        throw illegal_access("atomic access at {:#x} isn't backed by host memory", addr);
+    }
+
+    uint64_t val = h.reg.read(dec.rs2());
+    uint64_t res;
+
+    if (bytes == 4) {
+        res = sign_extend(atomic_access<uint32_t>(dec.amo(), host, val, amo_order(dec),
+            h.reservation, h.reservation_value, addr), 32);
+    } else {
+        res = atomic_access<uint64_t>(dec.amo(), host, val, amo_order(dec), h.reservation, h.reservation_value, addr);
+    }
+
+    h.reg.write(dec.rd(), res);
+}
+
+void rv64_executor::_csr(hart& h, const rv64::decoder& dec) {
+    uint64_t src = _operand(h, dec, dec.a(), dec.rs1());
+
+    /* Setting or clearing nothing is a pure read, which read-only CSRs allow */
+    bool writes = dec.csr_operation() == rv64::csr_op::rw
+        || ((dec.a() == rv64::alu_input::imm) ? src != 0 : dec.rs1() != rv64::reg::zero);
+
+    uint64_t old = _read_csr(h, dec);
+
+    if (writes) {
+        switch (dec.csr_operation()) {
+            case rv64::csr_op::rw: _write_csr(h, dec, src);        break;
+            case rv64::csr_op::rs: _write_csr(h, dec, old | src);  break;
+            case rv64::csr_op::rc: _write_csr(h, dec, old & ~src); break;
+            default: throw rv64::illegal_instruction(h.pc, dec.instr(), "csr funct");
+        }
+    }
+
+    h.reg.write(dec.rd(), old);
+}
+
+uint64_t rv64_executor::_read_csr(hart& h, const rv64::decoder& dec) {
+    switch (dec.csr_addr()) {
+        case rv64::csr::fflags: return static_cast<uint64_t>(_fflags(h));
+        case rv64::csr::frm:    return static_cast<uint64_t>(h.frm);
+        case rv64::csr::fcsr:   return (static_cast<uint64_t>(h.frm) << 5) | static_cast<uint64_t>(_fflags(h));
+
+        /* One instruction per cycle, like the totals reported by run() */
+        case rv64::csr::cycle:
+        case rv64::csr::instret:
+            return h.instructions;
+
+        case rv64::csr::time:
+            return host_time();
+
+        case rv64::csr::vstart: return h.vec.vstart();
+        case rv64::csr::vl:     return h.vec.vl();
+        case rv64::csr::vtype:  return h.vec.vtype();
+        case rv64::csr::vlenb:  return rv64::vector_unit::vlenb;
+
+        default:
+            throw rv64::illegal_instruction(h.pc, dec.instr(), "unknown csr {:#x}", static_cast<uint16_t>(dec.csr_addr()));
+    }
+}
+
+void rv64_executor::_write_csr(hart& h, const rv64::decoder& dec, uint64_t val) {
+    switch (dec.csr_addr()) {
+        case rv64::csr::fflags:
+            _set_fflags(h, static_cast<rv64::fflags>(val & 0b11111));
+            break;
+
+        /* Any value can be written, reserved rounding modes only trap once an instruction uses them */
+        case rv64::csr::frm:
+            h.frm = static_cast<rv64::rounding_mode>(val & 0b111);
+            break;
+
+        case rv64::csr::fcsr:
+            _set_fflags(h, static_cast<rv64::fflags>(val & 0b11111));
+            h.frm = static_cast<rv64::rounding_mode>((val >> 5) & 0b111);
+            break;
+
+        /* Only needs to hold any element index */
+        case rv64::csr::vstart:
+            h.vec.set_vstart(val & (rv64::vector_unit::vlen - 1));
+            break;
+
+        default:
+            throw rv64::illegal_instruction(h.pc, dec.instr(), "read-only csr {:#x}", static_cast<uint16_t>(dec.csr_addr()));
+    }
+}
+
+rv64::fflags rv64_executor::_fflags(hart& h) const {
+    h.accrued |= h.alu.take_flags();
+    return h.accrued;
+}
+
+void rv64_executor::_set_fflags(hart& h, rv64::fflags flags) const {
+    /* Anything raised before the write is overwritten with it */
+    (void) h.alu.take_flags();
+    h.accrued = flags & static_cast<rv64::fflags>(0b11111);
+}
+
+bool rv64_executor::_syscall(hart& h) {
+    uint64_t id = h.reg.read(rv64::reg::a7);
+
+    std::array<uint64_t, 6> args {
+        h.reg.read(rv64::reg::a0),
+        h.reg.read(rv64::reg::a1),
+        h.reg.read(rv64::reg::a2),
+        h.reg.read(rv64::reg::a3),
+        h.reg.read(rv64::reg::a4),
+        h.reg.read(rv64::reg::a5)
+    };
+
+#ifdef SPECTER_ENABLE_IO_URING
+    if (auto ticket = _io.submit(static_cast<rv64::syscall>(id), args)) {
+        /* a0 is written once the call completes */
+        h.pending_io = ticket;
+        return true;
+    }
+#endif
+
+    if (auto io_res = _io.dispatch(static_cast<rv64::syscall>(id), args)) {
+        h.reg.write(rv64::reg::a0, *io_res);
+        return true;
+    }
+
+    uint64_t res = 0;
+
+    switch (static_cast<rv64::syscall>(id)) {
+        case rv64::syscall::exit:
+            h.exit_code = static_cast<int>(args[0]);
+            return false;
+
+        case rv64::syscall::exit_group:
+            _exit_group(static_cast<int>(args[0]));
+            return false;
+
+        case rv64::syscall::set_tid_address:
+            h.clear_child_tid = args[0];
+            res = h.tid;
+            break;
+
+        case rv64::syscall::set_robust_list:
+            h.robust_list_head = args[0];
+            h.robust_list_len = args[1];
+            break;
+
+        case rv64::syscall::getpid:
+            res = guest_pid;
+            break;
+
+        case rv64::syscall::gettid:
+            res = h.tid;
+            break;
+
+        case rv64::syscall::sched_yield: {
+            safepoint::blocking_section blocking { &_sync };
+            std::this_thread::yield();
+            break;
+        }
+
+        case rv64::syscall::clone:
+            res = _clone(h, args);
+            break;
+
+        case rv64::syscall::futex:
+            res = _futex(args);
+            break;
+
+        case rv64::syscall::kill:
+            res = _kill(h, args);
+            break;
+
+        case rv64::syscall::tkill:
+            res = _signal_thread(h, args[0], static_cast<int>(args[1]));
+            break;
+
+        case rv64::syscall::tgkill:
+            res = _tgkill(h, args);
+            break;
+
+        case rv64::syscall::rt_sigaction:
+            res = _rt_sigaction(args);
+            break;
+
+        case rv64::syscall::rt_sigprocmask:
+            res = _rt_sigprocmask(h, args);
+            break;
+
+        /* Continues where the signal interrupted the hart, a0 included */
+        case rv64::syscall::rt_sigreturn:
+            return _rt_sigreturn(h);
+
+        case rv64::syscall::getitimer:
+            res = _getitimer(args);
+            break;
+
+        case rv64::syscall::setitimer:
+            res = _setitimer(args);
+            break;
+
+        /* Memory layout changes stop all other harts first */
+        case rv64::syscall::brk: {
+            safepoint::exclusive_section exclusive { _sync };
+            res = _brk(args);
+            break;
+        }
+
+        case rv64::syscall::mmap: {
+            safepoint::exclusive_section exclusive { _sync };
+            res = _mmap(args);
+            break;
+        }
+
+        case rv64::syscall::munmap: {
+            safepoint::exclusive_section exclusive { _sync };
+            res = _munmap(args);
+            break;
+        }
+
+        case rv64::syscall::mprotect: {
+            safepoint::exclusive_section exclusive { _sync };
+            res = _mprotect(args);
+            break;
+        }
+
+        case rv64::syscall::mremap: {
+            safepoint::exclusive_section exclusive { _sync };
+            res = _mremap(args);
+            break;
+        }
+
+        default:
+            throw invalid_syscall(h.pc, id, std::span(args.begin(), args.end()));
+    }
+
+    h.reg.write(rv64::reg::a0, res);
+
+    return true;
+}
+
+uint64_t rv64_executor::_brk(std::span<const uint64_t, 6> args) {
+    uint64_t newbrk = args[0];
+
+    /* Current break */
+    uint64_t oldbrk = _heap.base() + _heap.size();
+
+    /* If newbrk is out of range (or 0) it's just a request for the current break */
+    if (newbrk < _heap.base() || newbrk > (_heap.base() + _heap.capacity())) {
+        return oldbrk;
+    }
+
+    /* Round up to a page */
+    newbrk = (newbrk + page_size - 1) & uint64_t(-page_size);
+
+    if (newbrk > oldbrk) {
+        /* The heap must be contiguous, so fail if anything was mapped in the way */
+        if (!_regions.reserve(oldbrk, newbrk - oldbrk)) {
+            return oldbrk;
+        }
+    } else if (newbrk < oldbrk) {
+        _regions.release(newbrk, oldbrk - newbrk);
+    }
+
+    /* Growth and shrink are the same operation, both only touch the affected pages */
+    _heap.resize(newbrk - _heap.base());
+
+    return newbrk;
+}
+
+uint64_t rv64_executor::_mmap(std::span<const uint64_t, 6> args) {
+    uint64_t addr   = args[0];
+    uint64_t length = args[1];
+    uint64_t prot   = args[2];
+    uint64_t flags  = args[3];
+    int fd          = static_cast<int>(args[4]);
+    uint64_t offset = args[5];
+
+    if (length == 0 || (addr % page_size) != 0 || (offset % page_size) != 0) {
+        return syscall_error(EINVAL);
+    }
+
+    length = (length + page_size - 1) & uint64_t(-page_size);
+
+    bool anonymous = flags & MAP_ANONYMOUS;
+    bool shared = (flags & MAP_TYPE) != MAP_PRIVATE;
+
+    int host_fd = anonymous ? -1 : _io.fds().host(fd);
+    if (!anonymous && host_fd < 0) {
+        return syscall_error(EBADF);
+    }
+
+    if (flags & MAP_FIXED_NOREPLACE) {
+        if (!_regions.reserve(addr, length)) {
+            return syscall_error(EEXIST);
+        }
+    } else if (flags & MAP_FIXED) {
+        if (addr < mmap_min_addr) {
+            return syscall_error(EPERM);
+        }
+
+        /* Anything in the way is replaced, which is only possible for other mappings */
+        try {
+            mem.unmap(addr, length);
+        } catch (const illegal_access&) {
+            return syscall_error(ENOMEM);
+        }
+
+        _regions.release(addr, length);
+
+        if (!_regions.reserve(addr, length)) {
+            return syscall_error(ENOMEM);
+        }
+    } else if (addr < mmap_min_addr || !_regions.reserve(addr, length)) {
+        /* The address is just a hint, pick a free range instead */
+        auto free = _regions.allocate(length);
+        if (!free) {
+            return syscall_error(ENOMEM);
+        }
+
+        addr = *free;
+    }
+
+    try {
+        mem.add<virtual_memory::role::mmap, mapped_memory>(
+            mem.byte_order(), guest_permissions(prot), addr, length,
+            host_fd, static_cast<off_t>(offset), shared,
+            anonymous ? "anonymous" : "file");
+    } catch (const std::system_error& e) {
+        _regions.release(addr, length);
+        return syscall_error(e.code().value());
+    } catch (const std::invalid_argument&) {
+        /* Where an empty region like the heap starts */
+        _regions.release(addr, length);
+        return syscall_error(ENOMEM);
+    }
+
+    return addr;
+}
+
+uint64_t rv64_executor::_munmap(std::span<const uint64_t, 6> args) {
+    uint64_t addr   = args[0];
+    uint64_t length = args[1];
+
+    if (length == 0 || (addr % page_size) != 0 || addr < mmap_min_addr) {
+        return syscall_error(EINVAL);
+    }
+
+    length = (length + page_size - 1) & uint64_t(-page_size);
+
+    try {
+        mem.unmap(addr, length);
+    } catch (const illegal_access&) {
+        return syscall_error(EINVAL);
+    }
+
+    _regions.release(addr, length);
+
+    return 0;
+}
+
+uint64_t rv64_executor::_mprotect(std::span<const uint64_t, 6> args) {
+    uint64_t addr   = args[0];
+    uint64_t length = args[1];
+    uint64_t prot   = args[2];
+
+    if ((addr % page_size) != 0) {
+        return syscall_error(EINVAL);
+    }
+
+    length = (length + page_size - 1) & uint64_t(-page_size);
+
+    if (!mem.overlaps(addr, length)) {
+        return syscall_error(ENOMEM);
+    }
+
+    try {
+        mem.protect(addr, length, guest_permissions(prot));
+    } catch (const std::system_error& e) {
+        return syscall_error(e.code().value());
+    }
+
+    return 0;
+}
+
+uint64_t rv64_executor::_mremap(std::span<const uint64_t, 6> args) {
+    uint64_t old_addr = args[0];
+    uint64_t old_size = args[1];
+    uint64_t new_size = args[2];
+    uint64_t flags    = args[3];
+    uint64_t new_addr = args[4];
+
+    if ((old_addr % page_size) != 0 || new_size == 0) {
+        return syscall_error(EINVAL);
+    }
+
+    old_size = (old_size + page_size - 1) & uint64_t(-page_size);
+    new_size = (new_size + page_size - 1) & uint64_t(-page_size);
+
+    try {
+        if (!(flags & MREMAP_FIXED)) {
+            if (new_size <= old_size) {
+                /* Shrinking is unmapping the tail */
+                mem.unmap(old_addr + new_size, old_size - new_size);
+                _regions.release(old_addr + new_size, old_size - new_size);
+                return old_addr;
+            }
+
+            /* Grow in-place if possible */
+            if (_regions.reserve(old_addr + old_size, new_size - old_size)) {
+                try {
+                    mem.remap(old_addr, old_size, old_addr, new_size);
+                } catch (...) {
+                    _regions.release(old_addr + old_size, new_size - old_size);
+                    throw;
+                }
+
+                return old_addr;
+            }
+        }
+
+        if (!(flags & MREMAP_MAYMOVE)) {
+            return syscall_error(ENOMEM);
+        }
+
+        if (flags & MREMAP_FIXED) {
+            if ((new_addr % page_size) != 0 || new_addr < mmap_min_addr) {
+                return syscall_error(EINVAL);
+            }
+
+            /* Unmapping the target must not take away part of the source */
+            if (new_addr < old_addr + old_size && old_addr < new_addr + new_size) {
+                return syscall_error(EINVAL);
+            }
+
+            mem.unmap(new_addr, new_size);
+            _regions.release(new_addr, new_size);
+
+            if (!_regions.reserve(new_addr, new_size)) {
+                return syscall_error(ENOMEM);
+            }
+        } else {
+            auto free = _regions.allocate(new_size);
+            if (!free) {
+                return syscall_error(ENOMEM);
+            }
+
+            new_addr = *free;
+        }
+
+        try {
+            mem.remap(old_addr, old_size, new_addr, new_size);
+        } catch (...) {
+            _regions.release(new_addr, new_size);
+            throw;
+        }
+
+        /* Only reached once the whole old range moved, so none of it is still mapped */
+        _regions.release(old_addr, old_size);
+
+        return new_addr;
+    } catch (const illegal_access&) {
+        return syscall_error(EFAULT);
+    } catch (const std::system_error& e) {
+        return syscall_error(e.code().value());
+    }
+}
+
+
+uint64_t rv64_executor::_clone(hart& h, std::span<const uint64_t, 6> args) {
+    uint64_t flags   = args[0];
+    uintptr_t newsp  = args[1];
+    uintptr_t ptid   = args[2];
+    uint64_t tls     = args[3];
+    uintptr_t ctid   = args[4];
+
+    /* Only threads are supported, not new processes */
+    constexpr uint64_t thread_flags = CLONE_VM | CLONE_THREAD | CLONE_SIGHAND;
+    if ((flags & thread_flags) != thread_flags) {
+        return syscall_error(ENOSYS);
+    }
+
+    auto child = std::make_unique<hart>();
+
+    /* The child continues after the ecall with a return value of 0 */
+    child->reg = h.reg;
+    child->reg.write(rv64::reg::a0, 0);
+    child->pc = h.next_pc;
+    child->sigmask = h.sigmask;
+    child->vec = h.vec;
+    child->frm = h.frm;
+    child->accrued = h.accrued;
+
+    if (newsp) {
+        child->reg.write(rv64::reg::sp, newsp);
+    }
+
+    if (flags & CLONE_SETTLS) {
+        child->reg.write(rv64::reg::tp, tls);
+    }
+
+    if (flags & CLONE_CHILD_CLEARTID) {
+        child->clear_child_tid = ctid;
+    }
 
-using namespace arch;
+    /* Reap harts that have exited, except the initial one */
+    std::vector<std::unique_ptr<hart>> exited;
+
+    {
+        std::scoped_lock lock { _harts_lock };
+
+        for (auto it = _harts.begin(); it != _harts.end();) {
+            if (it->second->exited && it->second->thread.joinable()) {
+                exited.push_back(std::move(it->second));
+                it = _harts.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /* Not under the lock, a hart that failed takes it once more on its way out */
+    for (auto& h : exited) {
+        h->thread.join();
+    }
+
+    std::scoped_lock lock { _harts_lock };
+
+    uint64_t tid = _next_tid++;
+    child->tid = tid;
+
+    try {
+        if (flags & CLONE_PARENT_SETTID) {
+            mem.write_word(ptid, static_cast<uint32_t>(tid));
+        }
+
+        if (flags & CLONE_CHILD_SETTID) {
+            mem.write_word(ctid, static_cast<uint32_t>(tid));
+        }
+    } catch (const illegal_access&) {
+        return syscall_error(EFAULT);
+    }
+
+    hart& ref = *child;
+    _harts.emplace(tid, std::move(child));
+    _live += 1;
+
+    ref.thread = std::thread([this, &ref] {
+        try {
+            _run_hart(ref);
+        } catch (...) {
+            {
+                std::scoped_lock lock { _harts_lock };
+                if (!_error) {
+                    _error = std::current_exception();
+                }
+            }
+
+            _exit_group(EXIT_FAILURE);
+        }
+    });
 
-bool rv64_executor::memory_hole::contains(size_t idx, size_t pages) const {
-    uintptr_t req_end = idx + pages;
-    return (idx >= start && idx < end) && (req_end >= start && req_end < end);
+    return tid;
 }
 
-bool rv64_executor::_allocate_pages(size_t idx, size_t count) {
-    for (auto it = _hole_list.begin(); it != _hole_list.end(); ++it) {
-        auto& hole = *it;
-        if (hole.contains(idx, count)) {
-            /* Correct hole was found, split */
-            memory_hole before {
-                .start = hole.start,
-                .end = idx,
-            };
+uint64_t rv64_executor::_futex(std::span<const uint64_t, 6> args) {
+    uintptr_t uaddr  = args[0];
+    int op           = static_cast<int>(args[1]);
+    uint32_t val     = static_cast<uint32_t>(args[2]);
+    uintptr_t uaddr2 = args[4];
+    uint32_t val3    = static_cast<uint32_t>(args[5]);
 
-            memory_hole after {
-                .start = idx + count,
-                .end = hole.end,
-            };
+    if ((uaddr % 4) != 0) {
+        return syscall_error(EINVAL);
+    }
 
-            if (before.size() == 0 && after.size() != 0) {
-                /* Memory allocated at the start of an existing hole, shrink */
-                hole = after;
-            } else if (before.size() != 0 && after.size() == 0) {
-                /* Memory allocated at the end of an existing hole, shrink */
-                hole = before;
-            } else {
-                /* Memory allocated in the middle of an existing hole,
-                 * shrink it and insert the new one
-                 */
-                hole = before;
+    /* Guest memory is host memory shared by all harts, so the host futex does the actual work.
+     * The operation encoding is the same on both sides.
+     */
+    auto word = mem.translate(uaddr, 4, memory::access::read);
+    if (word.empty()) {
+        return syscall_error(EFAULT);
+    }
 
-                ++it;
+    long res;
+    switch (op & FUTEX_CMD_MASK) {
+        case FUTEX_WAIT:
+        case FUTEX_WAIT_BITSET: {
+            timespec timeout {};
+            bool has_timeout = args[3] != 0;
+
+            if (has_timeout) {
+                /* struct timespec is the same on both sides */
+                try {
+                    mem.read_block(args[3], std::span(reinterpret_cast<uint8_t*>(&timeout), sizeof(timeout)));
+                } catch (const illegal_access&) {
+                    return syscall_error(EFAULT);
+                }
+            }
+
+            safepoint::blocking_section blocking { &_sync };
+            res = host_futex(word.data(), op, val, has_timeout ? &timeout : nullptr, nullptr, val3);
+            break;
+        }
+
+        case FUTEX_WAKE:
+        case FUTEX_WAKE_BITSET:
+            res = host_futex(word.data(), op, val, nullptr, nullptr, val3);
+            break;
 
-                _hole_list.insert(it, after);
+        case FUTEX_REQUEUE:
+        case FUTEX_CMP_REQUEUE:
+        case FUTEX_WAKE_OP: {
+            if ((uaddr2 % 4) != 0) {
+                return syscall_error(EINVAL);
             }
 
-            return true;
+            auto word2 = mem.translate(uaddr2, 4, memory::access::write);
+            if (word2.empty()) {
+                return syscall_error(EFAULT);
+            }
+
+            /* The timeout argument holds val2 for these */
+            res = host_futex(word.data(), op, val, reinterpret_cast<const void*>(args[3]), word2.data(), val3);
+            break;
         }
+
+        default:
+            return syscall_error(ENOSYS);
     }
 
-    return false;
+    return (res < 0) ? syscall_error(errno) : static_cast<uint64_t>(res);
 }
 
-void rv64_executor::fetch() {
-    uint32_t instr = mem.read_half(pc);
-    if (rv64::decoder::compressed(instr)) {
-        _dec.set_instr(pc, instr);
-        _next_pc = pc + 2;
-    } else {
-        _dec.set_instr(pc, static_cast<uint32_t>(mem.read_half(pc + 2) << 16) | instr);
-        _next_pc = pc + 4;
+uint64_t rv64_executor::_kill(hart& h, std::span<const uint64_t, 6> args) {
+    auto pid = static_cast<int64_t>(args[0]);
+    int sig  = static_cast<int>(args[1]);
+
+    if (sig < 0 || sig > guest_signals::count) {
+        return syscall_error(EINVAL);
+    }
+
+    /* The guest is the only process, its own group and everything it may signal */
+    if (pid != static_cast<int64_t>(guest_pid) && pid != 0 && pid != -1 && pid != -static_cast<int64_t>(guest_pid)) {
+        return syscall_error(ESRCH);
+    }
+
+    if (sig != 0) {
+        if (_verbose) {
+            fmt::print(std::cerr, "thread {} sent signal {} to the process\n", h.tid, sig);
+        }
+
+        _signals.raise(sig);
     }
+
+    return 0;
 }
 
-bool rv64_executor::exec(int& retval) {
-    switch (_dec.type()) {
-        case rv64::instr_type::R:
-            return _exec_r();
+uint64_t rv64_executor::_tgkill(hart& h, std::span<const uint64_t, 6> args) {
+    if (args[0] != guest_pid) {
+        return syscall_error(ESRCH);
+    }
 
-        case rv64::instr_type::I:
-            return _exec_i(retval);
+    return _signal_thread(h, args[1], static_cast<int>(args[2]));
+}
 
-        case rv64::instr_type::S:
-            return _exec_s();
+uint64_t rv64_executor::_signal_thread(hart& h, uint64_t tid, int sig) {
+    if (sig < 0 || sig > guest_signals::count) {
+        return syscall_error(EINVAL);
+    }
 
-        case rv64::instr_type::B:
-            return _exec_b();
+    std::scoped_lock lock { _harts_lock };
 
-        case rv64::instr_type::U:
-            return _exec_u();
+    auto it = _harts.find(tid);
+    if (it == _harts.end() || it->second->exited) {
+        return syscall_error(ESRCH);
+    }
 
-        case rv64::instr_type::J:
-            return _exec_j();
+    /* Existence check */
+    if (sig == 0) {
+        return 0;
     }
 
-    try {
-        fmt::print(std::cerr, "error on:\n{}\n", _fmt.instr());
-    } catch (const rv64::illegal_instruction&){
-        /* pass */
-        fmt::print(std::cerr, "error on unknown instruction\n");
+    if (_verbose) {
+        fmt::print(std::cerr, "thread {} sent signal {} to thread {}\n", h.tid, sig, tid);
+    }
+
+    hart& target = *it->second;
+    guest_signals::raise(target.pending, sig);
+
+    /* Blocking calls return EINTR, so the signal is delivered without waiting for them */
+    if (target.running && !pthread_equal(target.host_thread, pthread_self())) {
+        pthread_kill(target.host_thread, interrupt_signal());
     }
 
-    throw rv64::illegal_instruction(pc, _dec.instr(), "unknown type");
+    return 0;
 }
 
-bool rv64_executor::_exec_i(int& retval) {
-    _alu.set_a(_reg.read(_dec.rs1()));
-    _alu.set_b(_dec.imm());
-    _alu.set_op(_dec.op());
-    _alu.pulse();
-    
-    switch (_dec.opcode()) {
-        case rv64::opc::jalr: {
-            _reg.write(_dec.rd(), pc + (_dec.compressed() ? 2 : 4));
-            _next_pc = _alu.result();
-            break;
-        }
+uint64_t rv64_executor::_rt_sigaction(std::span<const uint64_t, 6> args) {
+    int sig          = static_cast<int>(args[0]);
+    uintptr_t act    = args[1];
+    uintptr_t oldact = args[2];
 
-        case rv64::opc::load: {
-            uintptr_t addr = _alu.result();
+    if (args[3] != sizeof(uint64_t)) {
+        return syscall_error(EINVAL);
+    }
 
-            uint64_t memory_value;
-            switch (_dec.memory_size()) {
-                case 1: memory_value = mem.read_byte(addr); break;
-                case 2: memory_value = mem.read_half(addr); break;
-                case 4: memory_value = mem.read_word(addr); break;
-                case 8: memory_value = mem.read_dword(addr); break;
-            }
+    if (!guest_signals::valid(sig) || (act && (guest_signals::bit(sig) & guest_signals::unblockable))) {
+        return syscall_error(EINVAL);
+    }
 
-            
-            if (!_dec.unsigned_memory()) {
-                memory_value = sign_extend(memory_value, _dec.memory_size() * 8);
-            }
+    try {
+        /* act and oldact may be the same */
+        std::optional<guest_signals::action> newact;
+        if (act) {
+            newact = guest_signals::action {
+                mem.read_dword(act),
+                mem.read_dword(act + 8),
+                mem.read_dword(act + 16) & ~guest_signals::unblockable
+            };
+        }
 
-            _reg.write(_dec.rd(), memory_value);
-            break;
+        guest_signals::action old = newact ? _signals.set(sig, *newact) : _signals.get(sig);
+
+        if (oldact) {
+            mem.write_dword(oldact, old.handler);
+            mem.write_dword(oldact + 8, old.flags);
+            mem.write_dword(oldact + 16, old.mask);
         }
+    } catch (const illegal_access&) {
+        return syscall_error(EFAULT);
+    }
 
-        case rv64::opc::addi:
-        case rv64::opc::addiw: {
-            _reg.write(_dec.rd(), _alu.result());
-            break;
+    return 0;
+}
+
+uint64_t rv64_executor::_rt_sigprocmask(hart& h, std::span<const uint64_t, 6> args) {
+    int how          = static_cast<int>(args[0]);
+    uintptr_t set    = args[1];
+    uintptr_t oldset = args[2];
+
+    if (args[3] != sizeof(h.sigmask)) {
+        return syscall_error(EINVAL);
+    }
+
+    try {
+        /* set and oldset may be the same */
+        std::optional<uint64_t> newset;
+        if (set) {
+            newset = mem.read_dword(set);
         }
 
-        case rv64::opc::fence: {
-            /* FENCE no-op for now */
-            break;
+        if (oldset) {
+            mem.write_dword(oldset, h.sigmask);
         }
 
-        case rv64::opc::ecall: {
-            switch (_dec.imm()) {
-                case 0: return _syscall(retval);
-                case 1: throw rv64::illegal_instruction(pc, _dec.instr(), "ebreak");
+        if (newset) {
+            switch (how) {
+                case SIG_BLOCK:   h.sigmask |= *newset;  break;
+                case SIG_UNBLOCK: h.sigmask &= ~*newset; break;
+                case SIG_SETMASK: h.sigmask = *newset;   break;
+                default: return syscall_error(EINVAL);
             }
-            break;
+
+            /* SIGKILL and SIGSTOP can't be blocked */
+            h.sigmask &= ~guest_signals::unblockable;
+
+            /* Signals that were blocked may be deliverable now */
+            h.signals_seen = ~uint64_t { 0 };
         }
+    } catch (const illegal_access&) {
+        return syscall_error(EFAULT);
+    }
+
+    return 0;
+}
 
-        default: throw rv64::illegal_instruction(pc, _dec.instr(), "i-type");
+uint64_t rv64_executor::_getitimer(std::span<const uint64_t, 6> args) {
+    itimerval cur {};
+
+    if (int err = _signals.get_timer(static_cast<int>(args[0]), cur); err != 0) {
+        return syscall_error(err);
     }
 
-    return true;
+    /* struct itimerval is the same on both sides */
+    try {
+        mem.write_block(args[1], std::span(reinterpret_cast<const uint8_t*>(&cur), sizeof(cur)));
+    } catch (const illegal_access&) {
+        return syscall_error(EFAULT);
+    }
+
+    return 0;
 }
 
-bool rv64_executor::_exec_s() {
-    switch (_dec.opcode()) {
-        case rv64::opc::store: {
-            _alu.set_a(_reg.read(_dec.rs1()));
-            _alu.set_b(_dec.imm());
-            _alu.set_op(_dec.op());
-            _alu.pulse();
+uint64_t rv64_executor::_setitimer(std::span<const uint64_t, 6> args) {
+    itimerval next {};
+    itimerval old {};
 
-            uintptr_t addr = _alu.result();
+    /* The guest's own timers, they interrupt the hart that set them like tgkill would */
+    try {
+        mem.read_block(args[1], std::span(reinterpret_cast<uint8_t*>(&next), sizeof(next)));
 
-            switch (_dec.memory_size()) {
-                case 1: mem.write_byte(addr, _reg.read(_dec.rs2())); break;
-                case 2: mem.write_half(addr, _reg.read(_dec.rs2())); break;
-                case 4: mem.write_word(addr, _reg.read(_dec.rs2())); break;
-                case 8: mem.write_dword(addr, _reg.read(_dec.rs2())); break;
-            }
-            break;
+        if (int err = _signals.set_timer(static_cast<int>(args[0]), next, old, interrupt_signal()); err != 0) {
+            return syscall_error(err);
         }
 
-        default: throw rv64::illegal_instruction(pc, _dec.instr(), "exec::s-type");
+        if (args[2]) {
+            mem.write_block(args[2], std::span(reinterpret_cast<const uint8_t*>(&old), sizeof(old)));
+        }
+    } catch (const illegal_access&) {
+        return syscall_error(EFAULT);
     }
 
-    return true;
+    return 0;
 }
 
-bool rv64_executor::_exec_j() {
-    _reg.write(_dec.rd(), pc + (_dec.compressed() ? 2 : 4));
-    _next_pc = pc + _dec.imm();
-    return true;
-}
+bool rv64_executor::_deliver_signals(hart& h) {
+    /* Anything sent after this bumps the sequence again */
+    h.signals_seen = guest_signals::sequence();
+
+    while (auto sig = _signals.take(h.pending, h.sigmask)) {
+        guest_signals::action act = _signals.get(*sig);
+
+        if (act.handler == guest_signals::handler_ignore
+            || (act.handler == guest_signals::handler_default && guest_signals::ignored_by_default(*sig))) {
+            continue;
+        }
+
+        if (act.handler == guest_signals::handler_default) {
+            if (_verbose) {
+                fmt::print(std::cerr, "thread {} killed by signal {}\n", h.tid, *sig);
+            }
+
+            /* Terminated by a signal, like a shell would report it */
+            _exit_group(128 + *sig);
+            return false;
+        }
+
+        if (!_enter_handler(h, *sig, act)) {
+            /* Like the kernel, a stack the frame doesn't fit on is fatal */
+            _exit_group(128 + SIGSEGV);
+            return false;
+        }
+
+        if (act.flags & SA_RESETHAND) {
+            _signals.reset(*sig);
+        }
+    }
 
-bool rv64_executor::_exec_r() {
-    _alu.set_a(_reg.read(_dec.rs1()));
-    _alu.set_b(_reg.read(_dec.rs2()));
-    _alu.set_op(_dec.op());
-    _alu.pulse();
-    _reg.write(_dec.rd(), _alu.result());
     return true;
 }
 
-bool rv64_executor::_exec_u() {
-    _alu.set_a(_dec.imm());
-    _alu.set_b(pc);
-    _alu.set_op(_dec.op());
-    _alu.pulse();
-    _reg.write(_dec.rd(), _alu.result());
+bool rv64_executor::_enter_handler(hart& h, int sig, const guest_signals::action& act) {
+    std::array<uint8_t, signal_frame::size> frame {};
+
+    /* Sent with kill or tgkill, the sender isn't tracked */
+    signal_frame::put<int32_t>(frame, signal_frame::info_signo, sig);
+    signal_frame::put<int32_t>(frame, signal_frame::info_code, SI_USER);
+    signal_frame::put<int32_t>(frame, signal_frame::info_pid, static_cast<int32_t>(guest_pid));
+
+    signal_frame::put<int32_t>(frame, signal_frame::uc_stack + 8, SS_DISABLE);
+    signal_frame::put<uint64_t>(frame, signal_frame::uc_sigmask, h.sigmask);
+
+    /* The pc to return to takes the place of x0 */
+    signal_frame::put<uint64_t>(frame, signal_frame::sc_regs, h.pc);
+    for (size_t i = 1; i < 32; i++) {
+        signal_frame::put<uint64_t>(frame, signal_frame::sc_regs + i * 8, h.reg.read(static_cast<rv64::reg>(i)));
+    }
+
+    for (size_t i = 0; i < 32; i++) {
+        signal_frame::put<uint64_t>(frame, signal_frame::sc_fpregs + i * 8, h.reg.read(static_cast<rv64::reg>(32 + i)));
+    }
+
+    uint32_t fcsr = (static_cast<uint32_t>(h.frm) << 5) | static_cast<uint32_t>(_fflags(h));
+    signal_frame::put<uint32_t>(frame, signal_frame::sc_fcsr, fcsr);
+
+    signal_frame::put<uint32_t>(frame, signal_frame::trampoline, signal_frame::li_a7_rt_sigreturn);
+    signal_frame::put<uint32_t>(frame, signal_frame::trampoline + 4, signal_frame::ecall);
+
+    uintptr_t sp = (h.reg.read(rv64::reg::sp) - frame.size()) & ~uintptr_t { 15 };
+
+    try {
+        mem.write_block(sp, frame);
+    } catch (const illegal_access&) {
+        return false;
+    }
+
+    h.sigmask |= act.mask;
+    if (!(act.flags & SA_NODEFER)) {
+        h.sigmask |= guest_signals::bit(sig);
+    }
+
+    h.sigmask &= ~guest_signals::unblockable;
+
+    /* There's no vDSO, the handler returns to the trampoline in the frame */
+    h.reg.write(rv64::reg::sp, sp);
+    h.reg.write(rv64::reg::ra, sp + signal_frame::trampoline);
+    h.reg.write(rv64::reg::a0, static_cast<uint64_t>(sig));
+    h.reg.write(rv64::reg::a1, sp + signal_frame::siginfo);
+    h.reg.write(rv64::reg::a2, sp + signal_frame::ucontext);
+    h.pc = act.handler;
+
     return true;
 }
 
-bool rv64_executor::_exec_b() {
-    _alu.set_a(_reg.read(_dec.rs1()));
-    _alu.set_b(_reg.read(_dec.rs2()));
-    _alu.set_op(_dec.op());
-    _alu.pulse();
+bool rv64_executor::_rt_sigreturn(hart& h) {
+    std::array<uint8_t, signal_frame::size> frame {};
+
+    /* The handler returned with sp where the frame was pushed */
+    try {
+        mem.read_block(h.reg.read(rv64::reg::sp), frame);
+    } catch (const illegal_access&) {
+        _exit_group(128 + SIGSEGV);
+        return false;
+    }
+
+    h.next_pc = signal_frame::get<uint64_t>(frame, signal_frame::sc_regs);
+    for (size_t i = 1; i < 32; i++) {
+        h.reg.write(static_cast<rv64::reg>(i), signal_frame::get<uint64_t>(frame, signal_frame::sc_regs + i * 8));
+    }
 
-    if (_alu.result()) {
-        _next_pc = pc + int64_t(_dec.imm());
+    for (size_t i = 0; i < 32; i++) {
+        h.reg.write(static_cast<rv64::reg>(32 + i), signal_frame::get<uint64_t>(frame, signal_frame::sc_fpregs + i * 8));
     }
 
+    /* Applied by the ecall once the syscall returns */
+    uint32_t fcsr = signal_frame::get<uint32_t>(frame, signal_frame::sc_fcsr);
+    h.accrued = static_cast<rv64::fflags>(fcsr & 0b11111);
+    h.frm = static_cast<rv64::rounding_mode>((fcsr >> 5) & 0b111);
+
+    h.sigmask = signal_frame::get<uint64_t>(frame, signal_frame::uc_sigmask) & ~guest_signals::unblockable;
+
+    /* Signals blocked while the handler ran may be deliverable now */
+    h.signals_seen = ~uint64_t { 0 };
+
     return true;
 }
 
-bool rv64_executor::_syscall(int& retval) {
-    uint64_t id = _reg.read(rv64::reg::a7);
+void rv64_executor::_save_snapshot(hart& h) {
+    {
+        std::scoped_lock lock { _harts_lock };
 
-    uint64_t res = 0;
+        if (h.tid != guest_pid || _live != 1) {
+            throw std::runtime_error(fmt::format("snapshot at {:#x} with {} threads running, only the initial thread may be",
+                h.pc, _live));
+        }
+    }
 
-    switch (static_cast<rv64::syscall>(id)) {
-        case rv64::syscall::exit:
-            retval = _reg.read(rv64::reg::a0);
-            return false;
+    snapshot snap;
+    snap.executable = elf.path();
 
-        case rv64::syscall::set_tid_address:
-            clear_child_tid = _reg.read(rv64::reg::a0);
-            res = 1; /* Temporary PID */
-            break;
+    snap.main.tid = h.tid;
+    snap.main.pc = h.pc;
+    for (size_t i = 0; i < snap.main.regs.size(); i++) {
+        snap.main.regs[i] = h.reg.read(static_cast<rv64::reg>(i));
+    }
 
-        case rv64::syscall::set_robust_list:
-            robust_list_head = _reg.read(rv64::reg::a0);
-            robust_list_len = _reg.read(rv64::reg::a1);
-            break;
-        
-        case rv64::syscall::brk:
-            res = _brk();
-            break;
+    snap.main.fcsr = (static_cast<uint32_t>(h.frm) << 5) | static_cast<uint32_t>(_fflags(h));
+    snap.main.sigmask = h.sigmask;
+    snap.main.clear_child_tid = h.clear_child_tid;
+    snap.main.robust_list_head = h.robust_list_head;
+    snap.main.robust_list_len = h.robust_list_len;
 
-        case rv64::syscall::mmap:
-            res = _mmap();
-            break;
+    static_assert(std::is_trivially_copyable_v<rv64::vector_unit>);
+    auto* vec = reinterpret_cast<const uint8_t*>(&h.vec);
+    snap.main.vector_state.assign(vec, vec + sizeof(h.vec));
 
-        default: {
-            std::vector<uint64_t> args {
-                _reg.read(rv64::reg::a0),
-                _reg.read(rv64::reg::a1),
-                _reg.read(rv64::reg::a2),
-                _reg.read(rv64::reg::a3),
-                _reg.read(rv64::reg::a4),
-                _reg.read(rv64::reg::a5)
-            };
+    snap.next_tid = _next_tid;
+
+    for (int sig = 1; sig <= guest_signals::count; sig++) {
+        snap.actions[static_cast<size_t>(sig - 1)] = _signals.get(sig);
+    }
+
+    snap.holes.assign(_regions.holes().begin(), _regions.holes().end());
+
+    for (const auto& [guest, host] : _io.fds().open_fds()) {
+        snapshot::file f;
+        f.guest = guest;
 
-            throw invalid_syscall(pc, id, std::span(args.begin(), args.end()));
+        if (host <= STDERR_FILENO) {
+            f.host_stdio = host;
+        } else {
+            std::error_code ec;
+            auto target = std::filesystem::read_symlink(fmt::format("/proc/self/fd/{}", host), ec);
+
+            /* Pipes, sockets and the like have no path to reopen them by */
+            if (ec || !target.is_absolute() || !std::filesystem::is_regular_file(target, ec)) {
+                throw invalid_snapshot("guest fd {} is not a regular file", guest);
+            }
+
+            f.path = target.string();
+            f.flags = fcntl(host, F_GETFL);
+            f.offset = lseek(host, 0, SEEK_CUR);
         }
+
+        snap.files.push_back(std::move(f));
     }
 
-    _reg.write(rv64::reg::a0, res);
+    snap.save(_snapshot_path, mem);
 
-    return true;
+    if (_verbose) {
+        fmt::print(std::cerr, "saved snapshot at {:#x} to {}\n", h.pc, _snapshot_path.string());
+    }
+
+    /* Only the first time the pc is reached */
+    _snapshot_at = ~uintptr_t { 0 };
 }
 
-uint64_t rv64_executor::_brk() {
-    uint64_t newbrk = _reg.read(rv64::reg::a0);
+void rv64_executor::restore(const snapshot& snap) {
+    hart& main = _main_hart();
 
-    /* Current break */
-    uint64_t oldbrk = _heap.base() + _heap.size();
+    main.pc = snap.main.pc;
+    for (size_t i = 0; i < snap.main.regs.size(); i++) {
+        main.reg.write(static_cast<rv64::reg>(i), snap.main.regs[i]);
+    }
 
-    // No shrinking, and if newbrk == 0, it's just a request for the current break
+    main.frm = static_cast<rv64::rounding_mode>((snap.main.fcsr >> 5) & 0b111);
+    main.accrued = static_cast<rv64::fflags>(snap.main.fcsr & 0b11111);
+    main.sigmask = snap.main.sigmask;
+    main.clear_child_tid = snap.main.clear_child_tid;
+    main.robust_list_head = snap.main.robust_list_head;
+    main.robust_list_len = snap.main.robust_list_len;
 
-    if (newbrk < _heap.base()) {
-        return oldbrk;
+    if (snap.main.vector_state.size() != sizeof(main.vec)) {
+        throw invalid_snapshot("vector state of {} bytes doesn't match this build", snap.main.vector_state.size());
+    }
+
+    std::memcpy(reinterpret_cast<void*>(&main.vec), snap.main.vector_state.data(), sizeof(main.vec));
+
+    _next_tid = snap.next_tid;
+
+    for (int sig = 1; sig <= guest_signals::count; sig++) {
+        const auto& act = snap.actions[static_cast<size_t>(sig - 1)];
+
+        if (act.handler != guest_signals::handler_default) {
+            (void) _signals.set(sig, act);
+        }
+    }
+
+    /* The address space as it was, not as the regions suggest */
+    _regions = region_allocator {};
+    for (const auto& [start, end] : snap.holes) {
+        _regions.release(start, end - start);
+    }
+
+    std::array<bool, 3> stdio_kept {};
+
+    for (const auto& f : snap.files) {
+        if (f.host_stdio >= 0) {
+            _io.fds().install(f.guest, f.host_stdio, false);
+
+            if (f.guest <= STDERR_FILENO) {
+                stdio_kept[static_cast<size_t>(f.guest)] = true;
+            }
+
+            continue;
+        }
+
+        int host = open(f.path.c_str(), (f.flags & ~(O_CREAT | O_EXCL | O_TRUNC)) | O_CLOEXEC);
+        if (host < 0) {
+            throw std::system_error(errno, std::generic_category(), f.path);
+        }
+
+        lseek(host, f.offset, SEEK_SET);
+        _io.fds().install(f.guest, host);
+    }
+
+    for (int fd = STDIN_FILENO; fd <= STDERR_FILENO; fd++) {
+        if (!stdio_kept[static_cast<size_t>(fd)] && _io.fds().host(fd) == fd) {
+            (void) _io.fds().close(fd);
+        }
     }
 
-    if (newbrk > 0) {
-        /* Clamp to a reasonable value.
-         * brk always grows into the first hole, as it must be contiguous.
-         */
-        newbrk = std::clamp(newbrk, _heap.base(), _hole_list.front().end * page_size);
+    /* sp is part of the registers */
+    _sp_init = true;
+    pc = main.pc;
+}
+
+void rv64_executor::attach_stdio(std::span<const int, 3> host) {
+    for (int fd = STDIN_FILENO; fd <= STDERR_FILENO; fd++) {
+        if (host[static_cast<size_t>(fd)] >= 0) {
+            _io.fds().install(fd, host[static_cast<size_t>(fd)]);
+        }
+    }
+}
+
+void rv64_executor::_finish_hart(hart& h) {
+    /* Wake anyone joining this thread, this is how pthread_join works */
+    if (h.clear_child_tid && !_exiting.load()) {
+        auto word = mem.translate(h.clear_child_tid, 4, memory::access::write);
+        if (!word.empty()) {
+            std::atomic_ref(*reinterpret_cast<uint32_t*>(word.data())).store(0);
+            host_futex(word.data(), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+        }
+    }
 
-        /* Round up to a page */
-        newbrk = (newbrk + page_size - 1) & uint64_t(-page_size);
+    std::scoped_lock lock { _harts_lock };
 
-        ssize_t growth = newbrk - oldbrk;
+    h.running = false;
+    h.exited = true;
+    _live -= 1;
 
-        //fmt::print(std::cerr, "old = {}, new = {}\n", oldbrk, newbrk);
-        //fmt::print(std::cerr, "growing by {}\n", growth);
+    /* The last thread to exit decides the exit code, unless exit_group was used */
+    if (_live == 0 && !_exiting.load()) {
+        _exit_code = h.exit_code;
+    }
+
+    _harts_cond.notify_all();
+}
 
-        /* Growth and shrink are the same operation*/
-        _heap.resize(_heap.size() + growth);
-        _hole_list.front().start += (growth / page_size);
+void rv64_executor::_exit_group(int code) {
+    {
+        std::scoped_lock lock { _harts_lock };
 
-        return newbrk;
+        if (!_exiting.load()) {
+            _exit_code = code;
+            _exiting.store(true);
+        }
     }
 
-    return oldbrk;
+    _interrupt_harts();
 }
 
-uint64_t rv64_executor::_mmap() {
-    uint64_t addr   = _reg.read(rv64::reg::a0);
-    uint64_t length = _reg.read(rv64::reg::a1);
-    uint64_t prot   = _reg.read(rv64::reg::a2);
-    uint64_t flags  = _reg.read(rv64::reg::a3);
-    uint64_t fd     = _reg.read(rv64::reg::a4);
-    uint64_t offset = _reg.read(rv64::reg::a5);
+void rv64_executor::_interrupt_harts() {
+    std::scoped_lock lock { _harts_lock };
 
-    if (addr) {
-        throw invalid_syscall("mmap at address is not supported");
-    } else if (fd != uint64_t(-1)) {
-        throw invalid_syscall("mmap of fd is not supported");
+    for (const auto& [tid, h] : _harts) {
+        if (h->running && !pthread_equal(h->host_thread, pthread_self())) {
+            pthread_kill(h->host_thread, interrupt_signal());
+        }
     }
-    throw invalid_syscall("mmap");
-    return uint64_t(-1);
 }
 
-void rv64_executor::next_instr() {
-    pc = _next_pc;
+void rv64_executor::_join_harts() {
+    using namespace std::chrono_literals;
+
+    std::unique_lock lock { _harts_lock };
+
+    while (_live > 0) {
+        if (_exiting.load()) {
+            /* A hart may have been about to block when it was interrupted, so keep trying */
+            lock.unlock();
+            _interrupt_harts();
+            lock.lock();
+        }
+
+        _harts_cond.wait_for(lock, 10ms, [this] { return _live == 0; });
+    }
+
+    std::vector<std::thread> threads;
+
+    for (const auto& [tid, h] : _harts) {
+        if (h->thread.joinable()) {
+            threads.push_back(std::move(h->thread));
+        }
+    }
+
+    /* Joined without the lock, see _clone */
+    lock.unlock();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
 }
 
 void rv64_executor::init_registers(std::shared_ptr<cpptoml::table> init) {
@@ -337,7 +1766,7 @@ void rv64_executor::init_registers(std::shared_ptr<cpptoml::table> init) {
             _sp_init = true;
         }
 
-        _reg.write(reg, init->get());
+        _main_hart().reg.write(reg, init->get());
     }
 }
 
@@ -356,7 +1785,7 @@ bool rv64_executor::validate_registers(std::shared_ptr<cpptoml::table> post, std
             throw std::runtime_error(fmt::format("invalid postcondition value: {}", val->as<std::string>()->get()));
         }
 
-        int64_t actual = _reg.read(reg);
+        int64_t actual = _main_hart().reg.read(reg);
 
         if (actual != expected->get()) {
             fmt::print(os, "{},{},{}\n", reg, expected->get(), actual);
@@ -369,11 +1798,31 @@ bool rv64_executor::validate_registers(std::shared_ptr<cpptoml::table> post, std
 
 rv64_executor::rv64_executor(elf_file& elf, virtual_memory& mem, uintptr_t entry, uintptr_t sp, std::shared_ptr<cpptoml::table> config)
     : executor(elf, mem, entry, sp)
-    , _config { config }, _fmt { _dec, _reg }
+    , _config { config }
     , _heap { dynamic_cast<growable_memory&>(mem.get_first(virtual_memory::role::heap)) }
-    , _stack { dynamic_cast<memory_backed_memory&>(mem.get_first(virtual_memory::role::stack)) } {
+    , _stack { mem.get_first(virtual_memory::role::stack) }
+    , _io { mem, &_sync } {
+
+    install_interrupt_handler();
+
+    auto main = std::make_unique<hart>();
+    main->tid = guest_pid;
+    main->pc = entry;
+    _harts.emplace(guest_pid, std::move(main));
+    _live = 1;
+
+    /* Everything up to the top of the stack is free, except for what's already loaded */
+    _regions.release(mmap_min_addr, (_stack.base() + _stack.size()) - mmap_min_addr);
 
-    _hole_list.push_back({ .start = _heap.base() + _heap.size(), .end = _stack.base() });
+    uintptr_t reserved_end = 0;
+    for (const auto& [base, region] : mem.regions()) {
+        uintptr_t start = std::max(base & uintptr_t(-page_size), reserved_end);
+        uintptr_t end = (base + region.mem->size() + page_size - 1) & uintptr_t(-page_size);
+
+        if (end > start && _regions.reserve(start, end - start)) {
+            reserved_end = end;
+        }
+    }
 
     if (config) {
         init_registers(_config->get_table_qualified("regfile.init"));
@@ -382,39 +1831,87 @@ rv64_executor::rv64_executor(elf_file& elf, virtual_memory& mem, uintptr_t entry
         if (auto val = _config->get_qualified_as<bool>("execution.verbose")) {
             _verbose = *val;
         }
+
+        if (auto path = _config->get_qualified_as<std::string>("execution.snapshot")) {
+            auto at = _config->get_qualified_as<int64_t>("execution.snapshot_at");
+            if (!at) {
+                throw std::runtime_error("execution.snapshot needs execution.snapshot_at");
+            }
+
+            _snapshot_path = *path;
+            _snapshot_at = static_cast<uintptr_t>(*at);
+        }
+
+#ifdef SPECTER_ENABLE_IO_URING
+        if (auto val = _config->get_qualified_as<bool>("execution.async_io"); val && *val) {
+            /* Falls back to synchronous I/O on hosts without io_uring */
+            _io.enable_async();
+        }
+#endif
+    }
+}
+
+
+rv64_executor::~rv64_executor() {
+    /* Harts only outlive run() if it was left through an unexpected exception */
+    bool running = std::ranges::any_of(_harts, [](const auto& entry) { return entry.second->thread.joinable(); });
+
+    if (running) {
+        _exit_group(EXIT_FAILURE);
+
+        for (const auto& [tid, h] : _harts) {
+            if (h->thread.joinable()) {
+                h->thread.join();
+            }
+        }
     }
 }
 
 int rv64_executor::run() {
-    int retval = 0;
+    hart& main = _main_hart();
 
     if (!_sp_init) {
-        _reg.write(rv64::reg::sp, sp);
+        main.reg.write(rv64::reg::sp, sp);
     }
 
-    bool cont = true;
+    auto finish = [&] {
+        _signals.on_host_signal({});
+        end_time = std::chrono::steady_clock::now();
+
+        pc = main.pc;
+        instructions = 0;
+        for (const auto& [tid, h] : _harts) {
+            instructions += h->instructions;
+        }
+
+        cycles = instructions;
+    };
+
+    /* Host signals for the guest break its harts out of blocking calls, the same as tgkill */
+    _signals.on_host_signal([this] { _interrupt_harts(); });
 
     try {
         start_time = std::chrono::steady_clock::now();
-        while (cont) {
-            fetch();
-            cont = exec(retval);
-            next_instr();
 
-            cycles += 1;
-            instructions += 1;
-
-            if (_verbose) {
-                _fmt.instr(std::cerr) << '\n';
-            }
-        }
-        end_time = std::chrono::steady_clock::now();
+        /* The initial thread runs on the calling thread */
+        _run_hart(main);
+        _join_harts();
     } catch (std::exception&) {
-        /* Less accurate because overhead but it's as close as it'll get*/
-        end_time = std::chrono::steady_clock::now();
+        /* Take down the other harts before reporting the error */
+        _exit_group(EXIT_FAILURE);
+        _join_harts();
+        finish();
         throw;
     }
-    
+
+    finish();
+
+    /* An error on any other thread takes the whole guest down */
+    if (_error) {
+        std::rethrow_exception(_error);
+    }
+
+    int retval = _exit_code;
 
     if (_testmode) {
         bool good = true;
@@ -437,11 +1934,11 @@ int rv64_executor::run() {
 
         /* Add header if there's any output */
         if (!good) {
-            fmt::print(std::cerr, "what,expected,actual\n{}", ss.str());
+            fmt::print(*report, "what,expected,actual\n{}", ss.str());
         }
 
         if (_verbose) {
-            _fmt.regs(std::cerr);
+            main.reg.print(*report);
         }
     }
 
@@ -453,17 +1950,8 @@ std::ostream& rv64_executor::print_state(std::ostream& os) const {
         fmt::print(os, "RISC-V 64-bit executor, entrypoint = {:#08x}, pc = {:#08x}, sp = {:#08x}\n", entry, pc, sp);
         os << mem;
 
-        fmt::print(os, "Memory: ");
-        for (auto [start, end] : _hole_list) {
-            fmt::print(os, "[{:#x}, {:#x}]", start, end);
-
-            if (_hole_list.back().start != start || _hole_list.back().end != end) {
-                fmt::print(os, ", ");
-            } else {
-                fmt::print(os, "\n");
-            }
-        }
-        _fmt.regs(os);
+        os << _regions;
+        _main_hart().reg.print(os);
     }
 
     return os;
@@ -1,86 +1,232 @@
 #pragma once
 
 #include "executor.hpp"
+#include "io_syscalls.hpp"
+#include "safepoint.hpp"
+#include "guest_signals.hpp"
+#include "snapshot.hpp"
 
 #include <arch/rv64/rv64.hpp>
 #include <arch/rv64/decoder.hpp>
 #include <arch/rv64/regfile.hpp>
 #include <arch/rv64/alu.hpp>
+#include <arch/rv64/vector.hpp>
 #include <arch/rv64/formatter.hpp>
 
 #include <memory/growable_memory.hpp>
 #include <memory/memory_backed_memory.hpp>
+#include <memory/mapped_memory.hpp>
+#include <memory/region_allocator.hpp>
 
 #include <array>
 #include <concepts>
 #include <string_view>
 #include <charconv>
-#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <optional>
+#include <exception>
+#include <condition_variable>
+
+#include <pthread.h>
 
 #include <magic_enum.hpp>
 #include <cpptoml.h>
 
 class rv64_executor : public executor {
+    public:
+    /* A single guest thread, each one runs on its own host thread */
+    struct hart {
+        uint64_t tid;
+
+        arch::rv64::regfile reg;
+        arch::rv64::alu alu;
+        arch::rv64::vector_unit vec;
+
+        uintptr_t pc;
+        uintptr_t next_pc;
+
+        uintptr_t clear_child_tid = 0;
+        uintptr_t robust_list_head = 0;
+        uintptr_t robust_list_len = 0;
+
+        /* Dynamic rounding mode, the frm field of fcsr */
+        arch::rv64::rounding_mode frm = arch::rv64::rounding_mode::rne;
+
+        /* Exception flags collected from the host so far. Float instructions
+         * don't touch this, the host's sticky flags are only folded in when
+         * the guest can observe them, see _fflags.
+         */
+        arch::rv64::fflags accrued = arch::rv64::fflags::none;
+
+        /* LR/SC reservation: the address and the value LR loaded from it.
+         * SC is a compare-exchange against that value, so reservations need
+         * no shared state. SC only fails if the value changed, another hart
+         * storing the same value back in between doesn't break it.
+         */
+        std::optional<uintptr_t> reservation;
+        uint64_t reservation_value = 0;
+
+        /* Blocked signals, and the ones sent to this thread that weren't delivered yet */
+        uint64_t sigmask = 0;
+        std::atomic<uint64_t> pending { 0 };
+
+        /* guest_signals::sequence() when the hart last looked for signals */
+        uint64_t signals_seen = ~uint64_t { 0 };
+
+        size_t instructions = 0;
+
+        /* Exit code passed to exit */
+        int exit_code = 0;
+
+#ifdef SPECTER_ENABLE_IO_URING
+        /* Asynchronous syscall the hart is waiting on */
+        std::optional<io_ring::ticket> pending_io;
+#endif
+
+        /* Not joinable for the initial thread, which runs on the caller of run() */
+        std::thread thread;
+        pthread_t host_thread {};
+
+        /* Protected by _harts_lock */
+        bool running = false;
+        bool exited = false;
+    };
+
+    private:
     std::shared_ptr<cpptoml::table> _config;
     bool _testmode = false;
     bool _verbose = false;
     bool _sp_init = false;
 
-    arch::rv64::decoder _dec;
-    arch::rv64::regfile _reg;
-    arch::rv64::alu _alu;
-    arch::rv64::formatter _fmt;
-
-    uintptr_t _next_pc;
-
     growable_memory& _heap;
-    memory_backed_memory& _stack;
+    memory& _stack;
 
     static constexpr size_t page_size = 4096;
 
-    struct memory_hole {
-        uintptr_t start;
-        size_t end;
+    /* Lowest address a guest is allowed to map, like vm.mmap_min_addr */
+    static constexpr uintptr_t mmap_min_addr = 0x10000;
 
-        [[nodiscard]] size_t size() const { return end - start; }
-        [[nodiscard]] bool contains(size_t idx, size_t pages) const;
-    };
+    /* Process ID, which is also the thread ID of the initial thread */
+    static constexpr uint64_t guest_pid = 1;
+
+    /* Free guest address space between mmap_min_addr and the top of the stack */
+    region_allocator _regions;
+
+    /* Memory layout changes happen while all other harts are stopped */
+    safepoint _sync;
+
+    /* Guest file descriptors and file I/O */
+    io_syscalls _io;
+
+    /* Signal actions and signals sent to the whole process */
+    guest_signals _signals;
+
+    /* Where and when to save a snapshot, execution.snapshot and execution.snapshot_at */
+    std::filesystem::path _snapshot_path;
+    uintptr_t _snapshot_at = ~uintptr_t { 0 };
+
+    /* All harts by thread ID, exited ones are reaped when new ones are made */
+    std::map<uint64_t, std::unique_ptr<hart>> _harts;
+    std::mutex _harts_lock;
+    std::condition_variable _harts_cond;
+    uint64_t _next_tid = guest_pid + 1;
+    size_t _live = 0;
+
+    /* Set by exit_group or a fatal error, every hart stops at its next safe point */
+    std::atomic<bool> _exiting = false;
+    int _exit_code = 0;
 
-    std::deque<memory_hole> _hole_list;
+    /* First exception thrown by a hart on another thread, rethrown by run() */
+    std::exception_ptr _error;
 
-    bool _allocate_pages(size_t idx, size_t count);
+    [[nodiscard]] hart& _main_hart() const;
 
-    uintptr_t clear_child_tid = 0;
-    uintptr_t robust_list_head = 0;
-    uintptr_t robust_list_len = 0;
+    /* Run a hart until it exits */
+    void _run_hart(hart& h);
 
-    /* Fetch an instruction */
-    void fetch();
+    /* Fetch, decode and execute a single instruction, returns whether the hart continues */
+    [[nodiscard]] bool _step(hart& h);
+    [[nodiscard]] bool _exec(hart& h, const arch::rv64::decoder& dec);
 
-    /* Return whether to continue execution */
-    [[nodiscard]] bool exec(int& retval);
+    /* ALU input value, reg is the register used if the input is a register */
+    [[nodiscard]] uint64_t _operand(const hart& h, const arch::rv64::decoder& dec,
+        arch::rv64::alu_input input, arch::rv64::reg reg) const;
 
-    bool _exec_i(int& retval);
-    bool _exec_s();
-    bool _exec_j();
-    bool _exec_r();
-    bool _exec_u();
-    bool _exec_b();
+    /* Static rounding mode for a float instruction, resolving dyn to frm */
+    [[nodiscard]] arch::rv64::rounding_mode _rounding(const hart& h, const arch::rv64::decoder& dec) const;
 
-    bool _syscall(int& retval);
-    uint64_t _brk();
-    uint64_t _mmap();
+    /* The guest's fflags, collecting whatever the host raised since the last time */
+    [[nodiscard]] arch::rv64::fflags _fflags(hart& h) const;
+    void _set_fflags(hart& h, arch::rv64::fflags flags) const;
 
-    /* Increment PC */
-    void next_instr();
+    /* Zicsr, the counters and the float CSRs */
+    void _csr(hart& h, const arch::rv64::decoder& dec);
+    [[nodiscard]] uint64_t _read_csr(hart& h, const arch::rv64::decoder& dec);
+    void _write_csr(hart& h, const arch::rv64::decoder& dec, uint64_t val);
+
+    /* V extension, memory accesses go through the executor and everything else to the vector unit */
+    void _vector(hart& h, const arch::rv64::decoder& dec);
+    void _vector_memory(hart& h, const arch::rv64::decoder& dec);
+
+    /* A extension, on the host memory backing the guest address */
+    void _atomic(hart& h, const arch::rv64::decoder& dec);
+
+    bool _syscall(hart& h);
+    uint64_t _brk(std::span<const uint64_t, 6> args);
+    uint64_t _mmap(std::span<const uint64_t, 6> args);
+    uint64_t _munmap(std::span<const uint64_t, 6> args);
+    uint64_t _mprotect(std::span<const uint64_t, 6> args);
+    uint64_t _mremap(std::span<const uint64_t, 6> args);
+    uint64_t _clone(hart& h, std::span<const uint64_t, 6> args);
+    uint64_t _futex(std::span<const uint64_t, 6> args);
+    uint64_t _kill(hart& h, std::span<const uint64_t, 6> args);
+    uint64_t _tgkill(hart& h, std::span<const uint64_t, 6> args);
+    uint64_t _rt_sigaction(std::span<const uint64_t, 6> args);
+    uint64_t _rt_sigprocmask(hart& h, std::span<const uint64_t, 6> args);
+    uint64_t _getitimer(std::span<const uint64_t, 6> args);
+    uint64_t _setitimer(std::span<const uint64_t, 6> args);
+
+    /* Send a signal to a single thread, waking it if it's blocked in the host */
+    uint64_t _signal_thread(hart& h, uint64_t tid, int sig);
+
+    /* Deliver pending signals that aren't blocked, returns whether the hart continues */
+    [[nodiscard]] bool _deliver_signals(hart& h);
+
+    /* Push a signal frame and enter the handler, false if the frame couldn't be written */
+    [[nodiscard]] bool _enter_handler(hart& h, int sig, const guest_signals::action& act);
+
+    /* Restore the state saved by _enter_handler, returns whether the hart continues */
+    [[nodiscard]] bool _rt_sigreturn(hart& h);
+
+    /* Save the guest once the initial thread reaches _snapshot_at, it has to be the only one */
+    void _save_snapshot(hart& h);
+
+    /* Bookkeeping when a hart stops running */
+    void _finish_hart(hart& h);
+
+    /* Stop every hart with the given exit code */
+    void _exit_group(int code);
+
+    /* Break harts out of blocking host calls */
+    void _interrupt_harts();
+
+    /* Wait for all harts to exit and join their host threads */
+    void _join_harts();
 
     void init_registers(std::shared_ptr<cpptoml::table> init);
     bool validate_registers(std::shared_ptr<cpptoml::table> post, std::ostream& os) const;
 
     public:
     rv64_executor(elf_file& elf, virtual_memory& mem, uintptr_t entry, uintptr_t sp, std::shared_ptr<cpptoml::table> config);
-    
+    ~rv64_executor() override;
+
     [[nodiscard]] int run() override;
 
+    void restore(const snapshot& snap) override;
+    void attach_stdio(std::span<const int, 3> host) override;
+
     std::ostream& print_state(std::ostream& os) const override;
 };
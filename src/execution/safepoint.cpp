@@ -0,0 +1,46 @@
+#include "safepoint.hpp"
+
+void safepoint::enter() {
+    std::unique_lock lock { _lock };
+
+    /* Pending exclusive sections go first */
+    _cond.wait(lock, [this] { return !_exclusive && _waiting == 0; });
+
+    _running += 1;
+}
+
+void safepoint::leave() {
+    std::scoped_lock lock { _lock };
+
+    _running -= 1;
+    _cond.notify_all();
+}
+
+void safepoint::yield() {
+    leave();
+    enter();
+}
+
+void safepoint::start_exclusive() {
+    std::unique_lock lock { _lock };
+
+    /* The caller doesn't count as running while it waits */
+    _running -= 1;
+    _waiting += 1;
+    _requested.store(true, std::memory_order_relaxed);
+    _cond.notify_all();
+
+    _cond.wait(lock, [this] { return !_exclusive && _running == 0; });
+
+    _waiting -= 1;
+    _exclusive = true;
+}
+
+void safepoint::end_exclusive() {
+    std::scoped_lock lock { _lock };
+
+    _exclusive = false;
+    _running += 1;
+    _requested.store(_waiting > 0, std::memory_order_relaxed);
+    _cond.notify_all();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+
+/* Coordinates guest threads that share an address space.
+ *
+ * Every host thread executing guest code is "running" between enter() and
+ * leave(). An exclusive section waits until no other thread is running, and
+ * keeps new ones from starting until it ends. Running threads are expected
+ * to poll requested() regularly and yield() when it's set, and to leave
+ * before blocking in the host for any amount of time.
+ *
+ * This makes it safe to change the memory layout while other threads run,
+ * without any locking on the memory access path itself.
+ */
+class safepoint {
+    std::mutex _lock;
+    std::condition_variable _cond;
+
+    size_t _running = 0;
+    size_t _waiting = 0;
+    bool _exclusive = false;
+
+    std::atomic<bool> _requested = false;
+
+    public:
+    /* Start and stop running guest code on this thread */
+    void enter();
+    void leave();
+
+    /* Whether an exclusive section is waiting for running threads */
+    [[nodiscard]] bool requested() const { return _requested.load(std::memory_order_relaxed); }
+
+    /* Let a pending exclusive section go ahead */
+    void yield();
+
+    /* Must be called by a running thread, which stays running afterwards */
+    void start_exclusive();
+    void end_exclusive();
+
+    /* Leaves for the duration of a blocking host call */
+    class blocking_section {
+        safepoint* _sync;
+
+        public:
+        explicit blocking_section(safepoint* sync) : _sync { sync } { if (_sync) { _sync->leave(); } }
+        ~blocking_section() { if (_sync) { _sync->enter(); } }
+
+        blocking_section(const blocking_section&) = delete;
+        blocking_section& operator=(const blocking_section&) = delete;
+    };
+
+    class exclusive_section {
+        safepoint& _sync;
+
+        public:
+        explicit exclusive_section(safepoint& sync) : _sync { sync } { _sync.start_exclusive(); }
+        ~exclusive_section() { _sync.end_exclusive(); }
+
+        exclusive_section(const exclusive_section&) = delete;
+        exclusive_section& operator=(const exclusive_section&) = delete;
+    };
+};
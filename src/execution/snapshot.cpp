@@ -0,0 +1,407 @@
+#include "snapshot.hpp"
+
+#include <memory/growable_memory.hpp>
+#include <memory/mapped_memory.hpp>
+#include <memory/memory_backed_memory.hpp>
+
+#include <fstream>
+#include <unordered_map>
+#include <deque>
+#include <cstring>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <magic_enum.hpp>
+
+using namespace magic_enum::bitwise_operators;
+
+namespace {
+    constexpr std::array<char, 8> magic { 'S', 'P', 'E', 'C', 'S', 'N', 'A', 'P' };
+    constexpr uint32_t version = 1;
+
+    /* How a region is recreated */
+    enum class region_kind : uint8_t {
+        mapped, growable
+    };
+
+    struct header {
+        std::array<char, 8> magic;
+        uint32_t version;
+        uint32_t page_size;
+
+        /* Pages start right after the header's page, the state follows them */
+        uint64_t page_count;
+        uint64_t state_offset;
+        uint64_t state_size;
+    };
+
+    class writer {
+        std::vector<uint8_t> _data;
+
+        public:
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        void put(const T& val) {
+            auto* bytes = reinterpret_cast<const uint8_t*>(&val);
+            _data.insert(_data.end(), bytes, bytes + sizeof(T));
+        }
+
+        void put(std::string_view str) {
+            put<uint64_t>(str.size());
+            _data.insert(_data.end(), str.begin(), str.end());
+        }
+
+        void put(std::span<const uint8_t> bytes) {
+            put<uint64_t>(bytes.size());
+            _data.insert(_data.end(), bytes.begin(), bytes.end());
+        }
+
+        [[nodiscard]] const std::vector<uint8_t>& data() const { return _data; }
+    };
+
+    class reader {
+        std::span<const uint8_t> _data;
+        size_t _pos = 0;
+
+        [[nodiscard]] std::span<const uint8_t> _take(size_t size) {
+            if (size > _data.size() - _pos) {
+                throw invalid_snapshot("snapshot state is truncated");
+            }
+
+            auto res = _data.subspan(_pos, size);
+            _pos += size;
+
+            return res;
+        }
+
+        public:
+        explicit reader(std::span<const uint8_t> data) : _data { data } { }
+
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        [[nodiscard]] T get() {
+            T val;
+            std::memcpy(&val, _take(sizeof(T)).data(), sizeof(T));
+            return val;
+        }
+
+        [[nodiscard]] std::string str() {
+            auto bytes = _take(get<uint64_t>());
+            return std::string(bytes.begin(), bytes.end());
+        }
+
+        [[nodiscard]] std::vector<uint8_t> bytes() {
+            auto bytes = _take(get<uint64_t>());
+            return std::vector<uint8_t>(bytes.begin(), bytes.end());
+        }
+    };
+
+    /* Pages in the order they're written, identical ones are only kept once */
+    class page_store {
+        std::ofstream& _out;
+        size_t _count = 0;
+
+        /* Hash to the pages with that hash, they stay readable until saving is done */
+        std::unordered_multimap<size_t, std::pair<const uint8_t*, uint64_t>> _pages;
+
+        /* Copies of partial pages at the end of regions */
+        std::deque<std::vector<uint8_t>> _tails;
+
+        public:
+        explicit page_store(std::ofstream& out) : _out { out } { }
+
+        [[nodiscard]] size_t count() const { return _count; }
+
+        /* File page holding the contents of page, nothing if it's all zero */
+        [[nodiscard]] std::optional<uint64_t> add(std::span<const uint8_t> page) {
+            size_t size = host_page_size();
+
+            if (page.size() < size) {
+                auto& tail = _tails.emplace_back(size, uint8_t { 0 });
+                std::ranges::copy(page, tail.begin());
+                page = tail;
+            }
+
+            if (std::ranges::all_of(page, [](uint8_t byte) { return byte == 0; })) {
+                return std::nullopt;
+            }
+
+            size_t hash = std::hash<std::string_view> {}(
+                std::string_view(reinterpret_cast<const char*>(page.data()), page.size()));
+
+            auto [begin, end] = _pages.equal_range(hash);
+            for (auto it = begin; it != end; ++it) {
+                if (std::memcmp(it->second.first, page.data(), size) == 0) {
+                    return it->second.second;
+                }
+            }
+
+            _out.write(reinterpret_cast<const char*>(page.data()), static_cast<std::streamsize>(size));
+            _pages.emplace(hash, std::pair { page.data(), _count });
+
+            return _count++;
+        }
+    };
+
+    [[nodiscard]] mapped_memory::permissions region_permissions(memory& mem) {
+        if (auto* mapped = dynamic_cast<mapped_memory*>(&mem)) {
+            return mapped->protection();
+        } else if (auto* fixed = dynamic_cast<memory_backed_memory*>(&mem)) {
+            return fixed->protection();
+        }
+
+        return mapped_memory::permissions::R | mapped_memory::permissions::W;
+    }
+}
+
+void snapshot::save(const std::filesystem::path& path, const virtual_memory& mem) const {
+    std::ofstream out { path, std::ios::binary | std::ios::trunc };
+    if (!out) {
+        throw std::system_error(errno, std::generic_category(), path.string());
+    }
+
+    size_t page = host_page_size();
+
+    /* Pages first, the header is written once their number is known */
+    out.seekp(static_cast<std::streamoff>(page));
+
+    page_store pages { out };
+    writer state;
+
+    state.put(std::string_view(executable.string()));
+
+    state.put(main.tid);
+    state.put(main.pc);
+    state.put(main.regs);
+    state.put(main.fcsr);
+    state.put(main.sigmask);
+    state.put(main.clear_child_tid);
+    state.put(main.robust_list_head);
+    state.put(main.robust_list_len);
+    state.put(std::span<const uint8_t>(main.vector_state));
+    state.put(next_tid);
+
+    state.put(actions);
+
+    state.put<uint64_t>(holes.size());
+    for (const auto& [start, end] : holes) {
+        state.put<uint64_t>(start);
+        state.put<uint64_t>(end);
+    }
+
+    state.put<uint64_t>(files.size());
+    for (const auto& f : files) {
+        state.put(f.guest);
+        state.put(f.host_stdio);
+        state.put(std::string_view(f.path));
+        state.put(f.flags);
+        state.put(f.offset);
+    }
+
+    /* Guest mappings without any access are made readable while they're saved */
+    std::vector<mapped_memory*> inaccessible;
+
+    auto restore_protection = [&] {
+        for (auto* mapped : inaccessible) {
+            mapped->protect(static_cast<mapped_memory::permissions>(0));
+        }
+    };
+
+    try {
+        state.put<uint64_t>(mem.regions().size());
+
+        for (const auto& [base, region] : mem.regions()) {
+            memory& m = *region.mem;
+            auto* heap = dynamic_cast<growable_memory*>(&m);
+
+            auto perms = region_permissions(m);
+            if (auto* mapped = dynamic_cast<mapped_memory*>(&m); mapped && magic_enum::enum_integer(perms) == 0) {
+                mapped->protect(mapped_memory::permissions::R);
+                inaccessible.push_back(mapped);
+            }
+
+            std::span<uint8_t> data = m.backing();
+            if (data.empty() && m.size() != 0) {
+                throw invalid_snapshot("region {} at {:#x} isn't backed by host memory", m.tag(), base);
+            }
+
+            state.put(region.kind);
+            state.put(heap ? region_kind::growable : region_kind::mapped);
+            state.put(perms);
+            state.put(m.byte_order() == std::endian::big);
+            state.put<uint64_t>(base);
+            state.put<uint64_t>(m.size());
+            state.put<uint64_t>(heap ? heap->capacity() : m.size());
+            state.put(m.tag());
+
+            /* Runs of pages that are consecutive in the file: first page, count, file page */
+            std::vector<std::array<uint64_t, 3>> runs;
+
+            for (size_t offset = 0; offset < data.size(); offset += page) {
+                auto file_page = pages.add(data.subspan(offset, std::min(page, data.size() - offset)));
+                if (!file_page) {
+                    continue;
+                }
+
+                uint64_t region_page = offset / page;
+
+                if (!runs.empty() && runs.back()[0] + runs.back()[1] == region_page
+                    && runs.back()[2] + runs.back()[1] == *file_page) {
+                    runs.back()[1] += 1;
+                } else {
+                    runs.push_back({ region_page, 1, *file_page });
+                }
+            }
+
+            state.put<uint64_t>(runs.size());
+            for (const auto& run : runs) {
+                state.put(run);
+            }
+        }
+    } catch (...) {
+        restore_protection();
+        throw;
+    }
+
+    restore_protection();
+
+    header hdr {
+        .magic = magic,
+        .version = version,
+        .page_size = static_cast<uint32_t>(page),
+        .page_count = pages.count(),
+        .state_offset = (pages.count() + 1) * page,
+        .state_size = state.data().size()
+    };
+
+    out.write(reinterpret_cast<const char*>(state.data().data()), static_cast<std::streamsize>(state.data().size()));
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+
+    if (!out.flush()) {
+        throw std::system_error(errno, std::generic_category(), path.string());
+    }
+}
+
+snapshot snapshot::load(const std::filesystem::path& path, virtual_memory& mem) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), path.string());
+    }
+
+    /* Mappings keep the file alive on their own */
+    struct closer {
+        int fd;
+        ~closer() { close(fd); }
+    } close_fd { fd };
+
+    size_t page = host_page_size();
+
+    header hdr {};
+    if (pread(fd, &hdr, sizeof(hdr), 0) != static_cast<ssize_t>(sizeof(hdr)) || hdr.magic != magic) {
+        throw invalid_snapshot("{} is not a snapshot", path.string());
+    }
+
+    if (hdr.version != version || hdr.page_size != page) {
+        throw invalid_snapshot("{} was written by another version or for another page size", path.string());
+    }
+
+    std::vector<uint8_t> data(hdr.state_size);
+    if (pread(fd, data.data(), data.size(), static_cast<off_t>(hdr.state_offset)) != static_cast<ssize_t>(data.size())) {
+        throw invalid_snapshot("snapshot state is truncated");
+    }
+
+    reader in { data };
+    snapshot res;
+
+    res.executable = in.str();
+
+    res.main.tid = in.get<uint64_t>();
+    res.main.pc = in.get<uint64_t>();
+    res.main.regs = in.get<decltype(res.main.regs)>();
+    res.main.fcsr = in.get<uint32_t>();
+    res.main.sigmask = in.get<uint64_t>();
+    res.main.clear_child_tid = in.get<uint64_t>();
+    res.main.robust_list_head = in.get<uint64_t>();
+    res.main.robust_list_len = in.get<uint64_t>();
+    res.main.vector_state = in.bytes();
+    res.next_tid = in.get<uint64_t>();
+
+    res.actions = in.get<decltype(res.actions)>();
+
+    res.holes.resize(in.get<uint64_t>());
+    for (auto& [start, end] : res.holes) {
+        start = in.get<uint64_t>();
+        end = in.get<uint64_t>();
+    }
+
+    res.files.resize(in.get<uint64_t>());
+    for (auto& f : res.files) {
+        f.guest = in.get<int>();
+        f.host_stdio = in.get<int>();
+        f.path = in.str();
+        f.flags = in.get<int>();
+        f.offset = in.get<int64_t>();
+    }
+
+    uint64_t regions = in.get<uint64_t>();
+
+    for (uint64_t i = 0; i < regions; i++) {
+        auto role = in.get<virtual_memory::role>();
+        auto kind = in.get<region_kind>();
+        auto perms = in.get<mapped_memory::permissions>();
+        auto endian = in.get<bool>() ? std::endian::big : std::endian::little;
+        auto base = in.get<uint64_t>();
+        auto size = in.get<uint64_t>();
+        auto capacity = in.get<uint64_t>();
+        auto tag = in.str();
+
+        std::unique_ptr<memory> m;
+        mapped_memory* mapped = nullptr;
+
+        if (kind == region_kind::growable) {
+            auto heap = std::make_unique<growable_memory>(endian, base, capacity, tag);
+            heap->resize(size);
+            m = std::move(heap);
+        } else {
+            /* Writable until the pages are in, the real protection comes after */
+            auto region = std::make_unique<mapped_memory>(endian,
+                mapped_memory::permissions::R | mapped_memory::permissions::W, base, size, -1, 0, false, tag);
+
+            mapped = region.get();
+            m = std::move(region);
+        }
+
+        std::span<uint8_t> host = m->backing();
+        uint64_t runs = in.get<uint64_t>();
+
+        for (uint64_t r = 0; r < runs; r++) {
+            auto [first, count, file_page] = in.get<std::array<uint64_t, 3>>();
+
+            if (file_page + count > hdr.page_count || (first + count) * page > ((host.size() + page - 1) & ~(page - 1))) {
+                throw invalid_snapshot("page run of {} at {:#x} is out of range", tag, base);
+            }
+
+            /* This splits the region's host mapping, mapped_memory::remap copies it if it has to move */
+            void* target = host.data() + first * page;
+            void* res_addr = mmap(target, count * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd,
+                static_cast<off_t>((file_page + 1) * page));
+
+            if (res_addr == MAP_FAILED) {
+                throw std::system_error(errno, std::generic_category(), "mmap");
+            }
+        }
+
+        if (mapped) {
+            mapped->protect(perms);
+        }
+
+        mem.add(role, std::move(m));
+    }
+
+    return res;
+}
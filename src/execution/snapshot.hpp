@@ -0,0 +1,86 @@
+#pragma once
+
+#include "guest_signals.hpp"
+
+#include <array>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <stdexcept>
+#include <cstdint>
+
+#include <memory/virtual_memory.hpp>
+
+#include <util/formatting.hpp>
+
+class invalid_snapshot : public std::runtime_error {
+    public:
+    template <typename... Args>
+    invalid_snapshot(fmt::format_string<Args...> fmt, Args&&... args)
+        : std::runtime_error(fmt::format(fmt, std::forward<Args>(args)...)) {
+
+    }
+};
+
+/* Complete state of a stopped guest, to continue it later or many times over.
+ *
+ * The file holds this state followed by the guest's memory as host pages.
+ * Pages that are all zero aren't stored and identical pages only once, each
+ * region lists runs of its pages that are consecutive in the file. Loading
+ * maps those runs privately, so restoring is a handful of mmap calls no
+ * matter how large the guest is, and workers started from the same file
+ * share its pages until they write to them.
+ *
+ * Only the state of a single thread is kept. Files are reopened by path at
+ * their saved offset, other kinds of descriptors can't be saved.
+ */
+class snapshot {
+    public:
+    /* A guest thread, registers are indexed like arch::rv64::reg */
+    struct thread {
+        uint64_t tid = 0;
+        uint64_t pc = 0;
+        std::array<uint64_t, 64> regs {};
+
+        /* fcsr, with the host's exception flags folded in */
+        uint32_t fcsr = 0;
+
+        uint64_t sigmask = 0;
+        uint64_t clear_child_tid = 0;
+        uint64_t robust_list_head = 0;
+        uint64_t robust_list_len = 0;
+
+        /* vector_unit as is, snapshots are only read by the build that wrote them */
+        std::vector<uint8_t> vector_state;
+    };
+
+    /* An open guest file descriptor */
+    struct file {
+        int guest = -1;
+
+        /* stdin, stdout and stderr stay the host's */
+        int host_stdio = -1;
+
+        std::string path;
+        int flags = 0;
+        int64_t offset = 0;
+    };
+
+    std::filesystem::path executable;
+
+    thread main;
+    uint64_t next_tid = 0;
+
+    std::array<guest_signals::action, guest_signals::count> actions {};
+
+    /* Free guest address space, start and end */
+    std::vector<std::pair<uintptr_t, uintptr_t>> holes;
+
+    std::vector<file> files;
+
+    /* Write the state and every region of mem */
+    void save(const std::filesystem::path& path, const virtual_memory& mem) const;
+
+    /* Read the state, mem gets the regions mapped copy-on-write from the file */
+    [[nodiscard]] static snapshot load(const std::filesystem::path& path, virtual_memory& mem);
+};
@@ -0,0 +1,246 @@
+#include "test_suite.hpp"
+
+#include <map>
+#include <algorithm>
+#include <stdexcept>
+
+#include <glob.h>
+
+#include <util/formatting.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+    [[nodiscard]] std::vector<fs::path> expand(const std::string& pattern) {
+        std::vector<fs::path> res;
+
+        std::error_code ec;
+        if (fs::is_directory(pattern, ec)) {
+            for (const auto& entry : fs::directory_iterator(pattern)) {
+                if (entry.is_regular_file() && entry.path().extension() == ".toml") {
+                    res.push_back(entry.path());
+                }
+            }
+        } else {
+            glob_t matches {};
+
+            if (glob(pattern.c_str(), 0, nullptr, &matches) == 0) {
+                for (size_t i = 0; i < matches.gl_pathc; i++) {
+                    res.emplace_back(matches.gl_pathv[i]);
+                }
+            }
+
+            globfree(&matches);
+        }
+
+        if (res.empty()) {
+            throw std::runtime_error(fmt::format("no tests match {}", pattern));
+        }
+
+        return res;
+    }
+
+    [[nodiscard]] std::string escape_xml(std::string_view text) {
+        std::string res;
+
+        for (char c : text) {
+            switch (c) {
+                case '<':  res += "&lt;"; break;
+                case '>':  res += "&gt;"; break;
+                case '&':  res += "&amp;"; break;
+                case '"':  res += "&quot;"; break;
+                case '\'': res += "&apos;"; break;
+                default:   res += c; break;
+            }
+        }
+
+        return res;
+    }
+
+    /* Always quoted, messages have commas and newlines of their own */
+    [[nodiscard]] std::string escape_csv(std::string_view text) {
+        std::string res = "\"";
+
+        for (char c : text) {
+            if (c == '"') {
+                res += '"';
+            }
+
+            res += c;
+        }
+
+        return res + "\"";
+    }
+
+    /* Test mode reports mismatches as "what,expected,actual" CSV, make them a line each */
+    [[nodiscard]] std::string describe(std::string_view report) {
+        std::string res;
+
+        while (!report.empty()) {
+            auto line = report.substr(0, report.find('\n'));
+            report.remove_prefix(std::min(line.size() + 1, report.size()));
+
+            auto first = line.find(',');
+            auto second = line.find(',', first + 1);
+
+            if (line == "what,expected,actual") {
+                continue;
+            } else if (first == std::string_view::npos || second == std::string_view::npos) {
+                res += fmt::format("{}\n", line);
+            } else {
+                res += fmt::format("{}: expected {}, got {}\n", line.substr(0, first),
+                    line.substr(first + 1, second - first - 1), line.substr(second + 1));
+            }
+        }
+
+        return res;
+    }
+
+    [[nodiscard]] double seconds(std::chrono::nanoseconds time) {
+        return std::chrono::duration<double>(time).count();
+    }
+}
+
+test_suite::test_suite(std::span<const std::string> patterns) {
+    std::vector<fs::path> configs;
+
+    for (const auto& pattern : patterns) {
+        for (auto& config : expand(pattern)) {
+            configs.push_back(fs::canonical(config));
+        }
+    }
+
+    /* By name, a test that was matched twice only runs once */
+    std::ranges::sort(configs, [](const fs::path& a, const fs::path& b) {
+        return std::pair { a.stem(), a } < std::pair { b.stem(), b };
+    });
+
+    auto [first, last] = std::ranges::unique(configs);
+    configs.erase(first, last);
+
+    std::map<std::string, size_t> by_name;
+
+    for (const auto& config : configs) {
+        test t;
+        t.name = config.stem().string();
+        t.config = config;
+
+        by_name.emplace(t.name, _tests.size());
+        _tests.push_back(std::move(t));
+    }
+
+    for (const auto& t : _tests) {
+        auto job = batch_runner::from_config(t.config);
+
+        /* What specter_emu -c gives them, expected stack addresses depend on it */
+        job.env = { "FOO=BAR" };
+
+        std::vector<std::string> depends;
+        if (auto one = job.config->get_qualified_as<std::string>("testing.depends")) {
+            depends.push_back(*one);
+        } else if (auto many = job.config->get_qualified_array_of<std::string>("testing.depends")) {
+            depends = *many;
+        }
+
+        for (const auto& name : depends) {
+            if (auto it = by_name.find(name); it != by_name.end()) {
+                job.depends.push_back(it->second);
+            }
+        }
+
+        _jobs.push_back(std::move(job));
+    }
+}
+
+void test_suite::run(size_t threads) {
+    batch_runner runner { threads };
+
+    auto start = std::chrono::steady_clock::now();
+    auto results = runner.run(_jobs);
+    _runtime = std::chrono::steady_clock::now() - start;
+
+    for (size_t i = 0; i < _tests.size(); i++) {
+        auto& t = _tests[i];
+        const auto& res = results[i];
+
+        t.instructions = res.instructions;
+        t.runtime = res.runtime;
+
+        if (res.skipped) {
+            t.result = status::skipped;
+            t.message = res.error;
+        } else if (!res.error.empty()) {
+            t.result = status::error;
+            t.message = res.error;
+        } else if (res.exit_code != 0) {
+            t.result = status::failed;
+            t.message = res.report.empty() ? fmt::format("exited with code {}", res.exit_code) : describe(res.report);
+        } else {
+            t.result = status::passed;
+            t.message.clear();
+        }
+    }
+
+    /* Name the dependency instead of its job, once every test has its status */
+    for (size_t i = 0; i < _tests.size(); i++) {
+        if (_tests[i].result != status::skipped) {
+            continue;
+        }
+
+        for (size_t dep : _jobs[i].depends) {
+            if (_tests[dep].result != status::passed) {
+                _tests[i].message = fmt::format("depends on {}, which {}", _tests[dep].name,
+                    (_tests[dep].result == status::skipped) ? "was skipped" : "didn't pass");
+                break;
+            }
+        }
+    }
+}
+
+size_t test_suite::count(status s) const {
+    return static_cast<size_t>(std::ranges::count(_tests, s, &test::result));
+}
+
+void test_suite::write_junit(std::ostream& os) const {
+    fmt::print(os, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fmt::print(os, "<testsuite name=\"specter\" tests=\"{}\" failures=\"{}\" errors=\"{}\" skipped=\"{}\" time=\"{:.6f}\">\n",
+        _tests.size(), count(status::failed), count(status::error), count(status::skipped), seconds(_runtime));
+
+    for (const auto& t : _tests) {
+        fmt::print(os, "  <testcase name=\"{}\" classname=\"{}\" time=\"{:.6f}\"",
+            escape_xml(t.name), escape_xml(t.config.parent_path().filename().string()), seconds(t.runtime));
+
+        /* The first line is the summary, the rest is in the element */
+        std::string_view summary = t.message;
+        summary = summary.substr(0, summary.find('\n'));
+
+        switch (t.result) {
+            case status::passed:
+                fmt::print(os, "/>\n");
+                break;
+
+            case status::failed:
+                fmt::print(os, ">\n    <failure message=\"{}\">{}</failure>\n  </testcase>\n", escape_xml(summary), escape_xml(t.message));
+                break;
+
+            case status::error:
+                fmt::print(os, ">\n    <error message=\"{}\">{}</error>\n  </testcase>\n", escape_xml(summary), escape_xml(t.message));
+                break;
+
+            case status::skipped:
+                fmt::print(os, ">\n    <skipped message=\"{}\"/>\n  </testcase>\n", escape_xml(summary));
+                break;
+        }
+    }
+
+    fmt::print(os, "</testsuite>\n");
+}
+
+void test_suite::write_csv(std::ostream& os) const {
+    fmt::print(os, "name,status,instructions,runtime_ns,message\n");
+
+    for (const auto& t : _tests) {
+        fmt::print(os, "{},{},{},{},{}\n", escape_csv(t.name), magic_enum::enum_name(t.result),
+            t.instructions, t.runtime.count(), escape_csv(t.message));
+    }
+}
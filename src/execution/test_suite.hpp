@@ -0,0 +1,60 @@
+#pragma once
+
+#include "batch_runner.hpp"
+
+#include <span>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ostream>
+#include <filesystem>
+
+/* Microtests run concurrently in this process, each an executor config with a testing table.
+ *
+ * A test is named after its config's stem, testing.depends names the tests
+ * that have to pass before it runs, like tests/depends.py reads it. Those
+ * outside the selected tests are ignored, so any subset can run on its own.
+ */
+class test_suite {
+    public:
+    enum class status {
+        passed,
+        failed,
+        error,
+        skipped
+    };
+
+    struct test {
+        std::string name;
+        std::filesystem::path config;
+
+        status result = status::skipped;
+
+        /* The mismatches, the error or why it was skipped */
+        std::string message;
+
+        size_t instructions = 0;
+        std::chrono::nanoseconds runtime {};
+    };
+
+    private:
+    std::vector<test> _tests;
+    std::vector<batch_runner::job> _jobs;
+
+    std::chrono::nanoseconds _runtime {};
+
+    public:
+    /* A directory means every .toml in it, anything else is a config or a glob pattern */
+    explicit test_suite(std::span<const std::string> patterns);
+
+    void run(size_t threads = 0);
+
+    [[nodiscard]] std::span<const test> tests() const { return _tests; }
+    [[nodiscard]] size_t count(status s) const;
+
+    /* Wall time of the last run */
+    [[nodiscard]] std::chrono::nanoseconds runtime() const { return _runtime; }
+
+    void write_junit(std::ostream& os) const;
+    void write_csv(std::ostream& os) const;
+};
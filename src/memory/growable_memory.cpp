@@ -1,6 +1,11 @@
 #include "growable_memory.hpp"
 
 #include <bit>
+#include <cstring>
+#include <system_error>
+#include <utility>
+
+#include <sys/mman.h>
 
 #include <fmt/ostream.h>
 
@@ -8,17 +13,61 @@
 
 using namespace magic_enum::bitwise_operators;
 
+namespace {
+    [[nodiscard]] size_t round_to_page(size_t size) {
+        return (size + host_page_size() - 1) & ~(host_page_size() - 1);
+    }
+}
+
 void growable_memory::access_check(uintptr_t addr, size_t size) {
-    for (size_t i = 0; i < size; ++i) {
-        if (!contains(addr + i)) {
-            throw illegal_access("illegal access of size {} at {:#x}", size, addr);
-        }
+    if (addr < base_addr || (addr - base_addr) + size > used_size) {
+        throw illegal_access("illegal access of size {} at {:#x}", size, addr);
+    }
+}
+
+growable_memory::growable_memory(std::endian endian, uintptr_t vaddr, size_t max_size, std::string_view tag)
+    : memory(endian, tag), base_addr { vaddr }, data { nullptr }
+    , reserved_size { round_to_page(max_size) }, committed_size { 0 }, used_size { 0 } {
+
+    /* Only reserve address space, nothing is backed until it's committed */
+    void* addr = mmap(nullptr, reserved_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (addr == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "mmap");
     }
+
+    data = static_cast<uint8_t*>(addr);
+}
+
+growable_memory::~growable_memory() {
+    if (data) {
+        munmap(data, reserved_size);
+    }
+}
+
+growable_memory::growable_memory(growable_memory&& other) noexcept
+    : memory(std::move(other)), base_addr { other.base_addr }, data { std::exchange(other.data, nullptr) }
+    , reserved_size { std::exchange(other.reserved_size, 0) }
+    , committed_size { std::exchange(other.committed_size, 0) }
+    , used_size { std::exchange(other.used_size, 0) } {
+
 }
 
-growable_memory::growable_memory(std::endian endian, uintptr_t vaddr, std::string_view tag)
-    : memory(endian, tag), base_addr { vaddr } {
+growable_memory& growable_memory::operator=(growable_memory&& other) noexcept {
+    if (this != &other) {
+        if (data) {
+            munmap(data, reserved_size);
+        }
+
+        memory::operator=(std::move(other));
+        base_addr = other.base_addr;
+        data = std::exchange(other.data, nullptr);
+        reserved_size = std::exchange(other.reserved_size, 0);
+        committed_size = std::exchange(other.committed_size, 0);
+        used_size = std::exchange(other.used_size, 0);
+    }
 
+    return *this;
 }
 
 uintptr_t growable_memory::base() const {
@@ -26,15 +75,50 @@ uintptr_t growable_memory::base() const {
 }
 
 size_t growable_memory::size() const {
-    return data.size();
+    return used_size;
+}
+
+size_t growable_memory::capacity() const {
+    return reserved_size;
 }
 
 void growable_memory::resize(size_t new_size) {
-    data.resize(new_size);
+    if (new_size > reserved_size) {
+        throw illegal_access("cannot grow {} to {:#x} bytes, only {:#x} reserved", tag(), new_size, reserved_size);
+    }
+
+    size_t new_committed = round_to_page(new_size);
+
+    if (new_committed > committed_size) {
+        /* Only the newly touched pages are committed, fresh anonymous pages read as zero */
+        if (mprotect(data + committed_size, new_committed - committed_size, PROT_READ | PROT_WRITE) != 0) {
+            throw std::system_error(errno, std::generic_category(), "mprotect");
+        }
+    } else if (new_committed < committed_size) {
+        /* Give the pages back to the host so they read as zero if they're ever committed again.
+         * A fresh mapping rather than MADV_DONTNEED, pages mapped from a snapshot would read
+         * as the file's contents again otherwise.
+         */
+        uint8_t* start = data + new_committed;
+        size_t length = committed_size - new_committed;
+        void* res = mmap(start, length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+
+        if (res == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "mmap");
+        }
+    }
+
+    if (new_size < used_size) {
+        /* The remainder of the last committed page stays mapped, clear it for any later growth */
+        std::memset(data + new_size, 0, std::min(used_size, new_committed) - new_size);
+    }
+
+    committed_size = new_committed;
+    used_size = new_size;
 }
 
 bool growable_memory::contains(uintptr_t addr) const {
-    return (addr >= base_addr) && (addr < (base_addr + data.size()));
+    return (addr >= base_addr) && (addr < (base_addr + used_size));
 }
 
 uint8_t growable_memory::read_byte(uintptr_t addr) {
@@ -69,9 +153,29 @@ memory& growable_memory::write_dword(uintptr_t addr, uint64_t val) {
     return write_data<uint64_t>(addr, val);
 }
 
+void growable_memory::read_block(uintptr_t addr, std::span<uint8_t> dest) {
+    access_check(addr, dest.size());
+    std::copy_n(&data[addr - base_addr], dest.size(), dest.data());
+}
+
+memory& growable_memory::write_block(uintptr_t addr, std::span<const uint8_t> src) {
+    access_check(addr, src.size());
+    std::ranges::copy(src, &data[addr - base_addr]);
+    return *this;
+}
+
+std::span<uint8_t> growable_memory::translate(uintptr_t addr, size_t size, [[maybe_unused]] access op) {
+    access_check(addr, size);
+    return { &data[addr - base_addr], size };
+}
+
+std::span<uint8_t> growable_memory::backing() {
+    return { data, used_size };
+}
+
 std::ostream& growable_memory::print_state(std::ostream& os) const {
-    fmt::print(os, "[{} growable memory, tag={}, base={:#x}, size={}]",
+    fmt::print(os, "[{} growable memory, tag={}, base={:#x}, size={}, committed={}, reserved={}]",
         (byte_order() == std::endian::little) ? "little-endian" : "big-endian",
-        tag(), base_addr, data.size());
+        tag(), base_addr, used_size, committed_size, reserved_size);
     return os;
 }
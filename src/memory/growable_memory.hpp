@@ -3,12 +3,28 @@
 #include "memory.hpp"
 
 #include <algorithm>
-#include <vector>
 
+/* Memory region that can grow in-place.
+ *
+ * A large PROT_NONE region of host address space is reserved up front, pages
+ * are only committed (made accessible) as the region grows. Growing never moves
+ * existing data, so host pointers into the region stay valid.
+ */
 class growable_memory : public memory {
+    public:
+    /* Default amount of host address space to reserve */
+    static constexpr size_t default_reservation = size_t{1} << 36;
+
     protected:
     uintptr_t base_addr;
-    std::vector<uint8_t> data;
+
+    /* Start of the host reservation */
+    uint8_t* data;
+
+    /* Total reserved bytes, committed (host page-granular) bytes and the currently visible size */
+    size_t reserved_size;
+    size_t committed_size;
+    size_t used_size;
 
     void access_check(uintptr_t addr, size_t size);
 
@@ -47,16 +63,22 @@ class growable_memory : public memory {
     }
 
     public:
-    growable_memory(std::endian endian, uintptr_t vaddr, std::string_view tag = "unknown");
+    growable_memory(std::endian endian, uintptr_t vaddr,
+        size_t max_size = default_reservation, std::string_view tag = "unknown");
+
+    ~growable_memory() override;
 
     growable_memory(const growable_memory&) = delete;
     growable_memory& operator=(const growable_memory&) = delete;
 
-    growable_memory(growable_memory&& other) noexcept = default;
-    growable_memory& operator=(growable_memory&& other) noexcept = default;
+    growable_memory(growable_memory&& other) noexcept;
+    growable_memory& operator=(growable_memory&& other) noexcept;
+
+    [[nodiscard]] uintptr_t base() const override;
+    [[nodiscard]] size_t size() const override;
 
-    [[nodiscard]] uintptr_t base() const;
-    [[nodiscard]] size_t size() const;
+    /* Maximum size this region can ever grow to */
+    [[nodiscard]] size_t capacity() const;
 
     void resize(size_t new_size);
 
@@ -72,5 +94,11 @@ class growable_memory : public memory {
     memory& write_word(uintptr_t addr, uint32_t val) override;
     memory& write_dword(uintptr_t addr, uint64_t val) override;
 
+    void read_block(uintptr_t addr, std::span<uint8_t> dest) override;
+    memory& write_block(uintptr_t addr, std::span<const uint8_t> src) override;
+
+    [[nodiscard]] std::span<uint8_t> translate(uintptr_t addr, size_t size, access op) override;
+    [[nodiscard]] std::span<uint8_t> backing() override;
+
     std::ostream& print_state(std::ostream& os) const override;
 };
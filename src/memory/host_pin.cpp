@@ -0,0 +1,97 @@
+#include "host_pin.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <cstdint>
+
+#include <sys/mman.h>
+
+namespace {
+    struct registry {
+        std::mutex lock;
+
+        /* One entry per pinned range, the same range may be pinned several times */
+        std::vector<iovec> pins;
+
+        /* Released while pinned */
+        std::vector<iovec> placeholders;
+    };
+
+    [[nodiscard]] registry& pins() {
+        static registry reg;
+        return reg;
+    }
+
+    [[nodiscard]] bool overlaps(const iovec& range, const void* addr, size_t size) {
+        auto begin = static_cast<const uint8_t*>(range.iov_base);
+        auto start = static_cast<const uint8_t*>(addr);
+        return begin < (start + size) && start < (begin + range.iov_len);
+    }
+
+    [[nodiscard]] bool any_overlaps(const std::vector<iovec>& ranges, const void* addr, size_t size) {
+        return std::ranges::any_of(ranges, [&](const iovec& range) { return overlaps(range, addr, size); });
+    }
+}
+
+host_pin::host_pin(std::span<const iovec> ranges) : _ranges(ranges.begin(), ranges.end()) {
+    if (_ranges.empty()) {
+        return;
+    }
+
+    auto& reg = pins();
+    std::scoped_lock lock { reg.lock };
+    reg.pins.insert(reg.pins.end(), _ranges.begin(), _ranges.end());
+}
+
+host_pin::~host_pin() {
+    if (_ranges.empty()) {
+        return;
+    }
+
+    auto& reg = pins();
+    std::scoped_lock lock { reg.lock };
+
+    for (const auto& range : _ranges) {
+        auto it = std::ranges::find_if(reg.pins, [&](const iovec& pin) {
+            return pin.iov_base == range.iov_base && pin.iov_len == range.iov_len;
+        });
+
+        if (it != reg.pins.end()) {
+            reg.pins.erase(it);
+        }
+    }
+
+    std::erase_if(reg.placeholders, [&](const iovec& placeholder) {
+        if (any_overlaps(reg.pins, placeholder.iov_base, placeholder.iov_len)) {
+            return false;
+        }
+
+        munmap(placeholder.iov_base, placeholder.iov_len);
+        return true;
+    });
+}
+
+bool host_pin::pinned(const void* addr, size_t size) {
+    auto& reg = pins();
+    std::scoped_lock lock { reg.lock };
+    return any_overlaps(reg.pins, addr, size);
+}
+
+void host_pin::release(void* addr, size_t size) {
+    auto& reg = pins();
+    std::scoped_lock lock { reg.lock };
+
+    if (!any_overlaps(reg.pins, addr, size)) {
+        munmap(addr, size);
+        return;
+    }
+
+    /* MAP_FIXED replaces the pages in one step, nothing else can be mapped there in between */
+    void* res = mmap(addr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+    if (res == MAP_FAILED) {
+        munmap(addr, size);
+        return;
+    }
+
+    reg.placeholders.push_back(iovec { .iov_base = addr, .iov_len = size });
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstddef>
+
+#include <sys/uio.h>
+
+/* Keeps host pages around for calls that use them outside a safe point.
+ *
+ * Guest memory only changes while every running guest thread is stopped, but
+ * a thread blocked in the host, say in a read() into a guest buffer, isn't.
+ * Pages released while pinned are replaced by an inaccessible placeholder
+ * rather than handed back to the host, so a late access faults instead of
+ * landing in whatever reuses the address. The placeholder goes with the last
+ * pin on it.
+ */
+class host_pin {
+    std::vector<iovec> _ranges;
+
+    public:
+    explicit host_pin(std::span<const iovec> ranges);
+    ~host_pin();
+
+    host_pin(const host_pin&) = delete;
+    host_pin& operator=(const host_pin&) = delete;
+
+    /* Whether any part of [addr, addr + size) is pinned */
+    [[nodiscard]] static bool pinned(const void* addr, size_t size);
+
+    /* Unmap host pages, or leave a placeholder until they're no longer pinned */
+    static void release(void* addr, size_t size);
+};
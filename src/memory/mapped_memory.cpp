@@ -0,0 +1,253 @@
+#include "mapped_memory.hpp"
+#include "host_pin.hpp"
+
+#include <system_error>
+#include <utility>
+
+#include <sys/mman.h>
+
+#include <fmt/ostream.h>
+
+#include <magic_enum.hpp>
+
+using namespace magic_enum::bitwise_operators;
+
+namespace {
+    /* Emulator accesses always need host read access, write access mirrors the guest */
+    [[nodiscard]] int host_protection(mapped_memory::permissions perms) {
+        int prot = PROT_NONE;
+
+        if (magic_enum::enum_integer(perms) != 0) {
+            prot |= PROT_READ;
+        }
+
+        if ((perms & mapped_memory::permissions::W) == mapped_memory::permissions::W) {
+            prot |= PROT_WRITE;
+        }
+
+        return prot;
+    }
+}
+
+mapped_memory::mapped_memory(std::endian endian, permissions perms, uintptr_t vaddr, size_t size,
+    bool shared, uint8_t* data, std::string_view tag)
+    : memory(endian, tag), perms { perms }, base_addr { vaddr }, mapped_size { size }
+    , shared { shared }, data { data } {
+
+}
+
+mapped_memory::mapped_memory(std::endian endian, permissions perms, uintptr_t vaddr, size_t size,
+    int fd, off_t offset, bool shared, std::string_view tag)
+    : memory(endian, tag), perms { perms }, base_addr { vaddr }, mapped_size { size }
+    , shared { shared }, data { nullptr } {
+
+    int flags = shared ? MAP_SHARED : MAP_PRIVATE;
+    if (fd < 0) {
+        flags |= MAP_ANONYMOUS | MAP_NORESERVE;
+    }
+
+    void* addr = mmap(nullptr, mapped_size, host_protection(perms), flags, fd, offset);
+
+    if (addr == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "mmap");
+    }
+
+    data = static_cast<uint8_t*>(addr);
+}
+
+mapped_memory::~mapped_memory() {
+    if (data) {
+        host_pin::release(data, mapped_size);
+    }
+}
+
+mapped_memory::mapped_memory(mapped_memory&& other) noexcept
+    : memory(std::move(other)), perms { other.perms }, base_addr { other.base_addr }
+    , mapped_size { std::exchange(other.mapped_size, 0) }, shared { other.shared }
+    , data { std::exchange(other.data, nullptr) } {
+
+}
+
+mapped_memory& mapped_memory::operator=(mapped_memory&& other) noexcept {
+    if (this != &other) {
+        if (data) {
+            host_pin::release(data, mapped_size);
+        }
+
+        memory::operator=(std::move(other));
+        perms = other.perms;
+        base_addr = other.base_addr;
+        mapped_size = std::exchange(other.mapped_size, 0);
+        shared = other.shared;
+        data = std::exchange(other.data, nullptr);
+    }
+
+    return *this;
+}
+
+void mapped_memory::access_check(uintptr_t addr, size_t size, permissions perms) {
+    if (addr < base_addr || (addr - base_addr) + size > mapped_size || (perms & this->perms) != perms) {
+        switch (perms) {
+            case permissions::R:
+                throw invalid_read(addr, size);
+
+            case permissions::W:
+                throw invalid_write(addr, size);
+
+            default:
+                throw illegal_access("illegal flags for access at {:#x}: {:#x}", addr, magic_enum::enum_integer(perms));
+        }
+    }
+}
+
+uintptr_t mapped_memory::base() const {
+    return base_addr;
+}
+
+size_t mapped_memory::size() const {
+    return mapped_size;
+}
+
+mapped_memory::permissions mapped_memory::protection() const {
+    return perms;
+}
+
+std::unique_ptr<mapped_memory> mapped_memory::split(uintptr_t addr) {
+    if (addr <= base_addr || addr >= (base_addr + mapped_size)) {
+        throw illegal_access("cannot split mapping [{:#x}, {:#x}) at {:#x}", base_addr, base_addr + mapped_size, addr);
+    }
+
+    size_t offset = addr - base_addr;
+
+    /* Host mappings can be partially unmapped, so each half simply owns part of the original */
+    std::unique_ptr<mapped_memory> tail {
+        new mapped_memory(byte_order(), perms, addr, mapped_size - offset, shared, data + offset, tag())
+    };
+
+    mapped_size = offset;
+
+    return tail;
+}
+
+void mapped_memory::protect(permissions perms) {
+    if (mprotect(data, mapped_size, host_protection(perms)) != 0) {
+        throw std::system_error(errno, std::generic_category(), "mprotect");
+    }
+
+    this->perms = perms;
+}
+
+void mapped_memory::relocate(size_t new_size) {
+    void* addr;
+
+    if (shared) {
+        /* A second view of the same pages */
+        addr = mremap(data, 0, new_size, MREMAP_MAYMOVE);
+    } else {
+        addr = mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+        if (addr != MAP_FAILED) {
+            if (host_protection(perms) == PROT_NONE) {
+                mprotect(data, mapped_size, PROT_READ);
+            }
+
+            std::copy_n(data, std::min(mapped_size, new_size), static_cast<uint8_t*>(addr));
+            mprotect(addr, new_size, host_protection(perms));
+        }
+    }
+
+    if (addr == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "mremap");
+    }
+
+    host_pin::release(data, mapped_size);
+
+    data = static_cast<uint8_t*>(addr);
+    mapped_size = new_size;
+}
+
+void mapped_memory::remap(uintptr_t new_base, size_t new_size) {
+    if (new_size < mapped_size) {
+        /* Same as shrinking with mremap, unless the tail is still in use */
+        host_pin::release(data + new_size, mapped_size - new_size);
+        mapped_size = new_size;
+    } else if (new_size > mapped_size) {
+        if (host_pin::pinned(data, mapped_size)) {
+            /* mremap would free the old pages under a blocked host call */
+            relocate(new_size);
+        } else if (void* addr = mremap(data, mapped_size, new_size, MREMAP_MAYMOVE); addr != MAP_FAILED) {
+            data = static_cast<uint8_t*>(addr);
+            mapped_size = new_size;
+        } else if (errno == EFAULT && !shared) {
+            /* Spans several host mappings, like a region restored from a snapshot with file pages mapped into it */
+            relocate(new_size);
+        } else {
+            throw std::system_error(errno, std::generic_category(), "mremap");
+        }
+    }
+
+    base_addr = new_base;
+}
+
+bool mapped_memory::contains(uintptr_t addr) const {
+    return (addr >= base_addr) && (addr < (base_addr + mapped_size));
+}
+
+uint8_t mapped_memory::read_byte(uintptr_t addr) {
+    return read_data<uint8_t>(addr);
+}
+
+uint16_t mapped_memory::read_half(uintptr_t addr) {
+    return read_data<uint16_t>(addr);
+}
+
+uint32_t mapped_memory::read_word(uintptr_t addr) {
+    return read_data<uint32_t>(addr);
+}
+
+uint64_t mapped_memory::read_dword(uintptr_t addr) {
+    return read_data<uint64_t>(addr);
+}
+
+memory& mapped_memory::write_byte(uintptr_t addr, uint8_t val) {
+    return write_data<uint8_t>(addr, val);
+}
+
+memory& mapped_memory::write_half(uintptr_t addr, uint16_t val) {
+    return write_data<uint16_t>(addr, val);
+}
+
+memory& mapped_memory::write_word(uintptr_t addr, uint32_t val) {
+    return write_data<uint32_t>(addr, val);
+}
+
+memory& mapped_memory::write_dword(uintptr_t addr, uint64_t val) {
+    return write_data<uint64_t>(addr, val);
+}
+
+void mapped_memory::read_block(uintptr_t addr, std::span<uint8_t> dest) {
+    access_check(addr, dest.size(), permissions::R);
+    std::copy_n(&data[addr - base_addr], dest.size(), dest.data());
+}
+
+memory& mapped_memory::write_block(uintptr_t addr, std::span<const uint8_t> src) {
+    access_check(addr, src.size(), permissions::W);
+    std::ranges::copy(src, &data[addr - base_addr]);
+    return *this;
+}
+
+std::span<uint8_t> mapped_memory::translate(uintptr_t addr, size_t size, access op) {
+    access_check(addr, size, (op == access::read) ? permissions::R : permissions::W);
+    return { &data[addr - base_addr], size };
+}
+
+std::span<uint8_t> mapped_memory::backing() {
+    return { data, mapped_size };
+}
+
+std::ostream& mapped_memory::print_state(std::ostream& os) const {
+    fmt::print(os, "[{} mapped memory, tag={}, base={:#x}, size={}, perms={:#x}, {}]",
+        (byte_order() == std::endian::little) ? "little-endian" : "big-endian",
+        tag(), base_addr, mapped_size, magic_enum::enum_integer(perms), shared ? "shared" : "private");
+    return os;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "memory.hpp"
+#include "memory_backed_memory.hpp"
+
+#include <algorithm>
+
+#include <sys/types.h>
+
+/* Guest memory backed directly by a host mapping, as created by a guest's mmap.
+ *
+ * The host mapping mirrors the guest's protection, so accesses are checked in
+ * software like memory_backed_memory and the host enforces it as well.
+ */
+class mapped_memory : public memory {
+    public:
+    using permissions = memory_backed_memory::permissions;
+
+    protected:
+    permissions perms;
+    uintptr_t base_addr;
+    size_t mapped_size;
+    bool shared;
+
+    uint8_t* data;
+
+    /* Take ownership of an existing host mapping */
+    mapped_memory(std::endian endian, permissions perms, uintptr_t vaddr, size_t size,
+        bool shared, uint8_t* data, std::string_view tag);
+
+    void access_check(uintptr_t addr, size_t size, permissions perms);
+
+    /* Move to a new host mapping of new_size by copying, leaving the old pages to host_pin */
+    void relocate(size_t new_size);
+
+    template <std::unsigned_integral T>
+    T read_data(uintptr_t addr) {
+        access_check(addr, sizeof(T), permissions::R);
+
+        if constexpr (sizeof(T) == 1) {
+            return static_cast<T>(data[addr - base_addr]);
+        } else {
+            uint8_t buf[sizeof(T)];
+            std::copy_n(&data[addr - base_addr], sizeof(T), buf);
+
+            if (byte_order() == std::endian::native) {
+                return std::bit_cast<T>(buf);
+            } else {
+                return std::byteswap(std::bit_cast<T>(buf));
+            }
+        }
+    }
+
+    template <std::unsigned_integral T>
+    memory& write_data(uintptr_t addr, T val) {
+        access_check(addr, sizeof(T), permissions::W);
+
+        if constexpr (sizeof(T) == 1) {
+            data[addr - base_addr] = val;
+        } else {
+            if (byte_order() != std::endian::native) {
+                val = std::byteswap(val);
+            }
+
+            std::copy_n(reinterpret_cast<uint8_t*>(&val), sizeof(T), &data[addr - base_addr]);
+        }
+        return *this;
+    }
+
+    public:
+    /* Anonymous mapping if fd is negative, else a mapping of fd at offset */
+    mapped_memory(std::endian endian, permissions perms, uintptr_t vaddr, size_t size,
+        int fd = -1, off_t offset = 0, bool shared = false, std::string_view tag = "mmap");
+
+    ~mapped_memory() override;
+
+    mapped_memory(const mapped_memory&) = delete;
+    mapped_memory& operator=(const mapped_memory&) = delete;
+
+    mapped_memory(mapped_memory&& other) noexcept;
+    mapped_memory& operator=(mapped_memory&& other) noexcept;
+
+    [[nodiscard]] uintptr_t base() const override;
+    [[nodiscard]] size_t size() const override;
+    [[nodiscard]] permissions protection() const;
+
+    /* Split at addr, this keeps [base, addr) and returns [addr, end) without copying */
+    [[nodiscard]] std::unique_ptr<mapped_memory> split(uintptr_t addr);
+
+    /* Change the protection of the entire mapping */
+    void protect(permissions perms);
+
+    /* Move to a new guest address and size, the host mapping may move as well */
+    void remap(uintptr_t new_base, size_t new_size);
+
+    [[nodiscard]] bool contains(uintptr_t addr) const override;
+
+    [[nodiscard]] uint8_t read_byte(uintptr_t addr) override;
+    [[nodiscard]] uint16_t read_half(uintptr_t addr) override;
+    [[nodiscard]] uint32_t read_word(uintptr_t addr) override;
+    [[nodiscard]] uint64_t read_dword(uintptr_t addr) override;
+
+    memory& write_byte(uintptr_t addr, uint8_t val) override;
+    memory& write_half(uintptr_t addr, uint16_t val) override;
+    memory& write_word(uintptr_t addr, uint32_t val) override;
+    memory& write_dword(uintptr_t addr, uint64_t val) override;
+
+    void read_block(uintptr_t addr, std::span<uint8_t> dest) override;
+    memory& write_block(uintptr_t addr, std::span<const uint8_t> src) override;
+
+    [[nodiscard]] std::span<uint8_t> translate(uintptr_t addr, size_t size, access op) override;
+    [[nodiscard]] std::span<uint8_t> backing() override;
+
+    std::ostream& print_state(std::ostream& os) const override;
+};
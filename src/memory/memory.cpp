@@ -1,5 +1,7 @@
 #include "memory.hpp"
 
+#include <unistd.h>
+
 #include <fmt/format.h>
 #include <fmt/ostream.h>
 
@@ -9,6 +11,11 @@ invalid_read::invalid_read(uintptr_t addr, size_t size)
 invalid_write::invalid_write(uintptr_t addr, size_t size)
     : illegal_access("invalid write at {:#x} of size {}", addr, size) { }
 
+size_t host_page_size() {
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
 memory::memory(std::endian byte_order) : memory(byte_order, "unnamed") { }
 
 memory::memory(std::endian byte_order, std::string_view tag)
@@ -23,6 +30,28 @@ std::string_view memory::tag() const {
     return _tag;
 }
 
+void memory::read_block(uintptr_t addr, std::span<uint8_t> dest) {
+    for (uint8_t& byte : dest) {
+        byte = read_byte(addr++);
+    }
+}
+
+memory& memory::write_block(uintptr_t addr, std::span<const uint8_t> src) {
+    for (uint8_t byte : src) {
+        write_byte(addr++, byte);
+    }
+
+    return *this;
+}
+
+std::span<uint8_t> memory::translate([[maybe_unused]] uintptr_t addr, [[maybe_unused]] size_t size, [[maybe_unused]] access op) {
+    return {};
+}
+
+std::span<uint8_t> memory::backing() {
+    return {};
+}
+
 std::ostream& memory::print_state(std::ostream& os) const {
     fmt::print(os, "[{} memory, tag={}]", (_byte_order == std::endian::little) ? "little-endian" : "big-endian", _tag);
 
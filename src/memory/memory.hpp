@@ -6,6 +6,7 @@
 #include <stdexcept>
 #include <memory>
 #include <ranges>
+#include <span>
 #include <vector>
 #include <string_view>
 
@@ -33,11 +34,18 @@ class invalid_write : public illegal_access {
     invalid_write(uintptr_t addr, size_t size);
 };
 
+/* Granularity of host mappings, and so of everything that maps guest memory */
+[[nodiscard]] size_t host_page_size();
+
 /* Interface similar to rv64-emu */
 class memory {
     std::endian _byte_order;
     std::string _tag;
     public:
+    enum class access {
+        read, write
+    };
+
     virtual ~memory() = default;
 
     explicit memory(std::endian byte_order);
@@ -46,6 +54,10 @@ class memory {
     [[nodiscard]] std::endian byte_order() const;
     [[nodiscard]] std::string_view tag() const;
 
+    /* Guest address range covered by this memory */
+    [[nodiscard]] virtual uintptr_t base() const = 0;
+    [[nodiscard]] virtual size_t size() const = 0;
+
     [[nodiscard]] virtual bool contains(uintptr_t addr) const = 0;
 
     [[nodiscard]] virtual uint8_t read_byte(uintptr_t addr) = 0;
@@ -58,6 +70,18 @@ class memory {
     virtual memory& write_word(uintptr_t addr, uint32_t val) = 0;
     virtual memory& write_dword(uintptr_t addr, uint64_t val) = 0;
 
+    /* Bulk copies of raw bytes, no byte order conversion is done.
+     * The default implementations go byte-by-byte, regions backed by host memory do a single copy.
+     */
+    virtual void read_block(uintptr_t addr, std::span<uint8_t> dest);
+    virtual memory& write_block(uintptr_t addr, std::span<const uint8_t> src);
+
+    /* Host memory backing [addr, addr + size), empty if it's not contiguous in host memory */
+    [[nodiscard]] virtual std::span<uint8_t> translate(uintptr_t addr, size_t size, access op);
+
+    /* Host memory backing the whole region regardless of its protection, empty if there is none */
+    [[nodiscard]] virtual std::span<uint8_t> backing();
+
     virtual std::ostream& print_state(std::ostream& os) const;
 };
 
@@ -1,6 +1,9 @@
 #include "memory_backed_memory.hpp"
 
 #include <bit>
+#include <system_error>
+
+#include <sys/mman.h>
 
 #include <fmt/ostream.h>
 
@@ -13,13 +16,7 @@ void memory_backed_memory::access_check(uintptr_t addr, size_t size, permissions
         throw illegal_access("illegal flags for access at {:#x}: {:#x}", addr, magic_enum::enum_integer(perms));
     }
 
-    bool contained = true;
-    for (size_t i = 0; i < size; ++i) {
-        if (!contains(addr + i)) {
-            contained = false;
-            break;
-        }
-    }
+    bool contained = (addr >= base_addr) && (addr - base_addr) + size <= mapped_size;
 
     if (contained) {
         if ((perms & this->perms) != perms) {
@@ -53,11 +50,35 @@ memory_backed_memory::memory_backed_memory(
     std::align_val_t alignment, std::span<uint8_t> data, std::string_view tag)
     : memory(endian, tag)
     , perms { perms }, base_addr { vaddr }, mapped_size { memsize }, alignment { alignment }
-    , data(new (alignment) uint8_t[mapped_size], alignment) {
+    , data { allocate(mapped_size, alignment) } {
     
-    /* Copy supplied memory and pad with zeroes */
+    /* Copy supplied memory and pad with zeroes, a mapping already is */
     std::ranges::copy(data, this->data.get());
-    std::fill_n(this->data.get() + data.size(), mapped_size - data.size(), 0);
+
+    if (!this->data.get_deleter().mapped) {
+        std::fill_n(this->data.get() + data.size(), mapped_size - data.size(), 0);
+    }
+}
+
+void memory_backed_memory::release::operator()(uint8_t* ptr) const {
+    if (mapped) {
+        munmap(ptr, size);
+    } else {
+        operator delete[](ptr, alignment);
+    }
+}
+
+std::unique_ptr<uint8_t[], memory_backed_memory::release> memory_backed_memory::allocate(size_t size, std::align_val_t alignment) {
+    if (size == 0 || static_cast<size_t>(alignment) > host_page_size()) {
+        return { new (alignment) uint8_t[size], release { size, alignment, false } };
+    }
+
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (addr == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "mmap");
+    }
+
+    return { static_cast<uint8_t*>(addr), release { size, alignment, true } };
 }
 
 uintptr_t memory_backed_memory::base() const {
@@ -68,6 +89,10 @@ size_t memory_backed_memory::size() const {
     return mapped_size;
 }
 
+memory_backed_memory::permissions memory_backed_memory::protection() const {
+    return perms;
+}
+
 bool memory_backed_memory::contains(uintptr_t addr) const {
     return (addr >= base_addr) && (addr < (base_addr + mapped_size));
 }
@@ -104,6 +129,26 @@ memory& memory_backed_memory::write_dword(uintptr_t addr, uint64_t val) {
     return write_data<uint64_t>(addr, val);
 }
 
+void memory_backed_memory::read_block(uintptr_t addr, std::span<uint8_t> dest) {
+    access_check(addr, dest.size(), permissions::R);
+    std::copy_n(&data[addr - base_addr], dest.size(), dest.data());
+}
+
+memory& memory_backed_memory::write_block(uintptr_t addr, std::span<const uint8_t> src) {
+    access_check(addr, src.size(), permissions::W);
+    std::ranges::copy(src, &data[addr - base_addr]);
+    return *this;
+}
+
+std::span<uint8_t> memory_backed_memory::translate(uintptr_t addr, size_t size, access op) {
+    access_check(addr, size, (op == access::read) ? permissions::R : permissions::W);
+    return { &data[addr - base_addr], size };
+}
+
+std::span<uint8_t> memory_backed_memory::backing() {
+    return { data.get(), mapped_size };
+}
+
 std::ostream& memory_backed_memory::print_state(std::ostream& os) const {
     fmt::print(os, "[{} memory-backed memory, tag={}, base={:#x}, size={}, alignment={}]",
         (byte_order() == std::endian::little) ? "little-endian" : "big-endian",
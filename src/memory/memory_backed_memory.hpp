@@ -18,7 +18,18 @@ class memory_backed_memory : public memory {
     size_t mapped_size;
     std::align_val_t alignment;
 
-    aligned_unique_ptr<uint8_t[]> data;
+    /* Page aligned memory is an anonymous mapping, it starts out zeroed and is only backed once touched */
+    struct release {
+        size_t size;
+        std::align_val_t alignment;
+        bool mapped;
+
+        void operator()(uint8_t* ptr) const;
+    };
+
+    std::unique_ptr<uint8_t[], release> data;
+
+    [[nodiscard]] static std::unique_ptr<uint8_t[], release> allocate(size_t size, std::align_val_t alignment);
 
     void access_check(uintptr_t addr, size_t size, permissions perms);
 
@@ -67,8 +78,9 @@ class memory_backed_memory : public memory {
     memory_backed_memory(memory_backed_memory&& other) noexcept = default;
     memory_backed_memory& operator=(memory_backed_memory&& other) noexcept = default;
 
-    [[nodiscard]] uintptr_t base() const;
-    [[nodiscard]] size_t size() const;
+    [[nodiscard]] uintptr_t base() const override;
+    [[nodiscard]] size_t size() const override;
+    [[nodiscard]] permissions protection() const;
 
     [[nodiscard]] bool contains(uintptr_t addr) const override;
 
@@ -82,5 +94,11 @@ class memory_backed_memory : public memory {
     memory& write_word(uintptr_t addr, uint32_t val) override;
     memory& write_dword(uintptr_t addr, uint64_t val) override;
 
+    void read_block(uintptr_t addr, std::span<uint8_t> dest) override;
+    memory& write_block(uintptr_t addr, std::span<const uint8_t> src) override;
+
+    [[nodiscard]] std::span<uint8_t> translate(uintptr_t addr, size_t size, access op) override;
+    [[nodiscard]] std::span<uint8_t> backing() override;
+
     std::ostream& print_state(std::ostream& os) const override;
 };
@@ -0,0 +1,125 @@
+#include "region_allocator.hpp"
+
+#include <algorithm>
+
+#include <fmt/ostream.h>
+
+region_allocator::region_allocator(uintptr_t start, uintptr_t end) {
+    if (end > start) {
+        _insert(start, end);
+    }
+}
+
+void region_allocator::_insert(uintptr_t start, uintptr_t end) {
+    _by_addr.emplace(start, end);
+    _by_size.emplace(end - start, start);
+}
+
+void region_allocator::_erase(std::map<uintptr_t, uintptr_t>::iterator it) {
+    _by_size.erase({ it->second - it->first, it->first });
+    _by_addr.erase(it);
+}
+
+bool region_allocator::reserve(uintptr_t start, size_t size) {
+    if (size == 0) {
+        return true;
+    }
+
+    /* Hole containing start */
+    auto it = _by_addr.upper_bound(start);
+    if (it == _by_addr.begin()) {
+        return false;
+    }
+
+    --it;
+
+    auto [hole_start, hole_end] = *it;
+    uintptr_t end = start + size;
+    if (end > hole_end || end < start) {
+        return false;
+    }
+
+    _erase(it);
+
+    if (hole_start != start) {
+        _insert(hole_start, start);
+    }
+
+    if (end != hole_end) {
+        _insert(end, hole_end);
+    }
+
+    return true;
+}
+
+std::optional<uintptr_t> region_allocator::allocate(size_t size) {
+    if (size == 0) {
+        return std::nullopt;
+    }
+
+    auto fit = _by_size.lower_bound({ size, 0 });
+    if (fit == _by_size.end()) {
+        return std::nullopt;
+    }
+
+    /* Take it from the top, growing down like a regular mmap base, away from the heap */
+    uintptr_t start = fit->second + fit->first - size;
+
+    if (!reserve(start, size)) {
+        return std::nullopt;
+    }
+
+    return start;
+}
+
+void region_allocator::release(uintptr_t start, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    uintptr_t end = start + size;
+
+    /* Absorb any hole that overlaps or touches the released range */
+    auto it = _by_addr.upper_bound(start);
+    if (it != _by_addr.begin() && std::prev(it)->second >= start) {
+        --it;
+    }
+
+    while (it != _by_addr.end() && it->first <= end) {
+        start = std::min(start, it->first);
+        end = std::max(end, it->second);
+
+        auto next = std::next(it);
+        _erase(it);
+        it = next;
+    }
+
+    _insert(start, end);
+}
+
+bool region_allocator::is_free(uintptr_t start, size_t size) const {
+    auto it = _by_addr.upper_bound(start);
+    if (it == _by_addr.begin()) {
+        return false;
+    }
+
+    --it;
+
+    return (start + size) <= it->second;
+}
+
+const std::map<uintptr_t, uintptr_t>& region_allocator::holes() const {
+    return _by_addr;
+}
+
+std::ostream& region_allocator::print_state(std::ostream& os) const {
+    fmt::print(os, "Memory holes: ");
+
+    for (auto it = _by_addr.begin(); it != _by_addr.end(); ++it) {
+        fmt::print(os, "[{:#x}, {:#x}]{}", it->first, it->second, (std::next(it) == _by_addr.end()) ? "" : ", ");
+    }
+
+    fmt::print(os, "\n");
+
+    return os;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <optional>
+#include <ostream>
+
+/* Tracks the free parts of a guest address space.
+ *
+ * Free ranges are indexed both by address and by size, so lookups,
+ * allocations and releases are all logarithmic in the number of holes.
+ */
+class region_allocator {
+    /* start -> end */
+    std::map<uintptr_t, uintptr_t> _by_addr;
+
+    /* (size, start), ordered by size */
+    std::set<std::pair<size_t, uintptr_t>> _by_size;
+
+    void _insert(uintptr_t start, uintptr_t end);
+    void _erase(std::map<uintptr_t, uintptr_t>::iterator it);
+
+    public:
+    region_allocator() = default;
+    region_allocator(uintptr_t start, uintptr_t end);
+
+    /* Mark a specific range as used, fails if any part of it is not free */
+    [[nodiscard]] bool reserve(uintptr_t start, size_t size);
+
+    /* Find and reserve a free range, taken from the top of the smallest hole that fits */
+    [[nodiscard]] std::optional<uintptr_t> allocate(size_t size);
+
+    /* Return a range, parts that are already free are ignored */
+    void release(uintptr_t start, size_t size);
+
+    [[nodiscard]] bool is_free(uintptr_t start, size_t size) const;
+
+    [[nodiscard]] const std::map<uintptr_t, uintptr_t>& holes() const;
+
+    std::ostream& print_state(std::ostream& os) const;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const region_allocator& alloc) {
+    return alloc.print_state(os);
+}
@@ -1,5 +1,8 @@
 #include "virtual_memory.hpp"
 
+#include <algorithm>
+#include <ranges>
+
 #include <fmt/ostream.h>
 
 #include <magic_enum.hpp>
@@ -11,21 +14,152 @@ virtual_memory::virtual_memory(std::endian endian, std::string_view name)
 
 }
 
+memory* virtual_memory::_find(uintptr_t addr) const {
+    /* Last region starting at or before addr */
+    auto it = _bank.upper_bound(addr);
+    if (it == _bank.begin()) {
+        return nullptr;
+    }
+
+    --it;
+
+    memory* mem = it->second.mem.get();
+    return mem->contains(addr) ? mem : nullptr;
+}
+
+std::vector<virtual_memory::map_type::iterator> virtual_memory::_overlapping(uintptr_t addr, size_t size) {
+    std::vector<map_type::iterator> res;
+
+    auto it = _bank.upper_bound(addr);
+    if (it != _bank.begin() && std::prev(it)->second.mem->contains(addr)) {
+        --it;
+    }
+
+    for (; it != _bank.end() && it->first < (addr + size); ++it) {
+        if (it->second.mem->size() > 0) {
+            res.push_back(it);
+        }
+    }
+
+    return res;
+}
+
+void virtual_memory::_split(uintptr_t addr) {
+    auto it = _bank.upper_bound(addr);
+    if (it == _bank.begin()) {
+        return;
+    }
+
+    --it;
+
+    auto& [kind, mem] = it->second;
+    if (it->first == addr || !mem->contains(addr)) {
+        /* Already a boundary */
+        return;
+    }
+
+    if (auto mapped = dynamic_cast<mapped_memory*>(mem.get())) {
+        _bank.emplace(addr, region { .kind = kind, .mem = mapped->split(addr) });
+    }
+}
+
 void virtual_memory::add(role role, std::unique_ptr<memory> mem) {
     if (mem->byte_order() != this->byte_order()) {
         throw std::invalid_argument("endianness mismatch");
     }
 
-    _bank.insert({role, std::move(mem)});
+    if (mem->size() > 0 && overlaps(mem->base(), mem->size())) {
+        throw std::invalid_argument(fmt::format("region at {:#x} overlaps existing memory", mem->base()));
+    }
+
+    /* An empty region, like the heap before it grows, still takes its base */
+    uintptr_t base = mem->base();
+    if (!_bank.emplace(base, region { .kind = role, .mem = std::move(mem) }).second) {
+        throw std::invalid_argument(fmt::format("a region already starts at {:#x}", base));
+    }
 }
 
-memory& virtual_memory::get(uintptr_t addr, size_t size, operation op) const {
-    for (auto& [k, mem] : _bank) {
-        if (mem->contains(addr)) {
-            return *mem;
+void virtual_memory::unmap(uintptr_t addr, size_t size) {
+    auto regions = _overlapping(addr, size);
+
+    /* Validate everything first so a failure leaves the mappings intact */
+    for (auto it : regions) {
+        if (!dynamic_cast<mapped_memory*>(it->second.mem.get())) {
+            throw illegal_access("cannot unmap fixed memory {} at {:#x}", it->second.mem->tag(), it->first);
+        }
+    }
+
+    _split(addr);
+    _split(addr + size);
+
+    for (auto it = _bank.lower_bound(addr); it != _bank.end() && it->first < (addr + size);) {
+        if (dynamic_cast<mapped_memory*>(it->second.mem.get())) {
+            it = _bank.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void virtual_memory::protect(uintptr_t addr, size_t size, mapped_memory::permissions perms) {
+    _split(addr);
+    _split(addr + size);
+
+    for (auto it : _overlapping(addr, size)) {
+        /* Fixed regions (ELF segments, stack) keep their original permissions */
+        if (auto mapped = dynamic_cast<mapped_memory*>(it->second.mem.get())) {
+            mapped->protect(perms);
+        }
+    }
+}
+
+void virtual_memory::remap(uintptr_t old_addr, size_t old_size, uintptr_t new_addr, size_t new_size) {
+    /* Like Linux, the old range has to lie within a single mapping */
+    auto old = dynamic_cast<mapped_memory*>(_find(old_addr));
+    if (!old || old_size == 0 || !old->contains(old_addr + old_size - 1)) {
+        throw illegal_access("no mapping covers [{:#x}, {:#x}) to remap", old_addr, old_addr + old_size);
+    }
+
+    /* Only the requested part is moved */
+    _split(old_addr);
+    _split(old_addr + old_size);
+
+    auto node = _bank.extract(old_addr);
+    auto& mapped = static_cast<mapped_memory&>(*node.mapped().mem);
+
+    /* With the old range out of the bank this also checks the tail when growing in place */
+    if (overlaps(new_addr, new_size)) {
+        _bank.insert(std::move(node));
+        throw illegal_access("remap target [{:#x}, {:#x}) is not free", new_addr, new_addr + new_size);
+    }
+
+    mapped.remap(new_addr, new_size);
+
+    node.key() = new_addr;
+    _bank.insert(std::move(node));
+}
+
+bool virtual_memory::overlaps(uintptr_t addr, size_t size) const {
+    auto it = _bank.upper_bound(addr);
+    if (it != _bank.begin()) {
+        auto prev = std::prev(it);
+        if (prev->first + prev->second.mem->size() > addr) {
+            return true;
         }
     }
 
+    return it != _bank.end() && it->first < (addr + size);
+}
+
+const virtual_memory::map_type& virtual_memory::regions() const {
+    return _bank;
+}
+
+memory& virtual_memory::get(uintptr_t addr, size_t size, operation op) const {
+    if (memory* mem = _find(addr)) {
+        return *mem;
+    }
+
     switch (op) {
         case operation::read:
             throw invalid_read(addr, size);
@@ -37,24 +171,29 @@ memory& virtual_memory::get(uintptr_t addr, size_t size, operation op) const {
 }
 
 std::vector<std::reference_wrapper<memory>> virtual_memory::get(role role) const {
-    auto range = _bank.equal_range(role);
     std::vector<std::reference_wrapper<memory>> res;
 
-    for (auto it = range.first; it != range.second; ++it) {
-        res.push_back(*it->second);
+    for (const auto& [base, region] : _bank) {
+        if (region.kind == role) {
+            res.push_back(*region.mem);
+        }
     }
 
     return res;
 }
 
 memory& virtual_memory::get_first(role role) const {
-    auto range = _bank.equal_range(role);
+    for (const auto& [base, region] : _bank) {
+        if (region.kind == role) {
+            return *region.mem;
+        }
+    }
 
-    return *range.first->second;
+    throw std::out_of_range(fmt::format("no memory with role {}", magic_enum::enum_name(role)));
 }
 
 size_t virtual_memory::count(role role) const {
-    return _bank.count(role);
+    return std::ranges::count(_bank | std::views::values, role, &region::kind);
 }
 
 size_t virtual_memory::bytes_read() const {
@@ -65,63 +204,156 @@ size_t virtual_memory::bytes_written() const {
     return _written;
 }
 
-bool virtual_memory::contains(uintptr_t addr) const {
-    for (const auto& [k, mem] : _bank) {
-        if (mem->contains(addr)) {
-            return true;
-        }
+uintptr_t virtual_memory::base() const {
+    return _bank.empty() ? 0 : _bank.begin()->first;
+}
+
+size_t virtual_memory::size() const {
+    if (_bank.empty()) {
+        return 0;
     }
 
-    return false;
+    const auto& [last_base, last] = *_bank.rbegin();
+    return (last_base + last.mem->size()) - base();
+}
+
+bool virtual_memory::contains(uintptr_t addr) const {
+    return _find(addr) != nullptr;
 }
 
 uint8_t virtual_memory::read_byte(uintptr_t addr) {
-    _read += 1;
+    _count(_read, 1);
     return get(addr, 1, operation::read).read_byte(addr);
 }
 
 uint16_t virtual_memory::read_half(uintptr_t addr) {
-    _read += 2;
+    _count(_read, 2);
     return get(addr, 2, operation::read).read_half(addr);
 }
 
 uint32_t virtual_memory::read_word(uintptr_t addr) {
-    _read += 4;
+    _count(_read, 4);
     return get(addr, 4, operation::read).read_word(addr);
 }
 
 uint64_t virtual_memory::read_dword(uintptr_t addr) {
-    _read += 8;
+    _count(_read, 8);
     return get(addr, 8, operation::read).read_dword(addr);
 }
 
 memory& virtual_memory::write_byte(uintptr_t addr, uint8_t val) {
-    _written += 1;
+    _count(_written, 1);
     return get(addr, 1, operation::write).write_byte(addr, val);
 }
 
 memory& virtual_memory::write_half(uintptr_t addr, uint16_t val) {
-    _written += 2;
+    _count(_written, 2);
     return get(addr, 2, operation::write).write_half(addr, val);
 }
 
 memory& virtual_memory::write_word(uintptr_t addr, uint32_t val) {
-    _written += 4;
+    _count(_written, 4);
     return get(addr, 4, operation::write).write_word(addr, val);
 }
 
 memory& virtual_memory::write_dword(uintptr_t addr, uint64_t val) {
-    _written += 8;
+    _count(_written, 8);
     return get(addr, 8, operation::write).write_dword(addr, val);
 }
 
+void virtual_memory::read_block(uintptr_t addr, std::span<uint8_t> dest) {
+    _count(_read, dest.size());
+
+    /* One copy per region the range spans */
+    while (!dest.empty()) {
+        memory& mem = get(addr, dest.size(), operation::read);
+        size_t count = std::min<size_t>(dest.size(), (mem.base() + mem.size()) - addr);
+
+        mem.read_block(addr, dest.first(count));
+
+        addr += count;
+        dest = dest.subspan(count);
+    }
+}
+
+memory& virtual_memory::write_block(uintptr_t addr, std::span<const uint8_t> src) {
+    _count(_written, src.size());
+
+    while (!src.empty()) {
+        memory& mem = get(addr, src.size(), operation::write);
+        size_t count = std::min<size_t>(src.size(), (mem.base() + mem.size()) - addr);
+
+        mem.write_block(addr, src.first(count));
+
+        addr += count;
+        src = src.subspan(count);
+    }
+
+    return *this;
+}
+
+std::span<uint8_t> virtual_memory::translate(uintptr_t addr, size_t size, access op) {
+    memory* mem = _find(addr);
+    if (!mem || (addr - mem->base()) + size > mem->size()) {
+        return {};
+    }
+
+    /* Assume the caller is going to transfer the entire range */
+    _count((op == access::read) ? _read : _written, size);
+
+    return mem->translate(addr, size, op);
+}
+
+void virtual_memory::translate_range(uintptr_t addr, size_t size, access op, std::vector<iovec>& out) {
+    _count((op == access::read) ? _read : _written, size);
+
+    while (size > 0) {
+        memory& mem = get(addr, size, (op == access::read) ? operation::read : operation::write);
+        size_t count = std::min<size_t>(size, (mem.base() + mem.size()) - addr);
+
+        auto host = mem.translate(addr, count, op);
+        if (host.empty()) {
+            if (op == access::read) {
+                throw invalid_read(addr, count);
+            } else {
+                throw invalid_write(addr, count);
+            }
+        }
+
+        /* Merge ranges that happen to be contiguous on the host as well */
+        if (!out.empty() && static_cast<uint8_t*>(out.back().iov_base) + out.back().iov_len == host.data()) {
+            out.back().iov_len += host.size();
+        } else {
+            out.push_back(iovec { .iov_base = host.data(), .iov_len = host.size() });
+        }
+
+        addr += count;
+        size -= count;
+    }
+}
+
+size_t virtual_memory::translate_iovec(uintptr_t iov_addr, size_t iov_count, access op, std::vector<iovec>& out) {
+    size_t total = 0;
+
+    for (size_t i = 0; i < iov_count; ++i) {
+        /* struct iovec is 2 dwords */
+        uintptr_t base = read_dword(iov_addr + (16 * i));
+        size_t len = read_dword(iov_addr + (16 * i) + 8);
+
+        translate_range(base, len, op, out);
+        total += len;
+    }
+
+    return total;
+}
+
 std::ostream& virtual_memory::print_state(std::ostream& os) const {
     fmt::print(os, "[{} virtual memory for \"{}\", bank size={}, read={}, written={}]\n",
         (byte_order() == std::endian::little) ? "little-endian" : "big-endian",
         tag(), _bank.size(), _read, _written);
 
-    for (const auto& [k, mem] : _bank) {
-        fmt::print(os, "  {}: {}\n", magic_enum::enum_name(k), fmt::streamed(*mem));
+    for (const auto& [base, region] : _bank) {
+        fmt::print(os, "  {}: {}\n", magic_enum::enum_name(region.kind), fmt::streamed(*region.mem));
     }
 
     return os;
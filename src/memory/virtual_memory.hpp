@@ -1,11 +1,15 @@
 #pragma once
 
 #include "memory.hpp"
+#include "mapped_memory.hpp"
 
 #include <vector>
 #include <map>
 #include <memory>
 #include <bit>
+#include <atomic>
+
+#include <sys/uio.h>
 
 class virtual_memory : public memory {
     public:
@@ -21,13 +25,36 @@ class virtual_memory : public memory {
         read, write, exec
     };
 
-    using map_type = std::multimap<role, std::unique_ptr<memory>>;
+    struct region {
+        role kind;
+        std::unique_ptr<memory> mem;
+    };
+
+    /* Regions ordered by their base address */
+    using map_type = std::map<uintptr_t, region>;
     private:
     map_type _bank;
 
     size_t _read;
     size_t _written;
 
+    /* The counters are statistics only, so concurrent guest threads may lose
+     * an update, but plain relaxed accesses keep the hot path free of locked instructions
+     */
+    static void _count(size_t& counter, size_t bytes) {
+        std::atomic_ref ref { counter };
+        ref.store(ref.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+    }
+
+    /* Region containing addr, or nullptr */
+    [[nodiscard]] memory* _find(uintptr_t addr) const;
+
+    /* All regions overlapping [addr, addr + size) */
+    [[nodiscard]] std::vector<map_type::iterator> _overlapping(uintptr_t addr, size_t size);
+
+    /* Split the mapped_memory containing addr so that a region starts at addr */
+    void _split(uintptr_t addr);
+
     public:
     explicit virtual_memory(std::endian endian, std::string_view name = "unknown");
 
@@ -44,6 +71,20 @@ class virtual_memory : public memory {
         add(role, std::make_unique<T>(std::forward<Args>(args)...));
     }
 
+    /* Remove [addr, addr + size), only mapped_memory regions can be unmapped */
+    void unmap(uintptr_t addr, size_t size);
+
+    /* Change protection of [addr, addr + size), fixed regions are left as-is */
+    void protect(uintptr_t addr, size_t size, mapped_memory::permissions perms);
+
+    /* Move and/or resize the mapping at [old_addr, old_addr + old_size) */
+    void remap(uintptr_t old_addr, size_t old_size, uintptr_t new_addr, size_t new_size);
+
+    /* Whether any part of [addr, addr + size) is occupied */
+    [[nodiscard]] bool overlaps(uintptr_t addr, size_t size) const;
+
+    [[nodiscard]] const map_type& regions() const;
+
     [[nodiscard]] memory& get(uintptr_t addr, size_t size, operation op) const;
     [[nodiscard]] std::vector<std::reference_wrapper<memory>> get(role role) const;
     [[nodiscard]] memory& get_first(role role) const;
@@ -53,6 +94,9 @@ class virtual_memory : public memory {
     [[nodiscard]] size_t bytes_read() const;
     [[nodiscard]] size_t bytes_written() const;
 
+    [[nodiscard]] uintptr_t base() const override;
+    [[nodiscard]] size_t size() const override;
+
     [[nodiscard]] bool contains(uintptr_t addr) const override;
 
     [[nodiscard]] uint8_t read_byte(uintptr_t addr) override;
@@ -65,5 +109,19 @@ class virtual_memory : public memory {
     memory& write_word(uintptr_t addr, uint32_t val) override;
     memory& write_dword(uintptr_t addr, uint64_t val) override;
 
+    void read_block(uintptr_t addr, std::span<uint8_t> dest) override;
+    memory& write_block(uintptr_t addr, std::span<const uint8_t> src) override;
+
+    /* Host span for a guest range, only non-empty if the range lies within a single region */
+    [[nodiscard]] std::span<uint8_t> translate(uintptr_t addr, size_t size, access op) override;
+
+    /* Append host iovecs covering [addr, addr + size) to out, one per region the range spans.
+     * op is the access made to guest memory, throws if any part of the range isn't accessible.
+     */
+    void translate_range(uintptr_t addr, size_t size, access op, std::vector<iovec>& out);
+
+    /* translate_range for every entry of a guest iovec array, returns the total size */
+    size_t translate_iovec(uintptr_t iov_addr, size_t iov_count, access op, std::vector<iovec>& out);
+
     std::ostream& print_state(std::ostream& os) const override;
 };
@@ -0,0 +1,80 @@
+#include "code_buffer.hpp"
+
+#include <system_error>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+code_buffer::code_buffer(size_t size) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    _size = (size + page - 1) & ~(page - 1);
+
+    _fd = memfd_create("specter-code", MFD_CLOEXEC);
+    if (_fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "memfd_create");
+    }
+
+    if (ftruncate(_fd, static_cast<off_t>(_size)) != 0) {
+        int err = errno;
+        close(_fd);
+        throw std::system_error(err, std::generic_category(), "ftruncate");
+    }
+
+    void* rw = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    void* rx = mmap(nullptr, _size, PROT_READ | PROT_EXEC, MAP_SHARED, _fd, 0);
+
+    if (rw == MAP_FAILED || rx == MAP_FAILED) {
+        int err = errno;
+
+        if (rw != MAP_FAILED) { munmap(rw, _size); }
+        if (rx != MAP_FAILED) { munmap(rx, _size); }
+        close(_fd);
+
+        throw std::system_error(err, std::generic_category(), "mmap");
+    }
+
+    _rw = static_cast<uint8_t*>(rw);
+    _rx = static_cast<uint8_t*>(rx);
+}
+
+code_buffer::~code_buffer() {
+    munmap(_rw, _size);
+    munmap(_rx, _size);
+    close(_fd);
+}
+
+std::optional<code_buffer::allocation> code_buffer::allocate(size_t size, size_t align) {
+    size_t cur = _used.load(std::memory_order_relaxed);
+    size_t start;
+
+    do {
+        start = (cur + align - 1) & ~(align - 1);
+
+        if (start > _size || size > _size - start) {
+            return std::nullopt;
+        }
+    } while (!_used.compare_exchange_weak(cur, start + size, std::memory_order_relaxed));
+
+    return allocation { { _rw + start, size }, _rx + start };
+}
+
+void code_buffer::publish(const allocation& alloc) {
+    auto* begin = static_cast<char*>(const_cast<void*>(alloc.entry));
+
+    /* A no-op on x86, other hosts need the instruction cache synced with the data written */
+    __builtin___clear_cache(begin, begin + alloc.code.size());
+
+    /* Whoever picks up the entry point with an acquire load sees the code */
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void code_buffer::reset() {
+    /* Give the pages back, they read as zero afterwards */
+    madvise(_rw, _size, MADV_REMOVE);
+    _used.store(0, std::memory_order_relaxed);
+}
+
+bool code_buffer::contains(const void* entry) const {
+    auto* ptr = static_cast<const uint8_t*>(entry);
+    return ptr >= _rx && ptr < _rx + _size;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+
+/* Executable memory for translated code, mapped twice from the same memfd.
+ *
+ * Code is written through a read-write view and executed from a separate
+ * read-execute view, so no page is ever writable and executable at once
+ * and nothing has to be re-protected while other threads run code from it.
+ * Allocation is a lock-free bump pointer, space is only reclaimed by reset().
+ */
+class code_buffer {
+    int _fd = -1;
+    uint8_t* _rw = nullptr;
+    uint8_t* _rx = nullptr;
+    size_t _size;
+
+    std::atomic<size_t> _used { 0 };
+
+    public:
+    struct allocation {
+        /* Where the code is written */
+        std::span<uint8_t> code;
+
+        /* Where it runs */
+        const void* entry;
+    };
+
+    explicit code_buffer(size_t size);
+    ~code_buffer();
+
+    code_buffer(const code_buffer&) = delete;
+    code_buffer& operator=(const code_buffer&) = delete;
+
+    /* Nothing if the buffer is full */
+    [[nodiscard]] std::optional<allocation> allocate(size_t size, size_t align = 16);
+
+    /* Make fully written code visible to instruction fetch on any thread */
+    void publish(const allocation& alloc);
+
+    /* Drop all code, no thread may still execute from the buffer */
+    void reset();
+
+    [[nodiscard]] bool contains(const void* entry) const;
+
+    [[nodiscard]] size_t used() const { return _used.load(std::memory_order_relaxed); }
+    [[nodiscard]] size_t capacity() const { return _size; }
+};
@@ -0,0 +1,224 @@
+#include "code_watch.hpp"
+
+#include <stdexcept>
+#include <system_error>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+std::atomic<code_watch*> code_watch::_active { nullptr };
+
+code_watch::code_watch(translation_cache& cache)
+    : _cache { cache }, _page_size { static_cast<size_t>(sysconf(_SC_PAGESIZE)) },
+      _pages { std::make_unique<page[]>(size_t { 1 } << table_bits) } {
+
+    code_watch* expected = nullptr;
+    if (!_active.compare_exchange_strong(expected, this)) {
+        throw std::logic_error("only one code_watch can be active");
+    }
+
+    struct sigaction action {};
+    action.sa_sigaction = &_handler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+
+    if (sigaction(SIGSEGV, &action, &_previous) != 0) {
+        int err = errno;
+        _active.store(nullptr);
+        throw std::system_error(err, std::generic_category(), "sigaction");
+    }
+}
+
+code_watch::~code_watch() {
+    sigaction(SIGSEGV, &_previous, nullptr);
+    _active.store(nullptr);
+
+    /* The memory may outlive us, give it its write access back */
+    for (size_t i = 0; i < (size_t { 1 } << table_bits); i++) {
+        uintptr_t host = _pages[i].host.load(std::memory_order_relaxed);
+
+        if (host && host != removed && _pages[i].armed.load(std::memory_order_relaxed)) {
+            mprotect(reinterpret_cast<void*>(host), _page_size, _pages[i].prot.load(std::memory_order_relaxed));
+        }
+    }
+}
+
+size_t code_watch::_index(uintptr_t host_page) const {
+    /* Fibonacci hashing on the page number */
+    return static_cast<size_t>(((host_page / _page_size) * 0x9e3779b97f4a7c15) >> (64 - table_bits));
+}
+
+code_watch::page* code_watch::_find(uintptr_t host_page) const {
+    size_t mask = (size_t { 1 } << table_bits) - 1;
+
+    /* The load factor is bounded, so there's always a free slot to stop at */
+    for (size_t i = _index(host_page);; i = (i + 1) & mask) {
+        uintptr_t host = _pages[i].host.load(std::memory_order_acquire);
+
+        if (!host) {
+            return nullptr;
+        } else if (host == host_page) {
+            return &_pages[i];
+        }
+    }
+}
+
+void code_watch::_queue(uint64_t guest_page) {
+    for (auto& slot : _pending) {
+        uint64_t expected = 0;
+
+        if (slot.compare_exchange_strong(expected, guest_page, std::memory_order_release)) {
+            _dirty.store(true, std::memory_order_release);
+            return;
+        }
+    }
+
+    _overflow.store(true, std::memory_order_release);
+    _dirty.store(true, std::memory_order_release);
+}
+
+bool code_watch::_fault(uintptr_t addr) {
+    page* p = _find(addr & ~(_page_size - 1));
+
+    if (!p) {
+        return false;
+    }
+
+    /* The page wasn't writable before it was watched either, so the fault isn't ours */
+    int prot = p->prot.load(std::memory_order_acquire);
+    if (!(prot & PROT_WRITE)) {
+        return false;
+    }
+
+    /* Only the first thread to write invalidates, the others just retry their store */
+    if (p->armed.exchange(false, std::memory_order_acq_rel)) {
+        _queue(p->guest.load(std::memory_order_acquire));
+    }
+
+    /* Queued before the page is writable, the new code can't run before the old blocks are gone */
+    mprotect(reinterpret_cast<void*>(addr & ~(_page_size - 1)), _page_size, prot);
+
+    return true;
+}
+
+void code_watch::_handler(int sig, siginfo_t* info, void* context) {
+    code_watch* self = _active.load(std::memory_order_acquire);
+
+    if (self && info->si_code == SEGV_ACCERR && self->_fault(reinterpret_cast<uintptr_t>(info->si_addr))) {
+        return;
+    }
+
+    if (self && (self->_previous.sa_flags & SA_SIGINFO)) {
+        self->_previous.sa_sigaction(sig, info, context);
+    } else if (self && self->_previous.sa_handler != SIG_DFL && self->_previous.sa_handler != SIG_IGN) {
+        self->_previous.sa_handler(sig);
+    } else {
+        /* Not a page armed here, or one that wasn't writable before it was. The fault is real,
+         * and the retried store dies on it like it would without the watch
+         */
+        signal(SIGSEGV, SIG_DFL);
+    }
+}
+
+bool code_watch::watch(uint64_t guest_addr, std::span<const uint8_t> host, int prot) {
+    /* Nothing can change code through a read-only mapping, fence_i() covers the others */
+    if (host.empty() || !(prot & PROT_WRITE)) {
+        return true;
+    }
+
+    std::scoped_lock lock { _write_lock };
+
+    size_t capacity = size_t { 1 } << table_bits;
+    size_t mask = capacity - 1;
+
+    auto begin = reinterpret_cast<uintptr_t>(host.data()) & ~(_page_size - 1);
+    auto end = reinterpret_cast<uintptr_t>(host.data() + host.size());
+
+    for (uintptr_t host_page = begin; host_page < end; host_page += _page_size) {
+        page* p = _find(host_page);
+
+        if (!p) {
+            if ((_used + 1) * 4 > capacity * 3) {
+                return false;
+            }
+
+            size_t i = _index(host_page);
+            while (true) {
+                uintptr_t cur = _pages[i].host.load(std::memory_order_relaxed);
+                if (!cur || cur == removed) {
+                    break;
+                }
+
+                i = (i + 1) & mask;
+            }
+
+            p = &_pages[i];
+            if (!p->host.load(std::memory_order_relaxed)) {
+                _used += 1;
+            }
+
+            /* The guest page of wherever this host page starts, which may be before the block */
+            p->guest.store(guest_addr - (reinterpret_cast<uintptr_t>(host.data()) - host_page), std::memory_order_relaxed);
+            p->host.store(host_page, std::memory_order_release);
+        }
+
+        if (!p->armed.load(std::memory_order_acquire)) {
+            p->prot.store(prot, std::memory_order_release);
+        }
+
+        if (!p->armed.exchange(true, std::memory_order_acq_rel)) {
+            if (mprotect(reinterpret_cast<void*>(host_page), _page_size, prot & ~PROT_WRITE) != 0) {
+                p->armed.store(false, std::memory_order_release);
+                throw std::system_error(errno, std::generic_category(), "mprotect");
+            }
+        }
+    }
+
+    return true;
+}
+
+void code_watch::forget(uint64_t begin, uint64_t end) {
+    {
+        std::scoped_lock lock { _write_lock };
+
+        for (size_t i = 0; i < (size_t { 1 } << table_bits); i++) {
+            uintptr_t host = _pages[i].host.load(std::memory_order_relaxed);
+            uint64_t guest = _pages[i].guest.load(std::memory_order_relaxed);
+
+            if (host && host != removed && guest < end && guest + _page_size > begin) {
+                _pages[i].armed.store(false, std::memory_order_relaxed);
+                _pages[i].host.store(removed, std::memory_order_release);
+            }
+        }
+    }
+
+    _cache.invalidate(begin, end);
+}
+
+void code_watch::sync() {
+    if (!_dirty.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+
+    if (_overflow.exchange(false, std::memory_order_acq_rel)) {
+        for (auto& slot : _pending) {
+            slot.store(0, std::memory_order_relaxed);
+        }
+
+        _cache.invalidate(0, ~uint64_t { 0 });
+        return;
+    }
+
+    for (auto& slot : _pending) {
+        uint64_t guest_page = slot.exchange(0, std::memory_order_acquire);
+
+        if (guest_page) {
+            _cache.invalidate(guest_page, guest_page + _page_size);
+        }
+    }
+}
+
+void code_watch::fence_i() {
+    sync();
+    _cache.invalidate(0, ~uint64_t { 0 });
+}
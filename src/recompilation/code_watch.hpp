@@ -0,0 +1,101 @@
+#pragma once
+
+#include "translation_cache.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <array>
+#include <span>
+#include <cstdint>
+
+#include <signal.h>
+
+/* Catches guest writes to translated code without checking every store.
+ *
+ * The host pages backing a translated block are made read-only. A write to
+ * one of them faults, the SIGSEGV handler gives the page its write access
+ * back and queues its guest range, and the store is restarted. Threads call
+ * sync() before looking up blocks, which removes everything translated from
+ * the queued pages, so a block is at most finished once after its code
+ * changed. Faults on pages that aren't watched go to the handler that was
+ * installed before.
+ *
+ * Only one instance can exist at a time, as it owns the process' SIGSEGV
+ * handler. Unmapping, remapping or changing the protection of a watched
+ * range resets the host protection, so those have to call forget() after.
+ * Writes the host makes for the guest, like read() into guest memory or
+ * io_uring completions, don't fault and fail with EFAULT instead.
+ */
+class code_watch {
+    static constexpr size_t table_bits = 14;
+    static constexpr size_t pending_capacity = 256;
+
+    /* Host page marker for forgotten entries, real pages are never at 1 */
+    static constexpr uintptr_t removed = 1;
+
+    /* Entries stay after their page was written to, watching it again only re-arms them.
+     * That way a fault racing with another thread's on the same page still finds it.
+     */
+    struct page {
+        std::atomic<uintptr_t> host { 0 };
+        std::atomic<uint64_t> guest { 0 };
+        std::atomic<bool> armed { false };
+
+        /* Host protection before the page was armed, what faults and the destructor restore */
+        std::atomic<int> prot { 0 };
+    };
+
+    static std::atomic<code_watch*> _active;
+
+    translation_cache& _cache;
+    size_t _page_size;
+
+    /* Open-addressed by host page, the signal handler probes it without locking */
+    std::unique_ptr<page[]> _pages;
+
+    /* Serializes watch() and forget(), never taken in the signal handler */
+    std::mutex _write_lock;
+    size_t _used = 0;
+
+    /* Guest pages written to since the last sync(), 0 is a free slot as nothing runs from page zero */
+    std::array<std::atomic<uint64_t>, pending_capacity> _pending {};
+    std::atomic<bool> _dirty { false };
+
+    /* More pages were written than fit in _pending, the next sync() drops everything */
+    std::atomic<bool> _overflow { false };
+
+    struct sigaction _previous {};
+
+    [[nodiscard]] size_t _index(uintptr_t host_page) const;
+    [[nodiscard]] page* _find(uintptr_t host_page) const;
+    void _queue(uint64_t guest_page);
+
+    /* Called from the signal handler, true if addr is in a watched page */
+    [[nodiscard]] bool _fault(uintptr_t addr);
+
+    static void _handler(int sig, siginfo_t* info, void* context);
+
+    public:
+    explicit code_watch(translation_cache& cache);
+    ~code_watch();
+
+    code_watch(const code_watch&) = delete;
+    code_watch& operator=(const code_watch&) = delete;
+
+    /* Write-protect the host pages backing guest code at guest_addr. host is what the guest
+     * memory translates the block's range to, prot the host protection its pages have now.
+     * Pages that aren't writable to begin with are left alone. Returns false if too many
+     * pages are watched already, the block must not be inserted then.
+     */
+    [[nodiscard]] bool watch(uint64_t guest_addr, std::span<const uint8_t> host, int prot);
+
+    /* Stop watching and invalidate [begin, end), for ranges whose mapping changed */
+    void forget(uint64_t begin, uint64_t end);
+
+    /* Invalidate the blocks on pages written to since the last call */
+    void sync();
+
+    /* fence.i, also covers code written through another mapping of the same memory */
+    void fence_i();
+};
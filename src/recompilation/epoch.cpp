@@ -0,0 +1,102 @@
+#include "epoch.hpp"
+
+#include <algorithm>
+#include <utility>
+
+epoch_domain::handle::~handle() {
+    if (_domain) {
+        _slot->epoch.store(idle, std::memory_order_release);
+
+        std::scoped_lock lock { _domain->_lock };
+        std::erase_if(_domain->_participants, [this](const participant& p) { return &p == _slot; });
+    }
+}
+
+epoch_domain::handle::handle(handle&& other) noexcept
+    : _domain { std::exchange(other._domain, nullptr) }, _slot { std::exchange(other._slot, nullptr) }
+    , _depth { std::exchange(other._depth, 0) } {
+
+}
+
+epoch_domain::handle& epoch_domain::handle::operator=(handle&& other) noexcept {
+    if (this != &other) {
+        handle old { std::move(*this) };
+
+        _domain = std::exchange(other._domain, nullptr);
+        _slot = std::exchange(other._slot, nullptr);
+        _depth = std::exchange(other._depth, 0);
+    }
+
+    return *this;
+}
+
+void epoch_domain::handle::pin() {
+    if (_depth++ == 0) {
+        /* Acquire, so an epoch newer than a retirement also sees its unlink */
+        _slot->epoch.store(_domain->_global.load(std::memory_order_acquire), std::memory_order_relaxed);
+
+        /* The slot must be visible before any shared pointer is read */
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+void epoch_domain::handle::unpin() {
+    if (--_depth == 0) {
+        _slot->epoch.store(idle, std::memory_order_release);
+    }
+}
+
+epoch_domain::~epoch_domain() {
+    for (auto& obj : _retired) {
+        obj.destroy();
+    }
+}
+
+epoch_domain::handle epoch_domain::join() {
+    std::scoped_lock lock { _lock };
+    return handle { this, &_participants.emplace_back() };
+}
+
+void epoch_domain::retire(std::function<void()> destroy) {
+    std::scoped_lock lock { _lock };
+
+    /* Readers that pin from now on can't see the object anymore */
+    uint64_t epoch = _global.fetch_add(1, std::memory_order_seq_cst);
+    _retired.push_back({ epoch, std::move(destroy) });
+}
+
+uint64_t epoch_domain::oldest_pinned() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    uint64_t oldest = idle;
+    for (const auto& p : _participants) {
+        oldest = std::min(oldest, p.epoch.load(std::memory_order_acquire));
+    }
+
+    return oldest;
+}
+
+size_t epoch_domain::collect() {
+    std::vector<retired> ready;
+
+    {
+        std::scoped_lock lock { _lock };
+        uint64_t oldest = oldest_pinned();
+
+        auto safe = std::ranges::partition(_retired, [oldest](const retired& obj) { return obj.epoch >= oldest; });
+        std::ranges::move(safe, std::back_inserter(ready));
+        _retired.erase(safe.begin(), safe.end());
+    }
+
+    /* Destructors may retire more objects */
+    for (auto& obj : ready) {
+        obj.destroy();
+    }
+
+    return ready.size();
+}
+
+size_t epoch_domain::pending() {
+    std::scoped_lock lock { _lock };
+    return _retired.size();
+}
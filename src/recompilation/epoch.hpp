@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <list>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <limits>
+
+/* Epoch-based reclamation for data that's read without locks.
+ *
+ * Readers pin the current epoch for as long as they hold on to shared
+ * pointers. Writers unlink an object first and then retire it, and it's
+ * only destroyed once every reader that could still have seen it has
+ * unpinned. Pinning is a store and a fence on a per-thread slot, so
+ * readers never contend with each other or with writers.
+ */
+class epoch_domain {
+    static constexpr uint64_t idle = std::numeric_limits<uint64_t>::max();
+
+    struct participant {
+        std::atomic<uint64_t> epoch { idle };
+    };
+
+    struct retired {
+        uint64_t epoch;
+        std::function<void()> destroy;
+    };
+
+    std::atomic<uint64_t> _global { 0 };
+
+    /* Guards the participant list and the retired objects */
+    std::mutex _lock;
+    std::list<participant> _participants;
+    std::vector<retired> _retired;
+
+    [[nodiscard]] uint64_t oldest_pinned();
+
+    public:
+    /* A thread's registration, pins nest */
+    class handle {
+        epoch_domain* _domain = nullptr;
+        participant* _slot = nullptr;
+        size_t _depth = 0;
+
+        friend class epoch_domain;
+        handle(epoch_domain* domain, participant* slot) : _domain { domain }, _slot { slot } { }
+
+        public:
+        handle() = default;
+        ~handle();
+
+        handle(const handle&) = delete;
+        handle& operator=(const handle&) = delete;
+
+        handle(handle&& other) noexcept;
+        handle& operator=(handle&& other) noexcept;
+
+        void pin();
+        void unpin();
+
+        [[nodiscard]] bool pinned() const { return _depth > 0; }
+    };
+
+    class guard {
+        handle& _handle;
+
+        public:
+        explicit guard(handle& h) : _handle { h } { _handle.pin(); }
+        ~guard() { _handle.unpin(); }
+
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+    };
+
+    epoch_domain() = default;
+    ~epoch_domain();
+
+    epoch_domain(const epoch_domain&) = delete;
+    epoch_domain& operator=(const epoch_domain&) = delete;
+
+    /* Register the calling thread, the domain must outlive the handle */
+    [[nodiscard]] handle join();
+
+    /* Destroy an already unlinked object once no reader can reference it */
+    void retire(std::function<void()> destroy);
+
+    template <typename T>
+    void retire(T* ptr) {
+        retire([ptr] { delete ptr; });
+    }
+
+    /* Destroy everything that's safe to destroy, returns the number of objects */
+    size_t collect();
+
+    /* Objects waiting for readers to move on */
+    [[nodiscard]] size_t pending();
+};
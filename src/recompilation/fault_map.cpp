@@ -0,0 +1,114 @@
+#include "fault_map.hpp"
+
+#include <stdexcept>
+
+namespace {
+    void put_uleb(std::vector<uint8_t>& out, uint64_t val) {
+        do {
+            uint8_t byte = val & 0x7f;
+            val >>= 7;
+
+            out.push_back(byte | (val ? 0x80 : 0));
+        } while (val);
+    }
+
+    void put_sleb(std::vector<uint8_t>& out, int64_t val) {
+        /* Zigzag, so small negative deltas stay short as well */
+        put_uleb(out, (static_cast<uint64_t>(val) << 1) ^ static_cast<uint64_t>(val >> 63));
+    }
+
+    [[nodiscard]] uint64_t get_uleb(const uint8_t*& it) {
+        uint64_t val = 0;
+
+        for (unsigned shift = 0;; shift += 7) {
+            uint8_t byte = *it++;
+            val |= uint64_t(byte & 0x7f) << shift;
+
+            if (!(byte & 0x80)) {
+                return val;
+            }
+        }
+    }
+
+    [[nodiscard]] int64_t get_sleb(const uint8_t*& it) {
+        uint64_t val = get_uleb(it);
+        return static_cast<int64_t>((val >> 1) ^ -(val & 1));
+    }
+}
+
+void fault_map::builder::add(size_t host_offset, uint64_t guest_offset, std::span<const live_reg> live) {
+    if (host_offset < _host_offset || (host_offset == _host_offset && !_data.empty())) {
+        throw std::invalid_argument("fault sites have to be added in order of their host offset");
+    }
+
+    put_uleb(_data, host_offset - _host_offset);
+    put_sleb(_data, static_cast<int64_t>(guest_offset - _guest_offset));
+    put_uleb(_data, live.size());
+
+    for (const auto& reg : live) {
+        if (reg.guest >= guest_regs || reg.location.where == reg_location::kind::context) {
+            throw std::invalid_argument("invalid live register for a fault site");
+        }
+
+        /* The register and where it is share a byte */
+        _data.push_back(uint8_t(reg.guest | (static_cast<uint8_t>(reg.location.where) << 6)));
+        put_uleb(_data, reg.location.index);
+    }
+
+    _host_offset = host_offset;
+    _guest_offset = guest_offset;
+}
+
+fault_map fault_map::builder::finish() {
+    fault_map map;
+    map._data = std::move(_data);
+
+    _data.clear();
+    _host_offset = 0;
+    _guest_offset = 0;
+
+    return map;
+}
+
+std::optional<fault_map::site> fault_map::find(size_t host_offset) const {
+    const uint8_t* it = _data.data();
+    const uint8_t* end = it + _data.size();
+
+    size_t cur_host = 0;
+    uint64_t cur_guest = 0;
+
+    while (it < end) {
+        cur_host += get_uleb(it);
+        cur_guest += static_cast<uint64_t>(get_sleb(it));
+        uint64_t count = get_uleb(it);
+
+        if (cur_host > host_offset) {
+            return std::nullopt;
+        }
+
+        if (cur_host < host_offset) {
+            /* Skip the registers, each is a byte and an index */
+            for (uint64_t i = 0; i < count; i++) {
+                it += 1;
+                (void)get_uleb(it);
+            }
+
+            continue;
+        }
+
+        site result;
+        result.guest_offset = cur_guest;
+
+        for (uint64_t i = 0; i < count; i++) {
+            uint8_t packed = *it++;
+
+            auto& loc = result.regs[packed & 0b111111];
+            loc.where = static_cast<reg_location::kind>(packed >> 6);
+            loc.index = static_cast<uint32_t>(get_uleb(it));
+        }
+
+        return result;
+    }
+
+    return std::nullopt;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+
+/* Where a guest register's current value is while translated code runs */
+struct reg_location {
+    enum class kind : uint8_t {
+        /* Already in the guest context, nothing to restore */
+        context,
+
+        /* In a host general purpose register, by its encoding number */
+        host,
+
+        /* In a stack slot, by its byte offset from the host stack pointer */
+        spill
+    };
+
+    kind where = kind::context;
+    uint32_t index = 0;
+};
+
+/* Side table from host code offsets to the guest state at instructions that may fault.
+ *
+ * Translated code doesn't keep the guest pc or registers up to date, they
+ * are reconstructed from here when a guest memory access faults. Only the
+ * faulting instructions get an entry and only registers the allocator
+ * holds outside of the guest context are listed, in a byte stream of
+ * LEB128 deltas. Blocks are short, so lookup just decodes from the start.
+ *
+ * Float registers are never held in host vector registers across a memory
+ * access, the allocator writes them back or spills them first.
+ */
+class fault_map {
+    std::vector<uint8_t> _data;
+
+    public:
+    static constexpr size_t guest_regs = 64;
+
+    struct site {
+        /* Guest pc of the faulting instruction, relative to the start of the block */
+        uint64_t guest_offset = 0;
+
+        /* Indexed like arch::rv64::reg, floats after the integer registers */
+        std::array<reg_location, guest_regs> regs {};
+    };
+
+    /* A register the allocator holds outside of the guest context */
+    struct live_reg {
+        uint8_t guest;
+        reg_location location;
+    };
+
+    class builder {
+        std::vector<uint8_t> _data;
+        size_t _host_offset = 0;
+        uint64_t _guest_offset = 0;
+
+        public:
+        /* Sites have to be added in order of their host offset, which is where the faulting
+         * host instruction starts
+         */
+        void add(size_t host_offset, uint64_t guest_offset, std::span<const live_reg> live);
+
+        [[nodiscard]] fault_map finish();
+    };
+
+    fault_map() = default;
+
+    /* State at the instruction starting at host_offset, nothing if it can't fault. Doesn't
+     * allocate, so it's safe to call from a signal handler.
+     */
+    [[nodiscard]] std::optional<site> find(size_t host_offset) const;
+
+    [[nodiscard]] size_t size() const { return _data.size(); }
+};
@@ -0,0 +1,142 @@
+#include "native_fault.hpp"
+
+#include <stdexcept>
+#include <system_error>
+
+#include <ucontext.h>
+
+namespace {
+    /* Host pc, stack pointer and general purpose registers by encoding number */
+#if defined(__x86_64__)
+    [[nodiscard]] uintptr_t host_pc(const ucontext_t& uc) {
+        return static_cast<uintptr_t>(uc.uc_mcontext.gregs[REG_RIP]);
+    }
+
+    [[nodiscard]] uintptr_t host_sp(const ucontext_t& uc) {
+        return static_cast<uintptr_t>(uc.uc_mcontext.gregs[REG_RSP]);
+    }
+
+    [[nodiscard]] uint64_t host_reg(const ucontext_t& uc, uint32_t idx) {
+        static constexpr int gregs[] = {
+            REG_RAX, REG_RCX, REG_RDX, REG_RBX, REG_RSP, REG_RBP, REG_RSI, REG_RDI,
+            REG_R8, REG_R9, REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15
+        };
+
+        return static_cast<uint64_t>(uc.uc_mcontext.gregs[gregs[idx & 15]]);
+    }
+#elif defined(__aarch64__)
+    [[nodiscard]] uintptr_t host_pc(const ucontext_t& uc) {
+        return static_cast<uintptr_t>(uc.uc_mcontext.pc);
+    }
+
+    [[nodiscard]] uintptr_t host_sp(const ucontext_t& uc) {
+        return static_cast<uintptr_t>(uc.uc_mcontext.sp);
+    }
+
+    [[nodiscard]] uint64_t host_reg(const ucontext_t& uc, uint32_t idx) {
+        return (idx < 31) ? uc.uc_mcontext.regs[idx] : uc.uc_mcontext.sp;
+    }
+#else
+#error "translated code faults are only supported on x86-64 and AArch64 hosts"
+#endif
+}
+
+std::atomic<native_fault*> native_fault::_active { nullptr };
+thread_local native_fault::frame* native_fault::_current = nullptr;
+
+native_fault::scope::scope(frame& f) : _previous { _current } {
+    _current = &f;
+}
+
+native_fault::scope::~scope() {
+    _current = _previous;
+}
+
+native_fault::native_fault(translation_cache& cache) : _cache { cache } {
+    native_fault* expected = nullptr;
+    if (!_active.compare_exchange_strong(expected, this)) {
+        throw std::logic_error("only one native_fault can be active");
+    }
+
+    struct sigaction action {};
+    action.sa_sigaction = &_handler;
+    action.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+
+    if (sigaction(SIGSEGV, &action, &_previous_segv) != 0 || sigaction(SIGBUS, &action, &_previous_bus) != 0) {
+        int err = errno;
+
+        sigaction(SIGSEGV, &_previous_segv, nullptr);
+        _active.store(nullptr);
+
+        throw std::system_error(err, std::generic_category(), "sigaction");
+    }
+}
+
+native_fault::~native_fault() {
+    sigaction(SIGSEGV, &_previous_segv, nullptr);
+    sigaction(SIGBUS, &_previous_bus, nullptr);
+    _active.store(nullptr);
+}
+
+void native_fault::_handler(int sig, siginfo_t* info, void* context) {
+    native_fault* self = _active.load(std::memory_order_acquire);
+    frame* f = _current;
+
+    if (self && f) {
+        const auto& uc = *static_cast<const ucontext_t*>(context);
+        auto pc = reinterpret_cast<const uint8_t*>(host_pc(uc));
+
+        /* The entered block is gone from the cache if it was invalidated while running */
+        const translated_block* block = f->block;
+        auto* entry = block ? static_cast<const uint8_t*>(block->entry) : nullptr;
+
+        if (!block || pc < entry || pc >= entry + block->code_size) {
+            block = self->_cache.find_code(pc);
+            entry = block ? static_cast<const uint8_t*>(block->entry) : nullptr;
+        }
+
+        if (block) {
+            if (auto site = block->faults.find(static_cast<size_t>(pc - entry))) {
+                for (size_t i = 0; i < site->regs.size(); i++) {
+                    const reg_location& loc = site->regs[i];
+
+                    switch (loc.where) {
+                        case reg_location::kind::context:
+                            break;
+
+                        case reg_location::kind::host:
+                            f->regs[i] = host_reg(uc, loc.index);
+                            break;
+
+                        case reg_location::kind::spill:
+                            f->regs[i] = *reinterpret_cast<const uint64_t*>(host_sp(uc) + loc.index);
+                            break;
+                    }
+                }
+
+                f->pc = block->guest_pc + site->guest_offset;
+                f->fault_addr = reinterpret_cast<uintptr_t>(info->si_addr);
+                f->signal = sig;
+
+                siglongjmp(f->recover, 1);
+            }
+        }
+    }
+
+    const struct sigaction* previous = nullptr;
+    if (self) {
+        previous = (sig == SIGBUS) ? &self->_previous_bus : &self->_previous_segv;
+    }
+
+    if (previous && (previous->sa_flags & SA_SIGINFO)) {
+        previous->sa_sigaction(sig, info, context);
+    } else if (previous && previous->sa_handler != SIG_DFL && previous->sa_handler != SIG_IGN) {
+        previous->sa_handler(sig);
+    } else {
+        /* Outside guest code, or at an instruction the block didn't record as able to fault, so
+         * the emulator itself is broken. The retried instruction dumps core on the default action
+         */
+        signal(sig, SIG_DFL);
+    }
+}
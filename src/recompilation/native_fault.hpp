@@ -0,0 +1,80 @@
+#pragma once
+
+#include "translation_cache.hpp"
+#include "fault_map.hpp"
+
+#include <atomic>
+#include <span>
+#include <cstdint>
+
+#include <setjmp.h>
+#include <signal.h>
+
+/* Turns host faults in translated code into precise guest exceptions.
+ *
+ * Guest loads and stores are plain host accesses, so an invalid one raises
+ * SIGSEGV or SIGBUS in the middle of a block. The handler finds the block
+ * the faulting host pc is in, looks the instruction up in the block's
+ * fault_map and writes the guest pc and every register the allocator held
+ * outside of the context back into the thread's frame. It then jumps back
+ * to where the thread entered translated code, which can report the fault
+ * like the interpreter does. Nothing is stored on the fast path.
+ *
+ * Only one instance can exist at a time. Faults outside of translated code
+ * or at instructions without a fault site go to the handlers installed
+ * before. code_watch has to be created after this so it sees the writes to
+ * code pages first.
+ */
+class native_fault {
+    public:
+    /* A thread running translated code */
+    struct frame {
+        /* Guest context, indexed like arch::rv64::reg */
+        std::span<uint64_t, fault_map::guest_regs> regs;
+
+        /* Block the thread entered, in case it was invalidated while running */
+        const translated_block* block = nullptr;
+
+        /* Set when a fault jumps back to recover */
+        uint64_t pc = 0;
+        uintptr_t fault_addr = 0;
+        int signal = 0;
+
+        /* Set up with sigsetjmp(recover, 0) before entering translated code, the handler
+         * doesn't block its signal so the mask needn't be saved
+         */
+        sigjmp_buf recover;
+
+        explicit frame(std::span<uint64_t, fault_map::guest_regs> regs) : regs { regs } { }
+    };
+
+    /* Makes a frame the calling thread's while it's alive */
+    class scope {
+        frame* _previous;
+
+        public:
+        explicit scope(frame& f);
+        ~scope();
+
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+    };
+
+    private:
+    static std::atomic<native_fault*> _active;
+    static thread_local frame* _current;
+
+    translation_cache& _cache;
+
+    struct sigaction _previous_segv {};
+    struct sigaction _previous_bus {};
+
+    static void _handler(int sig, siginfo_t* info, void* context);
+
+    public:
+    explicit native_fault(translation_cache& cache);
+    ~native_fault();
+
+    native_fault(const native_fault&) = delete;
+    native_fault& operator=(const native_fault&) = delete;
+};
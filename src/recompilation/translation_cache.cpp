@@ -0,0 +1,277 @@
+#include "translation_cache.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+translation_cache::table::table(size_t bits)
+    : bits { bits }, slots { std::make_unique<std::atomic<translated_block*>[]>(size_t { 1 } << bits) } {
+
+}
+
+size_t translation_cache::table::index(uint64_t pc) const {
+    /* Fibonacci hashing, instructions are at least 2-byte aligned */
+    return static_cast<size_t>(((pc >> 1) * 0x9e3779b97f4a7c15) >> (64 - bits));
+}
+
+translated_block* translation_cache::tombstone() {
+    static translated_block removed { ~uint64_t { 0 }, ~uint64_t { 0 }, nullptr, 0, {} };
+    return &removed;
+}
+
+std::atomic<translated_block*>* translation_cache::find_slot(const table& t, uint64_t pc, bool for_insert) {
+    size_t mask = t.capacity() - 1;
+    std::atomic<translated_block*>* reuse = nullptr;
+
+    /* The load factor is bounded, so there's always a free slot to stop at */
+    for (size_t i = t.index(pc);; i = (i + 1) & mask) {
+        auto& slot = t.slots[i];
+        translated_block* block = slot.load(std::memory_order_acquire);
+
+        if (!block) {
+            return (for_insert && reuse) ? reuse : &slot;
+        } else if (block == tombstone()) {
+            if (!reuse) {
+                reuse = &slot;
+            }
+        } else if (block->guest_pc == pc) {
+            return &slot;
+        }
+    }
+}
+
+translation_cache::translation_cache(size_t code_size)
+    : _code { code_size }, _table { new table(initial_bits) } {
+
+}
+
+translation_cache::~translation_cache() {
+    table* t = _table.load(std::memory_order_relaxed);
+
+    for (size_t i = 0; i < t->capacity(); i++) {
+        translated_block* block = t->slots[i].load(std::memory_order_relaxed);
+
+        if (block && block != tombstone()) {
+            delete block;
+        }
+    }
+
+    delete t;
+}
+
+const translated_block* translation_cache::lookup(uint64_t pc) const {
+    const table* t = _table.load(std::memory_order_acquire);
+    translated_block* block = find_slot(*t, pc, false)->load(std::memory_order_acquire);
+
+    /* The slot may have been invalidated and reused for another pc since it was probed */
+    return (block && block != tombstone() && block->guest_pc == pc) ? block : nullptr;
+}
+
+const translated_block* translation_cache::find_code(const void* addr) const {
+    const table* t = _table.load(std::memory_order_acquire);
+    auto* host = static_cast<const uint8_t*>(addr);
+
+    if (!_code.contains(addr)) {
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < t->capacity(); i++) {
+        translated_block* block = t->slots[i].load(std::memory_order_acquire);
+
+        if (!block || block == tombstone()) {
+            continue;
+        }
+
+        auto* entry = static_cast<const uint8_t*>(block->entry);
+        if (host >= entry && host < entry + block->code_size) {
+            return block;
+        }
+    }
+
+    return nullptr;
+}
+
+void translation_cache::grow(table& t) {
+    /* Rehashing drops the tombstones, only double if the live blocks need it */
+    size_t bits = t.bits + (((t.live + 1) * 2 > t.capacity()) ? 1 : 0);
+    auto* grown = new table(bits);
+
+    for (size_t i = 0; i < t.capacity(); i++) {
+        translated_block* block = t.slots[i].load(std::memory_order_relaxed);
+
+        if (block && block != tombstone()) {
+            find_slot(*grown, block->guest_pc, true)->store(block, std::memory_order_relaxed);
+            grown->used += 1;
+            grown->live += 1;
+        }
+    }
+
+    /* Readers may still probe the old table, the blocks themselves stay */
+    _table.store(grown, std::memory_order_release);
+    _epochs.retire(&t);
+}
+
+const translated_block* translation_cache::insert(uint64_t pc, uint64_t guest_size,
+    const code_buffer::allocation& code, fault_map faults) {
+
+    if (!_code.contains(code.entry)) {
+        throw std::invalid_argument("code was not allocated from this cache");
+    }
+
+    std::scoped_lock lock { _write_lock };
+    table* t = _table.load(std::memory_order_relaxed);
+
+    /* Another thread translated the same block first, the code space is just left unused */
+    if (auto* existing = find_slot(*t, pc, false)->load(std::memory_order_relaxed);
+        existing && existing != tombstone()) {
+        return existing;
+    }
+
+    if ((t->used + 1) * 4 > t->capacity() * 3) {
+        grow(*t);
+        t = _table.load(std::memory_order_relaxed);
+    }
+
+    _code.publish(code);
+
+    auto* block = new translated_block { pc, pc + guest_size, code.entry, code.code.size(), std::move(faults) };
+    auto* slot = find_slot(*t, pc, true);
+
+    if (!slot->load(std::memory_order_relaxed)) {
+        t->used += 1;
+    }
+
+    t->live += 1;
+    slot->store(block, std::memory_order_release);
+
+    return block;
+}
+
+size_t translation_cache::invalidate(uint64_t begin, uint64_t end) {
+    std::vector<translated_block*> removed;
+
+    {
+        std::scoped_lock lock { _write_lock };
+        table* t = _table.load(std::memory_order_relaxed);
+
+        for (size_t i = 0; i < t->capacity(); i++) {
+            translated_block* block = t->slots[i].load(std::memory_order_relaxed);
+
+            if (block && block != tombstone() && block->overlaps(begin, end)) {
+                t->slots[i].store(tombstone(), std::memory_order_release);
+                t->live -= 1;
+                removed.push_back(block);
+            }
+        }
+
+        if (removed.empty()) {
+            return 0;
+        }
+
+        _generation.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    _epochs.retire([removed] {
+        for (translated_block* block : removed) {
+            delete block;
+        }
+    });
+
+    return removed.size();
+}
+
+void translation_cache::flush() {
+    {
+        std::scoped_lock lock { _write_lock };
+        table* t = _table.exchange(new table(initial_bits), std::memory_order_acq_rel);
+
+        _generation.fetch_add(1, std::memory_order_acq_rel);
+
+        _epochs.retire([t] {
+            for (size_t i = 0; i < t->capacity(); i++) {
+                translated_block* block = t->slots[i].load(std::memory_order_relaxed);
+
+                if (block && block != tombstone()) {
+                    delete block;
+                }
+            }
+
+            delete t;
+        });
+    }
+
+    _epochs.collect();
+    _code.reset();
+}
+
+size_t translation_cache::size() {
+    std::scoped_lock lock { _write_lock };
+    return _table.load(std::memory_order_relaxed)->live;
+}
+
+translation_cache::jump_cache::jump_cache(const translation_cache& cache)
+    : _cache { cache }, _generation { cache.generation() }, _entries(entries) {
+
+}
+
+const translated_block* translation_cache::jump_cache::lookup(uint64_t pc) {
+    /* Anything removed from the shared table may be cached here, start over */
+    if (uint64_t gen = _cache.generation(); gen != _generation) {
+        clear();
+        _generation = gen;
+    }
+
+    entry& e = _entries[(pc >> 1) & (entries - 1)];
+
+    if (e.pc != pc) {
+        const translated_block* block = _cache.lookup(pc);
+
+        if (!block) {
+            return nullptr;
+        }
+
+        e = { pc, block };
+    }
+
+    return e.block;
+}
+
+void translation_cache::jump_cache::clear() {
+    std::ranges::fill(_entries, entry {});
+}
+
+translation_cache::return_stack::return_stack(const translation_cache& cache)
+    : _cache { cache }, _generation { cache.generation() } {
+
+}
+
+void translation_cache::return_stack::push(uint64_t pc, const translated_block* block) {
+    _entries[_top++ % depth] = { pc, block };
+}
+
+const translated_block* translation_cache::return_stack::pop(uint64_t pc) {
+    /* Pushed blocks may have been removed since, the stack is only a prediction anyway */
+    if (uint64_t gen = _cache.generation(); gen != _generation) {
+        clear();
+        _generation = gen;
+    }
+
+    entry& e = _entries[--_top % depth];
+
+    if (e.pc != pc) {
+        return nullptr;
+    }
+
+    /* The return address wasn't translated yet when it was pushed */
+    if (!e.block) {
+        e.block = _cache.lookup(pc);
+    }
+
+    const translated_block* block = e.block;
+    e = {};
+
+    return block;
+}
+
+void translation_cache::return_stack::clear() {
+    std::ranges::fill(_entries, entry {});
+}
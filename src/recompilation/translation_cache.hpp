@@ -0,0 +1,167 @@
+#pragma once
+
+#include "code_buffer.hpp"
+#include "epoch.hpp"
+#include "fault_map.hpp"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+/* A guest block and the host code it was translated into */
+struct translated_block {
+    uint64_t guest_pc;
+    uint64_t guest_end;
+
+    const void* entry;
+    size_t code_size;
+
+    /* Guest state at the host instructions that may fault */
+    fault_map faults;
+
+    [[nodiscard]] bool overlaps(uint64_t begin, uint64_t end) const { return guest_pc < end && begin < guest_end; }
+};
+
+/* Maps guest addresses to translated code, shared by all guest threads.
+ *
+ * Lookups don't take any lock: the table is open-addressed with atomic
+ * slots, and readers only need to be pinned in the cache's epoch domain
+ * while they use a block. Inserting takes a short lock, translating itself
+ * happens outside of it, so threads translate in parallel and the loser of
+ * a race simply gets the winner's block back. Removed blocks and replaced
+ * tables are reclaimed once no pinned reader can still see them.
+ *
+ * An invalidation applies to lookups that start after it returns. A thread
+ * that looked a block up earlier may still finish running it.
+ */
+class translation_cache {
+    struct table {
+        size_t bits;
+        std::unique_ptr<std::atomic<translated_block*>[]> slots;
+
+        /* Only touched with the write lock held, used counts tombstones as well */
+        size_t used = 0;
+        size_t live = 0;
+
+        explicit table(size_t bits);
+
+        [[nodiscard]] size_t capacity() const { return size_t { 1 } << bits; }
+        [[nodiscard]] size_t index(uint64_t pc) const;
+    };
+
+    static constexpr size_t initial_bits = 12;
+
+    code_buffer _code;
+    epoch_domain _epochs;
+
+    std::atomic<table*> _table;
+    std::atomic<uint64_t> _generation { 0 };
+
+    /* Serializes writers, never taken on lookup */
+    std::mutex _write_lock;
+
+    [[nodiscard]] static translated_block* tombstone();
+
+    /* Probe for pc, returns the slot it's in or the first free one */
+    [[nodiscard]] static std::atomic<translated_block*>* find_slot(const table& t, uint64_t pc, bool for_insert);
+
+    void grow(table& t);
+
+    public:
+    /* Per-thread direct-mapped cache in front of the shared table, for indirect jumps */
+    class jump_cache {
+        static constexpr size_t entries = 4096;
+
+        struct entry {
+            uint64_t pc = ~uint64_t { 0 };
+            const translated_block* block = nullptr;
+        };
+
+        const translation_cache& _cache;
+        uint64_t _generation;
+        std::vector<entry> _entries;
+
+        public:
+        explicit jump_cache(const translation_cache& cache);
+
+        /* The calling thread must be pinned */
+        [[nodiscard]] const translated_block* lookup(uint64_t pc);
+
+        void clear();
+    };
+
+    /* Per-thread shadow stack of guest return addresses. Translated calls push the address
+     * they return to along with its block, so the matching return only has to compare the
+     * pc on top instead of doing a lookup. Returns that don't match, such as longjmp or
+     * coroutine switches, fall back to the jump cache. When calls nest deeper than the
+     * stack, the oldest entries are overwritten and those returns fall back as well.
+     */
+    class return_stack {
+        static constexpr size_t depth = 64;
+
+        struct entry {
+            uint64_t pc = ~uint64_t { 0 };
+            const translated_block* block = nullptr;
+        };
+
+        const translation_cache& _cache;
+        uint64_t _generation;
+        std::array<entry, depth> _entries {};
+
+        /* Grows and shrinks freely, only its lower bits index the entries */
+        size_t _top = 0;
+
+        public:
+        explicit return_stack(const translation_cache& cache);
+
+        /* block is where pc was translated to, or nullptr if it hasn't been yet */
+        void push(uint64_t pc, const translated_block* block);
+
+        /* Block to continue at when returning to pc, nullptr if the prediction was wrong
+         * or pc was never translated. The calling thread must be pinned.
+         */
+        [[nodiscard]] const translated_block* pop(uint64_t pc);
+
+        void clear();
+    };
+
+    explicit translation_cache(size_t code_size);
+    ~translation_cache();
+
+    translation_cache(const translation_cache&) = delete;
+    translation_cache& operator=(const translation_cache&) = delete;
+
+    /* Every thread using the cache needs its own handle, and pins it around lookups and execution */
+    [[nodiscard]] epoch_domain::handle join() { return _epochs.join(); }
+
+    [[nodiscard]] code_buffer& code() { return _code; }
+
+    /* The calling thread must be pinned */
+    [[nodiscard]] const translated_block* lookup(uint64_t pc) const;
+
+    /* Publish code written to an allocation from code(), returns the block that's in the cache afterwards */
+    const translated_block* insert(uint64_t pc, uint64_t guest_size, const code_buffer::allocation& code,
+        fault_map faults = {});
+
+    /* Block whose host code contains addr, for mapping faults back to the guest. Scans the
+     * whole table, but doesn't lock or allocate. The calling thread must be pinned.
+     */
+    [[nodiscard]] const translated_block* find_code(const void* addr) const;
+
+    /* Remove every block overlapping [begin, end), returns the number removed */
+    size_t invalidate(uint64_t begin, uint64_t end);
+
+    /* Remove everything and reclaim the code buffer, no other thread may be pinned or running translated code */
+    void flush();
+
+    /* Reclaim removed blocks, returns the number freed */
+    size_t collect() { return _epochs.collect(); }
+
+    /* Changes whenever blocks are removed */
+    [[nodiscard]] uint64_t generation() const { return _generation.load(std::memory_order_acquire); }
+
+    [[nodiscard]] size_t size();
+};
@@ -1,7 +1,9 @@
 #include <string>
 #include <vector>
+#include <optional>
 #include <filesystem>
 #include <ranges>
+#include <fstream>
 #include <algorithm>
 
 #include <iostream>
@@ -13,12 +15,23 @@
 #include <fmt/ostream.h>
 #include <fmt/chrono.h>
 
-#include <execution/elf_file.hpp>
+#include <util/elf_file.hpp>
+#include <execution/snapshot.hpp>
+#include <execution/fork_server.hpp>
+#include <execution/batch_runner.hpp>
+#include <execution/test_suite.hpp>
 
 namespace fs = std::filesystem;
 
 struct specter_options {
     fs::path executable;
+    fs::path restore;
+    fs::path fork_server;
+    fs::path batch;
+    size_t jobs = 0;
+    std::vector<std::string> tests;
+    fs::path junit;
+    fs::path csv;
     std::vector<std::string> argv;
     std::shared_ptr<cpptoml::table> config = nullptr;
     bool verbose;
@@ -30,12 +43,19 @@ struct specter_options {
             ("h,help", "Show help")
             ("v,verbose", "Enable verbose output", cxxopts::value<bool>()->default_value("false"))
             ("c,config", "Executor's config file (optional)", cxxopts::value<std::string>())
+            ("r,restore", "Continue from a snapshot instead of starting the executable", cxxopts::value<std::string>())
+            ("fork-server", "Load once and serve runs on a unix socket, or on stdin and stdout for -", cxxopts::value<std::string>())
+            ("b,batch", "Run the jobs listed in a TOML file concurrently", cxxopts::value<std::string>())
+            ("j,jobs", "Threads for --batch and --test, all cores by default", cxxopts::value<size_t>()->default_value("0"))
+            ("t,test", "Run the microtest configs in a directory or matching a glob", cxxopts::value<std::vector<std::string>>())
+            ("junit", "Write a JUnit report of --test", cxxopts::value<std::string>())
+            ("csv", "Write a CSV report of --test", cxxopts::value<std::string>())
             ("executable", "Input file to run", cxxopts::value<std::string>())
             ("argv", "Executable arguments", cxxopts::value<std::vector<std::string>>());
             ;
 
         options.parse_positional({ "executable", "argv" });
-        options.custom_help("[-v] [-c config.toml] <executable> [argv... ]");
+        options.custom_help("[-v] [-c config.toml] [-r snapshot] [--fork-server socket] <executable> [argv... ] | -b jobs.toml | -t tests... [--junit file] [--csv file]");
         options.positional_help("");
 
         specter_options opts;
@@ -50,6 +70,34 @@ struct specter_options {
 
             opts.verbose = res["verbose"].as<bool>();
 
+            /* A snapshot knows its executable and already has its arguments on the stack */
+            if (res.count("restore") > 0) {
+                opts.restore = res["restore"].as<std::string>();
+            }
+
+            if (res.count("fork-server") > 0) {
+                opts.fork_server = res["fork-server"].as<std::string>();
+            }
+
+            /* Jobs and tests bring their own executables */
+            opts.jobs = res["jobs"].as<size_t>();
+
+            if (res.count("batch") > 0) {
+                opts.batch = res["batch"].as<std::string>();
+            }
+
+            if (res.count("test") > 0) {
+                opts.tests = res["test"].as<std::vector<std::string>>();
+            }
+
+            if (res.count("junit") > 0) {
+                opts.junit = res["junit"].as<std::string>();
+            }
+
+            if (res.count("csv") > 0) {
+                opts.csv = res["csv"].as<std::string>();
+            }
+
             /* Parsed as follows:
              * if executable given in config file, use that as the executable's actual path
              * if no argv on command line but executable given in config file, use executable as argv[0]
@@ -89,7 +137,7 @@ struct specter_options {
                 if (!opts.executable.empty()) {
                     /* Use non-canonical executable as argv*/
                     opts.argv.push_back(executable);
-                } else {
+                } else if (opts.restore.empty() && opts.batch.empty() && opts.tests.empty()) {
                     throw;
                 }
             }
@@ -107,9 +155,111 @@ struct specter_options {
     }
 };
 
+/* Run the guest and report what stopped it, returns nothing if it was an error */
+[[nodiscard]] static std::optional<int> run_guest(executor& executor) {
+    try {
+        return executor.run();
+    } catch (illegal_access& e) {
+        fmt::print(std::cerr, "illegal_access: {}\n", e.what());
+    } catch (arch::illegal_instruction& e) {
+        fmt::print(std::cerr, "illegal_instruction: {}\n", e.what());
+    } catch (arch::invalid_syscall& e) {
+        fmt::print(std::cerr, "invalid syscall: {}\n", e.what());
+    } catch (arch::illegal_operation& e) {
+        fmt::print(std::cerr, "illegal operation: {}\n", e.what());
+    }
+
+    return std::nullopt;
+}
+
+/* Run all jobs of --batch, fails if any of them couldn't run to its end */
+[[nodiscard]] static int run_batch(const specter_options& opts) {
+    std::vector<batch_runner::job> jobs;
+
+    try {
+        jobs = batch_runner::load(opts.batch);
+    } catch (std::exception& e) {
+        fmt::print(std::cerr, "invalid job list: {}\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    batch_runner runner { opts.jobs };
+    auto results = runner.run(jobs);
+
+    int res = EXIT_SUCCESS;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const auto& result = results[i];
+
+        if (!result.error.empty()) {
+            fmt::print(std::cerr, "job {} ({}): {}\n", i, jobs[i].executable.string(), result.error);
+            res = EXIT_FAILURE;
+        } else {
+            fmt::print(std::cerr, "job {} ({}): exited with code {} after {} instructions in {}\n{}", i,
+                jobs[i].executable.string(), result.exit_code, result.instructions,
+                std::chrono::duration_cast<std::chrono::microseconds>(result.runtime), result.report);
+        }
+    }
+
+    return res;
+}
+
+/* Run the microtests of --test, fails unless all of them passed */
+[[nodiscard]] static int run_tests(const specter_options& opts) {
+    std::optional<test_suite> suite;
+
+    try {
+        suite.emplace(opts.tests);
+    } catch (std::exception& e) {
+        fmt::print(std::cerr, "invalid tests: {}\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    suite->run(opts.jobs);
+
+    for (const auto& t : suite->tests()) {
+        if (t.result != test_suite::status::passed) {
+            fmt::print(std::cerr, "{} {}:\n{}\n", magic_enum::enum_name(t.result), t.name, t.message);
+        }
+    }
+
+    auto write = [](const fs::path& path, auto&& writer) {
+        std::ofstream out { path };
+        writer(out);
+
+        if (!out) {
+            fmt::print(std::cerr, "could not write {}\n", path.string());
+        }
+    };
+
+    if (!opts.junit.empty()) {
+        write(opts.junit, [&](std::ostream& os) { suite->write_junit(os); });
+    }
+
+    if (!opts.csv.empty()) {
+        write(opts.csv, [&](std::ostream& os) { suite->write_csv(os); });
+    }
+
+    size_t passed = suite->count(test_suite::status::passed);
+
+    fmt::print(std::cerr, "{} of {} tests passed, {} failed, {} errors, {} skipped in {}\n",
+        passed, suite->tests().size(), suite->count(test_suite::status::failed),
+        suite->count(test_suite::status::error), suite->count(test_suite::status::skipped),
+        std::chrono::duration_cast<std::chrono::milliseconds>(suite->runtime()));
+
+    return (passed == suite->tests().size()) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int main(int argc, char** argv) {
     auto opts = specter_options::parse(argc, argv);
 
+    if (!opts.tests.empty()) {
+        return run_tests(opts);
+    }
+
+    if (!opts.batch.empty()) {
+        return run_batch(opts);
+    }
+
     std::unique_ptr<executor> executor;
     virtual_memory memory(std::endian::native);
     int res = 0;
@@ -139,37 +289,63 @@ int main(int argc, char** argv) {
     size_t read_before;
     size_t written_before;
     try {
-        elf_file elf { opts.executable };
+        std::optional<snapshot> snap;
+        if (!opts.restore.empty()) {
+            snap = snapshot::load(opts.restore, memory);
+        }
 
-        memory = elf.load();
+        elf_file elf { snap ? snap->executable : opts.executable };
 
-        executor = elf.make_executor(memory, elf.entry(), opts.config);
-        executor->setup_stack(opts.argv, env);
+        if (snap) {
+            executor = elf.make_executor(memory, elf.entry(), opts.config);
+            executor->restore(*snap);
+        } else {
+            memory = elf.load();
+            executor = elf.make_executor(memory, elf.entry(), opts.config);
+        }
+
+        if (!opts.fork_server.empty()) {
+            try {
+                /* A restored guest already has its arguments on the stack */
+                fork_server server { opts.fork_server, snap.has_value() };
+
+                server.serve([&](const fork_server::request& req) {
+                    if (!snap) {
+                        auto args = req.argv.empty() ? opts.argv : req.argv;
+                        auto vars = req.env.empty() ? env : req.env;
+
+                        executor->setup_stack(args, vars);
+                    }
+
+                    return run_guest(*executor).value_or(EXIT_FAILURE);
+                });
+            } catch (std::system_error& e) {
+                fmt::print(std::cerr, "fork server: {}\n", e.what());
+                return EXIT_FAILURE;
+            }
+
+            return EXIT_SUCCESS;
+        }
+
+        if (!snap) {
+            executor->setup_stack(opts.argv, env);
+        }
 
         read_before = memory.bytes_read();
         written_before = memory.bytes_written();
 
-        res = executor->run();
+        auto code = run_guest(*executor);
+        res = code.value_or(EXIT_FAILURE);
 
-        if (!testmode) {
+        if (code && !testmode) {
             fmt::print(std::cerr, "exited with code {}\n\n", res);
         }
-        
     } catch (invalid_file& e) {
         fmt::print(std::cerr, "invalid executable file: {}\n", e.what());
         return EXIT_FAILURE;
-    } catch (illegal_access& e) {
-        fmt::print(std::cerr, "illegal_access: {}\n", e.what());
-        res = EXIT_FAILURE;
-    } catch (arch::illegal_instruction& e) {
-        fmt::print(std::cerr, "illegal_instruction: {}\n", e.what());
-        res = EXIT_FAILURE;
-    } catch (arch::invalid_syscall& e) {
-        fmt::print(std::cerr, "invalid syscall: {}\n", e.what());
-        res = EXIT_FAILURE;
-    } catch (arch::illegal_operation& e) {
-        fmt::print(std::cerr, "illegal operation: {}\n", e.what());
-        res = EXIT_FAILURE;
+    } catch (invalid_snapshot& e) {
+        fmt::print(std::cerr, "invalid snapshot: {}\n", e.what());
+        return EXIT_FAILURE;
     }
 
     auto multiple = [](std::string_view text, size_t n) {
@@ -8,6 +8,7 @@
 #include <bit>
 #include <set>
 #include <stack>
+#include <optional>
 
 #include <cxxopts.hpp>
 #include <cpptoml.h>
@@ -93,13 +94,32 @@ int main(int argc, char** argv) {
         rv64::instruction_parser parser;
         std::vector<rv64::instruction_parser::parse_result> parsed;
 
+        /* Each instruction is held back until the next one, in case the two fuse */
+        std::optional<rv64::decoder> pending;
+
         for (const auto& instr : ingested) {
             std::visit(overloaded {
                 [] <std::unsigned_integral T> ([[maybe_unused]] rv64::decoder::udata<T> arg) { /* drop */ },
-                [&](const rv64::decoder& dec) { parsed.emplace_back(parser.parse(dec)); }
+                [&](const rv64::decoder& dec) {
+                    if (pending) {
+                        if (auto fused = parser.parse_fused(*pending, dec)) {
+                            parsed.emplace_back(std::move(fused));
+                            pending.reset();
+                            return;
+                        }
+
+                        parsed.emplace_back(parser.parse(*pending));
+                    }
+
+                    pending = dec;
+                }
             }, instr);
         }
 
+        if (pending) {
+            parsed.emplace_back(parser.parse(*pending));
+        }
+
         for (const auto& instr : parsed) {
             instr->dump(std::cerr);
             std::cerr << '\n';
@@ -191,18 +191,43 @@ virtual_memory elf_file::load() {
 
     uintptr_t heap_start = 0;
 
-    for (Elf64_Phdr& program : programs()) {
+    for (const Elf64_Phdr& program : programs()) {
         if (program.p_type == PT_LOAD) {
-            /* Only PT_LOAD needs to actually be mapped */
-            auto mem = std::make_unique<memory_backed_memory>(
-                std::endian::little,
-                static_cast<memory_backed_memory::permissions>(program.p_flags),
-                program.p_vaddr, program.p_memsz, std::align_val_t { program.p_align },
-                std::span<uint8_t>(_mapping.get_at<uint8_t>(program.p_offset), program.p_filesz),
-                "PT_LOAD"
-            );
-
-            res.add((program.p_flags & PF_X) ? virtual_memory::role::text : virtual_memory::role::generic, std::move(mem));
+            auto role = (program.p_flags & PF_X) ? virtual_memory::role::text : virtual_memory::role::generic;
+            std::unique_ptr<memory> mem;
+
+            /* Read-only segments are mapped from the file, every load of it shares the page cache's copy */
+            if (!(program.p_flags & PF_W) && program.p_filesz == program.p_memsz && program.p_filesz > 0
+                && program.p_offset % static_cast<size_t>(sysconf(_SC_PAGESIZE)) == 0
+                && program.p_offset + program.p_filesz <= _mapping.size()) {
+
+                int fd = detail::open_safe(_path);
+
+                try {
+                    mem = std::make_unique<mapped_memory>(
+                        std::endian::little,
+                        static_cast<mapped_memory::permissions>(program.p_flags),
+                        program.p_vaddr, program.p_memsz, fd, program.p_offset, false,
+                        "PT_LOAD"
+                    );
+                } catch (...) {
+                    close(fd);
+                    throw;
+                }
+
+                close(fd);
+            } else {
+                /* Only PT_LOAD needs to actually be mapped */
+                mem = std::make_unique<memory_backed_memory>(
+                    std::endian::little,
+                    static_cast<memory_backed_memory::permissions>(program.p_flags),
+                    program.p_vaddr, program.p_memsz, std::align_val_t { program.p_align },
+                    std::span<uint8_t>(_mapping.get_at<uint8_t>(program.p_offset), program.p_filesz),
+                    "PT_LOAD"
+                );
+            }
+
+            res.add(role, std::move(mem));
 
             // Heap starts after any loaded programs
             heap_start = std::max(heap_start, program.p_vaddr + program.p_memsz);
@@ -214,7 +239,10 @@ virtual_memory elf_file::load() {
     // Pad to account for up to 1 MiB pages
     heap_start = (heap_start + (1024*1024 - 1)) & uintptr_t(-(1024*1024));
 
-    res.add<virtual_memory::role::heap, growable_memory>(std::endian::little, heap_start, "heap");
+    /* Reserve host address space for the heap, it can grow at most up to the stack */
+    size_t heap_reservation = std::min<size_t>(stack_limit() - heap_start, growable_memory::default_reservation);
+
+    res.add<virtual_memory::role::heap, growable_memory>(std::endian::little, heap_start, heap_reservation, "heap");
 
     return res;
 }
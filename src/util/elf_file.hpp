@@ -89,6 +89,8 @@ class elf_file {
     public:
     elf_file(const std::filesystem::path& path);
 
+    [[nodiscard]] const std::filesystem::path& path() const { return _path; }
+
     [[nodiscard]] elf::arch_class arch_class() const;
     [[nodiscard]] elf::endian byte_order() const;
     [[nodiscard]] elf::abi abi() const;
@@ -0,0 +1,55 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    la s0, word
+    la s1, dword
+
+    li t0, 3
+    amoadd.w t1, t0, (s0)
+    lw t2, 0(s0)
+
+    li t0, -1
+    amoswap.d t3, t0, (s1)
+    ld t4, 0(s1)
+
+    # Signed and unsigned views of -1
+    li t0, 7
+    amomin.d t5, t0, (s1)
+    amominu.d t6, t0, (s1)
+
+    li t0, -4
+    amomax.w.aq s2, t0, (s0)
+    amomaxu.w.rl s3, t0, (s0)
+    lw s4, 0(s0)
+
+    li t0, 0xff
+    amoand.w.aqrl s5, t0, (s0)
+
+    li t0, 0x100
+    amoor.d s6, t0, (s1)
+    li t0, 0x3
+    amoxor.d s7, t0, (s1)
+    ld s8, 0(s1)
+
+    # Result discarded, memory still updated
+    li t0, -210
+    amoadd.w zero, t0, (s0)
+
+    fence rw, rw
+    fence.i
+
+    lw a0, 0(s0)
+    li a7, 93
+    ecall
+
+    .data
+    .align 4
+    .type word, @object
+word:
+    .word 5
+    .word 0
+    .type dword, @object
+dword:
+    .quad 10
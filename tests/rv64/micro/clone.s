@@ -0,0 +1,80 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    # Stack for the new thread
+    li a0, 0
+    li a1, 65536
+    li a2, 3        # PROT_READ | PROT_WRITE
+    li a3, 0x22     # MAP_PRIVATE | MAP_ANONYMOUS
+    li a4, -1
+    li a5, 0
+    li a7, 222      # mmap
+    ecall
+    li t0, 65536
+    add s1, a0, t0
+
+    # Cleared by the exiting thread
+    la s2, child_tid
+    li t0, 1
+    sw t0, 0(s2)
+
+    # CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD | CLONE_SYSVSEM
+    # | CLONE_PARENT_SETTID | CLONE_CHILD_CLEARTID
+    li a0, 0x00350f00
+    mv a1, s1
+    la a2, parent_tid
+    li a3, 0
+    mv a4, s2
+    li a7, 220      # clone
+    ecall
+    beqz a0, thread
+
+    mv s3, a0
+
+    # Wait for the thread like pthread_join
+wait:
+    lw t0, 0(s2)
+    beqz t0, joined
+    mv a0, s2
+    li a1, 0        # FUTEX_WAIT
+    mv a2, t0
+    li a3, 0
+    li a7, 98       # futex
+    ecall
+    j wait
+
+joined:
+    # s4 is 0 if the parent TID was written correctly
+    la t0, parent_tid
+    lw t1, 0(t0)
+    sub s4, t1, s3
+
+    la t0, counter
+    ld a0, 0(t0)
+    li a7, 94       # exit_group
+    ecall
+
+thread:
+    li t0, 42
+    la t1, counter
+loop:
+    ld t2, 0(t1)
+    addi t2, t2, 1
+    sd t2, 0(t1)
+    addi t0, t0, -1
+    bnez t0, loop
+
+    li a0, 0
+    li a7, 93       # exit
+    ecall
+
+    .data
+    .align 3
+counter:
+    .dword 0
+child_tid:
+    .word 0
+parent_tid:
+    .word 0
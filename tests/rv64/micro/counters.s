@@ -0,0 +1,33 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    # Every instruction retires once
+    rdinstret t0
+    nop
+    nop
+    rdinstret t1
+    sub s1, t1, t0
+
+    rdcycle t2
+    rdcycle t3
+    sub s2, t3, t2
+
+    # Time never goes backwards
+    rdtime t4
+    li t6, 1000
+1:
+    addi t6, t6, -1
+    bnez t6, 1b
+    rdtime t5
+    sltu s3, t5, t4
+    snez s4, t4
+
+    # Read-only counters can still be read through csrrs and csrrc
+    csrrc s5, instret, zero
+    sltu s6, t1, s5
+
+    li a0, 42
+    li a7, 93
+    ecall
@@ -0,0 +1,50 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    # Nothing raised yet
+    frflags t0
+
+    # 1.0 / 0.0 only divides by zero
+    li a1, 1
+    fcvt.d.l fa0, a1
+    fmv.d.x fa1, zero
+    fdiv.d fa2, fa0, fa1
+    frflags t1
+
+    # Flags accumulate, 1.0 / 3.0 is inexact
+    li a1, 3
+    fcvt.d.l fa3, a1
+    fdiv.d fa4, fa0, fa3
+    fsflags t2, zero
+    frflags t3
+
+    # sqrt(-1) is invalid, clear just that flag
+    fneg.d fa5, fa0
+    fsqrt.d fa6, fa5
+    csrrci t4, fflags, 0x10
+    frflags t5
+
+    # Dynamic rounding follows frm
+    csrrwi s1, frm, 2
+    fneg.d ft0, fa4
+    fcvt.l.d s2, ft0
+    frrm s3
+    fsrmi 3
+    fcvt.l.d s4, fa4
+
+    # fcsr holds both, frm above the flags
+    frcsr s5
+    li a2, 0x41
+    fscsr s6, a2
+    frrm s7
+    frflags s8
+
+    # Set bits with an immediate
+    csrrsi s9, fflags, 0x6
+    frflags s10
+
+    li a0, 42
+    li a7, 93
+    ecall
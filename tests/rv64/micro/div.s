@@ -16,4 +16,10 @@ _start:
     div s3, t3, t1
     div s4, t3, t4
 
+    # Divide by zero
+    div s5, t1, zero
+
+    # Overflow
+    div s6, t6, a1
+
     ecall
@@ -16,4 +16,7 @@ _start:
     divu s3, t3, t1
     divu s4, t4, t3
 
+    # Divide by zero
+    divu s5, t1, zero
+
     ecall
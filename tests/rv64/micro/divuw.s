@@ -0,0 +1,18 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    # Upper bits ignored
+    divuw s0, t5, t1
+
+    divuw s1, t0, t1
+
+    # Divide by zero
+    divuw s2, t1, t4
+
+    divuw s3, t3, t6
+
+    divuw s4, t6, t2
+
+    ecall
@@ -0,0 +1,20 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    # Upper bits ignored
+    divw s0, t5, t1
+
+    # Rounds towards zero
+    divw s1, t0, t1
+
+    # Divide by zero
+    divw s2, t1, t4
+
+    # Overflow
+    divw s3, t3, t6
+
+    divw s4, t2, t0
+
+    ecall
@@ -0,0 +1,67 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    la s0, values
+    fld fa0, 0(s0)
+    fld fa1, 8(s0)
+    fld fa2, 16(s0)
+    fld fa3, 24(s0)
+
+    fadd.d ft0, fa0, fa1
+    fmv.x.d t0, ft0
+
+    fsub.d ft1, fa0, fa1
+    fmv.x.d t1, ft1
+
+    fmul.d ft2, fa1, fa2
+    fmv.x.d t2, ft2
+
+    fdiv.d ft3, fa2, fa0
+    fmv.x.d t3, ft3
+
+    # Rounds down instead of to nearest
+    fdiv.d ft3, fa2, fa0, rdn
+    fmv.x.d t4, ft3
+
+    fsqrt.d ft4, fa1
+    fmv.x.d t5, ft4
+
+    fmsub.d ft5, fa0, fa1, fa2
+    fmv.x.d t6, ft5
+
+    fnmadd.d ft6, fa0, fa1, fa2
+    fmv.x.d s1, ft6
+
+    # Overflow to infinity, then the canonical NaN
+    fmul.d ft7, fa3, fa3
+    fmv.x.d s2, ft7
+    fsub.d ft8, ft7, ft7
+    fmv.x.d s3, ft8
+
+    fsd ft0, 32(s0)
+    ld s4, 32(s0)
+
+    # Single to double and back
+    fcvt.s.d ft9, fa0
+    fmv.x.d s5, ft9
+    fcvt.d.s ft10, ft9
+    fmv.x.d s6, ft10
+
+    fsgnjx.d ft11, fa0, fa2
+    fmv.x.d s7, ft11
+
+    li a0, 42
+    li a7, 93
+    ecall
+
+    .data
+    .align 4
+    .type values, @object
+values:
+    .double 1.5
+    .double 2.25
+    .double -4.0
+    .double 1e308
+    .quad 0
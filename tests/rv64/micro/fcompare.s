@@ -0,0 +1,55 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    la s0, values
+    fld fa0, 0(s0)
+    fld fa1, 8(s0)
+    fld fa2, 16(s0)
+    fld fa3, 24(s0)
+    fld fa4, 32(s0)
+
+    feq.d t0, fa0, fa0
+    flt.d t1, fa0, fa2
+    fle.d t2, fa2, fa0
+
+    # Comparisons with NaN are false
+    feq.d t3, fa3, fa3
+    flt.d t4, fa3, fa0
+
+    # -0.0 == +0.0, but min and max order them
+    feq.d t5, fa1, fa4
+    fmin.d ft0, fa1, fa4
+    fmv.x.d t6, ft0
+    fmax.d ft1, fa1, fa4
+    fmv.x.d s1, ft1
+
+    # The non-NaN operand wins
+    fmax.d ft2, fa3, fa0
+    fmv.x.d s2, ft2
+
+    fclass.d s3, fa0
+    fclass.d s4, fa1
+    fclass.d s5, fa3
+
+    # Single precision, an unboxed value is NaN
+    fmv.d.x ft3, zero
+    fmin.s ft4, ft3, ft3
+    fmv.x.w s6, ft4
+    fclass.s s7, ft3
+
+    li a0, 42
+    li a7, 93
+    ecall
+
+    .data
+    .align 4
+    .type values, @object
+values:
+    .double 1.5
+    .double -0.0
+    .double 3.0
+    # NaN
+    .quad 0x7ff8000000000000
+    .double 0.0
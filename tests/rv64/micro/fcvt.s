@@ -0,0 +1,57 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    la s0, values
+    fld fa0, 0(s0)
+    fld fa1, 8(s0)
+    fld fa2, 16(s0)
+    fld fa3, 24(s0)
+    flw fa4, 32(s0)
+
+    # 2.5 in every rounding mode
+    fcvt.w.d t0, fa0, rne
+    fcvt.w.d t1, fa0, rmm
+    fcvt.w.d t2, fa0, rdn
+    fcvt.w.d t3, fa0, rup
+    fcvt.w.d t4, fa0, rtz
+
+    # -2.5, ties away from zero
+    fcvt.l.d t5, fa1, rmm
+
+    # Out of range values saturate
+    fcvt.wu.d t6, fa1, rtz
+    fcvt.w.d s1, fa2, rtz
+    fcvt.l.d s2, fa3, rtz
+    fcvt.lu.d s3, fa2, rtz
+
+    # Single-precision source
+    fcvt.w.s s4, fa4, rtz
+
+    # Integer to float
+    li a1, -5
+    fcvt.d.l ft0, a1
+    fmv.x.d s5, ft0
+
+    li a1, -1
+    fcvt.s.wu ft1, a1
+    fmv.x.w s6, ft1
+
+    fcvt.s.l ft2, a1
+    fmv.x.w s7, ft2
+
+    li a0, 42
+    li a7, 93
+    ecall
+
+    .data
+    .align 4
+    .type values, @object
+values:
+    .double 2.5
+    .double -2.5
+    .double 1e10
+    # NaN
+    .quad 0x7ff8000000000001
+    .float -3.75
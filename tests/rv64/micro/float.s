@@ -0,0 +1,66 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    la s0, values
+    flw fa0, 0(s0)
+    flw fa1, 4(s0)
+    flw fa2, 8(s0)
+
+    fadd.s ft0, fa0, fa1
+    fmv.x.w t0, ft0
+
+    fsub.s ft1, fa0, fa1
+    fmv.x.w t1, ft1
+
+    fmul.s ft2, fa1, fa2
+    fmv.x.w t2, ft2
+
+    fdiv.s ft3, fa2, fa0
+    fmv.x.w t3, ft3
+
+    # Static rounding mode
+    fdiv.s ft3, fa2, fa0, rtz
+    fmv.x.w t4, ft3
+
+    fsqrt.s ft4, fa1
+    fmv.x.w t5, ft4
+
+    # Fused, single rounding
+    fmadd.s ft5, fa0, fa1, fa2
+    fmv.x.w t6, ft5
+
+    fnmsub.s ft6, fa0, fa1, fa2
+    fmv.x.w s1, ft6
+
+    # An unboxed value reads as the canonical NaN
+    fmv.d.x ft7, zero
+    fadd.s ft8, ft7, fa0
+    fmv.x.w s2, ft8
+
+    # Stores write the raw lower half, registers hold the NaN-boxed value
+    fsw ft0, 12(s0)
+    lw s3, 12(s0)
+    fmv.x.d s4, fa0
+
+    fsgnjn.s ft9, fa0, fa0
+    fmv.x.w s5, ft9
+
+    # Integer moves are NaN-boxed as well
+    li t0, 0x40490fdb
+    fmv.w.x ft10, t0
+    fmv.x.d s6, ft10
+
+    li a0, 42
+    li a7, 93
+    ecall
+
+    .data
+    .align 4
+    .type values, @object
+values:
+    .float 1.5
+    .float 2.25
+    .float -4.0
+    .word 0
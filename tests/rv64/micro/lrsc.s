@@ -0,0 +1,44 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    la s0, dword
+    la s1, word
+
+    lr.d t0, (s0)
+    addi t0, t0, 41
+    sc.d t1, t0, (s0)
+
+    # No reservation left
+    sc.d t2, t0, (s0)
+
+    lr.w t3, (s1)
+    sc.w.rl t4, zero, (s1)
+    lw t5, 0(s1)
+
+    # A changed value breaks the reservation
+    lr.d.aq t6, (s0)
+    li s2, 7
+    sd s2, 0(s0)
+    sc.d s3, t6, (s0)
+    ld s4, 0(s0)
+
+    # Retry loop as used by compilers
+1:
+    lr.w a0, (s1)
+    addi a0, a0, 42
+    sc.w a1, a0, (s1)
+    bnez a1, 1b
+
+    li a7, 93
+    ecall
+
+    .data
+    .align 4
+    .type dword, @object
+dword:
+    .quad 1
+    .type word, @object
+word:
+    .word -1
@@ -0,0 +1,19 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    # Mixed signs
+    mulh s0, t0, t1
+
+    # Largest positive
+    mulh s1, t2, t2
+
+    # Most negative
+    mulh s2, t3, t3
+
+    mulh s3, t3, t2
+
+    mulh s4, t5, t6
+
+    ecall
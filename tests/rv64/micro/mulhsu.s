@@ -0,0 +1,18 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    # Negative times unsigned
+    mulhsu s0, t0, t1
+
+    # -1 times 2^64 - 1
+    mulhsu s1, t6, t6
+
+    mulhsu s2, t2, t6
+
+    mulhsu s3, t3, t3
+
+    mulhsu s4, t5, t0
+
+    ecall
@@ -0,0 +1,17 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    # Large unsigned values
+    mulhu s0, t0, t1
+
+    mulhu s1, t6, t6
+
+    mulhu s2, t2, t2
+
+    mulhu s3, t3, t1
+
+    mulhu s4, t5, t5
+
+    ecall
@@ -0,0 +1,18 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    # Upper bits ignored
+    mulw s0, t0, t1
+
+    # Overflowing 32 bits
+    mulw s1, t2, t2
+
+    mulw s2, t3, t6
+
+    mulw s3, t5, t1
+
+    mulw s4, t5, t5
+
+    ecall
@@ -16,4 +16,10 @@ _start:
     rem s3, t3, t1
     rem s4, t3, t4
 
+    # Divide by zero
+    rem s5, t1, zero
+
+    # Overflow
+    rem s6, t6, a1
+
     ecall
@@ -16,4 +16,7 @@ _start:
     remu s3, t3, t1
     remu s4, t4, t3
 
+    # Divide by zero
+    remu s5, t1, zero
+
     ecall
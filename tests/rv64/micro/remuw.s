@@ -0,0 +1,18 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    # Upper bits ignored
+    remuw s0, t5, t1
+
+    remuw s1, t0, t1
+
+    # Divide by zero
+    remuw s2, t0, t4
+
+    remuw s3, t3, t6
+
+    remuw s4, t6, t2
+
+    ecall
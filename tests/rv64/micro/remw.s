@@ -0,0 +1,20 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    # Upper bits ignored
+    remw s0, t5, t1
+
+    # Sign follows the dividend
+    remw s1, t0, t1
+
+    # Divide by zero
+    remw s2, t1, t4
+
+    # Overflow
+    remw s3, t3, t6
+
+    remw s4, t2, t0
+
+    ecall
@@ -0,0 +1,104 @@
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    # SIGUSR1 goes to handler, with SA_SIGINFO
+    li a0, 10
+    la a1, action
+    li a2, 0
+    li a3, 8
+    li a7, 134      # rt_sigaction
+    ecall
+
+    # SIGUSR2 is ignored
+    li a0, 12
+    la a1, ignore
+    li a2, 0
+    li a3, 8
+    li a7, 134      # rt_sigaction
+    ecall
+
+    # Must survive the handler
+    li s2, 0x1234
+
+    li a0, 1
+    li a1, 1
+    li a2, 10       # SIGUSR1
+    li a7, 131      # tgkill
+    ecall
+    mv s6, a0
+
+    li a0, 1
+    li a1, 12       # SIGUSR2
+    li a7, 129      # kill
+    ecall
+
+    # Blocked signals stay pending until they're unblocked
+    la t0, set
+    li t1, 0x200    # SIGUSR1
+    sd t1, 0(t0)
+    li a0, 0        # SIG_BLOCK
+    mv a1, t0
+    li a2, 0
+    li a3, 8
+    li a7, 135      # rt_sigprocmask
+    ecall
+
+    li a0, 1
+    li a1, 1
+    li a2, 10       # SIGUSR1
+    li a7, 131      # tgkill
+    ecall
+
+    la t0, counter
+    ld s7, 0(t0)
+
+    li a0, 1        # SIG_UNBLOCK
+    la a1, set
+    li a2, 0
+    li a3, 8
+    li a7, 135      # rt_sigprocmask
+    ecall
+
+    la t0, counter
+    ld s3, 0(t0)
+    la t0, seen
+    ld s4, 0(t0)
+    mv s5, s2
+
+    mv a0, s3
+    li a7, 94       # exit_group
+    ecall
+
+handler:
+    la t0, counter
+    ld t1, 0(t0)
+    addi t1, t1, 1
+    sd t1, 0(t0)
+
+    # The signal number, from the argument and from the siginfo
+    lw t1, 0(a1)
+    add t1, t1, a0
+    la t0, seen
+    sd t1, 0(t0)
+
+    li s2, 0
+    ret
+
+    .data
+    .align 3
+action:
+    .dword handler
+    .dword 4        # SA_SIGINFO
+    .dword 0
+ignore:
+    .dword 1        # SIG_IGN
+    .dword 0
+    .dword 0
+set:
+    .dword 0
+counter:
+    .dword 0
+seen:
+    .dword 0
@@ -0,0 +1,75 @@
+    .option arch, +v
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    la s0, src
+    la s1, dst
+
+    # VLEN is 128, so 8 elements fit in two registers
+    li t0, 8
+    vsetvli t1, t0, e32, m2, ta, ma
+    vle32.v v2, (s0)
+    vadd.vi v4, v2, 3
+    vmul.vv v6, v2, v4
+    vse32.v v6, (s1)
+    lw s3, 28(s1)
+
+    # Sum of i * (i + 3) for 1 to 8
+    vmv.v.i v8, 0
+    vredsum.vs v8, v6, v8
+    vmv.x.s s2, v8
+
+    # Only the elements above 4
+    vmsgt.vi v0, v2, 4
+    vcpop.m s4, v0
+    vfirst.m s5, v0
+    vmv.v.i v10, 0
+    vadd.vx v10, v2, t0, v0.t
+    vredsum.vs v12, v10, v8
+    vmv.x.s s6, v12
+
+    # Every other element
+    li t2, 8
+    vsetivli zero, 4, e32, m1, ta, ma
+    vlse32.v v14, (s0), t2
+    vmv.s.x v15, zero
+    vredsum.vs v15, v14, v15
+    vmv.x.s s7, v15
+
+    vid.v v16
+    vslidedown.vi v17, v16, 1
+    vslide1up.vx v18, v16, t0
+    vmv.x.s s8, v17
+    vmv.x.s s9, v18
+
+    # vl is clipped to VLMAX
+    li t3, 100
+    vsetvli s10, t3, e8, m1, ta, ma
+    csrr s11, vlenb
+
+    # Division by zero like the scalar instructions
+    vsetivli zero, 2, e64, m1, ta, ma
+    vmv.v.i v20, 7
+    vmv.v.i v21, 0
+    vdivu.vv v22, v20, v21
+    vrem.vv v23, v20, v21
+    vmv.x.s t4, v22
+    vmv.x.s t5, v23
+
+    # Negative results of narrow elements are sign-extended
+    vsetivli zero, 1, e16, m1, ta, ma
+    vrsub.vi v24, v20, 0
+    vmv.x.s t6, v24
+
+    li a0, 42
+    li a7, 93
+    ecall
+
+    .data
+    .align 4
+src:
+    .word 1, 2, 3, 4, 5, 6, 7, 8
+dst:
+    .zero 32
@@ -0,0 +1,64 @@
+    .option arch, +v
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    la s0, singles
+    la s1, doubles
+    flw fa0, 16(s0)
+    flw fa2, 20(s0)
+
+    vsetivli zero, 4, e32, m1, ta, ma
+    vle32.v v1, (s0)
+
+    # 0.5 + i * i
+    vfmv.v.f v3, fa0
+    vfmacc.vv v3, v1, v1
+    vmv.s.x v4, zero
+    vfredosum.vs v4, v3, v4
+    vfmv.f.s fa1, v4
+    fmv.x.w s7, fa1
+    vfredmin.vs v5, v3, v3
+    vfmv.f.s fa1, v5
+    fmv.x.w s3, fa1
+
+    # Elements below 2.5
+    vmflt.vf v0, v1, fa2
+    vcpop.m s2, v0
+
+    # Half of the selected elements, the rest stays
+    vmv.v.v v6, v1
+    vfmul.vf v6, v1, fa0, v0.t
+    vfredusum.vs v7, v6, v4
+    vfmv.f.s fa1, v7
+    fmv.x.w s6, fa1
+
+    vsetivli zero, 2, e64, m1, ta, ma
+    vle64.v v8, (s1)
+
+    # Absolute values
+    vfsgnjx.vv v9, v8, v8
+    vmv.s.x v10, zero
+    vfredusum.vs v10, v9, v10
+    vfmv.f.s fa3, v10
+    fmv.x.d s4, fa3
+
+    # 0 / 0 gives the canonical NaN
+    vmv.v.i v12, 0
+    vfdiv.vv v13, v12, v12
+    vfmv.f.s fa4, v13
+    fmv.x.d s5, fa4
+
+    li a0, 42
+    li a7, 93
+    ecall
+
+    .data
+    .align 4
+singles:
+    .float 1.0, 2.0, 3.0, 4.0
+    .float 0.5, 2.5
+    .align 3
+doubles:
+    .double 1.5, -2.25
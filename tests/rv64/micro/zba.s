@@ -0,0 +1,22 @@
+    .option arch, +zba
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    # Array indexing
+    sh1add s0, t0, t1
+    sh2add s1, t0, t1
+    sh3add s2, t0, t1
+
+    # The uw forms only look at the lower 32 bits of the index
+    sh1add.uw s3, t2, t1
+    sh2add.uw s4, t2, t1
+    sh3add.uw s5, t2, t1
+    add.uw s6, t2, t1
+    zext.w s7, t2
+    slli.uw s8, t2, 4
+
+    li a0, 42
+    li a7, 93
+    ecall
@@ -0,0 +1,44 @@
+    .option arch, +zbb
+    .text
+    .align 4
+    .global _start
+    .type   _start, @function
+_start:
+    # Logic with negated operand
+    andn s0, t0, t1
+    orn s1, t0, t1
+    xnor s2, t0, t1
+
+    # Counts, a zero input counts every bit
+    clz s3, t0
+    ctz s4, t0
+    cpop s5, t0
+    clz s6, zero
+    clzw s7, t0
+    ctzw s8, zero
+    cpopw s9, t2
+
+    # Signed and unsigned minimum and maximum
+    min s10, t2, t0
+    minu s11, t2, t0
+    max t3, t2, t0
+    maxu t4, t2, t0
+
+    # Extensions
+    sext.b a1, t1
+    sext.h a2, t1
+    zext.h a3, t2
+
+    # Rotates
+    rol a4, t0, t1
+    rori a5, t0, 8
+    roriw a6, t0, 4
+    rorw t5, t2, t0
+
+    # Byte operations
+    orc.b t6, t1
+    rev8 ra, t0
+
+    li a0, 42
+    li a7, 93
+    ecall
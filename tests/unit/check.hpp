@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdlib>
+#include <source_location>
+
+#include <fmt/core.h>
+
+/* assert() that stays in release builds, the unit tests are plain executables */
+inline void check(bool cond, const char* expr, std::source_location loc = std::source_location::current()) {
+    if (!cond) {
+        fmt::print(stderr, "{}:{}: check failed: {}\n", loc.file_name(), loc.line(), expr);
+        std::exit(1);
+    }
+}
+
+#define CHECK(expr) check(static_cast<bool>(expr), #expr)
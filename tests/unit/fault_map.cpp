@@ -0,0 +1,115 @@
+#include "check.hpp"
+
+#include <recompilation/fault_map.hpp>
+#include <recompilation/native_fault.hpp>
+#include <recompilation/translation_cache.hpp>
+
+#include <algorithm>
+#include <array>
+
+#include <setjmp.h>
+#include <signal.h>
+
+namespace {
+    using kind = reg_location::kind;
+
+    void lookup() {
+        std::array<fault_map::live_reg, 2> first {{
+            { 10, { kind::host, 3 } },
+            { 42, { kind::spill, 16 } }
+        }};
+
+        std::array<fault_map::live_reg, 1> last {{
+            { 63, { kind::spill, 4096 } }
+        }};
+
+        fault_map::builder builder;
+        builder.add(4, 0, first);
+        builder.add(19, 8, {});
+        builder.add(300, 1000, last);
+
+        fault_map map = builder.finish();
+
+        auto site = map.find(4);
+        CHECK(site.has_value());
+        CHECK(site->guest_offset == 0);
+        CHECK(site->regs[10].where == kind::host && site->regs[10].index == 3);
+        CHECK(site->regs[42].where == kind::spill && site->regs[42].index == 16);
+        CHECK(site->regs[0].where == kind::context);
+
+        /* Registers are listed per site, nothing carries over from the one before */
+        site = map.find(19);
+        CHECK(site.has_value());
+        CHECK(site->guest_offset == 8);
+        CHECK(std::ranges::all_of(site->regs, [](const reg_location& loc) { return loc.where == kind::context; }));
+
+        site = map.find(300);
+        CHECK(site.has_value());
+        CHECK(site->guest_offset == 1000);
+        CHECK(site->regs[63].where == kind::spill && site->regs[63].index == 4096);
+
+        /* Only the first byte of a faulting instruction has a site */
+        CHECK(!map.find(0));
+        CHECK(!map.find(5));
+        CHECK(!map.find(301));
+        CHECK(!fault_map {}.find(0));
+    }
+
+#if defined(__x86_64__)
+    /* Runs a block that loads from address 0 and checks the guest state the handler recovers */
+    void native() {
+        translation_cache cache { 1 << 20 };
+        native_fault faults { cache };
+
+        /* mov ecx, 0x1234; mov rax, [0]; ret */
+        static constexpr std::array<uint8_t, 14> code {
+            0xb9, 0x34, 0x12, 0x00, 0x00,
+            0x48, 0x8b, 0x04, 0x25, 0x00, 0x00, 0x00, 0x00,
+            0xc3
+        };
+
+        auto alloc = cache.code().allocate(code.size());
+        CHECK(alloc.has_value());
+        std::ranges::copy(code, alloc->code.begin());
+
+        /* Guest a0 is in rcx at the load, which is the block's fourth guest instruction */
+        std::array<fault_map::live_reg, 1> live {{ { 10, { kind::host, 1 } } }};
+        fault_map::builder builder;
+        builder.add(5, 12, live);
+
+        const translated_block* block = cache.insert(0x10000, 16, *alloc, builder.finish());
+
+        auto handle = cache.join();
+        epoch_domain::guard pinned { handle };
+
+        std::array<uint64_t, fault_map::guest_regs> regs {};
+        native_fault::frame frame { regs };
+        frame.block = block;
+
+        native_fault::scope scope { frame };
+
+        if (sigsetjmp(frame.recover, 0) == 0) {
+            reinterpret_cast<void (*)()>(const_cast<void*>(block->entry))();
+            CHECK(!"the load didn't fault");
+        }
+
+        CHECK(frame.pc == 0x1000c);
+        CHECK(frame.signal == SIGSEGV);
+        CHECK(frame.fault_addr == 0);
+        CHECK(regs[10] == 0x1234);
+
+        /* Faults outside translated code aren't recovered, find_code doesn't claim them */
+        CHECK(cache.find_code(reinterpret_cast<const void*>(&lookup)) == nullptr);
+    }
+#endif
+}
+
+int main() {
+    lookup();
+
+#if defined(__x86_64__)
+    native();
+#endif
+
+    return 0;
+}
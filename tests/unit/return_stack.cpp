@@ -0,0 +1,58 @@
+#include "check.hpp"
+
+#include <recompilation/translation_cache.hpp>
+
+#include <vector>
+
+namespace {
+    constexpr uint64_t base = 0x10000;
+
+    /* Deeper than the stack, so the oldest entries get overwritten */
+    constexpr uint64_t calls = 80;
+    constexpr uint64_t depth = 64;
+}
+
+int main() {
+    translation_cache cache { 1 << 20 };
+    auto handle = cache.join();
+    epoch_domain::guard pinned { handle };
+
+    std::vector<const translated_block*> blocks;
+    for (uint64_t i = 0; i < calls; i++) {
+        auto code = cache.code().allocate(16);
+        CHECK(code.has_value());
+        blocks.push_back(cache.insert(base + i * 4, 4, *code));
+    }
+
+    translation_cache::return_stack returns { cache };
+
+    /* Underflow predicts nothing, and the stack keeps working after */
+    CHECK(returns.pop(base) == nullptr);
+    returns.push(base, blocks[0]);
+    CHECK(returns.pop(base) == blocks[0]);
+
+    /* Overflow keeps the newest entries, returns past them fall back */
+    for (uint64_t i = 0; i < calls; i++) {
+        returns.push(base + i * 4, blocks[i]);
+    }
+
+    for (uint64_t i = calls; i-- > 0;) {
+        const translated_block* expected = (i >= calls - depth) ? blocks[i] : nullptr;
+        CHECK(returns.pop(base + i * 4) == expected);
+    }
+
+    /* A return somewhere else than the call pushed, like longjmp */
+    returns.push(base, blocks[0]);
+    CHECK(returns.pop(base + 4) == nullptr);
+
+    /* Return addresses pushed before they were translated are looked up on return */
+    returns.push(base + 8, nullptr);
+    CHECK(returns.pop(base + 8) == blocks[2]);
+
+    /* Invalidating anything drops the predictions, the pushed blocks may be gone */
+    returns.push(base + 12, blocks[3]);
+    CHECK(cache.invalidate(base + 12, base + 16) == 1);
+    CHECK(returns.pop(base + 12) == nullptr);
+
+    return 0;
+}
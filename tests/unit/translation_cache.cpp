@@ -0,0 +1,130 @@
+#include "check.hpp"
+
+#include <recompilation/translation_cache.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+    constexpr uint64_t base = 0x10000;
+    constexpr uint64_t blocks = 6000;
+
+    /* Fills the block's code with the low byte of its pc, so readers can tell a freed block by its contents */
+    const translated_block* insert(translation_cache& cache, uint64_t pc) {
+        auto code = cache.code().allocate(16);
+        CHECK(code.has_value());
+
+        std::ranges::fill(code->code, static_cast<uint8_t>(pc >> 2));
+        return cache.insert(pc, 4, *code);
+    }
+
+    void basics(translation_cache& cache) {
+        auto handle = cache.join();
+
+        {
+            epoch_domain::guard pinned { handle };
+
+            auto* block = insert(cache, base);
+            CHECK(cache.lookup(base) == block);
+            CHECK(cache.lookup(base + 4) == nullptr);
+
+            /* The loser of a race gets the winner's block */
+            CHECK(insert(cache, base) == block);
+
+            auto* entry = static_cast<const uint8_t*>(block->entry);
+            CHECK(cache.find_code(entry + 15) == block);
+            CHECK(cache.find_code(entry + 16) != block);
+        }
+
+        /* A reader pinned before the block was removed may still use it */
+        {
+            epoch_domain::guard pinned { handle };
+            auto* block = cache.lookup(base);
+
+            uint64_t generation = cache.generation();
+            CHECK(cache.invalidate(base + 2, base + 3) == 1);
+            CHECK(cache.generation() != generation);
+            CHECK(cache.invalidate(base, base + 4) == 0);
+
+            CHECK(cache.lookup(base) == nullptr);
+            CHECK(cache.collect() == 0);
+            CHECK(block->guest_pc == base);
+        }
+
+        CHECK(cache.collect() == 1);
+    }
+
+    /* Readers look blocks up and read their code while writers insert, invalidate and reclaim.
+     * Growing the table past its initial size retires the old table along the way.
+     */
+    void concurrent(translation_cache& cache) {
+        std::atomic<bool> stop { false };
+        std::atomic<uint64_t> found { 0 };
+
+        std::vector<std::thread> readers;
+        for (int i = 0; i < 3; i++) {
+            readers.emplace_back([&] {
+                auto handle = cache.join();
+                translation_cache::jump_cache jumps { cache };
+
+                while (!stop.load(std::memory_order_relaxed)) {
+                    epoch_domain::guard pinned { handle };
+
+                    for (uint64_t pc = base; pc < base + blocks * 4; pc += 4) {
+                        const translated_block* block = (pc % 8) ? cache.lookup(pc) : jumps.lookup(pc);
+
+                        if (block) {
+                            CHECK(block->guest_pc == pc);
+                            CHECK(*static_cast<const uint8_t*>(block->entry) == static_cast<uint8_t>(pc >> 2));
+                            found.fetch_add(1, std::memory_order_relaxed);
+                        }
+                    }
+                }
+            });
+        }
+
+        std::vector<std::thread> writers;
+        for (uint64_t w = 0; w < 2; w++) {
+            writers.emplace_back([&, w] {
+                for (int round = 0; round < 4; round++) {
+                    for (uint64_t i = w; i < blocks; i += 2) {
+                        insert(cache, base + i * 4);
+                    }
+
+                    for (uint64_t i = w * 64; i < blocks; i += 128) {
+                        cache.invalidate(base + i * 4, base + (i + 32) * 4);
+                        cache.collect();
+                    }
+                }
+            });
+        }
+
+        for (auto& t : writers) {
+            t.join();
+        }
+
+        stop.store(true);
+        for (auto& t : readers) {
+            t.join();
+        }
+
+        CHECK(found.load() > 0);
+
+        /* Everything removed is reclaimed once the readers are gone */
+        cache.invalidate(0, ~uint64_t { 0 });
+        cache.collect();
+        CHECK(cache.size() == 0);
+        CHECK(cache.collect() == 0);
+    }
+}
+
+int main() {
+    translation_cache cache { 64 << 20 };
+
+    basics(cache);
+    concurrent(cache);
+
+    return 0;
+}